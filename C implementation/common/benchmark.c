@@ -0,0 +1,621 @@
+// benchmark.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "benchmark.h"
+#include "thread_pool.h"
+
+// Each STREAM array holds 2^STREAM_QUBITS doubles (128 MiB), far beyond any cache
+#define STREAM_QUBITS 24
+#define STREAM_REPEATS 5
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double* sorted, int count, double fraction) {
+    int rank = (int)(fraction * (count - 1) + 0.5);
+    return sorted[rank];
+}
+
+bool bench_measure(BenchBody body, void* context, int warmup, int trials, BenchStats* stats) {
+    if (!body || warmup < 0 || trials < 1 || !stats) {
+        fprintf(stderr, "Error: Invalid parameters for benchmark measurement\n");
+        return false;
+    }
+    // Double the calls per trial until one trial is long enough; these runs also warm up
+    long calls = 1;
+    for (;;) {
+        double start_time = wall_clock_seconds();
+        for (long c = 0; c < calls; c++) body(context);
+        if (wall_clock_seconds() - start_time >= BENCH_MIN_TRIAL_SECONDS) break;
+        calls *= 2;
+    }
+    return bench_measure_calls(body, context, warmup, trials, calls, stats);
+}
+
+bool bench_measure_calls(BenchBody body, void* context, int warmup, int trials, long calls, BenchStats* stats) {
+    if (!body || warmup < 0 || trials < 1 || calls < 1 || !stats) {
+        fprintf(stderr, "Error: Invalid parameters for benchmark measurement\n");
+        return false;
+    }
+    double* times = malloc((size_t)trials * sizeof(double));
+    if (!times) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    for (int w = 0; w < warmup; w++) {
+        for (long c = 0; c < calls; c++) body(context);
+    }
+
+    double sum = 0.0;
+    for (int t = 0; t < trials; t++) {
+        double start_time = wall_clock_seconds();
+        for (long c = 0; c < calls; c++) body(context);
+        times[t] = (wall_clock_seconds() - start_time) / (double)calls;
+        sum += times[t];
+    }
+    qsort(times, (size_t)trials, sizeof(double), compare_doubles);
+
+    stats->trials = trials;
+    stats->calls_per_trial = calls;
+    stats->min = times[0];
+    stats->p10 = percentile(times, trials, 0.10);
+    stats->median = percentile(times, trials, 0.50);
+    stats->p90 = percentile(times, trials, 0.90);
+    stats->max = times[trials - 1];
+    stats->mean = sum / trials;
+    free(times);
+    return true;
+}
+
+bool bench_measure_run(BenchBody body, void* context, BenchStats* stats) {
+    return bench_measure(body, context, BENCH_RUN_WARMUP, BENCH_RUN_TRIALS, stats);
+}
+
+void bench_ops_body(void* context) {
+    const BenchOpsRun* run = context;
+    for (int i = 0; i < run->circuit->num_ops; i++) apply_circuit_op(run->sv, &run->circuit->ops[i], NULL);
+}
+
+void bench_plan_body(void* context) {
+    const BenchPlanRun* run = context;
+    execute_plan(run->plan, run->sv, NULL);
+}
+
+// STREAM triad
+
+typedef struct {
+    double* a;
+    double* b;
+    double* c;
+    double scalar;
+} TriadJob;
+
+static void triad_fill_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const TriadJob* job = context;
+    for (size_t i = begin; i < end; i++) {
+        job->a[i] = 1.0;
+        job->b[i] = 2.0;
+        job->c[i] = 0.5;
+    }
+}
+
+static void triad_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const TriadJob* job = context;
+    for (size_t i = begin; i < end; i++) {
+        job->a[i] = job->b[i] + job->scalar * job->c[i];
+    }
+}
+
+static int stream_threads = 0;
+static double stream_bandwidth = 0.0;
+
+double stream_triad_bandwidth(void) {
+    if (stream_threads == thread_pool_get_num_threads()) return stream_bandwidth;
+
+    size_t count = (size_t)1 << STREAM_QUBITS;
+    double* a = malloc(count * sizeof(double));
+    double* b = malloc(count * sizeof(double));
+    double* c = malloc(count * sizeof(double));
+    if (!a || !b || !c) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(a);
+        free(b);
+        free(c);
+        return 0.0;
+    }
+    // Fill in parallel so that each thread's pages are local to it
+    TriadJob job = {a, b, c, 3.0};
+    parallel_for(count, triad_fill_task, &job);
+
+    double best = -1.0;
+    for (int r = 0; r < STREAM_REPEATS; r++) {
+        double start_time = wall_clock_seconds();
+        parallel_for(count, triad_task, &job);
+        double time_taken = wall_clock_seconds() - start_time;
+        if (best < 0 || time_taken < best) best = time_taken;
+    }
+    free(a);
+    free(b);
+    free(c);
+
+    stream_threads = thread_pool_get_num_threads();
+    stream_bandwidth = 3.0 * sizeof(double) * (double)count / best * 1e-9;
+    return stream_bandwidth;
+}
+
+size_t circuit_op_bytes(const CircuitOp* op, int num_qubits) {
+    size_t touched = (size_t)1 << num_qubits;
+    if (op->control != NO_CONTROL) touched /= 2;
+    if (op->op == OP_Z || op->op == OP_S || op->op == OP_T || op->op == OP_CZ) touched /= 2;
+    return 2 * touched * BYTES_PER_AMPLITUDE;  // read and written once
+}
+
+// Suite
+
+typedef struct {
+    char host[64];
+    char cpu[128];
+    char compiler[128];
+    char timestamp[32];
+    long num_cpus;
+    int num_threads;
+    const char* simd;
+    double stream_gbs;
+} MachineInfo;
+
+typedef struct {
+    const char* kind;  // "circuit" or "gate"
+    const char* gate;
+    int target;
+    int control;
+    int num_qubits;
+    BenchStats stats;
+    size_t bytes;
+} BenchRecord;
+
+static void read_cpu_model(char* model, size_t size) {
+    snprintf(model, size, "unknown");
+    FILE* file = fopen("/proc/cpuinfo", "r");
+    if (!file) return;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "model name", 10) != 0) continue;
+        const char* value = strchr(line, ':');
+        if (!value) break;
+        value++;
+        while (*value == ' ') value++;
+        snprintf(model, size, "%s", value);
+        model[strcspn(model, "\n")] = '\0';
+        break;
+    }
+    fclose(file);
+}
+
+static void collect_machine_info(MachineInfo* info) {
+    if (gethostname(info->host, sizeof(info->host)) != 0) snprintf(info->host, sizeof(info->host), "unknown");
+    info->host[sizeof(info->host) - 1] = '\0';
+    read_cpu_model(info->cpu, sizeof(info->cpu));
+#if defined(__clang__)
+    snprintf(info->compiler, sizeof(info->compiler), "%s", __VERSION__);  // already names clang
+#elif defined(__GNUC__)
+    snprintf(info->compiler, sizeof(info->compiler), "gcc %s", __VERSION__);
+#else
+    snprintf(info->compiler, sizeof(info->compiler), "unknown");
+#endif
+    time_t now = time(NULL);
+    strftime(info->timestamp, sizeof(info->timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    info->num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    info->num_threads = thread_pool_get_num_threads();
+    info->simd = simd_level_name(get_simd_level());
+    info->stream_gbs = stream_triad_bandwidth();
+}
+
+// Writes text as a JSON string, escaping the characters JSON does not allow raw
+static void write_json_string(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* p = text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(file, "\\%c", *p);
+        } else if ((unsigned char)*p < 0x20) {
+            fprintf(file, "\\u%04x", *p);
+        } else {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static double record_gbs(const BenchRecord* record) {
+    return record->stats.median > 0 ? (double)record->bytes / record->stats.median * 1e-9 : 0.0;
+}
+
+static bool write_json_report(const char* path, const char* backend, const MachineInfo* info,
+                              const BenchRecord* records, int num_records) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"backend\": ");
+    write_json_string(file, backend);
+    fprintf(file, ",\n  \"timestamp\": \"%s\",\n  \"machine\": {\n    \"host\": ", info->timestamp);
+    write_json_string(file, info->host);
+    fprintf(file, ",\n    \"cpu\": ");
+    write_json_string(file, info->cpu);
+    fprintf(file, ",\n    \"num_cpus\": %ld,\n    \"stream_triad_gbs\": %.3f\n  },\n  \"compiler\": ", info->num_cpus,
+            info->stream_gbs);
+    write_json_string(file, info->compiler);
+    fprintf(file, ",\n  \"threads\": %d,\n  \"simd\": \"%s\",\n  \"results\": [\n", info->num_threads, info->simd);
+
+    for (int i = 0; i < num_records; i++) {
+        const BenchRecord* r = &records[i];
+        double gbs = record_gbs(r);
+        fprintf(file,
+                "    {\"kind\": \"%s\", \"gate\": \"%s\", \"num_qubits\": %d, \"target\": %d, \"control\": %d, "
+                "\"trials\": %d, \"calls_per_trial\": %ld, \"min_s\": %.9e, \"p10_s\": %.9e, \"median_s\": %.9e, "
+                "\"p90_s\": %.9e, \"max_s\": %.9e, \"mean_s\": %.9e, \"bytes\": %zu, \"gbs\": %.3f, "
+                "\"stream_fraction\": %.3f}%s\n",
+                r->kind, r->gate, r->num_qubits, r->target, r->control, r->stats.trials, r->stats.calls_per_trial,
+                r->stats.min, r->stats.p10, r->stats.median, r->stats.p90, r->stats.max, r->stats.mean, r->bytes,
+                gbs, info->stream_gbs > 0 ? gbs / info->stream_gbs : 0.0, i + 1 < num_records ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+// Quotes a CSV field, doubling embedded quotes
+static void write_csv_string(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* p = text; *p; p++) {
+        if (*p == '"') fputc('"', file);
+        fputc(*p, file);
+    }
+    fputc('"', file);
+}
+
+static bool write_csv_report(const char* path, const char* backend, const MachineInfo* info,
+                             const BenchRecord* records, int num_records) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return false;
+    }
+    fprintf(file, "backend,kind,gate,num_qubits,target,control,trials,calls_per_trial,min_s,p10_s,median_s,"
+                  "p90_s,max_s,mean_s,bytes,gbs,stream_fraction,stream_triad_gbs,threads,simd,host,cpu,compiler,"
+                  "timestamp\n");
+    for (int i = 0; i < num_records; i++) {
+        const BenchRecord* r = &records[i];
+        double gbs = record_gbs(r);
+        fprintf(file, "%s,%s,%s,%d,%d,%d,%d,%ld,%.9e,%.9e,%.9e,%.9e,%.9e,%.9e,%zu,%.3f,%.3f,%.3f,%d,%s,", backend,
+                r->kind, r->gate, r->num_qubits, r->target, r->control, r->stats.trials, r->stats.calls_per_trial,
+                r->stats.min, r->stats.p10, r->stats.median, r->stats.p90, r->stats.max, r->stats.mean, r->bytes,
+                gbs, info->stream_gbs > 0 ? gbs / info->stream_gbs : 0.0, info->stream_gbs, info->num_threads,
+                info->simd);
+        write_csv_string(file, info->host);
+        fputc(',', file);
+        write_csv_string(file, info->cpu);
+        fputc(',', file);
+        write_csv_string(file, info->compiler);
+        fprintf(file, ",%s\n", info->timestamp);
+    }
+    fclose(file);
+    return true;
+}
+
+typedef struct {
+    const BenchBackend* backend;
+    Statevector* sv;
+    const CircuitOp* ops;
+    int num_ops;
+} SuiteJob;
+
+static void apply_ops_body(void* context) {
+    const SuiteJob* job = context;
+    for (int i = 0; i < job->num_ops; i++) {
+        job->backend->apply_op(job->sv, &job->ops[i], NULL);
+    }
+}
+
+// Gates on the lowest and the highest qubit, so per-gate results show the cost of the
+// target position, followed by a CNOT spanning the state
+static Circuit* build_suite_circuit(int num_qubits) {
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    int top = num_qubits - 1;
+    circuit_add_gate(circuit, OP_X, 0);
+    circuit_add_gate(circuit, OP_H, 0);
+    circuit_add_gate(circuit, OP_T, 0);
+    if (num_qubits > 1) {
+        circuit_add_gate(circuit, OP_H, top);
+        circuit_add_rotation(circuit, OP_RY, top, 0.3);
+        circuit_add_controlled(circuit, OP_CNOT, 0, top);
+    }
+    return circuit;
+}
+
+bool run_benchmark_suite(const BenchBackend* backend, const BenchOptions* options) {
+    if (!backend || !backend->apply_op || !options || options->min_qubits < 1 ||
+        options->max_qubits < options->min_qubits || options->max_qubits > 62 || options->warmup < 0 ||
+        options->trials < 1) {
+        fprintf(stderr, "Error: Invalid parameters for benchmark suite\n");
+        return false;
+    }
+    MachineInfo info;
+    collect_machine_info(&info);
+    printf("%s: %s, %d thread(s), %s kernels, STREAM triad %.1f GB/s\n", backend->name, info.cpu,
+           info.num_threads, info.simd, info.stream_gbs);
+    printf("%-8s %-8s %-10s %12s %12s %12s %8s\n", "qubits", "kind", "gate", "median (s)", "p10 (s)", "p90 (s)",
+           "GB/s");
+
+    // At most one circuit record and one record per op for each qubit count
+    int max_records = (options->max_qubits - options->min_qubits + 1) * 8;
+    BenchRecord* records = malloc((size_t)max_records * sizeof(BenchRecord));
+    if (!records) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    int num_records = 0;
+    bool ok = true;
+
+    for (int num_qubits = options->min_qubits; num_qubits <= options->max_qubits && ok; num_qubits++) {
+        Statevector* sv = create_statevector(num_qubits);
+        Circuit* circuit = build_suite_circuit(num_qubits);
+        if (!sv || !circuit) {
+            free_statevector(sv);
+            free_circuit(circuit);
+            break;  // sizes beyond memory end the sweep
+        }
+
+        size_t circuit_bytes = 0;
+        for (int i = 0; i < circuit->num_ops; i++) circuit_bytes += circuit_op_bytes(&circuit->ops[i], num_qubits);
+
+        for (int i = -1; i < circuit->num_ops && ok; i++) {
+            BenchRecord* record = &records[num_records];
+            SuiteJob job = {backend, sv, circuit->ops, circuit->num_ops};
+            if (i < 0) {
+                *record = (BenchRecord){"circuit", "test", -1, NO_CONTROL, num_qubits, {0}, circuit_bytes};
+            } else {
+                const CircuitOp* op = &circuit->ops[i];
+                job.ops = op;
+                job.num_ops = 1;
+                *record = (BenchRecord){"gate", gate_op_name(op->op), op->target, op->control, num_qubits,
+                                        {0}, circuit_op_bytes(op, num_qubits)};
+            }
+            ok = bench_measure(apply_ops_body, &job, options->warmup, options->trials, &record->stats);
+            if (!ok) break;
+            printf("%-8d %-8s %-10s %12.3e %12.3e %12.3e %8.2f\n", num_qubits, record->kind, record->gate,
+                   record->stats.median, record->stats.p10, record->stats.p90, record_gbs(record));
+            num_records++;
+        }
+        free_circuit(circuit);
+        free_statevector(sv);
+    }
+
+    if (ok && options->json_path) {
+        ok = write_json_report(options->json_path, backend->name, &info, records, num_records);
+    }
+    if (ok && options->csv_path) {
+        ok = write_csv_report(options->csv_path, backend->name, &info, records, num_records);
+    }
+    free(records);
+    return ok;
+}
+
+// Reports
+
+struct BenchReport {
+    char name[BENCH_LABEL_LENGTH];
+    MachineInfo info;
+    BenchResult* results;
+    int num_results;
+    int capacity;
+    bool failed;  // a result could not be added
+};
+
+BenchReport* create_bench_report(const char* name) {
+    if (!name) {
+        fprintf(stderr, "Error: Invalid parameters for benchmark report\n");
+        return NULL;
+    }
+    BenchReport* report = calloc(1, sizeof(BenchReport));
+    if (!report) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    snprintf(report->name, sizeof(report->name), "%s", name);
+    collect_machine_info(&report->info);
+    return report;
+}
+
+void free_bench_report(BenchReport* report) {
+    if (!report) return;
+    free(report->results);
+    free(report);
+}
+
+BenchResult* bench_report_add(BenchReport* report, const char* label, const BenchStats* stats) {
+    if (!report || !label) {
+        fprintf(stderr, "Error: Invalid parameters for benchmark result\n");
+        return NULL;
+    }
+    if (report->num_results == report->capacity) {
+        int capacity = report->capacity ? 2 * report->capacity : 16;
+        BenchResult* results = realloc(report->results, (size_t)capacity * sizeof(BenchResult));
+        if (!results) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            report->failed = true;
+            return NULL;
+        }
+        report->results = results;
+        report->capacity = capacity;
+    }
+    BenchResult* result = &report->results[report->num_results++];
+    memset(result, 0, sizeof(BenchResult));
+    snprintf(result->label, sizeof(result->label), "%s", label);
+    if (stats) {
+        result->timed = true;
+        result->stats = *stats;
+    }
+    return result;
+}
+
+bool bench_result_value(BenchResult* result, const char* name, double value) {
+    if (!result) return false;
+    if (!name || result->num_values == BENCH_MAX_VALUES) {
+        fprintf(stderr, "Error: Cannot add value to benchmark result %s\n", result->label);
+        return false;
+    }
+    result->values[result->num_values++] = (BenchValue){name, value};
+    return true;
+}
+
+// Integers such as counts and byte sizes are written exactly, everything else with ten
+// significant digits. JSON has no NaN or infinity, so those become null (empty in CSV).
+static void write_number(FILE* file, double value, const char* missing) {
+    if (!isfinite(value)) {
+        fputs(missing, file);
+    } else if (value == floor(value) && fabs(value) < 1e15) {
+        fprintf(file, "%.0f", value);
+    } else {
+        fprintf(file, "%.9e", value);
+    }
+}
+
+static void write_json_stats(FILE* file, const BenchStats* stats) {
+    fprintf(file,
+            ", \"trials\": %d, \"calls_per_trial\": %ld, \"min_s\": %.9e, \"p10_s\": %.9e, \"median_s\": %.9e, "
+            "\"p90_s\": %.9e, \"max_s\": %.9e, \"mean_s\": %.9e",
+            stats->trials, stats->calls_per_trial, stats->min, stats->p10, stats->median, stats->p90, stats->max,
+            stats->mean);
+}
+
+static bool write_report_json(const BenchReport* report, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return false;
+    }
+    const MachineInfo* info = &report->info;
+    fprintf(file, "{\n  \"benchmark\": ");
+    write_json_string(file, report->name);
+    fprintf(file, ",\n  \"timestamp\": \"%s\",\n  \"machine\": {\n    \"host\": ", info->timestamp);
+    write_json_string(file, info->host);
+    fprintf(file, ",\n    \"cpu\": ");
+    write_json_string(file, info->cpu);
+    fprintf(file, ",\n    \"num_cpus\": %ld,\n    \"stream_triad_gbs\": %.3f\n  },\n  \"compiler\": ", info->num_cpus,
+            info->stream_gbs);
+    write_json_string(file, info->compiler);
+    fprintf(file, ",\n  \"threads\": %d,\n  \"simd\": \"%s\",\n  \"results\": [\n", info->num_threads, info->simd);
+
+    for (int i = 0; i < report->num_results; i++) {
+        const BenchResult* r = &report->results[i];
+        fprintf(file, "    {\"label\": ");
+        write_json_string(file, r->label);
+        if (r->timed) write_json_stats(file, &r->stats);
+        for (int v = 0; v < r->num_values; v++) {
+            fprintf(file, ", ");
+            write_json_string(file, r->values[v].name);
+            fprintf(file, ": ");
+            write_number(file, r->values[v].value, "null");
+        }
+        fprintf(file, "}%s\n", i + 1 < report->num_results ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+// Value names in the order they first appear; returns how many there are, or -1
+static int collect_value_names(const BenchReport* report, const char*** names) {
+    int capacity = 0;
+    for (int i = 0; i < report->num_results; i++) capacity += report->results[i].num_values;
+    *names = malloc((size_t)(capacity > 0 ? capacity : 1) * sizeof(const char*));
+    if (!*names) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    int count = 0;
+    for (int i = 0; i < report->num_results; i++) {
+        for (int v = 0; v < report->results[i].num_values; v++) {
+            const char* name = report->results[i].values[v].name;
+            int n = 0;
+            while (n < count && strcmp((*names)[n], name) != 0) n++;
+            if (n == count) (*names)[count++] = name;
+        }
+    }
+    return count;
+}
+
+static bool write_report_csv(const BenchReport* report, const char* path) {
+    const char** names;
+    int num_names = collect_value_names(report, &names);
+    if (num_names < 0) return false;
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        free(names);
+        return false;
+    }
+    const MachineInfo* info = &report->info;
+    fprintf(file, "benchmark,label,trials,calls_per_trial,min_s,p10_s,median_s,p90_s,max_s,mean_s");
+    for (int n = 0; n < num_names; n++) fprintf(file, ",%s", names[n]);
+    fprintf(file, ",stream_triad_gbs,threads,simd,host,cpu,compiler,timestamp\n");
+
+    for (int i = 0; i < report->num_results; i++) {
+        const BenchResult* r = &report->results[i];
+        write_csv_string(file, report->name);
+        fputc(',', file);
+        write_csv_string(file, r->label);
+        if (r->timed) {
+            fprintf(file, ",%d,%ld,%.9e,%.9e,%.9e,%.9e,%.9e,%.9e", r->stats.trials, r->stats.calls_per_trial,
+                    r->stats.min, r->stats.p10, r->stats.median, r->stats.p90, r->stats.max, r->stats.mean);
+        } else {
+            fprintf(file, ",,,,,,,,");
+        }
+        for (int n = 0; n < num_names; n++) {
+            fputc(',', file);
+            for (int v = 0; v < r->num_values; v++) {
+                if (strcmp(r->values[v].name, names[n]) == 0) {
+                    write_number(file, r->values[v].value, "");
+                    break;
+                }
+            }
+        }
+        fprintf(file, ",%.3f,%d,%s,", info->stream_gbs, info->num_threads, info->simd);
+        write_csv_string(file, info->host);
+        fputc(',', file);
+        write_csv_string(file, info->cpu);
+        fputc(',', file);
+        write_csv_string(file, info->compiler);
+        fprintf(file, ",%s\n", info->timestamp);
+    }
+    fclose(file);
+    free(names);
+    return true;
+}
+
+bool write_bench_report(const BenchReport* report) {
+    if (!report) {
+        fprintf(stderr, "Error: Invalid parameters for benchmark report\n");
+        return false;
+    }
+    if (report->failed) {
+        fprintf(stderr, "Error: Benchmark report %s is missing results\n", report->name);
+        return false;
+    }
+    char path[BENCH_LABEL_LENGTH + 16];
+    snprintf(path, sizeof(path), "%s_bench.json", report->name);
+    bool ok = write_report_json(report, path);
+    snprintf(path, sizeof(path), "%s_bench.csv", report->name);
+    return write_report_csv(report, path) && ok;
+}
@@ -0,0 +1,128 @@
+// benchmark.h
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "statevector_core.h"
+#include "circuit.h"
+
+#define BENCH_DEFAULT_WARMUP 2
+#define BENCH_DEFAULT_TRIALS 10
+
+// A trial repeats its body until it has run for at least this long, so that gates on
+// small states are timed well above the resolution of the clock
+#define BENCH_MIN_TRIAL_SECONDS 1e-4
+
+// Per-call wall time over the trials of one measurement, in seconds
+typedef struct {
+    int trials;
+    long calls_per_trial;
+    double min;
+    double p10;
+    double median;
+    double p90;
+    double max;
+    double mean;
+} BenchStats;
+
+// Times body(context) after warmup untimed runs. Each trial is one monotonic wall-clock
+// interval over calls_per_trial calls, chosen during warmup.
+typedef void (*BenchBody)(void* context);
+bool bench_measure(BenchBody body, void* context, int warmup, int trials, BenchStats* stats);
+
+// bench_measure with a fixed number of calls per trial, for bodies that every rank of a
+// distributed run has to call the same number of times
+bool bench_measure_calls(BenchBody body, void* context, int warmup, int trials, long calls, BenchStats* stats);
+
+// Whole circuits and engine runs take up to seconds at the benchmarks' default sizes, so
+// bench_measure_run gives them fewer trials than the suite's single gates
+#define BENCH_RUN_WARMUP 1
+#define BENCH_RUN_TRIALS 3
+bool bench_measure_run(BenchBody body, void* context, BenchStats* stats);
+
+// Timing bodies for whole runs, each continuing from the state the previous call left:
+// circuit ops applied one at a time, and a compiled plan
+typedef struct {
+    const Circuit* circuit;
+    Statevector* sv;
+} BenchOpsRun;
+
+typedef struct {
+    const CircuitPlan* plan;
+    Statevector* sv;
+} BenchPlanRun;
+
+void bench_ops_body(void* context);
+void bench_plan_body(void* context);
+
+// Best STREAM triad bandwidth (a[i] = b[i] + s * c[i]) in GB/s on the current thread count,
+// counting 24 bytes per element as STREAM does. Measured once and cached.
+double stream_triad_bandwidth(void);
+
+// Bytes of amplitudes a kernel reads and writes to apply op to an n-qubit state: every
+// amplitude for full gates, half of them per control and for phase gates, which leave
+// the |0⟩ amplitudes alone
+size_t circuit_op_bytes(const CircuitOp* op, int num_qubits);
+
+// The backend under test: its name in the report and how it applies a single op
+typedef struct {
+    const char* name;
+    bool (*apply_op)(Statevector* sv, const CircuitOp* op, const double* params);
+} BenchBackend;
+
+typedef struct {
+    int min_qubits;
+    int max_qubits;
+    int warmup;
+    int trials;
+    const char* json_path;  // NULL skips the JSON report
+    const char* csv_path;   // NULL skips the CSV report
+} BenchOptions;
+
+// Times the test circuit and each of its gates for every qubit count in
+// [min_qubits, max_qubits], prints a summary, and writes one record per measurement with
+// the machine, compiler, thread count and SIMD level. Reports are overwritten.
+bool run_benchmark_suite(const BenchBackend* backend, const BenchOptions* options);
+
+// Reports
+
+// Values a result can carry besides its timing, and the length of its label
+#define BENCH_MAX_VALUES 16
+#define BENCH_LABEL_LENGTH 48
+
+typedef struct {
+    const char* name;  // not copied, so in practice a string literal
+    double value;
+} BenchValue;
+
+// One measured variant of a benchmark: a label such as "adjoint" or "qft/swept", the
+// bench_measure statistics if it was timed, and named values such as the qubit count, a
+// speedup or the error against a reference run
+typedef struct {
+    char label[BENCH_LABEL_LENGTH];
+    bool timed;
+    BenchStats stats;
+    int num_values;
+    BenchValue values[BENCH_MAX_VALUES];
+} BenchResult;
+
+// The results of one benchmark, written like the suite's with the machine, compiler,
+// thread count and SIMD level
+typedef struct BenchReport BenchReport;
+
+// Collects the machine information, which includes a STREAM triad run
+BenchReport* create_bench_report(const char* name);
+void free_bench_report(BenchReport* report);
+
+// Appends a result, untimed if stats is NULL. Returns it so values can be attached, or
+// NULL if the report could not grow; bench_result_value accepts NULL, and the failure is
+// reported again by write_bench_report.
+BenchResult* bench_report_add(BenchReport* report, const char* label, const BenchStats* stats);
+bool bench_result_value(BenchResult* result, const char* name, double value);
+
+// Writes <name>_bench.json and <name>_bench.csv in the working directory, overwriting
+// them. The CSV has one column for every value name used by any result.
+bool write_bench_report(const BenchReport* report);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,267 @@
+// cache_blocking.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include "cache_blocking.h"
+#include "thread_pool.h"
+
+// Used when the L2 size cannot be queried
+#define DEFAULT_L2_BYTES (1024 * 1024)
+
+static int local_qubits;
+static bool local_qubits_initialized = false;
+
+static void initialize_local_qubits(void) {
+    long l2_bytes = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    l2_bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (l2_bytes <= 0) l2_bytes = DEFAULT_L2_BYTES;
+
+    // Half of L2 leaves room for the other data a kernel touches
+    local_qubits = max_qubits_for_memory((size_t)l2_bytes / 2);
+    if (local_qubits < MIN_LOCAL_QUBITS) local_qubits = MIN_LOCAL_QUBITS;
+
+    const char* requested = getenv("QSIM_LOCAL_QUBITS");
+    if (requested) {
+        int value = atoi(requested);
+        if (value >= MIN_LOCAL_QUBITS && value <= 62) {
+            local_qubits = value;
+        } else {
+            fprintf(stderr, "Error: Invalid QSIM_LOCAL_QUBITS value '%s'\n", requested);
+        }
+    }
+    local_qubits_initialized = true;
+}
+
+int get_local_qubits(void) {
+    if (!local_qubits_initialized) initialize_local_qubits();
+    return local_qubits;
+}
+
+bool set_local_qubits(int value) {
+    if (value < MIN_LOCAL_QUBITS || value > 62) {
+        fprintf(stderr, "Error: Local qubit count must be between %d and 62\n", MIN_LOCAL_QUBITS);
+        return false;
+    }
+    local_qubits = value;
+    local_qubits_initialized = true;
+    return true;
+}
+
+// Qubit swaps
+
+typedef struct {
+    double* real;
+    double* imag;
+    const int* a;
+    const int* b;
+    int count;
+    int run_qubits;  // the lowest swapped qubit; runs of 2^run_qubits amplitudes move together
+} SwapJob;
+
+// Run r starts at x = r << run_qubits and moves to the index with bits a[i] and b[i]
+// exchanged. Each pair of runs is handled by the chunk that owns the lower one, so chunks
+// never write to the same amplitude.
+static void swap_qubits_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const SwapJob* job = context;
+    size_t run_length = (size_t)1 << job->run_qubits;
+    for (size_t r = begin; r < end; r++) {
+        size_t x = r << job->run_qubits;
+        size_t y = x;
+        for (int i = 0; i < job->count; i++) {
+            if (((x >> job->a[i]) ^ (x >> job->b[i])) & 1) {
+                y ^= ((size_t)1 << job->a[i]) | ((size_t)1 << job->b[i]);
+            }
+        }
+        if (y <= x) continue;
+        double* x_re = job->real + x;
+        double* x_im = job->imag + x;
+        double* y_re = job->real + y;
+        double* y_im = job->imag + y;
+        for (size_t j = 0; j < run_length; j++) {
+            double re = x_re[j], im = x_im[j];
+            x_re[j] = y_re[j];
+            x_im[j] = y_im[j];
+            y_re[j] = re;
+            y_im[j] = im;
+        }
+    }
+}
+
+bool kernel_swap_qubits(Statevector* sv, const int* a, const int* b, int count) {
+    uint64_t used = 0;
+    int lowest = sv->num_qubits;
+    for (int i = 0; i < count; i++) {
+        if (a[i] < 0 || a[i] >= sv->num_qubits || b[i] < 0 || b[i] >= sv->num_qubits || a[i] == b[i] ||
+            (used & (((uint64_t)1 << a[i]) | ((uint64_t)1 << b[i])))) {
+            fprintf(stderr, "Error: Invalid qubit indices\n");
+            return false;
+        }
+        used |= ((uint64_t)1 << a[i]) | ((uint64_t)1 << b[i]);
+        if (a[i] < lowest) lowest = a[i];
+        if (b[i] < lowest) lowest = b[i];
+    }
+    if (count == 0) return true;
+
+    SwapJob job = {sv->real, sv->imag, a, b, count, lowest};
+    parallel_for(sv->dimension >> lowest, swap_qubits_task, &job);
+    return true;
+}
+
+// Scheduling
+
+static int next_use(const CircuitPlan* plan, int from, int qubit) {
+    for (int i = from; i < plan->num_steps; i++) {
+        if (plan_step_local_mask(&plan->steps[i]) & ((uint64_t)1 << qubit)) return i;
+    }
+    return INT_MAX;
+}
+
+// Logical qubit q lives at physical position position[q]; qubit_at is the inverse
+typedef struct {
+    int position[64];
+    int qubit_at[64];
+} QubitLayout;
+
+static void exchange_positions(QubitLayout* layout, int p, int q) {
+    int a = layout->qubit_at[p], b = layout->qubit_at[q];
+    layout->qubit_at[p] = b;
+    layout->qubit_at[q] = a;
+    layout->position[a] = q;
+    layout->position[b] = p;
+}
+
+// Moves every qubit in needed below position local with one swap pass. The evicted
+// local qubits are those whose next use after the window is furthest away.
+static int make_local(Statevector* sv, const CircuitPlan* plan, int window_end, uint64_t needed, int local,
+                      QubitLayout* layout) {
+    int a[64], b[64], count = 0;
+    for (int q = 0; q < sv->num_qubits; q++) {
+        if (!(needed & ((uint64_t)1 << q)) || layout->position[q] < local) continue;
+
+        int victim = -1, victim_use = -1;
+        for (int p = SWAP_RUN_QUBITS; p < local; p++) {
+            int resident = layout->qubit_at[p];
+            if (needed & ((uint64_t)1 << resident)) continue;
+            int use = next_use(plan, window_end, resident);
+            if (use > victim_use) {
+                victim = p;
+                victim_use = use;
+            }
+        }
+        a[count] = layout->position[q];
+        b[count] = victim;
+        count++;
+        exchange_positions(layout, layout->position[q], victim);
+    }
+    if (count > 0) kernel_swap_qubits(sv, a, b, count);
+    return count > 0;
+}
+
+// Returns every qubit to its own position, one pass per round of disjoint swaps
+static int restore_layout(Statevector* sv, QubitLayout* layout) {
+    int passes = 0;
+    for (;;) {
+        int a[64], b[64], count = 0;
+        uint64_t used = 0;
+        for (int p = 0; p < sv->num_qubits; p++) {
+            int q = layout->position[p];  // where logical qubit p currently lives
+            if (q == p || (used & (((uint64_t)1 << p) | ((uint64_t)1 << q)))) continue;
+            used |= ((uint64_t)1 << p) | ((uint64_t)1 << q);
+            a[count] = p;
+            b[count] = q;
+            count++;
+        }
+        if (count == 0) return passes;
+        for (int i = 0; i < count; i++) exchange_positions(layout, a[i], b[i]);
+        kernel_swap_qubits(sv, a, b, count);
+        passes++;
+    }
+}
+
+typedef struct {
+    Statevector* sv;
+    const PlanStep* steps;
+    int num_steps;
+    const double* params;
+    int local;
+} WindowJob;
+
+static void window_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const WindowJob* job = context;
+    size_t chunk_size = (size_t)1 << job->local;
+    for (size_t c = begin; c < end; c++) {
+        Statevector chunk = {
+            .real = job->sv->real + c * chunk_size,
+            .imag = job->sv->imag + c * chunk_size,
+            .num_qubits = job->local,
+            .dimension = chunk_size,
+        };
+        for (int i = 0; i < job->num_steps; i++) {
+            run_plan_step_at(&chunk, &job->steps[i], job->params, c * chunk_size);
+        }
+    }
+}
+
+bool execute_plan_blocked(const CircuitPlan* plan, Statevector* sv, const double* params, BlockingStats* stats) {
+    BlockingStats local_stats = {0, 0};
+    if (!stats) stats = &local_stats;
+    stats->num_windows = 0;
+    stats->num_swap_passes = 0;
+
+    int local = get_local_qubits();
+    if (!sv || sv->num_qubits <= local) {
+        if (!execute_plan(plan, sv, params)) return false;
+        stats->num_windows = plan->num_steps;
+        return true;
+    }
+    if (!plan || (plan->num_params > 0 && !params) || sv->num_qubits < plan->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for blocked execution\n");
+        return false;
+    }
+    PlanStep* window = malloc(((size_t)plan->num_steps + 1) * sizeof(PlanStep));
+    if (!window) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    get_simd_level();  // resolve the kernel level before the workers need it
+
+    QubitLayout layout;
+    for (int q = 0; q < 64; q++) {
+        layout.position[q] = q;
+        layout.qubit_at[q] = q;
+    }
+
+    // The fixed low qubits are always local; the rest of a window has to share the others
+    uint64_t fixed = ((uint64_t)1 << SWAP_RUN_QUBITS) - 1;
+    int first = 0;
+    while (first < plan->num_steps) {
+        uint64_t needed = 0;
+        int end = first;
+        while (end < plan->num_steps) {
+            uint64_t next = needed | plan_step_local_mask(&plan->steps[end]);
+            if (__builtin_popcountll(next & ~fixed) > local - SWAP_RUN_QUBITS) break;
+            needed = next;
+            end++;
+        }
+        stats->num_swap_passes += make_local(sv, plan, end, needed, local, &layout);
+
+        for (int i = first; i < end; i++) {
+            window[i - first] = plan->steps[i];
+            remap_plan_step(&window[i - first], layout.position);
+        }
+        WindowJob job = {sv, window, end - first, params, local};
+        parallel_for_items(sv->dimension >> local, window_task, &job);
+        stats->num_windows++;
+        first = end;
+    }
+    stats->num_swap_passes += restore_layout(sv, &layout);
+
+    free(window);
+    return true;
+}
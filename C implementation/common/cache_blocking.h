@@ -0,0 +1,39 @@
+// cache_blocking.h
+#ifndef CACHE_BLOCKING_H
+#define CACHE_BLOCKING_H
+
+#include <stdbool.h>
+#include "statevector_core.h"
+#include "circuit.h"
+
+// Qubits below this position are never swapped, so a swap pass always moves contiguous
+// runs of at least 2^SWAP_RUN_QUBITS amplitudes
+#define SWAP_RUN_QUBITS 6
+
+// Above the fixed qubits, chunks must still hold every qubit of the widest plan step
+#define MIN_LOCAL_QUBITS (SWAP_RUN_QUBITS + MAX_BLOCK_QUBITS)
+
+// Counts of full passes over the state made by execute_plan_blocked
+typedef struct {
+    int num_windows;      // runs of steps applied chunk by chunk
+    int num_swap_passes;  // qubit reordering passes, including the final restore
+} BlockingStats;
+
+// Number of local qubits: chunks of 2^local_qubits amplitudes fit in half of the L2
+// cache. Override with QSIM_LOCAL_QUBITS=<n>.
+int get_local_qubits(void);
+bool set_local_qubits(int local_qubits);
+
+// Exchanges qubit a[i] with qubit b[i] for every i in one pass over the state. The pairs
+// must not share qubits.
+bool kernel_swap_qubits(Statevector* sv, const int* a, const int* b, int count);
+
+// Runs the plan in windows of consecutive steps whose qubits all fit in one chunk of
+// 2^get_local_qubits() amplitudes. Each window is applied to one L2-sized chunk at a
+// time, so the whole window costs a single pass over memory. When a window needs qubits
+// above the chunk, one reordering pass swaps them with local qubits (at or above
+// SWAP_RUN_QUBITS) that are not needed again for the longest time. The original qubit
+// order is restored before returning. stats may be NULL.
+bool execute_plan_blocked(const CircuitPlan* plan, Statevector* sv, const double* params, BlockingStats* stats);
+
+#endif // CACHE_BLOCKING_H
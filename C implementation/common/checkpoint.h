@@ -0,0 +1,76 @@
+// checkpoint.h
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "statevector_core.h"
+#include "statevector_f32.h"
+#include "mapped_statevector.h"
+
+#define CHECKPOINT_VERSION 1
+
+// The header takes one page, and raw amplitudes start on a page boundary so they can be
+// mapped in place
+#define CHECKPOINT_PAGE_BYTES 4096
+
+// Amplitudes are written and read in chunks of 2^chunk_qubits, one per task
+#define CHECKPOINT_DEFAULT_CHUNK_QUBITS 18
+
+typedef enum {
+    CHECKPOINT_RAW,       // the arrays as they are in memory
+    CHECKPOINT_ZERO_RUNS  // per chunk, runs of zero amplitudes replaced by their length
+} CheckpointCompression;
+
+// Checkpoint file, in native byte order:
+//   page 0      the header below
+//   RAW         from data_offset, all real parts, then all imaginary parts
+//   ZERO_RUNS   from table_offset, an (offset, bytes) pair of uint64 per chunk; each chunk
+//               is a sequence of tokens: a uint32 count of zero amplitudes, a uint32 count
+//               n of stored amplitudes, then their n real parts and n imaginary parts. A
+//               chunk that would not shrink is stored raw (real parts, then imaginary
+//               parts), which its byte count tells apart.
+typedef struct {
+    char magic[4];              // "QSCK"
+    uint32_t version;
+    uint32_t num_qubits;
+    uint32_t real_bytes;        // 8 for Statevector, 4 for StatevectorF32
+    uint32_t layout;            // 0: split real and imaginary arrays, as in memory
+    uint32_t compression;       // CheckpointCompression
+    uint32_t chunk_qubits;
+    uint32_t reserved;
+    uint64_t circuit_position;  // caller's resume point, e.g. the circuit ops already applied
+    uint64_t num_chunks;
+    uint64_t table_offset;      // 0 for RAW
+    uint64_t data_offset;
+    uint64_t data_bytes;
+} CheckpointHeader;
+
+typedef struct {
+    CheckpointCompression compression;
+    double zero_threshold;  // ZERO_RUNS: amplitudes with both parts within it are stored as 0
+    int chunk_qubits;       // 0 for CHECKPOINT_DEFAULT_CHUNK_QUBITS
+} CheckpointOptions;
+
+// Writes the state to path + ".tmp", syncs it and renames it over path, so an interrupted
+// save leaves the previous checkpoint intact. Chunks are compressed and written in
+// parallel. options may be NULL for a raw checkpoint.
+bool save_checkpoint(const Statevector* sv, uint64_t circuit_position, const CheckpointOptions* options,
+                     const char* path);
+bool save_checkpoint_f32(const StatevectorF32* sv, uint64_t circuit_position, const CheckpointOptions* options,
+                         const char* path);
+
+bool read_checkpoint_header(const char* path, CheckpointHeader* header);
+
+// Reads a checkpoint of the matching precision into a new state, chunks in parallel.
+// header may be NULL; otherwise it receives the file's header.
+Statevector* load_checkpoint(const char* path, CheckpointHeader* header);
+StatevectorF32* load_checkpoint_f32(const char* path, Precision precision, CheckpointHeader* header);
+
+// Restores a raw double-precision checkpoint without reading it: the file is mapped
+// copy-on-write and the state points into the mapping. Pages are loaded on first access
+// and shared with every other mapping of the file until written, so many continuations
+// can fork from one saved prefix while the file stays unchanged.
+MappedStatevector* map_checkpoint(const char* path, CheckpointHeader* header);
+
+#endif // CHECKPOINT_H
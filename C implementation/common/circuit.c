@@ -0,0 +1,545 @@
+// circuit.c
+#include <stdio.h>
+#include <stdlib.h>
+#include "circuit.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+
+static const struct {
+    const char* name;
+    int num_qubits;
+    bool rotation;
+} op_info[NUM_GATE_OPS] = {
+    [OP_X]    = {"X", 1, false},
+    [OP_Y]    = {"Y", 1, false},
+    [OP_Z]    = {"Z", 1, false},
+    [OP_H]    = {"H", 1, false},
+    [OP_S]    = {"S", 1, false},
+    [OP_T]    = {"T", 1, false},
+    [OP_RX]   = {"RX", 1, true},
+    [OP_RY]   = {"RY", 1, true},
+    [OP_RZ]   = {"RZ", 1, true},
+    [OP_CNOT] = {"CNOT", 2, false},
+    [OP_CZ]   = {"CZ", 2, false},
+};
+
+// Circuit construction
+
+Circuit* create_circuit(int num_qubits) {
+    if (num_qubits < 1 || num_qubits > MAX_CIRCUIT_QUBITS) {
+        fprintf(stderr, "Error: Invalid number of qubits\n");
+        return NULL;
+    }
+    Circuit* circuit = malloc(sizeof(Circuit));
+    if (!circuit) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    circuit->num_qubits = num_qubits;
+    circuit->num_params = 0;
+    circuit->ops = NULL;
+    circuit->num_ops = 0;
+    circuit->capacity = 0;
+    return circuit;
+}
+
+void free_circuit(Circuit* circuit) {
+    if (circuit) {
+        free(circuit->ops);
+        free(circuit);
+    }
+}
+
+static bool circuit_append(Circuit* circuit, CircuitOp op) {
+    if (op.target < 0 || op.target >= circuit->num_qubits ||
+        (op.control != NO_CONTROL && (op.control < 0 || op.control >= circuit->num_qubits || op.control == op.target))) {
+        fprintf(stderr, "Error: Invalid qubit indices\n");
+        return false;
+    }
+    if (circuit->num_ops == circuit->capacity) {
+        int capacity = circuit->capacity ? 2 * circuit->capacity : 16;
+        CircuitOp* ops = realloc(circuit->ops, (size_t)capacity * sizeof(CircuitOp));
+        if (!ops) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return false;
+        }
+        circuit->ops = ops;
+        circuit->capacity = capacity;
+    }
+    circuit->ops[circuit->num_ops++] = op;
+    if (op.param_index >= circuit->num_params) circuit->num_params = op.param_index + 1;
+    return true;
+}
+
+bool circuit_add_gate(Circuit* circuit, GateOp op, int target) {
+    if (!circuit || op < 0 || op >= NUM_GATE_OPS || op_info[op].num_qubits != 1 || op_info[op].rotation) {
+        fprintf(stderr, "Error: Invalid gate for circuit_add_gate\n");
+        return false;
+    }
+    return circuit_append(circuit, (CircuitOp){op, target, NO_CONTROL, -1, 0.0});
+}
+
+bool circuit_add_controlled(Circuit* circuit, GateOp op, int control, int target) {
+    if (!circuit || op < 0 || op >= NUM_GATE_OPS || op_info[op].num_qubits != 2) {
+        fprintf(stderr, "Error: Invalid gate for circuit_add_controlled\n");
+        return false;
+    }
+    return circuit_append(circuit, (CircuitOp){op, target, control, -1, 0.0});
+}
+
+bool circuit_add_rotation(Circuit* circuit, GateOp op, int target, double angle) {
+    if (!circuit || op < 0 || op >= NUM_GATE_OPS || !op_info[op].rotation) {
+        fprintf(stderr, "Error: Invalid gate for circuit_add_rotation\n");
+        return false;
+    }
+    return circuit_append(circuit, (CircuitOp){op, target, NO_CONTROL, -1, angle});
+}
+
+bool circuit_add_parametric(Circuit* circuit, GateOp op, int target, int param_index) {
+    if (!circuit || op < 0 || op >= NUM_GATE_OPS || !op_info[op].rotation || param_index < 0) {
+        fprintf(stderr, "Error: Invalid gate for circuit_add_parametric\n");
+        return false;
+    }
+    return circuit_append(circuit, (CircuitOp){op, target, NO_CONTROL, param_index, 0.0});
+}
+
+const char* gate_op_name(GateOp op) {
+    return op >= 0 && op < NUM_GATE_OPS ? op_info[op].name : "?";
+}
+
+QuantumGate circuit_op_gate(const CircuitOp* op, const double* params) {
+    double angle = op->param_index >= 0 ? params[op->param_index] : op->angle;
+    switch (op->op) {
+        case OP_X:
+        case OP_CNOT: return get_x_gate();
+        case OP_Y:    return get_y_gate();
+        case OP_Z:
+        case OP_CZ:   return get_z_gate();
+        case OP_H:    return get_hadamard_gate();
+        case OP_S:    return get_s_gate();
+        case OP_T:    return get_t_gate();
+        case OP_RX:   return get_rx_gate(angle);
+        case OP_RY:   return get_ry_gate(angle);
+        default:      return get_rz_gate(angle);
+    }
+}
+
+// Kernel selection
+
+static bool same_complex(Complex a, double real, double imag) {
+    return a.real == real && a.imag == imag;
+}
+
+static bool same_gate(const QuantumGate* a, const QuantumGate* b) {
+    for (int r = 0; r < 2; r++) {
+        for (int c = 0; c < 2; c++) {
+            if (!same_complex(a->elements[r][c], b->elements[r][c].real, b->elements[r][c].imag)) return false;
+        }
+    }
+    return true;
+}
+
+// Picks the cheapest kernel that applies gate exactly. Classifying the matrix rather
+// than the op also covers the products left behind by gate fusion.
+static void select_kernel(PlanStep* step, QuantumGate gate, int target, int control) {
+    QuantumGate X = get_x_gate();
+    QuantumGate H = get_hadamard_gate();
+
+    step->gate = gate;
+    step->target = target;
+    step->control = control;
+    step->num_qubits = 0;
+    step->matrix = NULL;
+    step->sweep = NULL;
+
+    bool diagonal = same_complex(gate.elements[0][1], 0.0, 0.0) && same_complex(gate.elements[1][0], 0.0, 0.0);
+    bool phase = diagonal && same_complex(gate.elements[0][0], 1.0, 0.0);
+
+    if (control != NO_CONTROL) {
+        if (same_gate(&gate, &X)) step->kind = STEP_CONTROLLED_SWAP;
+        else if (phase) step->kind = STEP_CONTROLLED_PHASE;
+        else if (diagonal) step->kind = STEP_CONTROLLED_DIAGONAL;
+        else step->kind = STEP_CONTROLLED_MATRIX;
+    } else if (same_gate(&gate, &X)) {
+        step->kind = STEP_SWAP;
+    } else if (same_gate(&gate, &H)) {
+        step->kind = STEP_HADAMARD;
+    } else if (phase) {
+        step->kind = STEP_PHASE;
+    } else if (diagonal) {
+        step->kind = STEP_DIAGONAL;
+    } else {
+        step->kind = STEP_MATRIX;
+    }
+}
+
+void run_plan_step(Statevector* sv, const PlanStep* step, const double* params) {
+    run_plan_step_at(sv, step, params, 0);
+}
+
+void run_plan_step_at(Statevector* sv, const PlanStep* step, const double* params, size_t base_index) {
+    switch (step->kind) {
+        case STEP_SWAP:
+            kernel_swap_pairs(sv, step->target);
+            break;
+        case STEP_HADAMARD:
+            kernel_hadamard_pairs(sv, step->target);
+            break;
+        case STEP_PHASE:
+            kernel_phase_pairs(sv, step->gate.elements[1][1], step->target);
+            break;
+        case STEP_DIAGONAL:
+            kernel_diagonal_pairs(sv, step->gate.elements[0][0], step->gate.elements[1][1], step->target);
+            break;
+        case STEP_MATRIX:
+            kernel_matrix_pairs(sv, &step->gate, step->target);
+            break;
+        case STEP_CONTROLLED_SWAP:
+            kernel_controlled_swap_pairs(sv, step->control, step->target);
+            break;
+        case STEP_CONTROLLED_PHASE:
+            kernel_controlled_phase_pairs(sv, step->gate.elements[1][1], step->control, step->target);
+            break;
+        case STEP_CONTROLLED_DIAGONAL:
+            kernel_controlled_diagonal_pairs(sv, step->gate.elements[0][0], step->gate.elements[1][1], step->control,
+                                             step->target);
+            break;
+        case STEP_CONTROLLED_MATRIX:
+            kernel_controlled_matrix_pairs(sv, &step->gate, step->control, step->target);
+            break;
+        case STEP_DENSE:
+            kernel_dense_block(sv, step->matrix, step->qubits, step->num_qubits);
+            break;
+        case STEP_DIAGONAL_SWEEP:
+            kernel_diagonal_sweep(sv, step->sweep, step->qubits, base_index);
+            break;
+        case STEP_PARAMETRIC: {
+            QuantumGate gate = circuit_op_gate(&step->op, params);
+            if (step->op.op == OP_RZ) {
+                kernel_diagonal_pairs(sv, gate.elements[0][0], gate.elements[1][1], step->target);
+            } else {
+                kernel_matrix_pairs(sv, &gate, step->target);
+            }
+            break;
+        }
+    }
+}
+
+uint64_t plan_step_mask(const PlanStep* step) {
+    if (step->num_qubits > 0) {
+        uint64_t mask = 0;
+        for (int b = 0; b < step->num_qubits; b++) mask |= (uint64_t)1 << step->qubits[b];
+        return mask;
+    }
+    uint64_t mask = (uint64_t)1 << step->target;
+    if (step->control != NO_CONTROL) mask |= (uint64_t)1 << step->control;
+    return mask;
+}
+
+uint64_t plan_step_local_mask(const PlanStep* step) {
+    return step->kind == STEP_DIAGONAL_SWEEP ? 0 : plan_step_mask(step);
+}
+
+void remap_plan_step(PlanStep* step, const int* position) {
+    step->target = position[step->target];
+    if (step->control != NO_CONTROL) step->control = position[step->control];
+    for (int b = 0; b < step->num_qubits; b++) step->qubits[b] = position[step->qubits[b]];
+}
+
+static bool valid_circuit_op(const Statevector* sv, const CircuitOp* op, const double* params) {
+    if (!sv || op->target < 0 || op->target >= sv->num_qubits ||
+        (op->control != NO_CONTROL && (op->control < 0 || op->control >= sv->num_qubits || op->control == op->target))) {
+        fprintf(stderr, "Error: Invalid qubit indices\n");
+        return false;
+    }
+    if (op->param_index >= 0 && !params) {
+        fprintf(stderr, "Error: Missing circuit parameters\n");
+        return false;
+    }
+    return true;
+}
+
+bool apply_circuit_op(Statevector* sv, const CircuitOp* op, const double* params) {
+    if (!valid_circuit_op(sv, op, params)) return false;
+    INSTRUMENT_BEGIN(span);
+    PlanStep step;
+    select_kernel(&step, circuit_op_gate(op, params), op->target, op->control);
+    run_plan_step(sv, &step, params);
+    INSTRUMENT_END(span, "gate", gate_op_name(op->op), op->target, op->control, 0, 0);
+    return true;
+}
+
+bool apply_circuit_op_inverse(Statevector* sv, const CircuitOp* op, const double* params) {
+    if (!valid_circuit_op(sv, op, params)) return false;
+    QuantumGate gate = circuit_op_gate(op, params), inverse;
+    for (int r = 0; r < 2; r++) {
+        for (int c = 0; c < 2; c++) {
+            inverse.elements[r][c] = (Complex){gate.elements[c][r].real, -gate.elements[c][r].imag};
+        }
+    }
+    INSTRUMENT_BEGIN(span);
+    PlanStep step;
+    select_kernel(&step, inverse, op->target, op->control);
+    run_plan_step(sv, &step, params);
+    INSTRUMENT_END(span, "gate", gate_op_name(op->op), op->target, op->control, 0, 0);
+    return true;
+}
+
+// Compilation
+
+// Lowers gates[0..count) to plan steps in order, fused if max_block_qubits > 0
+static bool lower_segment(const GateApplication* gates, int count, int max_block_qubits, CircuitPlan* plan) {
+    if (count == 0) return true;
+    if (max_block_qubits == 0) {
+        for (int i = 0; i < count; i++) {
+            select_kernel(&plan->steps[plan->num_steps++], gates[i].gate, gates[i].target, gates[i].control);
+        }
+        return true;
+    }
+
+    FusedCircuit fused;
+    if (!fuse_gates(gates, count, max_block_qubits, &fused)) {
+        return false;
+    }
+    for (int i = 0; i < fused.num_blocks; i++) {
+        FusedBlock* block = &fused.blocks[i];
+        PlanStep* step = &plan->steps[plan->num_steps++];
+        if (block->kind != FUSED_DENSE) {
+            select_kernel(step, block->gate, block->target, block->control);
+            continue;
+        }
+        step->kind = STEP_DENSE;
+        step->sweep = NULL;
+        step->target = block->qubits[0];
+        step->control = NO_CONTROL;
+        step->num_qubits = block->num_qubits;
+        for (int b = 0; b < block->num_qubits; b++) step->qubits[b] = block->qubits[b];
+        step->matrix = block->matrix;  // ownership moves to the plan
+        block->matrix = NULL;
+    }
+    free_fused_circuit(&fused);
+    return true;
+}
+
+static uint64_t gate_mask(const GateApplication* gate) {
+    uint64_t mask = (uint64_t)1 << gate->target;
+    if (gate->control != NO_CONTROL) mask |= (uint64_t)1 << gate->control;
+    return mask;
+}
+
+// Starts a sweep with the diagonal gate gates[first] and moves into it every later diagonal
+// gate that commutes with all the gates it would jump over, i.e. shares no qubit with the
+// gates left in place before it. suffix[j] holds the qubits of gates[j..count). Returns
+// NULL, taking no gates, when the sweep would not save a pass.
+static DiagonalSweep* collect_sweep(const GateApplication* gates, int first, int count, const uint64_t* suffix,
+                                    int max_block_qubits, bool* taken) {
+    DiagonalSweep* sweep = create_diagonal_sweep();
+    int* members = malloc((size_t)count * sizeof(int));
+    if (!sweep || !members || !diagonal_sweep_add(sweep, &gates[first].gate, gates[first].target, gates[first].control)) {
+        free_diagonal_sweep(sweep);
+        free(members);
+        return NULL;
+    }
+    int num_members = 0;
+    members[num_members++] = first;
+
+    uint64_t blocked = 0;
+    for (int j = first + 1; j < count && (suffix[j] & ~blocked); j++) {
+        if (taken[j]) continue;
+        uint64_t mask = gate_mask(&gates[j]);
+        if (!(mask & blocked) && diagonal_sweep_add(sweep, &gates[j].gate, gates[j].target, gates[j].control)) {
+            members[num_members++] = j;
+        } else {
+            blocked |= mask;
+        }
+    }
+
+    bool saves_passes = sweep->num_gates >= 2 && (max_block_qubits == 0 || sweep->num_qubits > max_block_qubits);
+    if (saves_passes) {
+        for (int m = 0; m < num_members; m++) taken[members[m]] = true;
+    } else {
+        free_diagonal_sweep(sweep);
+        sweep = NULL;
+    }
+    free(members);
+    return sweep;
+}
+
+// Lowers the fixed ops gates[0..count): runs of diagonal gates become diagonal sweeps,
+// and the gates between them are lowered as segments
+static bool lower_fixed_ops(const GateApplication* gates, int count, int max_block_qubits, CircuitPlan* plan) {
+    if (count == 0) return true;
+    bool* taken = calloc((size_t)count, sizeof(bool));
+    uint64_t* suffix = malloc(((size_t)count + 1) * sizeof(uint64_t));
+    GateApplication* segment = malloc((size_t)count * sizeof(GateApplication));
+    if (!taken || !suffix || !segment) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(taken);
+        free(suffix);
+        free(segment);
+        return false;
+    }
+    suffix[count] = 0;
+    for (int j = count - 1; j >= 0; j--) suffix[j] = suffix[j + 1] | gate_mask(&gates[j]);
+
+    bool ok = true;
+    int segment_length = 0;
+    for (int i = 0; i < count && ok; i++) {
+        if (taken[i]) continue;
+        DiagonalSweep* sweep = NULL;
+        if (is_diagonal_gate(&gates[i].gate)) {
+            sweep = collect_sweep(gates, i, count, suffix, max_block_qubits, taken);
+        }
+        if (!sweep) {
+            segment[segment_length++] = gates[i];
+            continue;
+        }
+        ok = lower_segment(segment, segment_length, max_block_qubits, plan);
+        segment_length = 0;
+
+        PlanStep* step = &plan->steps[plan->num_steps++];
+        step->kind = STEP_DIAGONAL_SWEEP;
+        step->target = sweep->qubits[0];
+        step->control = NO_CONTROL;
+        step->num_qubits = sweep->num_qubits;
+        for (int q = 0; q < sweep->num_qubits; q++) step->qubits[q] = sweep->qubits[q];
+        step->matrix = NULL;
+        step->sweep = sweep;
+    }
+    if (ok) ok = lower_segment(segment, segment_length, max_block_qubits, plan);
+    free(taken);
+    free(suffix);
+    free(segment);
+    return ok;
+}
+
+bool compile_circuit(const Circuit* circuit, int max_block_qubits, CircuitPlan* plan) {
+    if (!circuit || !plan || max_block_qubits < 0 || max_block_qubits > MAX_BLOCK_QUBITS) {
+        fprintf(stderr, "Error: Invalid parameters for circuit compilation\n");
+        return false;
+    }
+    if (circuit->num_qubits > 62) {
+        fprintf(stderr, "Error: Circuits on more than 62 qubits cannot be compiled to a statevector plan\n");
+        return false;
+    }
+    plan->num_qubits = circuit->num_qubits;
+    plan->num_params = circuit->num_params;
+    plan->num_steps = 0;
+    plan->num_source_ops = circuit->num_ops;
+
+    // Fusion never produces more steps than there are ops
+    plan->steps = malloc(((size_t)circuit->num_ops + 1) * sizeof(PlanStep));
+    GateApplication* pending = malloc(((size_t)circuit->num_ops + 1) * sizeof(GateApplication));
+    if (!plan->steps || !pending) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(pending);
+        free_circuit_plan(plan);
+        return false;
+    }
+
+    int num_pending = 0;
+    for (int i = 0; i < circuit->num_ops; i++) {
+        const CircuitOp* op = &circuit->ops[i];
+        if (op->param_index < 0) {
+            pending[num_pending++] = (GateApplication){circuit_op_gate(op, NULL), op->target, op->control};
+            continue;
+        }
+        // A parametric op ends the run of fixed ops that can be fused ahead of time
+        if (!lower_fixed_ops(pending, num_pending, max_block_qubits, plan)) {
+            free(pending);
+            free_circuit_plan(plan);
+            return false;
+        }
+        num_pending = 0;
+        PlanStep* step = &plan->steps[plan->num_steps++];
+        step->kind = STEP_PARAMETRIC;
+        step->target = op->target;
+        step->control = NO_CONTROL;
+        step->num_qubits = 0;
+        step->matrix = NULL;
+        step->sweep = NULL;
+        step->op = *op;
+    }
+    bool ok = lower_fixed_ops(pending, num_pending, max_block_qubits, plan);
+    free(pending);
+    if (!ok) free_circuit_plan(plan);
+    return ok;
+}
+
+void free_circuit_plan(CircuitPlan* plan) {
+    if (!plan) return;
+    if (plan->steps) {
+        for (int i = 0; i < plan->num_steps; i++) {
+            free(plan->steps[i].matrix);
+            free_diagonal_sweep(plan->steps[i].sweep);
+        }
+        free(plan->steps);
+    }
+    plan->steps = NULL;
+    plan->num_steps = 0;
+}
+
+// Execution
+
+static bool check_plan_state(const CircuitPlan* plan, const Statevector* sv, const double* params) {
+    if (!sv || sv->num_qubits < plan->num_qubits) {
+        fprintf(stderr, "Error: Statevector is too small for the circuit\n");
+        return false;
+    }
+    if (plan->num_params > 0 && !params) {
+        fprintf(stderr, "Error: Missing circuit parameters\n");
+        return false;
+    }
+    return true;
+}
+
+static void run_plan(const CircuitPlan* plan, Statevector* sv, const double* params) {
+    for (int i = 0; i < plan->num_steps; i++) {
+        run_plan_step(sv, &plan->steps[i], params);
+    }
+}
+
+bool execute_plan(const CircuitPlan* plan, Statevector* sv, const double* params) {
+    if (!plan || !check_plan_state(plan, sv, params)) return false;
+    run_plan(plan, sv, params);
+    return true;
+}
+
+typedef struct {
+    const CircuitPlan* plan;
+    Statevector* const* states;
+    const double* params;
+} BatchJob;
+
+static const double* batch_params(const BatchJob* job, size_t b) {
+    return job->params ? job->params + b * (size_t)job->plan->num_params : NULL;
+}
+
+static void batch_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const BatchJob* job = context;
+    for (size_t b = begin; b < end; b++) {
+        run_plan(job->plan, job->states[b], batch_params(job, b));
+    }
+}
+
+bool execute_plan_batch(const CircuitPlan* plan, Statevector* const* states, int batch_size, const double* params) {
+    if (!plan || !states || batch_size < 0) {
+        fprintf(stderr, "Error: Invalid parameters for batch execution\n");
+        return false;
+    }
+    BatchJob job = {plan, states, params};
+    bool small_states = true;
+    for (int b = 0; b < batch_size; b++) {
+        if (!check_plan_state(plan, states[b], batch_params(&job, (size_t)b))) return false;
+        if (states[b]->dimension / 2 >= PARALLEL_MIN_ITEMS) small_states = false;
+    }
+
+    // Large states already keep every thread busy inside each kernel
+    if (small_states) {
+        parallel_for_items((size_t)batch_size, batch_task, &job);
+    } else {
+        batch_task(0, (size_t)batch_size, 0, &job);
+    }
+    return true;
+}
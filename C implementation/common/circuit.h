@@ -0,0 +1,140 @@
+// circuit.h
+#ifndef CIRCUIT_H
+#define CIRCUIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "statevector_core.h"
+#include "gate_fusion.h"
+#include "diagonal_sweep.h"
+
+typedef enum {
+    OP_X,
+    OP_Y,
+    OP_Z,
+    OP_H,
+    OP_S,
+    OP_T,
+    OP_RX,
+    OP_RY,
+    OP_RZ,
+    OP_CNOT,
+    OP_CZ,
+    NUM_GATE_OPS
+} GateOp;
+
+// One entry of the gate list
+typedef struct {
+    GateOp op;
+    int target;
+    int control;      // NO_CONTROL for single-qubit ops
+    int param_index;  // rotations only: index into the bound parameters, or -1 for a fixed angle
+    double angle;     // fixed rotation angle
+} CircuitOp;
+
+// A circuit may be wider than any statevector: Clifford circuits run on the stabilizer
+// backend (stabilizer.h), whose cost grows with n^2 instead of 2^n. Plans, and with them
+// the statevector executors, are limited to 62 qubits.
+#define MAX_CIRCUIT_QUBITS 65536
+
+typedef struct {
+    int num_qubits;
+    int num_params;  // one more than the highest param_index in use
+    CircuitOp* ops;
+    int num_ops;
+    int capacity;
+} Circuit;
+
+Circuit* create_circuit(int num_qubits);
+void free_circuit(Circuit* circuit);
+
+// Builders. Each checks its qubits against circuit->num_qubits and returns false on error.
+bool circuit_add_gate(Circuit* circuit, GateOp op, int target);                  // X, Y, Z, H, S, T
+bool circuit_add_controlled(Circuit* circuit, GateOp op, int control, int target);  // CNOT, CZ
+bool circuit_add_rotation(Circuit* circuit, GateOp op, int target, double angle);    // RX, RY, RZ
+bool circuit_add_parametric(Circuit* circuit, GateOp op, int target, int param_index);
+
+const char* gate_op_name(GateOp op);
+
+// The 2x2 gate of an op (the target gate for controlled ops). params may be NULL when
+// the op has a fixed angle.
+QuantumGate circuit_op_gate(const CircuitOp* op, const double* params);
+
+// Applies a single op with the fastest kernel for it
+bool apply_circuit_op(Statevector* sv, const CircuitOp* op, const double* params);
+
+// Applies the inverse (conjugate transpose) of a single op, undoing apply_circuit_op
+bool apply_circuit_op_inverse(Statevector* sv, const CircuitOp* op, const double* params);
+
+typedef enum {
+    STEP_SWAP,                 // kernel_swap_pairs
+    STEP_HADAMARD,             // kernel_hadamard_pairs
+    STEP_PHASE,                // kernel_phase_pairs with gate.elements[1][1]
+    STEP_DIAGONAL,             // kernel_diagonal_pairs with the diagonal of gate
+    STEP_MATRIX,               // kernel_matrix_pairs
+    STEP_CONTROLLED_SWAP,      // kernel_controlled_swap_pairs
+    STEP_CONTROLLED_PHASE,     // kernel_controlled_phase_pairs with gate.elements[1][1]
+    STEP_CONTROLLED_DIAGONAL,  // kernel_controlled_diagonal_pairs with the diagonal of gate
+    STEP_CONTROLLED_MATRIX,    // kernel_controlled_matrix_pairs
+    STEP_DENSE,                // kernel_dense_block
+    STEP_DIAGONAL_SWEEP,       // kernel_diagonal_sweep
+    STEP_PARAMETRIC            // gate built from the bound parameters on every execution
+} PlanStepKind;
+
+typedef struct {
+    PlanStepKind kind;
+    int target;
+    int control;
+    QuantumGate gate;
+    int num_qubits;
+    int qubits[MAX_SWEEP_QUBITS];  // dense blocks use at most MAX_BLOCK_QUBITS, sweeps one per slot
+    Complex* matrix;
+    DiagonalSweep* sweep;
+    CircuitOp op;
+} PlanStep;
+
+// A circuit lowered to kernel calls. Compiling once and executing many times keeps the
+// kernel selection and fusion out of the per-run cost.
+typedef struct {
+    int num_qubits;
+    int num_params;
+    PlanStep* steps;
+    int num_steps;
+    int num_source_ops;
+} CircuitPlan;
+
+// max_block_qubits = 0 maps every op to its own kernel call. Otherwise the fixed ops
+// between two parametric ops are fused with fuse_gates() into blocks of at most
+// max_block_qubits qubits. In both cases a fixed diagonal gate collects the diagonal gates
+// after it that commute with everything in between into one diagonal sweep, when that
+// saves passes: at least two gates, on more than max_block_qubits qubits when fusing.
+bool compile_circuit(const Circuit* circuit, int max_block_qubits, CircuitPlan* plan);
+void free_circuit_plan(CircuitPlan* plan);
+
+// Runs one step on sv. Qubit indices are not checked; execute_plan() validates the plan.
+void run_plan_step(Statevector* sv, const PlanStep* step, const double* params);
+
+// Runs one step on a chunk of a larger state that starts at amplitude base_index. The
+// step's qubits in plan_step_local_mask() must lie inside the chunk.
+void run_plan_step_at(Statevector* sv, const PlanStep* step, const double* params, size_t base_index);
+
+// Bit q is set for every qubit q the step acts on
+uint64_t plan_step_mask(const PlanStep* step);
+
+// The qubits of plan_step_mask() that must be inside a chunk the step runs on. A diagonal
+// sweep reads the others from the chunk's base index and needs none.
+uint64_t plan_step_local_mask(const PlanStep* step);
+
+// Renames every qubit q of the step to position[q]
+void remap_plan_step(PlanStep* step, const int* position);
+
+// Runs the plan on the current contents of sv. params holds plan->num_params values and
+// may be NULL for a plan without parametric ops.
+bool execute_plan(const CircuitPlan* plan, Statevector* sv, const double* params);
+
+// Runs the plan on every state of the batch; row b of params (plan->num_params values)
+// binds the parameters of states[b]. States too small to split across the thread pool are
+// distributed over it whole instead.
+bool execute_plan_batch(const CircuitPlan* plan, Statevector* const* states, int batch_size, const double* params);
+
+#endif // CIRCUIT_H
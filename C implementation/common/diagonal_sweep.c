@@ -0,0 +1,339 @@
+// diagonal_sweep.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "diagonal_sweep.h"
+#include "gate_fusion.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+
+// Same as the pair kernels: no fused multiply-add, so every SIMD level gives the same bits,
+// and the dynamic cost model so GCC vectorizes the block loops at -O2
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off", "vect-cost-model=dynamic")
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define QSIM_HAVE_X86_SIMD 1
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+#endif
+
+// Amplitudes are scaled in blocks of 2^SWEEP_BLOCK_QUBITS. Within a block only the table
+// bits below SWEEP_BLOCK_QUBITS vary; the others are looked up once per block.
+#define SWEEP_BLOCK_QUBITS 6
+#define SWEEP_BLOCK ((size_t)1 << SWEEP_BLOCK_QUBITS)
+
+bool is_diagonal_gate(const QuantumGate* gate) {
+    return gate->elements[0][1].real == 0.0 && gate->elements[0][1].imag == 0.0 &&
+           gate->elements[1][0].real == 0.0 && gate->elements[1][0].imag == 0.0;
+}
+
+DiagonalSweep* create_diagonal_sweep(void) {
+    DiagonalSweep* sweep = calloc(1, sizeof(DiagonalSweep));
+    if (!sweep) fprintf(stderr, "Error: Memory allocation failed\n");
+    return sweep;
+}
+
+void free_diagonal_sweep(DiagonalSweep* sweep) {
+    if (!sweep) return;
+    for (int t = 0; t < sweep->num_tables; t++) {
+        free(sweep->tables[t].real);
+        free(sweep->tables[t].imag);
+    }
+    free(sweep);
+}
+
+// Building
+
+static int find_slot(const DiagonalSweep* sweep, int qubit) {
+    for (int s = 0; s < sweep->num_qubits; s++) {
+        if (sweep->qubits[s] == qubit) return s;
+    }
+    return -1;
+}
+
+static int table_bit(const PhaseTable* table, int slot) {
+    for (int b = 0; b < table->num_bits; b++) {
+        if (table->slots[b] == slot) return b;
+    }
+    return -1;
+}
+
+// Adds the given slots as new top bits; every new entry copies the entry with those bits clear
+static bool extend_table(PhaseTable* table, const int* slots, int count) {
+    size_t old_size = (size_t)1 << table->num_bits;
+    size_t size = old_size << count;
+    double* real = malloc(size * sizeof(double));
+    double* imag = malloc(size * sizeof(double));
+    if (!real || !imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(real);
+        free(imag);
+        return false;
+    }
+    for (size_t x = 0; x < size; x++) {
+        real[x] = table->real ? table->real[x & (old_size - 1)] : 1.0;
+        imag[x] = table->imag ? table->imag[x & (old_size - 1)] : 0.0;
+    }
+    free(table->real);
+    free(table->imag);
+    table->real = real;
+    table->imag = imag;
+    for (int i = 0; i < count; i++) table->slots[table->num_bits++] = slots[i];
+    return true;
+}
+
+bool diagonal_sweep_add(DiagonalSweep* sweep, const QuantumGate* gate, int target, int control) {
+    if (!sweep || !is_diagonal_gate(gate) || target < 0 || target >= 64 || control == target ||
+        (control != NO_CONTROL && (control < 0 || control >= 64))) {
+        return false;
+    }
+    // Slots the gate needs, with new ones numbered after the existing slots
+    int qubits[2] = {target, control};
+    int count = control == NO_CONTROL ? 1 : 2;
+    int slots[2], num_new = 0;
+    bool is_new[2] = {false, false};
+    for (int i = 0; i < count; i++) {
+        slots[i] = find_slot(sweep, qubits[i]);
+        if (slots[i] < 0) {
+            slots[i] = sweep->num_qubits + num_new++;
+            is_new[i] = true;
+        }
+    }
+    if (sweep->num_qubits + num_new > MAX_SWEEP_QUBITS) return false;
+
+    // Prefer a table that already has the gate's qubits, then one that has some of them,
+    // then any with room: fewer tables mean fewer lookups per amplitude
+    int chosen = -1, chosen_missing = 0, chosen_rank = 3;
+    for (int t = 0; t < sweep->num_tables; t++) {
+        int missing = 0;
+        for (int i = 0; i < count; i++) missing += table_bit(&sweep->tables[t], slots[i]) < 0;
+        if (sweep->tables[t].num_bits + missing > MAX_PHASE_TABLE_QUBITS) continue;
+        int rank = missing == 0 ? 0 : (missing < count ? 1 : 2);
+        if (rank < chosen_rank) {
+            chosen = t;
+            chosen_missing = missing;
+            chosen_rank = rank;
+        }
+    }
+    if (chosen < 0) {
+        if (sweep->num_tables == MAX_PHASE_TABLES) return false;
+        chosen = sweep->num_tables;
+        chosen_missing = count;
+        sweep->tables[chosen] = (PhaseTable){0};
+    }
+
+    PhaseTable* table = &sweep->tables[chosen];
+    int added[2], num_added = 0;
+    for (int i = 0; i < count; i++) {
+        if (table_bit(table, slots[i]) < 0) added[num_added++] = slots[i];
+    }
+    if (chosen_missing > 0 || !table->real) {
+        if (!extend_table(table, added, num_added)) return false;
+    }
+    if (chosen == sweep->num_tables) sweep->num_tables++;
+    for (int i = 0; i < count; i++) {
+        if (is_new[i]) sweep->qubits[sweep->num_qubits++] = qubits[i];
+    }
+
+    int target_bit = table_bit(table, slots[0]);
+    int control_bit = count == 2 ? table_bit(table, slots[1]) : -1;
+    for (size_t x = 0; x < ((size_t)1 << table->num_bits); x++) {
+        if (control_bit >= 0 && !((x >> control_bit) & 1)) continue;
+        int v = (x >> target_bit) & 1;
+        Complex d = gate->elements[v][v];
+        double re = table->real[x] * d.real - table->imag[x] * d.imag;
+        double im = table->real[x] * d.imag + table->imag[x] * d.real;
+        table->real[x] = re;
+        table->imag[x] = im;
+    }
+    sweep->num_gates++;
+    return true;
+}
+
+Complex diagonal_sweep_factor(const DiagonalSweep* sweep, const int* qubits, size_t index) {
+    Complex factor = {1.0, 0.0};
+    for (int t = 0; t < sweep->num_tables; t++) {
+        const PhaseTable* table = &sweep->tables[t];
+        size_t x = 0;
+        for (int b = 0; b < table->num_bits; b++) x |= ((index >> qubits[table->slots[b]]) & 1) << b;
+        double re = factor.real * table->real[x] - factor.imag * table->imag[x];
+        factor.imag = factor.real * table->imag[x] + factor.imag * table->real[x];
+        factor.real = re;
+    }
+    return factor;
+}
+
+// Kernel
+
+typedef struct {
+    void* real;  // double, or float for the float kernels
+    void* imag;
+    size_t base_index;
+    size_t block;
+    int num_tables;
+    // Tables with bits inside a block come first; their entries vary within the block
+    int num_varying;
+    const PhaseTable* tables[MAX_PHASE_TABLES];
+    int positions[MAX_PHASE_TABLES][MAX_PHASE_TABLE_QUBITS];
+    uint16_t block_index[MAX_PHASE_TABLES][SWEEP_BLOCK];  // index bits from the offset in the block
+} SweepJob;
+
+// Index bits of table t that come from outside the block starting at global index g
+static inline size_t outer_index(const SweepJob* job, int t, size_t g) {
+    size_t index = 0;
+    for (int b = 0; b < job->tables[t]->num_bits; b++) {
+        int p = job->positions[t][b];
+        if ((size_t)1 << p >= job->block) index |= ((g >> p) & 1) << b;
+    }
+    return index;
+}
+
+// The scalar, AVX2 and AVX-512 variants are the same loops compiled for each target. The
+// amplitudes are stored as S and multiplied by the factors in M; the factors themselves
+// are always built in double.
+#define SWEEP_TASK_BODY(job, begin, end, S, M)                                                    \
+    double phase_re[SWEEP_BLOCK], phase_im[SWEEP_BLOCK];                                          \
+    for (size_t start = (begin); start < (end); start += (job)->block) {                          \
+        size_t g = (job)->base_index + start;                                                     \
+        double c_re = 1.0, c_im = 0.0;                                                            \
+        for (int t = (job)->num_varying; t < (job)->num_tables; t++) {                            \
+            size_t x = outer_index(job, t, g);                                                    \
+            double t_re = (job)->tables[t]->real[x], t_im = (job)->tables[t]->imag[x];            \
+            double re = c_re * t_re - c_im * t_im;                                                \
+            c_im = c_re * t_im + c_im * t_re;                                                     \
+            c_re = re;                                                                            \
+        }                                                                                         \
+        S* restrict re_out = (S*)(job)->real + start;                                             \
+        S* restrict im_out = (S*)(job)->imag + start;                                             \
+        size_t n = (job)->block;                                                                  \
+        if ((job)->num_varying == 0) {                                                            \
+            M f_re = (M)c_re, f_im = (M)c_im;                                                     \
+            for (size_t j = 0; j < n; j++) {                                                      \
+                M a = re_out[j], b = im_out[j];                                                   \
+                re_out[j] = (S)(a * f_re - b * f_im);                                             \
+                im_out[j] = (S)(a * f_im + b * f_re);                                             \
+            }                                                                                     \
+            continue;                                                                             \
+        }                                                                                         \
+        for (size_t j = 0; j < n; j++) {                                                          \
+            phase_re[j] = c_re;                                                                   \
+            phase_im[j] = c_im;                                                                   \
+        }                                                                                         \
+        for (int t = 0; t < (job)->num_varying; t++) {                                            \
+            size_t x = outer_index(job, t, g);                                                    \
+            const double* t_re = (job)->tables[t]->real + x;                                      \
+            const double* t_im = (job)->tables[t]->imag + x;                                      \
+            const uint16_t* index = (job)->block_index[t];                                        \
+            for (size_t j = 0; j < n; j++) {                                                      \
+                double p_re = t_re[index[j]], p_im = t_im[index[j]];                              \
+                double re = phase_re[j] * p_re - phase_im[j] * p_im;                              \
+                phase_im[j] = phase_re[j] * p_im + phase_im[j] * p_re;                            \
+                phase_re[j] = re;                                                                 \
+            }                                                                                     \
+        }                                                                                         \
+        for (size_t j = 0; j < n; j++) {                                                          \
+            M a = re_out[j], b = im_out[j], f_re = (M)phase_re[j], f_im = (M)phase_im[j];         \
+            re_out[j] = (S)(a * f_re - b * f_im);                                                 \
+            im_out[j] = (S)(a * f_im + b * f_re);                                                 \
+        }                                                                                         \
+    }
+
+#define DEFINE_SWEEP_TASK(name, S, M)                                       \
+    static void name(size_t begin, size_t end, int worker, void* context) { \
+        (void)worker;                                                       \
+        const SweepJob* job = context;                                      \
+        SWEEP_TASK_BODY(job, begin, end, S, M)                              \
+    }
+
+// Double states, and float states in single and in mixed precision
+DEFINE_SWEEP_TASK(sweep_task, double, double)
+DEFINE_SWEEP_TASK(sweep_task_single, float, float)
+DEFINE_SWEEP_TASK(sweep_task_mixed, float, double)
+
+#ifdef QSIM_HAVE_X86_SIMD
+AVX2 DEFINE_SWEEP_TASK(sweep_task_avx2, double, double)
+AVX2 DEFINE_SWEEP_TASK(sweep_task_single_avx2, float, float)
+AVX2 DEFINE_SWEEP_TASK(sweep_task_mixed_avx2, float, double)
+AVX512 DEFINE_SWEEP_TASK(sweep_task_avx512, double, double)
+AVX512 DEFINE_SWEEP_TASK(sweep_task_single_avx512, float, float)
+AVX512 DEFINE_SWEEP_TASK(sweep_task_mixed_avx512, float, double)
+#endif
+
+typedef enum {
+    SWEEP_DOUBLE,
+    SWEEP_SINGLE,
+    SWEEP_MIXED
+} SweepStorage;
+
+static ParallelTask select_sweep_task(SweepStorage storage) {
+#ifdef QSIM_HAVE_X86_SIMD
+    switch (get_simd_level()) {
+        case SIMD_AVX512:
+            return storage == SWEEP_DOUBLE ? sweep_task_avx512
+                   : storage == SWEEP_SINGLE ? sweep_task_single_avx512 : sweep_task_mixed_avx512;
+        case SIMD_AVX2:
+            return storage == SWEEP_DOUBLE ? sweep_task_avx2
+                   : storage == SWEEP_SINGLE ? sweep_task_single_avx2 : sweep_task_mixed_avx2;
+        default: break;
+    }
+#endif
+    return storage == SWEEP_DOUBLE ? sweep_task : storage == SWEEP_SINGLE ? sweep_task_single : sweep_task_mixed;
+}
+
+static void run_sweep(void* real, void* imag, size_t dimension, SweepStorage storage, const DiagonalSweep* sweep,
+                      const int* qubits, size_t base_index) {
+    SweepJob job = {
+        .real = real,
+        .imag = imag,
+        .base_index = base_index,
+        .block = dimension < SWEEP_BLOCK ? dimension : SWEEP_BLOCK,
+        .num_tables = sweep->num_tables,
+    };
+    // Order the tables so that those with a bit inside the block come first
+    int next = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int t = 0; t < sweep->num_tables; t++) {
+            const PhaseTable* table = &sweep->tables[t];
+            bool varying = false;
+            for (int b = 0; b < table->num_bits; b++) {
+                varying |= ((size_t)1 << qubits[table->slots[b]]) < job.block;
+            }
+            if (varying != (pass == 0)) continue;
+            job.tables[next] = table;
+            job.num_varying += varying;
+            for (int b = 0; b < table->num_bits; b++) job.positions[next][b] = qubits[table->slots[b]];
+            if (varying) {
+                for (size_t j = 0; j < job.block; j++) {
+                    uint16_t index = 0;
+                    for (int b = 0; b < table->num_bits; b++) {
+                        if (((size_t)1 << job.positions[next][b]) < job.block) {
+                            index |= (uint16_t)(((j >> job.positions[next][b]) & 1) << b);
+                        }
+                    }
+                    job.block_index[next][j] = index;
+                }
+            }
+            next++;
+        }
+    }
+    parallel_for(dimension, select_sweep_task(storage), &job);
+}
+
+void kernel_diagonal_sweep(Statevector* sv, const DiagonalSweep* sweep, const int* qubits, size_t base_index) {
+    INSTRUMENT_BEGIN(span);
+    run_sweep(sv->real, sv->imag, sv->dimension, SWEEP_DOUBLE, sweep, qubits, base_index);
+    INSTRUMENT_END(span, "kernel", "diagonal-sweep", qubits[0], NO_CONTROL, sv->dimension / 2,
+                   2 * sv->dimension * BYTES_PER_AMPLITUDE);
+}
+
+void kernel_diagonal_sweep_f32(float* real, float* imag, size_t dimension, const DiagonalSweep* sweep,
+                               const int* qubits, bool mixed) {
+    INSTRUMENT_BEGIN(span);
+    run_sweep(real, imag, dimension, mixed ? SWEEP_MIXED : SWEEP_SINGLE, sweep, qubits, 0);
+    INSTRUMENT_END(span, "kernel", "diagonal-sweep-f32", qubits[0], NO_CONTROL, dimension / 2,
+                   2 * dimension * 2 * sizeof(float));
+}
@@ -0,0 +1,63 @@
+// diagonal_sweep.h
+#ifndef DIAGONAL_SWEEP_H
+#define DIAGONAL_SWEEP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "statevector_core.h"
+
+// A phase table covers at most this many qubits: 256 entries in 4 KiB, so all tables of a
+// sweep stay in L1 while it streams over the state
+#define MAX_PHASE_TABLE_QUBITS 8
+#define MAX_PHASE_TABLES 8
+
+// Distinct qubits one sweep may touch
+#define MAX_SWEEP_QUBITS 64
+
+// Diagonal of a gate on the qubits in slots slots[0..num_bits): entry x is the factor for
+// the amplitudes in which the qubit of slot slots[b] has the value of bit b of x
+typedef struct {
+    int num_bits;
+    int slots[MAX_PHASE_TABLE_QUBITS];
+    double* real;
+    double* imag;
+} PhaseTable;
+
+// A run of diagonal gates (Z, S, T, RZ, CZ, controlled phases, ...) multiplied into phase
+// tables. Each amplitude is scaled by the product of one entry of every table, so the
+// whole run costs a single pass over the state however many qubits it touches. Tables
+// may share qubits.
+typedef struct {
+    int num_qubits;
+    int qubits[MAX_SWEEP_QUBITS];  // the qubit of each slot
+    int num_tables;
+    PhaseTable tables[MAX_PHASE_TABLES];
+    int num_gates;
+} DiagonalSweep;
+
+bool is_diagonal_gate(const QuantumGate* gate);
+
+DiagonalSweep* create_diagonal_sweep(void);  // the identity
+void free_diagonal_sweep(DiagonalSweep* sweep);
+
+// Multiplies a diagonal gate on target, controlled by control unless that is NO_CONTROL,
+// into the sweep. Returns false and leaves the sweep unchanged if the gate is not diagonal
+// or the tables are full.
+bool diagonal_sweep_add(DiagonalSweep* sweep, const QuantumGate* gate, int target, int control);
+
+// Factor the sweep applies to the amplitude at index, for callers that store amplitudes
+// some other way
+Complex diagonal_sweep_factor(const DiagonalSweep* sweep, const int* qubits, size_t index);
+
+// Applies the sweep in one pass. qubits gives the position of each slot in the state
+// (sweep->qubits, or a remapped copy). sv may be a chunk holding amplitudes base_index,
+// base_index + 1, ... of a larger state: positions at or above sv->num_qubits are read from
+// base_index, so the sweep never needs its qubits to be local to the chunk.
+void kernel_diagonal_sweep(Statevector* sv, const DiagonalSweep* sweep, const int* qubits, size_t base_index);
+
+// The same pass over a float state of dimension amplitudes (statevector_f32.h). The factors
+// are built in double as above and multiplied in float, or in double when mixed is set.
+void kernel_diagonal_sweep_f32(float* real, float* imag, size_t dimension, const DiagonalSweep* sweep,
+                               const int* qubits, bool mixed);
+
+#endif // DIAGONAL_SWEEP_H
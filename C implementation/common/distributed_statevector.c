@@ -0,0 +1,313 @@
+// distributed_statevector.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "distributed_statevector.h"
+#include "cache_blocking.h"
+#include "instrumentation.h"
+
+// State management
+
+DistributedStatevector* create_distributed_statevector(int num_qubits, Transport* transport) {
+    if (!transport) {
+        fprintf(stderr, "Error: Invalid parameters for distributed statevector\n");
+        return NULL;
+    }
+    int global_qubits = 0;
+    while ((1 << global_qubits) < transport->num_ranks) global_qubits++;
+    if ((1 << global_qubits) != transport->num_ranks) {
+        fprintf(stderr, "Error: Rank count must be a power of two\n");
+        return NULL;
+    }
+    if (num_qubits > 62 || num_qubits - global_qubits < MIN_DISTRIBUTED_LOCAL_QUBITS) {
+        fprintf(stderr, "Error: Invalid number of qubits for %d ranks\n", transport->num_ranks);
+        return NULL;
+    }
+
+    DistributedStatevector* ds = malloc(sizeof(DistributedStatevector));
+    if (!ds) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        transport->fail(transport);
+        return NULL;
+    }
+    ds->num_qubits = num_qubits;
+    ds->local_qubits = num_qubits - global_qubits;
+    ds->global_qubits = global_qubits;
+    ds->transport = transport;
+    ds->stats.num_exchanges = 0;
+    ds->stats.bytes_sent = 0;
+    ds->local = create_statevector(ds->local_qubits);
+
+    size_t buffer_amplitudes = (size_t)1 << (ds->local_qubits - 1);
+    if (buffer_amplitudes > EXCHANGE_AMPLITUDES) buffer_amplitudes = EXCHANGE_AMPLITUDES;
+    ds->send_buffer = malloc(buffer_amplitudes * BYTES_PER_AMPLITUDE);
+    ds->recv_buffer = malloc(buffer_amplitudes * BYTES_PER_AMPLITUDE);
+    if (!ds->local || !ds->send_buffer || !ds->recv_buffer) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_distributed_statevector(ds);
+        transport->fail(transport);
+        return NULL;
+    }
+    // |0...0⟩ lives on rank 0
+    if (transport->rank != 0) ds->local->real[0] = 0.0;
+    return ds;
+}
+
+void free_distributed_statevector(DistributedStatevector* ds) {
+    if (!ds) return;
+    free_statevector(ds->local);
+    free(ds->send_buffer);
+    free(ds->recv_buffer);
+    free(ds);
+}
+
+double distributed_norm(const DistributedStatevector* ds) {
+    double norm = statevector_norm(ds->local);
+    double sum = norm * norm;
+    if (!ds->transport->allreduce_sum(ds->transport, &sum, 1)) return NAN;
+    return sqrt(sum);
+}
+
+bool gather_distributed_statevector(const DistributedStatevector* ds, Statevector* dst) {
+    Transport* transport = ds->transport;
+    size_t local_bytes = ds->local->dimension * sizeof(double);
+    if (transport->rank != 0) {
+        return transport->send(transport, 0, ds->local->real, local_bytes) &&
+               transport->send(transport, 0, ds->local->imag, local_bytes);
+    }
+    if (!dst || dst->num_qubits != ds->num_qubits) {
+        fprintf(stderr, "Error: Gather target must have %d qubits\n", ds->num_qubits);
+        transport->fail(transport);
+        return false;
+    }
+    memcpy(dst->real, ds->local->real, local_bytes);
+    memcpy(dst->imag, ds->local->imag, local_bytes);
+    for (int r = 1; r < transport->num_ranks; r++) {
+        size_t offset = (size_t)r << ds->local_qubits;
+        if (!transport->recv(transport, r, dst->real + offset, local_bytes) ||
+            !transport->recv(transport, r, dst->imag + offset, local_bytes)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Qubit layout
+
+// Logical qubit q lives at physical position position[q]; qubit_at is the inverse.
+// Positions at or above local_qubits are index bits of the rank.
+typedef struct {
+    int position[64];
+    int qubit_at[64];
+} QubitLayout;
+
+static void exchange_positions(QubitLayout* layout, int p, int q) {
+    int a = layout->qubit_at[p], b = layout->qubit_at[q];
+    layout->qubit_at[p] = b;
+    layout->qubit_at[q] = a;
+    layout->position[a] = q;
+    layout->position[b] = p;
+}
+
+// Swaps the global qubit at global_position with the local one at local_position. Only
+// amplitudes whose local bit differs from this rank's global bit move: this rank sends
+// that half of its amplitudes to the partner differing in the global bit and receives
+// the matching half of the partner's in their place. Both ranks pack their halves in
+// index order, so the k-th amplitude received replaces the k-th one sent.
+static bool exchange_qubit(DistributedStatevector* ds, int global_position, int local_position) {
+    INSTRUMENT_BEGIN(span);
+    Transport* transport = ds->transport;
+    int rank_bit = global_position - ds->local_qubits;
+    int peer = transport->rank ^ (1 << rank_bit);
+    size_t sent_bit = (size_t)(((transport->rank >> rank_bit) & 1) ^ 1) << local_position;
+    size_t low_mask = ((size_t)1 << local_position) - 1;
+    size_t half = ds->local->dimension / 2;
+    double* real = ds->local->real;
+    double* imag = ds->local->imag;
+
+    for (size_t first = 0; first < half; first += EXCHANGE_AMPLITUDES) {
+        size_t count = half - first < EXCHANGE_AMPLITUDES ? half - first : EXCHANGE_AMPLITUDES;
+        for (size_t k = 0; k < count; k++) {
+            size_t j = first + k;
+            size_t i = ((j & ~low_mask) << 1) | sent_bit | (j & low_mask);
+            ds->send_buffer[k] = real[i];
+            ds->send_buffer[count + k] = imag[i];
+        }
+        if (!transport->exchange(transport, peer, ds->send_buffer, ds->recv_buffer, count * BYTES_PER_AMPLITUDE)) {
+            return false;
+        }
+        for (size_t k = 0; k < count; k++) {
+            size_t j = first + k;
+            size_t i = ((j & ~low_mask) << 1) | sent_bit | (j & low_mask);
+            real[i] = ds->recv_buffer[k];
+            imag[i] = ds->recv_buffer[count + k];
+        }
+    }
+    ds->stats.num_exchanges++;
+    ds->stats.bytes_sent += half * BYTES_PER_AMPLITUDE;
+    INSTRUMENT_END(span, "comm", "exchange", global_position, NO_CONTROL, 0, 2 * half * BYTES_PER_AMPLITUDE);
+    return true;
+}
+
+// Exchanges the qubits at two physical positions. Two global qubits are swapped through
+// local position 0, which ends up where it started.
+static bool swap_positions(DistributedStatevector* ds, QubitLayout* layout, int p, int q) {
+    if (p > q) {
+        int t = p;
+        p = q;
+        q = t;
+    }
+    bool ok;
+    if (q < ds->local_qubits) {
+        ok = kernel_swap_qubits(ds->local, &p, &q, 1);
+    } else if (p < ds->local_qubits) {
+        ok = exchange_qubit(ds, q, p);
+    } else {
+        ok = exchange_qubit(ds, p, 0) && exchange_qubit(ds, q, 0) && exchange_qubit(ds, p, 0);
+    }
+    if (ok) exchange_positions(layout, p, q);
+    return ok;
+}
+
+// Execution
+
+// Multiplies every local amplitude by factor: a diagonal with equal entries on any qubit
+static void scale_local(Statevector* sv, Complex factor) {
+    if (factor.real == 1.0 && factor.imag == 0.0) return;
+    kernel_diagonal_pairs(sv, factor, factor, 0);
+}
+
+static bool is_diagonal_kind(const PlanStep* step) {
+    switch (step->kind) {
+        case STEP_PHASE:
+        case STEP_DIAGONAL:
+        case STEP_CONTROLLED_PHASE:
+        case STEP_CONTROLLED_DIAGONAL:
+            return true;
+        case STEP_PARAMETRIC:
+            return step->op.op == OP_RZ;
+        default:
+            return false;
+    }
+}
+
+// Whether a step given in physical positions has to make its global qubits local first.
+// This depends on the step and the layout only, never on the rank, so that all ranks
+// make the same exchanges. A diagonal gate on a global qubit reduces to one of its
+// entries, and a global control to a yes or no; anything else mixes amplitudes that
+// live on different ranks. A diagonal sweep reads its global qubits from the rank.
+static bool needs_exchange(const PlanStep* step, int local_qubits) {
+    if ((plan_step_local_mask(step) >> local_qubits) == 0) return false;
+    if (step->kind == STEP_DENSE) return true;
+    return step->target >= local_qubits && !is_diagonal_kind(step);
+}
+
+// Runs a step for which needs_exchange() is false on this rank's amplitudes
+static void run_step_on_rank(DistributedStatevector* ds, const PlanStep* step, const double* params) {
+    int local_qubits = ds->local_qubits;
+    int rank = ds->transport->rank;
+    if (step->kind == STEP_DIAGONAL_SWEEP) {
+        run_plan_step_at(ds->local, step, params, (size_t)rank << local_qubits);
+        return;
+    }
+    if ((plan_step_mask(step) >> local_qubits) == 0) {
+        run_plan_step(ds->local, step, params);
+        return;
+    }
+
+    if (step->control != NO_CONTROL && step->control >= local_qubits) {
+        if (!((rank >> (step->control - local_qubits)) & 1)) return;
+        PlanStep target_step = *step;
+        target_step.control = NO_CONTROL;
+        switch (step->kind) {
+            case STEP_CONTROLLED_SWAP: target_step.kind = STEP_SWAP; break;
+            case STEP_CONTROLLED_PHASE: target_step.kind = STEP_PHASE; break;
+            case STEP_CONTROLLED_DIAGONAL: target_step.kind = STEP_DIAGONAL; break;
+            default: target_step.kind = STEP_MATRIX; break;
+        }
+        run_step_on_rank(ds, &target_step, params);
+        return;
+    }
+
+    // A diagonal on a global target, with at most a local control
+    QuantumGate gate = step->gate;
+    if (step->kind == STEP_PARAMETRIC) {
+        gate = circuit_op_gate(&step->op, params);
+    } else if (step->kind == STEP_PHASE || step->kind == STEP_CONTROLLED_PHASE) {
+        gate.elements[0][0] = (Complex){1.0, 0.0};
+    }
+    int bit = (rank >> (step->target - local_qubits)) & 1;
+    Complex entry = gate.elements[bit][bit];
+    if (step->control == NO_CONTROL) {
+        scale_local(ds->local, entry);
+    } else {
+        kernel_phase_pairs(ds->local, entry, step->control);
+    }
+}
+
+static int next_use(const CircuitPlan* plan, int from, int qubit) {
+    for (int i = from; i < plan->num_steps; i++) {
+        if (plan_step_local_mask(&plan->steps[i]) & ((uint64_t)1 << qubit)) return i;
+    }
+    return INT_MAX;
+}
+
+// Brings every global qubit of step onto a local position the step does not use, evicting
+// the local qubit whose next use is furthest away
+static bool make_step_local(DistributedStatevector* ds, const CircuitPlan* plan, int step_index,
+                            QubitLayout* layout) {
+    uint64_t needed = plan_step_mask(&plan->steps[step_index]);
+    for (int q = 0; q < ds->num_qubits; q++) {
+        if (!(needed & ((uint64_t)1 << q)) || layout->position[q] < ds->local_qubits) continue;
+
+        int victim = -1, victim_use = -1;
+        for (int p = 0; p < ds->local_qubits; p++) {
+            int resident = layout->qubit_at[p];
+            if (needed & ((uint64_t)1 << resident)) continue;
+            int use = next_use(plan, step_index + 1, resident);
+            if (use >= victim_use) {
+                victim = p;
+                victim_use = use;
+            }
+        }
+        if (!swap_positions(ds, layout, layout->position[q], victim)) return false;
+    }
+    return true;
+}
+
+bool execute_plan_distributed(const CircuitPlan* plan, DistributedStatevector* ds, const double* params) {
+    if (!plan || !ds || plan->num_qubits > ds->num_qubits || (plan->num_params > 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for distributed execution\n");
+        return false;
+    }
+    ds->stats.num_exchanges = 0;
+    ds->stats.bytes_sent = 0;
+
+    QubitLayout layout;
+    for (int q = 0; q < 64; q++) {
+        layout.position[q] = q;
+        layout.qubit_at[q] = q;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < plan->num_steps && ok; i++) {
+        PlanStep step = plan->steps[i];
+        remap_plan_step(&step, layout.position);
+        if (needs_exchange(&step, ds->local_qubits)) {
+            ok = make_step_local(ds, plan, i, &layout);
+            step = plan->steps[i];
+            remap_plan_step(&step, layout.position);
+        }
+        if (ok) run_step_on_rank(ds, &step, params);
+    }
+
+    // Every rank made the same swaps, so every rank restores the same way
+    for (int p = 0; p < ds->num_qubits && ok; p++) {
+        if (layout.qubit_at[p] != p) ok = swap_positions(ds, &layout, p, layout.position[p]);
+    }
+    if (!ok) fprintf(stderr, "Error: Communication failed on rank %d\n", ds->transport->rank);
+    return ok;
+}
@@ -0,0 +1,60 @@
+// distributed_statevector.h
+#ifndef DISTRIBUTED_STATEVECTOR_H
+#define DISTRIBUTED_STATEVECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "statevector_core.h"
+#include "circuit.h"
+#include "transport.h"
+
+// Every rank must hold all qubits of the widest plan step locally
+#define MIN_DISTRIBUTED_LOCAL_QUBITS MAX_BLOCK_QUBITS
+
+// Amplitudes packed per message of a half-state exchange (1 MiB of real and imaginary parts)
+#define EXCHANGE_AMPLITUDES (1 << 16)
+
+// Communication done by execute_plan_distributed on this rank
+typedef struct {
+    int num_exchanges;  // half-state exchanges with a partner rank
+    size_t bytes_sent;
+} DistributedStats;
+
+// A statevector of num_qubits qubits split over num_ranks = 2^global_qubits ranks. Rank r
+// holds the amplitudes whose top global_qubits index bits equal r, so qubits below
+// local_qubits are local to every rank and the others are global: their value is fixed
+// by the rank.
+typedef struct {
+    Statevector* local;
+    int num_qubits;
+    int local_qubits;
+    int global_qubits;
+    Transport* transport;
+    double* send_buffer;
+    double* recv_buffer;
+    DistributedStats stats;
+} DistributedStatevector;
+
+// Collective: every rank calls it with the same num_qubits. The rank count must be a
+// power of two that leaves at least MIN_DISTRIBUTED_LOCAL_QUBITS local qubits. A rank
+// that runs out of memory fails the transport, so the others do not wait for it.
+DistributedStatevector* create_distributed_statevector(int num_qubits, Transport* transport);  // |0...0⟩
+void free_distributed_statevector(DistributedStatevector* ds);
+
+// Runs the plan on the distributed state; collective. Steps on local qubits run on each
+// rank without communication, as do diagonal steps on global qubits and controlled steps
+// whose control is global (the rank either applies the target gate or skips it). Any
+// other step on a global qubit first swaps that qubit with a local one that is not needed
+// again for the longest time: one pairwise exchange of half of each rank's amplitudes.
+// The qubit stays remapped until a later step needs the swap, and the original order is
+// restored before returning.
+bool execute_plan_distributed(const CircuitPlan* plan, DistributedStatevector* ds, const double* params);
+
+// Norm of the whole state (as statevector_norm); collective, NAN if the transport failed
+double distributed_norm(const DistributedStatevector* ds);
+
+// Collective. Rank 0 receives the whole state in dst, which must have num_qubits qubits;
+// the other ranks pass NULL.
+bool gather_distributed_statevector(const DistributedStatevector* ds, Statevector* dst);
+
+#endif // DISTRIBUTED_STATEVECTOR_H
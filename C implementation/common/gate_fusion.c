@@ -0,0 +1,250 @@
+// gate_fusion.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "gate_fusion.h"
+
+typedef struct {
+    GateApplication op;
+    int num_gates;
+} MergedGate;
+
+static uint64_t gate_qubit_mask(const GateApplication* gate) {
+    uint64_t mask = (uint64_t)1 << gate->target;
+    if (gate->control != NO_CONTROL) mask |= (uint64_t)1 << gate->control;
+    return mask;
+}
+
+static QuantumGate identity_gate(void) {
+    QuantumGate I = {
+        .elements = {
+            {{1.0, 0.0}, {0.0, 0.0}},
+            {{0.0, 0.0}, {1.0, 0.0}}
+        }
+    };
+    return I;
+}
+
+// Stage 1: fold runs of single-qubit gates into one 2x2 gate per qubit
+static int merge_single_qubit_runs(const GateApplication* gates, int num_gates, int num_qubits,
+                                   MergedGate* merged) {
+    QuantumGate* pending = malloc((size_t)num_qubits * sizeof(QuantumGate));
+    int* pending_count = calloc((size_t)num_qubits, sizeof(int));
+    if (!pending || !pending_count) {
+        free(pending);
+        free(pending_count);
+        return -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < num_gates; i++) {
+        const GateApplication* gate = &gates[i];
+        if (gate->control == NO_CONTROL) {
+            int q = gate->target;
+            if (pending_count[q] == 0) pending[q] = identity_gate();
+            pending[q] = multiply_gates(gate->gate, pending[q]);
+            pending_count[q]++;
+            continue;
+        }
+
+        // A controlled gate ends the runs on both of its qubits
+        int qubits[2] = {gate->control, gate->target};
+        for (int j = 0; j < 2; j++) {
+            int q = qubits[j];
+            if (pending_count[q] > 0) {
+                merged[count].op = (GateApplication){pending[q], q, NO_CONTROL};
+                merged[count].num_gates = pending_count[q];
+                count++;
+                pending_count[q] = 0;
+            }
+        }
+        merged[count].op = *gate;
+        merged[count].num_gates = 1;
+        count++;
+    }
+    // Runs still open at the end commute with everything after their last gate
+    for (int q = 0; q < num_qubits; q++) {
+        if (pending_count[q] > 0) {
+            merged[count].op = (GateApplication){pending[q], q, NO_CONTROL};
+            merged[count].num_gates = pending_count[q];
+            count++;
+        }
+    }
+
+    free(pending);
+    free(pending_count);
+    return count;
+}
+
+// Left-multiplies the block matrix by a gate acting on local bits (target, control)
+static void multiply_into_block(Complex* matrix, int size, const QuantumGate* gate, int target, int control) {
+    int stride = 1 << target;
+    for (int c = 0; c < size; c++) {
+        for (int r = 0; r < size; r++) {
+            if (r & stride) continue;
+            if (control >= 0 && !(r & (1 << control))) continue;
+            Complex* a = &matrix[(size_t)r * size + c];
+            Complex* b = &matrix[(size_t)(r | stride) * size + c];
+            Complex m00 = gate->elements[0][0], m01 = gate->elements[0][1];
+            Complex m10 = gate->elements[1][0], m11 = gate->elements[1][1];
+            Complex x = *a, y = *b;
+            a->real = (m00.real * x.real - m00.imag * x.imag) + (m01.real * y.real - m01.imag * y.imag);
+            a->imag = (m00.real * x.imag + m00.imag * x.real) + (m01.real * y.imag + m01.imag * y.real);
+            b->real = (m10.real * x.real - m10.imag * x.imag) + (m11.real * y.real - m11.imag * y.imag);
+            b->imag = (m10.real * x.imag + m10.imag * x.real) + (m11.real * y.imag + m11.imag * y.real);
+        }
+    }
+}
+
+static int local_bit(const int* qubits, int k, int qubit) {
+    for (int b = 0; b < k; b++) {
+        if (qubits[b] == qubit) return b;
+    }
+    return -1;
+}
+
+// Stage 2: turn merged[first..last) into one block
+static bool build_block(const MergedGate* merged, int first, int last, uint64_t mask, FusedBlock* block) {
+    block->num_gates = 0;
+    block->num_qubits = 0;
+    for (int i = first; i < last; i++) block->num_gates += merged[i].num_gates;
+    block->matrix = NULL;
+
+    if (last - first == 1) {
+        const GateApplication* op = &merged[first].op;
+        block->kind = op->control == NO_CONTROL ? FUSED_SINGLE : FUSED_CONTROLLED;
+        block->gate = op->gate;
+        block->target = op->target;
+        block->control = op->control;
+        return true;
+    }
+
+    block->kind = FUSED_DENSE;
+    for (int q = 0; q < 64; q++) {
+        if (mask & ((uint64_t)1 << q)) block->qubits[block->num_qubits++] = q;
+    }
+    int size = 1 << block->num_qubits;
+    block->matrix = calloc((size_t)size * size, sizeof(Complex));
+    if (!block->matrix) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    for (int r = 0; r < size; r++) block->matrix[(size_t)r * size + r].real = 1.0;
+
+    for (int i = first; i < last; i++) {
+        const GateApplication* op = &merged[i].op;
+        int target = local_bit(block->qubits, block->num_qubits, op->target);
+        int control = op->control == NO_CONTROL ? -1 : local_bit(block->qubits, block->num_qubits, op->control);
+        multiply_into_block(block->matrix, size, &op->gate, target, control);
+    }
+    return true;
+}
+
+bool fuse_gates(const GateApplication* gates, int num_gates, int max_block_qubits, FusedCircuit* fused) {
+    if (!gates || !fused || num_gates < 0 || max_block_qubits < 1 || max_block_qubits > MAX_BLOCK_QUBITS) {
+        fprintf(stderr, "Error: Invalid parameters for gate fusion\n");
+        return false;
+    }
+    fused->blocks = NULL;
+    fused->num_blocks = 0;
+    fused->num_source_gates = num_gates;
+
+    int num_qubits = 0;
+    for (int i = 0; i < num_gates; i++) {
+        if (gates[i].target < 0 || gates[i].target >= 64 || gates[i].control == gates[i].target ||
+            (gates[i].control != NO_CONTROL && (gates[i].control < 0 || gates[i].control >= 64))) {
+            fprintf(stderr, "Error: Invalid qubit indices\n");
+            return false;
+        }
+        if (gates[i].target >= num_qubits) num_qubits = gates[i].target + 1;
+        if (gates[i].control >= num_qubits) num_qubits = gates[i].control + 1;
+    }
+
+    MergedGate* merged = malloc(((size_t)num_gates + 1) * sizeof(MergedGate));
+    fused->blocks = malloc(((size_t)num_gates + 1) * sizeof(FusedBlock));
+    if (!merged || !fused->blocks) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(merged);
+        free_fused_circuit(fused);
+        return false;
+    }
+    int num_merged = merge_single_qubit_runs(gates, num_gates, num_qubits, merged);
+    if (num_merged < 0) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(merged);
+        free_fused_circuit(fused);
+        return false;
+    }
+
+    // Greedily extend the current block while its qubits fit in max_block_qubits
+    int first = 0;
+    uint64_t mask = 0;
+    for (int i = 0; i <= num_merged; i++) {
+        uint64_t next = i < num_merged ? mask | gate_qubit_mask(&merged[i].op) : 0;
+        if (i < num_merged && __builtin_popcountll(next) <= max_block_qubits) {
+            mask = next;
+            continue;
+        }
+        if (i > first) {
+            if (!build_block(merged, first, i, mask, &fused->blocks[fused->num_blocks])) {
+                free(merged);
+                free_fused_circuit(fused);
+                return false;
+            }
+            fused->num_blocks++;
+        }
+        first = i;
+        mask = i < num_merged ? gate_qubit_mask(&merged[i].op) : 0;
+    }
+
+    free(merged);
+    return true;
+}
+
+void free_fused_circuit(FusedCircuit* fused) {
+    if (!fused) return;
+    for (int i = 0; i < fused->num_blocks; i++) {
+        free(fused->blocks[i].matrix);
+    }
+    free(fused->blocks);
+    fused->blocks = NULL;
+    fused->num_blocks = 0;
+}
+
+int fused_passes_saved(const FusedCircuit* fused) {
+    return fused->num_source_gates - fused->num_blocks;
+}
+
+bool apply_gate_application(Statevector* sv, const GateApplication* gate) {
+    if (!sv || gate->target < 0 || gate->target >= sv->num_qubits ||
+        (gate->control != NO_CONTROL && (gate->control < 0 || gate->control >= sv->num_qubits ||
+                                         gate->control == gate->target))) {
+        fprintf(stderr, "Error: Invalid qubit indices\n");
+        return false;
+    }
+    if (gate->control == NO_CONTROL) {
+        kernel_matrix_pairs(sv, &gate->gate, gate->target);
+    } else {
+        kernel_controlled_matrix_pairs(sv, &gate->gate, gate->control, gate->target);
+    }
+    return true;
+}
+
+bool apply_fused_circuit(Statevector* sv, const FusedCircuit* fused) {
+    for (int i = 0; i < fused->num_blocks; i++) {
+        const FusedBlock* block = &fused->blocks[i];
+        bool ok;
+        switch (block->kind) {
+            case FUSED_DENSE:
+                ok = kernel_dense_block(sv, block->matrix, block->qubits, block->num_qubits);
+                break;
+            default: {
+                GateApplication gate = {block->gate, block->target, block->control};
+                ok = apply_gate_application(sv, &gate);
+                break;
+            }
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
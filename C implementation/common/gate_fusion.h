@@ -0,0 +1,54 @@
+// gate_fusion.h
+#ifndef GATE_FUSION_H
+#define GATE_FUSION_H
+
+#include <stdbool.h>
+#include "statevector_core.h"
+#include "multi_qubit_kernels.h"
+
+#define NO_CONTROL -1
+
+// One gate of a circuit: a 2x2 gate on target, optionally controlled by control
+typedef struct {
+    QuantumGate gate;
+    int target;
+    int control;  // NO_CONTROL for an uncontrolled gate
+} GateApplication;
+
+typedef enum {
+    FUSED_SINGLE,      // 2x2 gate, applied with kernel_matrix_pairs
+    FUSED_CONTROLLED,  // controlled 2x2 gate, applied with kernel_controlled_matrix_pairs
+    FUSED_DENSE        // 2^k x 2^k block, applied with kernel_dense_block
+} FusedBlockKind;
+
+typedef struct {
+    FusedBlockKind kind;
+    QuantumGate gate;
+    int target;
+    int control;
+    int num_qubits;
+    int qubits[MAX_BLOCK_QUBITS];
+    Complex* matrix;
+    int num_gates;  // source gates folded into this block
+} FusedBlock;
+
+// Each block is one full pass over the statevector
+typedef struct {
+    FusedBlock* blocks;
+    int num_blocks;
+    int num_source_gates;
+} FusedCircuit;
+
+// Fusion runs in two stages:
+//  1. consecutive gates on the same qubit (with no multi-qubit gate on that qubit in
+//     between) are multiplied into a single 2x2 gate;
+//  2. consecutive gates whose qubits together span at most max_block_qubits qubits are
+//     multiplied into one dense block. max_block_qubits = 1 disables this stage.
+bool fuse_gates(const GateApplication* gates, int num_gates, int max_block_qubits, FusedCircuit* fused);
+void free_fused_circuit(FusedCircuit* fused);
+int fused_passes_saved(const FusedCircuit* fused);
+
+bool apply_gate_application(Statevector* sv, const GateApplication* gate);
+bool apply_fused_circuit(Statevector* sv, const FusedCircuit* fused);
+
+#endif // GATE_FUSION_H
@@ -0,0 +1,195 @@
+// gradient.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gradient.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+
+// Shift of the parameter-shift rule for gates exp(-iθG/2) with G² = I
+#define SHIFT_ANGLE 1.57079632679489661923
+
+// Generator overlaps
+
+// Im⟨a|G|b⟩ for G = X, Y or Z on target, summed over the pairs (i0, i1 = i0 | 1 << target).
+// With cross(u, v) = Im(conj(u) v) and dot(u, v) = Re(conj(u) v) a pair contributes
+// X: cross(a0, b1) + cross(a1, b0)
+// Y: dot(a1, b0) - dot(a0, b1)
+// Z: cross(a0, b0) - cross(a1, b1)
+typedef struct {
+    const Statevector* a;
+    const Statevector* b;
+    GateOp generator;
+    int target;
+    size_t num_pairs;
+    size_t slice_pairs;
+    double* partials;
+} OverlapJob;
+
+static void overlap_slice_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const OverlapJob* job = context;
+    const double *ar = job->a->real, *ai = job->a->imag, *br = job->b->real, *bi = job->b->imag;
+    size_t low_mask = ((size_t)1 << job->target) - 1;
+    size_t stride = (size_t)1 << job->target;
+
+    for (size_t s = begin; s < end; s++) {
+        size_t first = s * job->slice_pairs;
+        size_t last = first + job->slice_pairs < job->num_pairs ? first + job->slice_pairs : job->num_pairs;
+        double sum = 0.0;
+        for (size_t g = first; g < last; g++) {
+            size_t i0 = ((g & ~low_mask) << 1) | (g & low_mask);
+            size_t i1 = i0 | stride;
+            switch (job->generator) {
+                case OP_RX:
+                    sum += ar[i0] * bi[i1] - ai[i0] * br[i1] + ar[i1] * bi[i0] - ai[i1] * br[i0];
+                    break;
+                case OP_RY:
+                    sum += ar[i1] * br[i0] + ai[i1] * bi[i0] - ar[i0] * br[i1] - ai[i0] * bi[i1];
+                    break;
+                default:
+                    sum += ar[i0] * bi[i0] - ai[i0] * br[i0] - ar[i1] * bi[i1] + ai[i1] * br[i1];
+                    break;
+            }
+        }
+        job->partials[s] = sum;
+    }
+}
+
+// Im⟨a|G|b⟩ for the generator G of the rotation op on target
+static double generator_overlap(const Statevector* a, const Statevector* b, GateOp rotation, int target) {
+    INSTRUMENT_BEGIN(span);
+    double partials[GRADIENT_MAX_SLICES];
+    OverlapJob job = {a, b, rotation, target, a->dimension / 2, 0, partials};
+    // The slice count depends on the state size only
+    size_t num_slices = (job.num_pairs + PARALLEL_MIN_ITEMS - 1) / PARALLEL_MIN_ITEMS;
+    if (num_slices > GRADIENT_MAX_SLICES) num_slices = GRADIENT_MAX_SLICES;
+    job.slice_pairs = (job.num_pairs + num_slices - 1) / num_slices;
+    num_slices = (job.num_pairs + job.slice_pairs - 1) / job.slice_pairs;
+    parallel_for_items(num_slices, overlap_slice_task, &job);
+
+    double sum = 0.0;
+    for (size_t s = 0; s < num_slices; s++) sum += partials[s];
+    INSTRUMENT_END(span, "kernel", "generator_overlap", target, -1, job.num_pairs, 2 * a->dimension * BYTES_PER_AMPLITUDE);
+    return sum;
+}
+
+// Adjoint differentiation
+
+static bool valid_gradient_inputs(const Circuit* circuit, const double* params, const Observable* observable) {
+    if (!circuit || !observable || observable->num_qubits > circuit->num_qubits ||
+        (circuit->num_params > 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for gradient computation\n");
+        return false;
+    }
+    return true;
+}
+
+// Runs the circuit from |0⟩ on sv
+static bool run_circuit(const Circuit* circuit, const double* params, Statevector* sv) {
+    CircuitPlan plan;
+    if (!compile_circuit(circuit, 0, &plan)) return false;
+    bool ok = initialize_statevector(sv) && execute_plan(&plan, sv, params);
+    free_circuit_plan(&plan);
+    return ok;
+}
+
+bool adjoint_gradient(const Circuit* circuit, const double* params, const Observable* observable,
+                      double* expectation, double* gradient) {
+    if (!valid_gradient_inputs(circuit, params, observable)) return false;
+    if (circuit->num_params > 0 && !gradient) {
+        fprintf(stderr, "Error: Missing gradient output\n");
+        return false;
+    }
+    Statevector* psi = create_statevector(circuit->num_qubits);
+    Statevector* lambda = create_statevector(circuit->num_qubits);
+    if (!psi || !lambda) {
+        free_statevector(psi);
+        free_statevector(lambda);
+        return false;
+    }
+    for (int k = 0; k < circuit->num_params; k++) gradient[k] = 0.0;
+
+    bool ok = run_circuit(circuit, params, psi) && apply_observable(observable, psi, lambda);
+    if (ok && expectation) {
+        double sum = 0.0;
+        for (size_t i = 0; i < psi->dimension; i++) sum += psi->real[i] * lambda->real[i] + psi->imag[i] * lambda->imag[i];
+        *expectation = sum;
+    }
+
+    // Nothing before the first parametric op changes a derivative, so the sweep stops there
+    int first_parametric = circuit->num_ops;
+    for (int o = 0; o < circuit->num_ops; o++) {
+        if (circuit->ops[o].param_index >= 0) {
+            first_parametric = o;
+            break;
+        }
+    }
+    for (int o = circuit->num_ops - 1; ok && o >= first_parametric; o--) {
+        const CircuitOp* op = &circuit->ops[o];
+        if (op->param_index >= 0) {
+            gradient[op->param_index] += generator_overlap(lambda, psi, op->op, op->target);
+        }
+        if (o > first_parametric) {
+            ok = apply_circuit_op_inverse(psi, op, params) && apply_circuit_op_inverse(lambda, op, params);
+        }
+    }
+
+    free_statevector(psi);
+    free_statevector(lambda);
+    return ok;
+}
+
+// Parameter shift
+
+bool parameter_shift_derivative(const Circuit* circuit, const double* params, const Observable* observable,
+                                int param_index, double* derivative) {
+    if (!valid_gradient_inputs(circuit, params, observable)) return false;
+    if (!derivative || param_index < 0 || param_index >= circuit->num_params) {
+        fprintf(stderr, "Error: Invalid parameter index for parameter shift\n");
+        return false;
+    }
+    // A copy of the circuit in which the shifted op gets a fixed angle
+    Circuit shifted = *circuit;
+    shifted.ops = malloc((size_t)circuit->num_ops * sizeof(CircuitOp) + 1);
+    Statevector* sv = create_statevector(circuit->num_qubits);
+    if (!shifted.ops || !sv) {
+        if (!shifted.ops) fprintf(stderr, "Error: Memory allocation failed\n");
+        free(shifted.ops);
+        free_statevector(sv);
+        return false;
+    }
+    memcpy(shifted.ops, circuit->ops, (size_t)circuit->num_ops * sizeof(CircuitOp));
+
+    bool ok = true;
+    double sum = 0.0;
+    for (int o = 0; ok && o < circuit->num_ops; o++) {
+        if (circuit->ops[o].param_index != param_index) continue;
+        double expectations[2];
+        for (int s = 0; ok && s < 2; s++) {
+            shifted.ops[o].param_index = -1;
+            shifted.ops[o].angle = params[param_index] + (s == 0 ? SHIFT_ANGLE : -SHIFT_ANGLE);
+            ok = run_circuit(&shifted, params, sv) && expectation_value(sv, observable, &expectations[s]);
+        }
+        shifted.ops[o] = circuit->ops[o];
+        if (ok) sum += (expectations[0] - expectations[1]) / 2.0;
+    }
+    if (ok) *derivative = sum;
+
+    free(shifted.ops);
+    free_statevector(sv);
+    return ok;
+}
+
+bool parameter_shift_gradient(const Circuit* circuit, const double* params, const Observable* observable,
+                              double* gradient) {
+    if (!valid_gradient_inputs(circuit, params, observable)) return false;
+    if (circuit->num_params > 0 && !gradient) {
+        fprintf(stderr, "Error: Missing gradient output\n");
+        return false;
+    }
+    for (int k = 0; k < circuit->num_params; k++) {
+        if (!parameter_shift_derivative(circuit, params, observable, k, &gradient[k])) return false;
+    }
+    return true;
+}
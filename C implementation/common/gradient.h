@@ -0,0 +1,34 @@
+// gradient.h
+#ifndef GRADIENT_H
+#define GRADIENT_H
+
+#include <stdbool.h>
+#include "circuit.h"
+#include "observable.h"
+
+// Partial sums of the generator overlaps are kept for at most this many slices of the
+// state and added in slice order, so gradients do not depend on the thread count
+#define GRADIENT_MAX_SLICES 64
+
+// E(θ) = ⟨0|U(θ)† H U(θ)|0⟩ and all of dE/dθ by adjoint differentiation. The circuit runs
+// forwards once, then backwards once on two states: ψ, the output state undone gate by
+// gate, and λ = H ψ undone the same way. At a parametric rotation exp(-iθG/2) the
+// derivative is Im⟨λ|G|ψ⟩, read from both states without changing them, so the whole
+// gradient costs about three runs of the circuit and two statevectors whatever the number
+// of parameters. gradient holds circuit->num_params values; a parameter used by several
+// ops gets the sum of their contributions. expectation may be NULL.
+bool adjoint_gradient(const Circuit* circuit, const double* params, const Observable* observable,
+                      double* expectation, double* gradient);
+
+// dE/dθ_k by the parameter-shift rule: every op that uses parameter k is run once with
+// its angle shifted by +π/2 and once by -π/2, and half the difference of the two
+// expectations is added. Costs two runs of the circuit per use of the parameter but needs
+// a single statevector; used to check adjoint_gradient().
+bool parameter_shift_derivative(const Circuit* circuit, const double* params, const Observable* observable,
+                                int param_index, double* derivative);
+
+// parameter_shift_derivative() for every parameter
+bool parameter_shift_gradient(const Circuit* circuit, const double* params, const Observable* observable,
+                              double* gradient);
+
+#endif // GRADIENT_H
@@ -0,0 +1,214 @@
+// instrumentation.c
+#include "instrumentation.h"
+
+#ifdef QSIM_INSTRUMENT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "thread_pool.h"
+
+// Slots of the totals table; comfortably more than categories x names x 64 targets
+#define TOTALS_SLOTS 8192
+
+typedef struct {
+    const char* category;
+    const char* name;
+    int target;
+    int control;
+    int thread;
+    double start;
+    double duration;
+    uint64_t pairs;
+    uint64_t bytes;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+} TraceEvent;
+
+typedef struct {
+    const char* category;  // NULL for an empty slot
+    const char* name;
+    int target;
+    uint64_t calls;
+    double seconds;
+    uint64_t pairs;
+    uint64_t bytes;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+} TotalsEntry;
+
+static struct {
+    pthread_mutex_t lock;
+    bool initialized;
+    double origin;
+    int next_thread;
+    TraceEvent* events;
+    size_t num_events;
+    size_t capacity;
+    size_t dropped;
+    TotalsEntry totals[TOTALS_SLOTS];
+} trace = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// Work counted on this thread so far; spans take the difference over their lifetime
+static __thread uint64_t thread_pairs, thread_bytes, thread_allocs, thread_alloc_bytes;
+static __thread int thread_id = -1;
+
+static void write_trace_at_exit(void);
+
+InstrumentSpan instrument_begin(void) {
+    if (!trace.initialized) {
+        pthread_mutex_lock(&trace.lock);
+        if (!trace.initialized) {
+            trace.origin = wall_clock_seconds();
+            atexit(write_trace_at_exit);
+            trace.initialized = true;
+        }
+        pthread_mutex_unlock(&trace.lock);
+    }
+    InstrumentSpan span = {wall_clock_seconds(), thread_pairs, thread_bytes, thread_allocs, thread_alloc_bytes};
+    return span;
+}
+
+void instrument_alloc(size_t bytes) {
+    thread_allocs++;
+    thread_alloc_bytes += bytes;
+}
+
+static TotalsEntry* find_totals(const char* category, const char* name, int target) {
+    size_t h = (size_t)target * 31;
+    for (const char* p = name; *p; p++) h = h * 131 + (unsigned char)*p;
+    for (const char* p = category; *p; p++) h = h * 131 + (unsigned char)*p;
+    for (size_t probe = 0; probe < TOTALS_SLOTS; probe++) {
+        TotalsEntry* entry = &trace.totals[(h + probe) % TOTALS_SLOTS];
+        if (!entry->category) {
+            entry->category = category;
+            entry->name = name;
+            entry->target = target;
+            return entry;
+        }
+        if (entry->target == target && strcmp(entry->name, name) == 0 && strcmp(entry->category, category) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void instrument_end(const InstrumentSpan* span, const char* category, const char* name, int target, int control,
+                    uint64_t pairs, uint64_t bytes) {
+    double end = wall_clock_seconds();
+    thread_pairs += pairs;
+    thread_bytes += bytes;
+
+    TraceEvent event = {
+        .category = category,
+        .name = name,
+        .target = target,
+        .control = control,
+        .start = span->start,
+        .duration = end - span->start,
+        .pairs = thread_pairs - span->pairs,
+        .bytes = thread_bytes - span->bytes,
+        .allocs = thread_allocs - span->allocs,
+        .alloc_bytes = thread_alloc_bytes - span->alloc_bytes,
+    };
+
+    pthread_mutex_lock(&trace.lock);
+    if (thread_id < 0) thread_id = trace.next_thread++;
+    event.thread = thread_id;
+
+    TotalsEntry* entry = find_totals(category, name, target);
+    if (entry) {
+        entry->calls++;
+        entry->seconds += event.duration;
+        entry->pairs += event.pairs;
+        entry->bytes += event.bytes;
+        entry->allocs += event.allocs;
+        entry->alloc_bytes += event.alloc_bytes;
+    }
+
+    if (trace.num_events == trace.capacity && trace.capacity < INSTRUMENT_MAX_EVENTS) {
+        size_t capacity = trace.capacity ? trace.capacity * 2 : 4096;
+        TraceEvent* events = realloc(trace.events, capacity * sizeof(TraceEvent));
+        if (events) {
+            trace.events = events;
+            trace.capacity = capacity;
+        }
+    }
+    if (trace.num_events < trace.capacity) {
+        trace.events[trace.num_events++] = event;
+    } else {
+        trace.dropped++;
+    }
+    pthread_mutex_unlock(&trace.lock);
+}
+
+static int compare_totals(const void* a, const void* b) {
+    const TotalsEntry* x = a;
+    const TotalsEntry* y = b;
+    int c = strcmp(x->category, y->category);
+    if (c == 0) c = strcmp(x->name, y->name);
+    if (c == 0) c = (x->target > y->target) - (x->target < y->target);
+    return c;
+}
+
+static void write_trace_at_exit(void) {
+    pthread_mutex_lock(&trace.lock);
+    const char* path = getenv("QSIM_TRACE_FILE");
+    if (!path) path = INSTRUMENT_TRACE_FILE;
+
+    // Compact the totals so they can be sorted for the report
+    size_t num_totals = 0;
+    for (size_t i = 0; i < TOTALS_SLOTS; i++) {
+        if (trace.totals[i].category) trace.totals[num_totals++] = trace.totals[i];
+    }
+    qsort(trace.totals, num_totals, sizeof(TotalsEntry), compare_totals);
+
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open trace file %s\n", path);
+    } else {
+        fprintf(file, "{\"traceEvents\": [\n");
+        for (size_t i = 0; i < trace.num_events; i++) {
+            const TraceEvent* e = &trace.events[i];
+            fprintf(file,
+                    "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, "
+                    "\"dur\": %.3f, \"args\": {\"target\": %d, \"control\": %d, \"pairs\": %llu, \"bytes\": %llu, "
+                    "\"allocs\": %llu, \"alloc_bytes\": %llu}},\n",
+                    e->name, e->category, e->thread, (e->start - trace.origin) * 1e6, e->duration * 1e6, e->target,
+                    e->control, (unsigned long long)e->pairs, (unsigned long long)e->bytes,
+                    (unsigned long long)e->allocs, (unsigned long long)e->alloc_bytes);
+        }
+        // Totals go in as one metadata event so the file stays a valid trace
+        fprintf(file, "{\"name\": \"totals\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"dropped_events\": %zu, "
+                      "\"totals\": [\n", trace.dropped);
+        for (size_t i = 0; i < num_totals; i++) {
+            const TotalsEntry* t = &trace.totals[i];
+            fprintf(file,
+                    "  {\"category\": \"%s\", \"name\": \"%s\", \"target\": %d, \"calls\": %llu, \"seconds\": %.9f, "
+                    "\"pairs\": %llu, \"bytes\": %llu, \"gbs\": %.3f, \"allocs\": %llu, \"alloc_bytes\": %llu}%s\n",
+                    t->category, t->name, t->target, (unsigned long long)t->calls, t->seconds,
+                    (unsigned long long)t->pairs, (unsigned long long)t->bytes,
+                    t->seconds > 0 ? (double)t->bytes / t->seconds * 1e-9 : 0.0, (unsigned long long)t->allocs,
+                    (unsigned long long)t->alloc_bytes, i + 1 < num_totals ? "," : "");
+        }
+        fprintf(file, "]}}\n]}\n");
+        fclose(file);
+    }
+
+    printf("\nInstrumentation totals (trace in %s%s):\n", path, trace.dropped ? ", truncated" : "");
+    printf("%-8s %-14s %6s %10s %12s %14s %8s %8s\n", "category", "name", "target", "calls", "seconds", "pairs",
+           "GB/s", "allocs");
+    for (size_t i = 0; i < num_totals; i++) {
+        const TotalsEntry* t = &trace.totals[i];
+        printf("%-8s %-14s %6d %10llu %12.6f %14llu %8.2f %8llu\n", t->category, t->name, t->target,
+               (unsigned long long)t->calls, t->seconds, (unsigned long long)t->pairs,
+               t->seconds > 0 ? (double)t->bytes / t->seconds * 1e-9 : 0.0, (unsigned long long)t->allocs);
+    }
+    free(trace.events);
+    trace.events = NULL;
+    trace.num_events = trace.capacity = 0;
+    pthread_mutex_unlock(&trace.lock);
+}
+
+#endif // QSIM_INSTRUMENT
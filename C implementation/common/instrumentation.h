@@ -0,0 +1,52 @@
+// instrumentation.h
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+// Opt-in hot-path instrumentation. Compile with -DQSIM_INSTRUMENT to record every gate
+// and kernel call: wall time, amplitude pairs processed, bytes of amplitudes read and
+// written, and allocations made while it ran. Without the flag every macro below expands
+// to nothing and its arguments are never evaluated.
+//
+// Spans nest: a gate span includes the pairs, bytes and allocations of the kernel spans
+// run inside it on the same thread. At exit the spans are written as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev) to QSIM_TRACE_FILE (default INSTRUMENT_TRACE_FILE),
+// and totals per category, name and target qubit are printed.
+
+#define INSTRUMENT_TRACE_FILE "qsim_trace.json"
+
+// Spans beyond this many are left out of the trace but still counted in the totals
+#define INSTRUMENT_MAX_EVENTS (1 << 20)
+
+#ifdef QSIM_INSTRUMENT
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    double start;
+    uint64_t pairs;
+    uint64_t bytes;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+} InstrumentSpan;
+
+InstrumentSpan instrument_begin(void);
+// name must be a string literal or otherwise outlive the program
+void instrument_end(const InstrumentSpan* span, const char* category, const char* name, int target, int control,
+                    uint64_t pairs, uint64_t bytes);
+void instrument_alloc(size_t bytes);
+
+#define INSTRUMENT_BEGIN(span) InstrumentSpan span = instrument_begin()
+#define INSTRUMENT_END(span, category, name, target, control, pairs, bytes) \
+    instrument_end(&(span), category, name, target, control, pairs, bytes)
+#define INSTRUMENT_ALLOC(bytes) instrument_alloc(bytes)
+
+#else
+
+#define INSTRUMENT_BEGIN(span) ((void)0)
+#define INSTRUMENT_END(span, category, name, target, control, pairs, bytes) ((void)0)
+#define INSTRUMENT_ALLOC(bytes) ((void)0)
+
+#endif // QSIM_INSTRUMENT
+
+#endif // INSTRUMENTATION_H
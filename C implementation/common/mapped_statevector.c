@@ -0,0 +1,339 @@
+// mapped_statevector.c
+#define _GNU_SOURCE  // sync_file_range
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "mapped_statevector.h"
+#include "thread_pool.h"
+
+#define MAX_CHUNK_QUBITS 30
+
+static int chunk_qubits;
+static bool chunk_qubits_initialized = false;
+
+static void initialize_chunk_qubits(void) {
+    size_t memory = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE);
+    chunk_qubits = max_qubits_for_memory(memory / 8);
+    if (chunk_qubits < MIN_CHUNK_QUBITS) chunk_qubits = MIN_CHUNK_QUBITS;
+    if (chunk_qubits > MAX_CHUNK_QUBITS) chunk_qubits = MAX_CHUNK_QUBITS;
+
+    const char* requested = getenv("QSIM_CHUNK_QUBITS");
+    if (requested) {
+        int value = atoi(requested);
+        if (value >= MIN_CHUNK_QUBITS && value <= MAX_CHUNK_QUBITS) {
+            chunk_qubits = value;
+        } else {
+            fprintf(stderr, "Error: Invalid QSIM_CHUNK_QUBITS value '%s'\n", requested);
+        }
+    }
+    chunk_qubits_initialized = true;
+}
+
+int get_chunk_qubits(void) {
+    if (!chunk_qubits_initialized) initialize_chunk_qubits();
+    return chunk_qubits;
+}
+
+bool set_chunk_qubits(int value) {
+    if (value < MIN_CHUNK_QUBITS || value > MAX_CHUNK_QUBITS) {
+        fprintf(stderr, "Error: Chunk qubit count must be between %d and %d\n", MIN_CHUNK_QUBITS, MAX_CHUNK_QUBITS);
+        return false;
+    }
+    chunk_qubits = value;
+    chunk_qubits_initialized = true;
+    return true;
+}
+
+// State management
+
+MappedStatevector* create_mapped_statevector(int num_qubits, const char* path) {
+    if (num_qubits < 1 || num_qubits > 62 || !path) {
+        fprintf(stderr, "Error: Invalid parameters for mapped statevector\n");
+        return NULL;
+    }
+    MappedStatevector* ms = malloc(sizeof(MappedStatevector));
+    if (!ms) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    ms->mapped_bytes = statevector_bytes(num_qubits);
+
+    ms->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (ms->fd < 0) {
+        fprintf(stderr, "Error: Could not open %s: %s\n", path, strerror(errno));
+        free(ms);
+        return NULL;
+    }
+    // Reserve the blocks up front so running out of disk fails here, not with SIGBUS
+    // halfway through a gate. Filesystems without fallocate get a sparse file.
+    int err = posix_fallocate(ms->fd, 0, (off_t)ms->mapped_bytes);
+    if (err == ENOSPC || (err != 0 && ftruncate(ms->fd, (off_t)ms->mapped_bytes) != 0)) {
+        fprintf(stderr, "Error: Could not size %s to %zu bytes: %s\n", path, ms->mapped_bytes,
+                strerror(err ? err : errno));
+        close(ms->fd);
+        free(ms);
+        return NULL;
+    }
+
+    ms->mapping = mmap(NULL, ms->mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, ms->fd, 0);
+    if (ms->mapping == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map %s: %s\n", path, strerror(errno));
+        close(ms->fd);
+        free(ms);
+        return NULL;
+    }
+    ms->sv.num_qubits = num_qubits;
+    ms->sv.dimension = (size_t)1 << num_qubits;
+    ms->sv.real = ms->mapping;
+    ms->sv.imag = ms->sv.real + ms->sv.dimension;
+
+    // The new file reads as zeros
+    ms->sv.real[0] = 1.0;
+    return ms;
+}
+
+void free_mapped_statevector(MappedStatevector* ms) {
+    if (ms) {
+        munmap(ms->mapping, ms->mapped_bytes);
+        close(ms->fd);
+        free(ms);
+    }
+}
+
+bool sync_mapped_statevector(MappedStatevector* ms) {
+    if (msync(ms->mapping, ms->mapped_bytes, MS_SYNC) != 0) {
+        fprintf(stderr, "Error: Could not write back the mapped statevector: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Paging hints. Both are advisory, so failures (e.g. a range that is not page aligned
+// in a tiny state) are ignored.
+
+static void prefetch_range(const double* start, size_t count) {
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGE_SIZE);
+    uintptr_t begin = (uintptr_t)start & ~(page - 1);
+    madvise((void*)begin, (uintptr_t)(start + count) - begin, MADV_WILLNEED);
+}
+
+// Starts writing the range back so that dirty pages do not pile up beyond RAM
+static void writeback_range(const MappedStatevector* ms, const double* start, size_t count) {
+#ifdef SYNC_FILE_RANGE_WRITE
+    off_t offset = (off_t)((const char*)start - (const char*)ms->mapping);
+    sync_file_range(ms->fd, offset, (off_t)(count * sizeof(double)), SYNC_FILE_RANGE_WRITE);
+#else
+    (void)ms;
+    (void)start;
+    (void)count;
+#endif
+}
+
+// Execution
+
+// Qubits of mask that cannot stay inside a segment. A window with h such qubits is run
+// on segments of 2^(chunk - h) amplitudes, so that 2^h segments fill one chunk buffer.
+// A segment below MIN_SEGMENT_QUBITS means the mask does not fit.
+static uint64_t window_high_qubits(uint64_t mask, int chunk, int* segment_qubits) {
+    int segment = chunk;
+    for (;;) {
+        uint64_t high = mask & ~(((uint64_t)1 << segment) - 1);
+        int next = chunk - __builtin_popcountll(high);
+        if (next == segment || next < MIN_SEGMENT_QUBITS) {
+            *segment_qubits = next;
+            return high;
+        }
+        segment = next;
+    }
+}
+
+// Chunk by chunk, in place in the mapping
+static void run_local_window(MappedStatevector* ms, const PlanStep* steps, int num_steps, const double* params,
+                             int chunk) {
+    size_t chunk_size = (size_t)1 << chunk;
+    size_t num_chunks = ms->sv.dimension >> chunk;
+    for (size_t c = 0; c < num_chunks; c++) {
+        double* real = ms->sv.real + c * chunk_size;
+        double* imag = ms->sv.imag + c * chunk_size;
+        if (c + 1 < num_chunks) {
+            prefetch_range(real + chunk_size, chunk_size);
+            prefetch_range(imag + chunk_size, chunk_size);
+        }
+        Statevector view = {real, imag, chunk, chunk_size};
+        for (int i = 0; i < num_steps; i++) {
+            run_plan_step_at(&view, &steps[i], params, c * chunk_size);
+        }
+        writeback_range(ms, real, chunk_size);
+        writeback_range(ms, imag, chunk_size);
+    }
+}
+
+typedef struct {
+    MappedStatevector* ms;
+    Statevector* buffer;
+    const size_t* offsets;  // file index of every segment of the current group
+    int segment;
+    bool gather;
+} SegmentCopyJob;
+
+static void segment_copy_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const SegmentCopyJob* job = context;
+    size_t length = (size_t)1 << job->segment;
+    for (size_t k = begin; k < end; k++) {
+        double* file_re = job->ms->sv.real + job->offsets[k];
+        double* file_im = job->ms->sv.imag + job->offsets[k];
+        double* buf_re = job->buffer->real + (k << job->segment);
+        double* buf_im = job->buffer->imag + (k << job->segment);
+        if (job->gather) {
+            memcpy(buf_re, file_re, length * sizeof(double));
+            memcpy(buf_im, file_im, length * sizeof(double));
+        } else {
+            memcpy(file_re, buf_re, length * sizeof(double));
+            memcpy(file_im, buf_im, length * sizeof(double));
+            writeback_range(job->ms, file_re, length);
+            writeback_range(job->ms, file_im, length);
+        }
+    }
+}
+
+// File index of segment k of group g: g fills the bits above the segment that are not
+// high qubits, and the bits of k fill the high qubits
+static void group_offsets(size_t g, int segment, const int* high, int num_high, size_t* offsets) {
+    size_t base = g << segment;
+    for (int b = 0; b < num_high; b++) {
+        size_t low = base & (((size_t)1 << high[b]) - 1);
+        base = ((base - low) << 1) | low;
+    }
+    for (size_t k = 0; k < ((size_t)1 << num_high); k++) {
+        size_t offset = base;
+        for (int b = 0; b < num_high; b++) {
+            if (k & ((size_t)1 << b)) offset |= (size_t)1 << high[b];
+        }
+        offsets[k] = offset;
+    }
+}
+
+// Group by group: the 2^num_high segments that the window mixes are gathered into buffer,
+// where the high qubits become qubits segment..chunk-1, and written back afterwards
+static bool run_segment_window(MappedStatevector* ms, Statevector* buffer, const PlanStep* steps, int num_steps,
+                               const double* params, int segment, const int* high, int num_high) {
+    size_t num_segments = (size_t)1 << num_high;
+    size_t* storage = malloc(2 * num_segments * sizeof(size_t));
+    if (!storage) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    size_t* offsets = storage;
+    size_t* next_offsets = storage + num_segments;
+    size_t num_groups = ms->sv.dimension >> (segment + num_high);
+    size_t length = (size_t)1 << segment;
+
+    group_offsets(0, segment, high, num_high, offsets);
+    for (size_t g = 0; g < num_groups; g++) {
+        if (g + 1 < num_groups) {
+            group_offsets(g + 1, segment, high, num_high, next_offsets);
+            for (size_t k = 0; k < num_segments; k++) {
+                prefetch_range(ms->sv.real + next_offsets[k], length);
+                prefetch_range(ms->sv.imag + next_offsets[k], length);
+            }
+        }
+        SegmentCopyJob job = {ms, buffer, offsets, segment, true};
+        parallel_for_items(num_segments, segment_copy_task, &job);
+        for (int i = 0; i < num_steps; i++) {
+            run_plan_step(buffer, &steps[i], params);
+        }
+        job.gather = false;
+        parallel_for_items(num_segments, segment_copy_task, &job);
+
+        size_t* swap = offsets;
+        offsets = next_offsets;
+        next_offsets = swap;
+    }
+    free(storage);
+    return true;
+}
+
+bool execute_plan_mapped(const CircuitPlan* plan, MappedStatevector* ms, const double* params, MappedStats* stats) {
+    MappedStats local_stats;
+    if (!stats) stats = &local_stats;
+    stats->num_passes = 0;
+    stats->bytes_moved = 0;
+
+    if (!plan || !ms || ms->sv.num_qubits < plan->num_qubits || (plan->num_params > 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for mapped execution\n");
+        return false;
+    }
+    int chunk = get_chunk_qubits();
+    if (chunk > ms->sv.num_qubits) chunk = ms->sv.num_qubits;
+
+    PlanStep* window = malloc(((size_t)plan->num_steps + 1) * sizeof(PlanStep));
+    if (!window) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    Statevector* buffer = NULL;
+
+    int first = 0;
+    while (first < plan->num_steps) {
+        uint64_t mask = 0, high = 0;
+        int segment = chunk;
+        int end = first;
+        bool has_sweep = false;
+        while (end < plan->num_steps) {
+            const PlanStep* step = &plan->steps[end];
+            uint64_t next = mask | plan_step_local_mask(step);
+            int next_segment;
+            uint64_t next_high = window_high_qubits(next, chunk, &next_segment);
+            // A single step always fits: it has at most MAX_BLOCK_QUBITS qubits
+            if (next_high && next_segment < MIN_SEGMENT_QUBITS && end > first) break;
+            // A diagonal sweep reads its high qubits from the chunk index, so it only runs in
+            // windows that keep the file order
+            bool sweep = step->kind == STEP_DIAGONAL_SWEEP;
+            if (next_high && (has_sweep || sweep) && end > first) break;
+            has_sweep = has_sweep || sweep;
+            mask = next;
+            high = next_high;
+            segment = next_segment;
+            end++;
+        }
+
+        if (!high) {
+            run_local_window(ms, &plan->steps[first], end - first, params, chunk);
+        } else {
+            if (!buffer && !(buffer = create_statevector(chunk))) {
+                free(window);
+                return false;
+            }
+            int position[64], high_qubits[64], num_high = 0;
+            for (int q = 0; q < ms->sv.num_qubits; q++) {
+                position[q] = q;
+                if (high & ((uint64_t)1 << q)) {
+                    position[q] = segment + num_high;
+                    high_qubits[num_high++] = q;
+                }
+            }
+            for (int i = first; i < end; i++) {
+                window[i - first] = plan->steps[i];
+                remap_plan_step(&window[i - first], position);
+            }
+            if (!run_segment_window(ms, buffer, window, end - first, params, segment, high_qubits, num_high)) {
+                free_statevector(buffer);
+                free(window);
+                return false;
+            }
+        }
+        stats->num_passes++;
+        stats->bytes_moved += 2 * ms->mapped_bytes;
+        first = end;
+    }
+
+    free_statevector(buffer);
+    free(window);
+    return true;
+}
@@ -0,0 +1,52 @@
+// mapped_statevector.h
+#ifndef MAPPED_STATEVECTOR_H
+#define MAPPED_STATEVECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "statevector_core.h"
+#include "circuit.h"
+
+// Segments copied for steps on high qubits are at least this many amplitudes (32 KiB of
+// each array), so every read and write of the backing file stays sequential
+#define MIN_SEGMENT_QUBITS 12
+
+// A chunk must hold a segment for every qubit of the widest plan step
+#define MIN_CHUNK_QUBITS (MIN_SEGMENT_QUBITS + MAX_BLOCK_QUBITS)
+
+// Statevector whose amplitudes live in a file mapped with mmap: all real parts, then all
+// imaginary parts. The page cache holds whatever fits in RAM, so the qubit count is
+// limited by disk space rather than by one malloc.
+typedef struct {
+    Statevector sv;  // real and imag point into the mapping
+    int fd;
+    void* mapping;
+    size_t mapped_bytes;
+} MappedStatevector;
+
+// Passes over the backing file made by execute_plan_mapped
+typedef struct {
+    int num_passes;
+    size_t bytes_moved;  // bytes read plus bytes written
+} MappedStats;
+
+// Creates (or truncates) path and initializes it to |0...0⟩
+MappedStatevector* create_mapped_statevector(int num_qubits, const char* path);
+// Unmaps and closes the state; the file itself is left in place
+void free_mapped_statevector(MappedStatevector* ms);
+// Writes every dirty page back to the file
+bool sync_mapped_statevector(MappedStatevector* ms);
+
+// Chunk size in qubits: one chunk of 2^chunk_qubits amplitudes is in flight at a time.
+// The default is an eighth of physical memory; override with QSIM_CHUNK_QUBITS=<n>.
+int get_chunk_qubits(void);
+bool set_chunk_qubits(int chunk_qubits);
+
+// Runs the plan chunk by chunk over the file. Consecutive steps on qubits below the chunk
+// size are applied to each chunk in place before moving on to the next one. Steps on
+// higher qubits stream groups of segments (a chunk pair for one high qubit) through a
+// chunk-sized buffer. Every window is one sequential pass, with readahead requested for
+// the next chunk and writeback started for the finished one. stats may be NULL.
+bool execute_plan_mapped(const CircuitPlan* plan, MappedStatevector* ms, const double* params, MappedStats* stats);
+
+#endif // MAPPED_STATEVECTOR_H
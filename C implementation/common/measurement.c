@@ -0,0 +1,451 @@
+// measurement.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "measurement.h"
+#include "thread_pool.h"
+
+// Random numbers
+
+static uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) rng->s[i] = splitmix64(&seed);
+}
+
+uint64_t rng_next(Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+double rng_uniform(Rng* rng) {
+    return (double)(rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+// Block sums
+
+typedef struct {
+    const double* real;
+    const double* imag;
+    size_t block_size;
+    double* block_sums;
+    // Sampling only
+    const double* targets;        // ascending points in [0, total)
+    const double* block_prefix;   // probability before each block
+    const size_t* first_target;   // targets of block b are [first_target[b], first_target[b + 1])
+    uint64_t* outcomes;           // block b writes its entries from first_target[b] on
+    uint64_t* counts;
+    size_t* block_entries;
+    // Collapse only
+    double* real_out;
+    double* imag_out;
+    uint64_t mask;
+    uint64_t pattern;
+    double scale;
+} BlockJob;
+
+static void block_sum_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const BlockJob* job = context;
+    for (size_t b = begin; b < end; b++) {
+        const double* re = job->real + b * job->block_size;
+        const double* im = job->imag + b * job->block_size;
+        double sum = 0.0;
+        for (size_t i = 0; i < job->block_size; i++) sum += re[i] * re[i] + im[i] * im[i];
+        job->block_sums[b] = sum;
+    }
+}
+
+static size_t num_blocks(const Statevector* sv, size_t* block_size) {
+    *block_size = sv->dimension < ((size_t)1 << SAMPLE_BLOCK_QUBITS) ? sv->dimension
+                                                                    : (size_t)1 << SAMPLE_BLOCK_QUBITS;
+    return sv->dimension / *block_size;
+}
+
+// Sampling
+
+// Block b walks its amplitudes with the same running sum as block_sum_task, so a target
+// lands on the first amplitude whose cumulative probability exceeds it. Targets left over
+// by rounding at the end of the block go to its last amplitude with nonzero probability.
+static void block_sample_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const BlockJob* job = context;
+    for (size_t b = begin; b < end; b++) {
+        size_t t = job->first_target[b], last = job->first_target[b + 1];
+        size_t first = t, entries = 0;
+        if (t == last) {
+            job->block_entries[b] = 0;
+            continue;
+        }
+        const double* re = job->real + b * job->block_size;
+        const double* im = job->imag + b * job->block_size;
+        size_t last_nonzero = job->block_size - 1;
+        double sum = 0.0;
+        for (size_t i = 0; i < job->block_size && t < last; i++) {
+            double p = re[i] * re[i] + im[i] * im[i];
+            sum += p;
+            if (p == 0.0) continue;
+            last_nonzero = i;
+            uint64_t count = 0;
+            while (t < last && job->targets[t] - job->block_prefix[b] < sum) {
+                count++;
+                t++;
+            }
+            if (count > 0) {
+                job->outcomes[first + entries] = b * job->block_size + i;
+                job->counts[first + entries] = count;
+                entries++;
+            }
+        }
+        if (t < last) {
+            uint64_t outcome = b * job->block_size + last_nonzero;
+            if (entries > 0 && job->outcomes[first + entries - 1] == outcome) {
+                job->counts[first + entries - 1] += last - t;
+            } else {
+                job->outcomes[first + entries] = outcome;
+                job->counts[first + entries] = last - t;
+                entries++;
+            }
+        }
+        job->block_entries[b] = entries;
+    }
+}
+
+bool sample_shots(const Statevector* sv, uint64_t num_shots, Rng* rng, ShotHistogram* histogram) {
+    if (!sv || !rng || !histogram || num_shots == 0) {
+        fprintf(stderr, "Error: Invalid parameters for sampling\n");
+        return false;
+    }
+    size_t block_size, blocks = num_blocks(sv, &block_size);
+    double* block_sums = malloc(blocks * sizeof(double));
+    double* block_prefix = malloc(blocks * sizeof(double));
+    size_t* first_target = malloc((blocks + 1) * sizeof(size_t));
+    size_t* block_entries = malloc(blocks * sizeof(size_t));
+    double* targets = malloc(num_shots * sizeof(double));
+    histogram->outcomes = malloc(num_shots * sizeof(uint64_t));
+    histogram->counts = malloc(num_shots * sizeof(uint64_t));
+    if (!block_sums || !block_prefix || !first_target || !block_entries || !targets || !histogram->outcomes ||
+        !histogram->counts) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(block_sums);
+        free(block_prefix);
+        free(first_target);
+        free(block_entries);
+        free(targets);
+        free_shot_histogram(histogram);
+        return false;
+    }
+
+    BlockJob job = {
+        .real = sv->real,
+        .imag = sv->imag,
+        .block_size = block_size,
+        .block_sums = block_sums,
+        .targets = targets,
+        .block_prefix = block_prefix,
+        .first_target = first_target,
+        .outcomes = histogram->outcomes,
+        .counts = histogram->counts,
+        .block_entries = block_entries,
+    };
+    parallel_for_items(blocks, block_sum_task, &job);
+    double total = 0.0;
+    for (size_t b = 0; b < blocks; b++) {
+        block_prefix[b] = total;
+        total += block_sums[b];
+    }
+    if (!(total > 0.0)) {
+        fprintf(stderr, "Error: Cannot sample a state with zero norm\n");
+        free(block_sums);
+        free(block_prefix);
+        free(first_target);
+        free(block_entries);
+        free(targets);
+        free_shot_histogram(histogram);
+        return false;
+    }
+
+    // Sorted uniforms from normalized partial sums of exponential variates; scaling by the
+    // total probability absorbs a norm that is slightly off 1. A target that rounds up to
+    // the total would land in a trailing block with no probability, so the targets are
+    // kept below it and such a target falls to the last block that has some.
+    double spacing = 0.0;
+    for (uint64_t k = 0; k < num_shots; k++) {
+        spacing += -log(1.0 - rng_uniform(rng));
+        targets[k] = spacing;
+    }
+    spacing += -log(1.0 - rng_uniform(rng));
+    double below_total = nextafter(total, 0.0);
+    for (uint64_t k = 0; k < num_shots; k++) targets[k] = fmin(targets[k] / spacing * total, below_total);
+
+    size_t t = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        while (t < num_shots && targets[t] < block_prefix[b]) t++;
+        first_target[b] = t;
+    }
+    first_target[blocks] = num_shots;
+    parallel_for_items(blocks, block_sample_task, &job);
+
+    size_t num_outcomes = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        memmove(histogram->outcomes + num_outcomes, histogram->outcomes + first_target[b],
+                block_entries[b] * sizeof(uint64_t));
+        memmove(histogram->counts + num_outcomes, histogram->counts + first_target[b],
+                block_entries[b] * sizeof(uint64_t));
+        num_outcomes += block_entries[b];
+    }
+    histogram->num_qubits = sv->num_qubits;
+    histogram->num_shots = num_shots;
+    histogram->num_outcomes = num_outcomes;
+
+    free(block_sums);
+    free(block_prefix);
+    free(first_target);
+    free(block_entries);
+    free(targets);
+    return true;
+}
+
+void free_shot_histogram(ShotHistogram* histogram) {
+    if (!histogram) return;
+    free(histogram->outcomes);
+    free(histogram->counts);
+    histogram->outcomes = NULL;
+    histogram->counts = NULL;
+    histogram->num_outcomes = 0;
+}
+
+static int compare_outcomes(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+void tally_shot_histogram(ShotHistogram* histogram, int num_qubits, uint64_t num_shots) {
+    qsort(histogram->outcomes, num_shots, sizeof(uint64_t), compare_outcomes);
+    size_t num_outcomes = 0;
+    for (uint64_t s = 0; s < num_shots; s++) {
+        if (num_outcomes > 0 && histogram->outcomes[num_outcomes - 1] == histogram->outcomes[s]) {
+            histogram->counts[num_outcomes - 1]++;
+        } else {
+            histogram->outcomes[num_outcomes] = histogram->outcomes[s];
+            histogram->counts[num_outcomes++] = 1;
+        }
+    }
+    histogram->num_qubits = num_qubits;
+    histogram->num_shots = num_shots;
+    histogram->num_outcomes = num_outcomes;
+}
+
+// Collapsing measurements
+
+static bool sample_one(const Statevector* sv, Rng* rng, uint64_t* outcome) {
+    ShotHistogram histogram;
+    if (!sample_shots(sv, 1, rng, &histogram)) return false;
+    *outcome = histogram.outcomes[0];
+    free_shot_histogram(&histogram);
+    return true;
+}
+
+// Zeroes the amplitudes that disagree with pattern on mask and sums the probability of
+// the rest per block
+static void block_project_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const BlockJob* job = context;
+    for (size_t b = begin; b < end; b++) {
+        size_t base = b * job->block_size;
+        double* re = job->real_out + base;
+        double* im = job->imag_out + base;
+        double sum = 0.0;
+        for (size_t i = 0; i < job->block_size; i++) {
+            if (((base + i) & job->mask) == job->pattern) {
+                sum += re[i] * re[i] + im[i] * im[i];
+            } else {
+                re[i] = 0.0;
+                im[i] = 0.0;
+            }
+        }
+        job->block_sums[b] = sum;
+    }
+}
+
+static void block_scale_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const BlockJob* job = context;
+    for (size_t i = begin * job->block_size; i < end * job->block_size; i++) {
+        job->real_out[i] *= job->scale;
+        job->imag_out[i] *= job->scale;
+    }
+}
+
+bool measure_qubits(Statevector* sv, const int* qubits, int count, Rng* rng, uint64_t* outcome) {
+    if (!sv || !qubits || !rng || !outcome || count < 1 || count > 64) {
+        fprintf(stderr, "Error: Invalid parameters for measurement\n");
+        return false;
+    }
+    uint64_t mask = 0;
+    for (int b = 0; b < count; b++) {
+        if (qubits[b] < 0 || qubits[b] >= sv->num_qubits || (mask & ((uint64_t)1 << qubits[b]))) {
+            fprintf(stderr, "Error: Invalid qubit indices\n");
+            return false;
+        }
+        mask |= (uint64_t)1 << qubits[b];
+    }
+
+    // The measured bits of a full sample follow the marginal distribution of the subset
+    uint64_t sample;
+    if (!sample_one(sv, rng, &sample)) return false;
+    *outcome = 0;
+    for (int b = 0; b < count; b++) *outcome |= ((sample >> qubits[b]) & 1) << b;
+
+    size_t block_size, blocks = num_blocks(sv, &block_size);
+    double* block_sums = malloc(blocks * sizeof(double));
+    if (!block_sums) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    BlockJob job = {
+        .block_size = block_size,
+        .block_sums = block_sums,
+        .real_out = sv->real,
+        .imag_out = sv->imag,
+        .mask = mask,
+        .pattern = sample & mask,
+    };
+    parallel_for_items(blocks, block_project_task, &job);
+    double probability = 0.0;
+    for (size_t b = 0; b < blocks; b++) probability += block_sums[b];
+    free(block_sums);
+    if (!(probability > 0.0)) {
+        fprintf(stderr, "Error: Measured outcome has zero probability\n");
+        return false;
+    }
+
+    job.scale = 1.0 / sqrt(probability);
+    parallel_for_items(blocks, block_scale_task, &job);
+    return true;
+}
+
+bool measure_qubit(Statevector* sv, int qubit, Rng* rng, int* outcome) {
+    uint64_t bits;
+    if (!outcome || !measure_qubits(sv, &qubit, 1, rng, &bits)) return false;
+    *outcome = (int)bits;
+    return true;
+}
+
+bool measure_all(Statevector* sv, Rng* rng, uint64_t* outcome) {
+    if (!sv || !rng || !outcome) {
+        fprintf(stderr, "Error: Invalid parameters for measurement\n");
+        return false;
+    }
+    if (!sample_one(sv, rng, outcome)) return false;
+
+    // Keep the phase of the observed amplitude
+    double re = sv->real[*outcome], im = sv->imag[*outcome];
+    double magnitude = sqrt(re * re + im * im);
+    if (!(magnitude > 0.0)) {
+        fprintf(stderr, "Error: Measured outcome has zero probability\n");
+        return false;
+    }
+    memset(sv->real, 0, sv->dimension * sizeof(double));
+    memset(sv->imag, 0, sv->dimension * sizeof(double));
+    sv->real[*outcome] = re / magnitude;
+    sv->imag[*outcome] = im / magnitude;
+    return true;
+}
+
+// Histogram files
+
+static bool write_varint(FILE* file, uint64_t value) {
+    unsigned char bytes[10];
+    int n = 0;
+    do {
+        bytes[n] = value & 0x7F;
+        value >>= 7;
+        if (value) bytes[n] |= 0x80;
+        n++;
+    } while (value);
+    return fwrite(bytes, 1, n, file) == (size_t)n;
+}
+
+static bool read_varint(FILE* file, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(file);
+        if (byte == EOF) return false;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Outcomes are strictly ascending, so each one after the first is stored as the number
+// of outcomes skipped since the previous one
+bool write_shot_histogram(const ShotHistogram* histogram, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open histogram file\n");
+        return false;
+    }
+    bool ok = fwrite("QSHG", 1, 4, file) == 4 && write_varint(file, (uint64_t)histogram->num_qubits) &&
+              write_varint(file, histogram->num_shots) && write_varint(file, histogram->num_outcomes);
+    for (size_t i = 0; ok && i < histogram->num_outcomes; i++) {
+        uint64_t gap = i == 0 ? histogram->outcomes[0] : histogram->outcomes[i] - histogram->outcomes[i - 1] - 1;
+        ok = write_varint(file, gap) && write_varint(file, histogram->counts[i]);
+    }
+    if (fclose(file) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Error: Could not write histogram file\n");
+    return ok;
+}
+
+bool read_shot_histogram(const char* path, ShotHistogram* histogram) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open histogram file\n");
+        return false;
+    }
+    char magic[4];
+    uint64_t num_qubits, num_shots, num_outcomes;
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "QSHG", 4) == 0 && read_varint(file, &num_qubits) &&
+              num_qubits <= 62 && read_varint(file, &num_shots) && read_varint(file, &num_outcomes) &&
+              num_outcomes <= num_shots && num_outcomes <= ((uint64_t)1 << num_qubits);
+    histogram->outcomes = NULL;
+    histogram->counts = NULL;
+    if (ok) {
+        histogram->outcomes = malloc((num_outcomes + 1) * sizeof(uint64_t));
+        histogram->counts = malloc((num_outcomes + 1) * sizeof(uint64_t));
+        ok = histogram->outcomes && histogram->counts;
+    }
+    for (uint64_t i = 0; ok && i < num_outcomes; i++) {
+        uint64_t gap;
+        ok = read_varint(file, &gap) && read_varint(file, &histogram->counts[i]);
+        histogram->outcomes[i] = i == 0 ? gap : histogram->outcomes[i - 1] + gap + 1;
+    }
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Error: Invalid histogram file\n");
+        free_shot_histogram(histogram);
+        return false;
+    }
+    histogram->num_qubits = (int)num_qubits;
+    histogram->num_shots = num_shots;
+    histogram->num_outcomes = num_outcomes;
+    return true;
+}
@@ -0,0 +1,57 @@
+// measurement.h
+#ifndef MEASUREMENT_H
+#define MEASUREMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "statevector_core.h"
+
+// Probabilities are summed in blocks of 2^SAMPLE_BLOCK_QUBITS amplitudes. The blocks only
+// depend on the state size, so samples are the same for every thread count.
+#define SAMPLE_BLOCK_QUBITS 14
+
+// xoshiro256** generator. Measurements draw from an explicit generator, so a run is
+// reproducible from its seed.
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+void rng_seed(Rng* rng, uint64_t seed);
+uint64_t rng_next(Rng* rng);
+double rng_uniform(Rng* rng);  // uniform in [0, 1)
+
+// Outcome counts of a many-shot run in ascending outcome order. Bit q of an outcome is the
+// result of qubit q.
+typedef struct {
+    int num_qubits;
+    uint64_t num_shots;
+    size_t num_outcomes;
+    uint64_t* outcomes;
+    uint64_t* counts;
+} ShotHistogram;
+
+// Measures every qubit and collapses the state to the observed basis state
+bool measure_all(Statevector* sv, Rng* rng, uint64_t* outcome);
+
+// Measures qubits[0..count) and collapses the state onto the observed results. Bit b of
+// outcome is the result of qubits[b].
+bool measure_qubits(Statevector* sv, const int* qubits, int count, Rng* rng, uint64_t* outcome);
+bool measure_qubit(Statevector* sv, int qubit, Rng* rng, int* outcome);
+
+// Draws num_shots samples of all qubits without touching the state. One parallel pass sums
+// the probability of every block; a second walks the cumulative probabilities once
+// against pre-sorted uniforms, so the cost barely depends on the number of shots.
+bool sample_shots(const Statevector* sv, uint64_t num_shots, Rng* rng, ShotHistogram* histogram);
+void free_shot_histogram(ShotHistogram* histogram);
+
+// Turns num_shots raw outcomes, stored one per shot in histogram->outcomes (with counts
+// as large), into the histogram: sorts them in place and counts each distinct one
+void tally_shot_histogram(ShotHistogram* histogram, int num_qubits, uint64_t num_shots);
+
+// Compact binary histogram file: the bytes "QSHG", then LEB128 varints for num_qubits,
+// num_shots and num_outcomes, then per outcome the gap to the previous outcome and the
+// count
+bool write_shot_histogram(const ShotHistogram* histogram, const char* path);
+bool read_shot_histogram(const char* path, ShotHistogram* histogram);
+
+#endif // MEASUREMENT_H
@@ -0,0 +1,695 @@
+// mps.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mps.h"
+#include "instrumentation.h"
+
+// One-sided Jacobi stops once every column pair is orthogonal to this relative precision.
+// Columns whose squared norm is below SVD_NEGLIGIBLE of the whole matrix are rounding
+// noise that would never settle; they end up as singular values far below the cutoff.
+#define SVD_TOLERANCE 1e-14
+#define SVD_NEGLIGIBLE 1e-28
+#define SVD_MAX_SWEEPS 64
+
+static Complex complex_mul(Complex a, Complex b) {
+    Complex product = {a.real * b.real - a.imag * b.imag, a.real * b.imag + a.imag * b.real};
+    return product;
+}
+
+// conj(a) * b
+static Complex complex_conj_mul(Complex a, Complex b) {
+    Complex product = {a.real * b.real + a.imag * b.imag, a.real * b.imag - a.imag * b.real};
+    return product;
+}
+
+static size_t site_entries(const MpsState* mps, int q) {
+    return (size_t)mps->bond[q] * 2 * (size_t)mps->bond[q + 1];
+}
+
+// SVD
+
+// Thin SVD of a tall matrix by one-sided Jacobi. a is rows x cols column-major with
+// cols <= rows and is overwritten: column pairs are rotated until all are orthogonal,
+// which leaves a = U diag(s) and the accumulated rotations in v (cols x cols,
+// column-major), so the input is a v†. Returns false if the sweeps do not converge.
+static bool jacobi_columns(Complex* a, Complex* v, int rows, int cols) {
+    for (int j = 0; j < cols; j++) {
+        for (int i = 0; i < cols; i++) v[(size_t)j * cols + i] = (Complex){i == j ? 1.0 : 0.0, 0.0};
+    }
+    double total = 0.0;
+    for (size_t i = 0; i < (size_t)rows * cols; i++) total += a[i].real * a[i].real + a[i].imag * a[i].imag;
+    for (int sweep = 0; sweep < SVD_MAX_SWEEPS; sweep++) {
+        bool rotated = false;
+        for (int p = 0; p < cols - 1; p++) {
+            for (int q = p + 1; q < cols; q++) {
+                Complex* ap = a + (size_t)p * rows;
+                Complex* aq = a + (size_t)q * rows;
+                double alpha = 0.0, beta = 0.0;
+                Complex gamma = {0.0, 0.0};
+                for (int i = 0; i < rows; i++) {
+                    alpha += ap[i].real * ap[i].real + ap[i].imag * ap[i].imag;
+                    beta += aq[i].real * aq[i].real + aq[i].imag * aq[i].imag;
+                    Complex term = complex_conj_mul(ap[i], aq[i]);
+                    gamma.real += term.real;
+                    gamma.imag += term.imag;
+                }
+                double magnitude = hypot(gamma.real, gamma.imag);
+                if (magnitude <= SVD_TOLERANCE * sqrt(alpha * beta) || alpha <= SVD_NEGLIGIBLE * total ||
+                    beta <= SVD_NEGLIGIBLE * total) {
+                    continue;
+                }
+                rotated = true;
+
+                // Turning column q by the phase of gamma makes the pair's overlap real, after
+                // which a real Jacobi rotation orthogonalizes it
+                Complex phase = {gamma.real / magnitude, -gamma.imag / magnitude};
+                double zeta = (beta - alpha) / (2.0 * magnitude);
+                double t = (zeta >= 0.0 ? 1.0 : -1.0) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+                double c = 1.0 / sqrt(1.0 + t * t);
+                double s = c * t;
+                Complex* vp = v + (size_t)p * cols;
+                Complex* vq = v + (size_t)q * cols;
+                for (int i = 0; i < rows; i++) {
+                    Complex x = ap[i], y = complex_mul(aq[i], phase);
+                    ap[i] = (Complex){c * x.real - s * y.real, c * x.imag - s * y.imag};
+                    aq[i] = (Complex){s * x.real + c * y.real, s * x.imag + c * y.imag};
+                }
+                for (int i = 0; i < cols; i++) {
+                    Complex x = vp[i], y = complex_mul(vq[i], phase);
+                    vp[i] = (Complex){c * x.real - s * y.real, c * x.imag - s * y.imag};
+                    vq[i] = (Complex){s * x.real + c * y.real, s * x.imag + c * y.imag};
+                }
+            }
+        }
+        if (!rotated) return true;
+    }
+    return false;
+}
+
+typedef struct {
+    int rank;   // min(rows, cols)
+    Complex* u; // rows x rank, row-major
+    double* s;  // rank values, descending
+    Complex* v; // cols x rank, row-major: m = u diag(s) v†
+} Svd;
+
+static void free_svd(Svd* svd) {
+    free(svd->u);
+    free(svd->s);
+    free(svd->v);
+}
+
+// Thin SVD of the row-major rows x cols matrix m. A wide matrix is decomposed through its
+// adjoint, m† = V S U†, so the Jacobi sweeps always run over the shorter side.
+static bool compute_svd(const Complex* m, int rows, int cols, Svd* svd) {
+    bool wide = cols > rows;
+    int tall_rows = wide ? cols : rows;
+    int tall_cols = wide ? rows : cols;
+    svd->rank = tall_cols;
+    svd->u = malloc((size_t)rows * tall_cols * sizeof(Complex));
+    svd->s = malloc((size_t)tall_cols * sizeof(double));
+    svd->v = malloc((size_t)cols * tall_cols * sizeof(Complex));
+    Complex* a = malloc((size_t)tall_rows * tall_cols * sizeof(Complex));
+    Complex* rotations = malloc((size_t)tall_cols * tall_cols * sizeof(Complex));
+    double* norms = malloc((size_t)tall_cols * sizeof(double));
+    int* order = malloc((size_t)tall_cols * sizeof(int));
+    if (!svd->u || !svd->s || !svd->v || !a || !rotations || !norms || !order) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_svd(svd);
+        free(a);
+        free(rotations);
+        free(norms);
+        free(order);
+        return false;
+    }
+
+    // Column-major copy of the tall matrix: m itself, or its adjoint
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            Complex x = m[(size_t)r * cols + c];
+            if (wide) a[(size_t)r * tall_rows + c] = (Complex){x.real, -x.imag};
+            else a[(size_t)c * tall_rows + r] = x;
+        }
+    }
+    bool ok = jacobi_columns(a, rotations, tall_rows, tall_cols);
+    if (!ok) fprintf(stderr, "Error: SVD did not converge\n");
+
+    for (int j = 0; j < tall_cols; j++) {
+        double sum = 0.0;
+        for (int i = 0; i < tall_rows; i++) {
+            Complex x = a[(size_t)j * tall_rows + i];
+            sum += x.real * x.real + x.imag * x.imag;
+        }
+        norms[j] = sqrt(sum);
+        order[j] = j;
+    }
+    for (int j = 1; j < tall_cols; j++) {
+        int k = order[j];
+        int i = j;
+        for (; i > 0 && norms[order[i - 1]] < norms[k]; i--) order[i] = order[i - 1];
+        order[i] = k;
+    }
+
+    // Tall side: left vectors a_j / s_j; short side: the rotations
+    Complex* left = wide ? svd->v : svd->u;
+    Complex* right = wide ? svd->u : svd->v;
+    for (int j = 0; j < tall_cols; j++) {
+        int k = order[j];
+        double scale = norms[k] > 0.0 ? 1.0 / norms[k] : 0.0;
+        svd->s[j] = norms[k];
+        for (int i = 0; i < tall_rows; i++) {
+            Complex x = a[(size_t)k * tall_rows + i];
+            left[(size_t)i * tall_cols + j] = (Complex){x.real * scale, x.imag * scale};
+        }
+        for (int i = 0; i < tall_cols; i++) right[(size_t)i * tall_cols + j] = rotations[(size_t)k * tall_cols + i];
+    }
+    free(a);
+    free(rotations);
+    free(norms);
+    free(order);
+    if (!ok) free_svd(svd);
+    return ok;
+}
+
+// Number of singular values to keep: those above the cutoff, at most max_bond of them
+// when capped. The kept values are rescaled to the weight of all of them, so truncation
+// leaves the norm unchanged, and the discarded weight is recorded.
+static int truncate_svd(MpsState* mps, Svd* svd, bool capped) {
+    double total = 0.0;
+    for (int j = 0; j < svd->rank; j++) total += svd->s[j] * svd->s[j];
+    int keep = 1;
+    while (keep < svd->rank && svd->s[keep] > mps->cutoff * svd->s[0]) keep++;
+    if (capped && keep > mps->max_bond) keep = mps->max_bond;
+
+    double kept = 0.0;
+    for (int j = 0; j < keep; j++) kept += svd->s[j] * svd->s[j];
+    if (total > 0.0 && kept < total) {
+        double discarded = (total - kept) / total;
+        mps->discarded_weight += discarded;
+        mps->fidelity *= 1.0 - discarded;
+        double scale = sqrt(total / kept);
+        for (int j = 0; j < keep; j++) svd->s[j] *= scale;
+    }
+    return keep;
+}
+
+// Canonical form
+
+static void set_bond(MpsState* mps, int b, int dimension) {
+    mps->bond[b] = dimension;
+    if (dimension > mps->peak_bond) mps->peak_bond = dimension;
+}
+
+// Splits site c as U (S V†) and pushes S V† into site c + 1
+static bool move_center_right(MpsState* mps) {
+    int c = mps->center;
+    int left = mps->bond[c], middle = mps->bond[c + 1], right = mps->bond[c + 2];
+    Svd svd;
+    if (!compute_svd(mps->sites[c], 2 * left, middle, &svd)) return false;
+    int keep = truncate_svd(mps, &svd, false);
+    Complex* site = malloc((size_t)2 * left * keep * sizeof(Complex));
+    Complex* next = calloc((size_t)keep * 2 * right, sizeof(Complex));
+    if (!site || !next) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(site);
+        free(next);
+        free_svd(&svd);
+        return false;
+    }
+    for (int i = 0; i < 2 * left; i++) memcpy(site + (size_t)i * keep, svd.u + (size_t)i * svd.rank, keep * sizeof(Complex));
+    const Complex* old = mps->sites[c + 1];
+    for (int j = 0; j < keep; j++) {
+        for (int m = 0; m < middle; m++) {
+            Complex v = svd.v[(size_t)m * svd.rank + j];
+            Complex w = {svd.s[j] * v.real, -svd.s[j] * v.imag};
+            for (int e = 0; e < 2 * right; e++) {
+                Complex term = complex_mul(w, old[(size_t)m * 2 * right + e]);
+                next[(size_t)j * 2 * right + e].real += term.real;
+                next[(size_t)j * 2 * right + e].imag += term.imag;
+            }
+        }
+    }
+    free(mps->sites[c]);
+    free(mps->sites[c + 1]);
+    mps->sites[c] = site;
+    mps->sites[c + 1] = next;
+    set_bond(mps, c + 1, keep);
+    mps->center = c + 1;
+    free_svd(&svd);
+    return true;
+}
+
+// Splits site c as (U S) V† and pushes U S into site c - 1
+static bool move_center_left(MpsState* mps) {
+    int c = mps->center;
+    int left = mps->bond[c - 1], middle = mps->bond[c], right = mps->bond[c + 1];
+    Svd svd;
+    if (!compute_svd(mps->sites[c], middle, 2 * right, &svd)) return false;
+    int keep = truncate_svd(mps, &svd, false);
+    Complex* site = malloc((size_t)keep * 2 * right * sizeof(Complex));
+    Complex* previous = calloc((size_t)2 * left * keep, sizeof(Complex));
+    if (!site || !previous) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(site);
+        free(previous);
+        free_svd(&svd);
+        return false;
+    }
+    for (int j = 0; j < keep; j++) {
+        for (int e = 0; e < 2 * right; e++) {
+            Complex v = svd.v[(size_t)e * svd.rank + j];
+            site[(size_t)j * 2 * right + e] = (Complex){v.real, -v.imag};
+        }
+    }
+    const Complex* old = mps->sites[c - 1];
+    for (int i = 0; i < 2 * left; i++) {
+        for (int m = 0; m < middle; m++) {
+            Complex x = old[(size_t)i * middle + m];
+            for (int j = 0; j < keep; j++) {
+                Complex u = svd.u[(size_t)m * svd.rank + j];
+                Complex term = complex_mul(x, (Complex){svd.s[j] * u.real, svd.s[j] * u.imag});
+                previous[(size_t)i * keep + j].real += term.real;
+                previous[(size_t)i * keep + j].imag += term.imag;
+            }
+        }
+    }
+    free(mps->sites[c - 1]);
+    free(mps->sites[c]);
+    mps->sites[c - 1] = previous;
+    mps->sites[c] = site;
+    set_bond(mps, c, keep);
+    mps->center = c - 1;
+    free_svd(&svd);
+    return true;
+}
+
+// Moves the center to the nearest site of [first, last]
+static bool move_center(MpsState* mps, int first, int last) {
+    while (mps->center < first) {
+        if (!move_center_right(mps)) return false;
+    }
+    while (mps->center > last) {
+        if (!move_center_left(mps)) return false;
+    }
+    return true;
+}
+
+// State management
+
+MpsState* create_mps(int num_qubits, int max_bond) {
+    if (num_qubits < 1 || num_qubits > MAX_CIRCUIT_QUBITS || max_bond < 0) {
+        fprintf(stderr, "Error: Invalid parameters for MPS\n");
+        return NULL;
+    }
+    MpsState* mps = calloc(1, sizeof(MpsState));
+    if (!mps) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    mps->num_qubits = num_qubits;
+    mps->max_bond = max_bond > 0 ? max_bond : MPS_DEFAULT_MAX_BOND;
+    mps->cutoff = MPS_DEFAULT_CUTOFF;
+    mps->bond = malloc(((size_t)num_qubits + 1) * sizeof(int));
+    mps->sites = calloc((size_t)num_qubits, sizeof(Complex*));
+    if (!mps->bond || !mps->sites || !initialize_mps(mps)) {
+        if (!mps->bond || !mps->sites) fprintf(stderr, "Error: Memory allocation failed\n");
+        free_mps(mps);
+        return NULL;
+    }
+    INSTRUMENT_ALLOC(mps_memory_bytes(mps));
+    return mps;
+}
+
+void free_mps(MpsState* mps) {
+    if (!mps) return;
+    for (int q = 0; mps->sites && q < mps->num_qubits; q++) free(mps->sites[q]);
+    free(mps->sites);
+    free(mps->bond);
+    free(mps);
+}
+
+bool initialize_mps(MpsState* mps) {
+    if (!mps) return false;
+    for (int q = 0; q < mps->num_qubits; q++) {
+        Complex* site = realloc(mps->sites[q], 2 * sizeof(Complex));
+        if (!site) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return false;
+        }
+        site[0] = (Complex){1.0, 0.0};
+        site[1] = (Complex){0.0, 0.0};
+        mps->sites[q] = site;
+    }
+    for (int b = 0; b <= mps->num_qubits; b++) mps->bond[b] = 1;
+    mps->center = 0;
+    mps->discarded_weight = 0.0;
+    mps->fidelity = 1.0;
+    mps->peak_bond = 1;
+    return true;
+}
+
+bool copy_mps(MpsState* dst, const MpsState* src) {
+    if (!dst || !src || dst->num_qubits != src->num_qubits) {
+        fprintf(stderr, "Error: MPS states have different sizes\n");
+        return false;
+    }
+    for (int q = 0; q < src->num_qubits; q++) {
+        size_t bytes = site_entries(src, q) * sizeof(Complex);
+        Complex* site = realloc(dst->sites[q], bytes);
+        if (!site) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return false;
+        }
+        memcpy(site, src->sites[q], bytes);
+        dst->sites[q] = site;
+    }
+    memcpy(dst->bond, src->bond, ((size_t)src->num_qubits + 1) * sizeof(int));
+    dst->max_bond = src->max_bond;
+    dst->cutoff = src->cutoff;
+    dst->center = src->center;
+    dst->discarded_weight = src->discarded_weight;
+    dst->fidelity = src->fidelity;
+    dst->peak_bond = src->peak_bond;
+    return true;
+}
+
+size_t mps_memory_bytes(const MpsState* mps) {
+    size_t total = 0;
+    for (int q = 0; q < mps->num_qubits; q++) total += site_entries(mps, q) * sizeof(Complex);
+    return total;
+}
+
+// Gates
+
+bool mps_apply_gate(MpsState* mps, const QuantumGate* gate, int qubit) {
+    if (!mps || !gate || qubit < 0 || qubit >= mps->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for MPS gate\n");
+        return false;
+    }
+    // A unitary on the physical index keeps the site orthonormal, so the center stays put
+    Complex* site = mps->sites[qubit];
+    int left = mps->bond[qubit], right = mps->bond[qubit + 1];
+    for (int l = 0; l < left; l++) {
+        for (int r = 0; r < right; r++) {
+            Complex* a = &site[(size_t)(l * 2) * right + r];
+            Complex* b = &site[(size_t)(l * 2 + 1) * right + r];
+            Complex x = *a, y = *b;
+            Complex m00 = complex_mul(gate->elements[0][0], x), m01 = complex_mul(gate->elements[0][1], y);
+            Complex m10 = complex_mul(gate->elements[1][0], x), m11 = complex_mul(gate->elements[1][1], y);
+            *a = (Complex){m00.real + m01.real, m00.imag + m01.imag};
+            *b = (Complex){m10.real + m11.real, m10.imag + m11.imag};
+        }
+    }
+    return true;
+}
+
+bool mps_apply_adjacent(MpsState* mps, const Complex* matrix, int qubit) {
+    if (!mps || !matrix || qubit < 0 || qubit + 1 >= mps->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for MPS gate\n");
+        return false;
+    }
+    if (!move_center(mps, qubit, qubit + 1)) return false;
+    int left = mps->bond[qubit], middle = mps->bond[qubit + 1], right = mps->bond[qubit + 2];
+    const Complex* a = mps->sites[qubit];
+    const Complex* b = mps->sites[qubit + 1];
+
+    // theta[(l, s0), (s1, r)] = sum_m A[l, s0, m] B[m, s1, r], then the gate on (s0, s1)
+    size_t cols = (size_t)2 * right;
+    Complex* theta = calloc((size_t)2 * left * cols, sizeof(Complex));
+    if (!theta) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    for (size_t i = 0; i < (size_t)2 * left; i++) {
+        for (int m = 0; m < middle; m++) {
+            Complex x = a[i * middle + m];
+            for (size_t e = 0; e < cols; e++) {
+                Complex term = complex_mul(x, b[(size_t)m * cols + e]);
+                theta[i * cols + e].real += term.real;
+                theta[i * cols + e].imag += term.imag;
+            }
+        }
+    }
+    for (int l = 0; l < left; l++) {
+        for (int r = 0; r < right; r++) {
+            Complex* entry[4];
+            Complex in[4];
+            for (int s = 0; s < 4; s++) {
+                entry[s] = &theta[(size_t)(l * 2 + (s & 1)) * cols + (size_t)(s >> 1) * right + r];
+                in[s] = *entry[s];
+            }
+            for (int t = 0; t < 4; t++) {
+                Complex sum = {0.0, 0.0};
+                for (int s = 0; s < 4; s++) {
+                    Complex term = complex_mul(matrix[t * 4 + s], in[s]);
+                    sum.real += term.real;
+                    sum.imag += term.imag;
+                }
+                *entry[t] = sum;
+            }
+        }
+    }
+
+    Svd svd;
+    bool ok = compute_svd(theta, 2 * left, (int)cols, &svd);
+    free(theta);
+    if (!ok) return false;
+    int keep = truncate_svd(mps, &svd, true);
+    Complex* site = malloc((size_t)2 * left * keep * sizeof(Complex));
+    Complex* next = malloc((size_t)keep * cols * sizeof(Complex));
+    if (!site || !next) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(site);
+        free(next);
+        free_svd(&svd);
+        return false;
+    }
+    // A = U stays left-orthonormal; B = S V† becomes the center
+    for (int i = 0; i < 2 * left; i++) memcpy(site + (size_t)i * keep, svd.u + (size_t)i * svd.rank, keep * sizeof(Complex));
+    for (int j = 0; j < keep; j++) {
+        for (size_t e = 0; e < cols; e++) {
+            Complex v = svd.v[e * svd.rank + j];
+            next[(size_t)j * cols + e] = (Complex){svd.s[j] * v.real, -svd.s[j] * v.imag};
+        }
+    }
+    free(mps->sites[qubit]);
+    free(mps->sites[qubit + 1]);
+    mps->sites[qubit] = site;
+    mps->sites[qubit + 1] = next;
+    set_bond(mps, qubit + 1, keep);
+    mps->center = qubit + 1;
+    free_svd(&svd);
+    return true;
+}
+
+// 4x4 matrix of a gate on bit target_bit controlled by the other bit
+static void controlled_matrix(const QuantumGate* gate, int target_bit, Complex* matrix) {
+    int control_mask = 1 << (1 - target_bit);
+    for (int t = 0; t < 4; t++) {
+        for (int s = 0; s < 4; s++) {
+            Complex entry = {0.0, 0.0};
+            if ((t & control_mask) != (s & control_mask)) {
+                // outside the gate's blocks
+            } else if (!(s & control_mask)) {
+                if (t == s) entry.real = 1.0;
+            } else {
+                entry = gate->elements[(t >> target_bit) & 1][(s >> target_bit) & 1];
+            }
+            matrix[t * 4 + s] = entry;
+        }
+    }
+}
+
+static void swap_matrix(Complex* matrix) {
+    static const int swapped[4] = {0, 2, 1, 3};
+    for (int t = 0; t < 4; t++) {
+        for (int s = 0; s < 4; s++) matrix[t * 4 + s] = (Complex){swapped[s] == t ? 1.0 : 0.0, 0.0};
+    }
+}
+
+bool mps_apply_controlled(MpsState* mps, const QuantumGate* gate, int control, int target) {
+    if (!mps || !gate || control < 0 || target < 0 || control >= mps->num_qubits || target >= mps->num_qubits ||
+        control == target) {
+        fprintf(stderr, "Error: Invalid parameters for MPS gate\n");
+        return false;
+    }
+    int low = control < target ? control : target;
+    int high = control < target ? target : control;
+    Complex swap[16], matrix[16];
+    swap_matrix(swap);
+    controlled_matrix(gate, control < target ? 1 : 0, matrix);
+
+    // The lower qubit walks up to high - 1, the gate runs there and the qubit walks back
+    bool ok = true;
+    for (int q = low; ok && q < high - 1; q++) ok = mps_apply_adjacent(mps, swap, q);
+    ok = ok && mps_apply_adjacent(mps, matrix, high - 1);
+    for (int q = high - 2; ok && q >= low; q--) ok = mps_apply_adjacent(mps, swap, q);
+    return ok;
+}
+
+bool apply_mps_op(MpsState* mps, const CircuitOp* op, const double* params) {
+    if (!mps || !op || (op->param_index >= 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for MPS op\n");
+        return false;
+    }
+    QuantumGate gate = circuit_op_gate(op, params);
+    if (op->control == NO_CONTROL) return mps_apply_gate(mps, &gate, op->target);
+    return mps_apply_controlled(mps, &gate, op->control, op->target);
+}
+
+// Queries
+
+bool mps_amplitude(const MpsState* mps, const uint8_t* bits, Complex* amplitude) {
+    if (!mps || !bits || !amplitude) {
+        fprintf(stderr, "Error: Invalid parameters for MPS amplitude\n");
+        return false;
+    }
+    Complex* vector = malloc((size_t)mps->peak_bond * sizeof(Complex));
+    Complex* next = malloc((size_t)mps->peak_bond * sizeof(Complex));
+    if (!vector || !next) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(vector);
+        free(next);
+        return false;
+    }
+    vector[0] = (Complex){1.0, 0.0};
+    for (int q = 0; q < mps->num_qubits; q++) {
+        int left = mps->bond[q], right = mps->bond[q + 1];
+        const Complex* site = mps->sites[q];
+        int s = bits[q] & 1;
+        for (int r = 0; r < right; r++) next[r] = (Complex){0.0, 0.0};
+        for (int l = 0; l < left; l++) {
+            for (int r = 0; r < right; r++) {
+                Complex term = complex_mul(vector[l], site[(size_t)(l * 2 + s) * right + r]);
+                next[r].real += term.real;
+                next[r].imag += term.imag;
+            }
+        }
+        Complex* swap = vector;
+        vector = next;
+        next = swap;
+    }
+    *amplitude = vector[0];
+    free(vector);
+    free(next);
+    return true;
+}
+
+bool mps_sample(const MpsState* mps, uint64_t num_shots, Rng* rng, uint8_t* outcomes) {
+    if (!mps || !rng || !outcomes) {
+        fprintf(stderr, "Error: Invalid parameters for MPS sampling\n");
+        return false;
+    }
+    // With every site right of 0 right-orthonormal, the probability of a prefix of outcomes
+    // is the squared norm of the prefix contracted into a bond vector. Unless the center is
+    // there already it is moved on a copy without a cutoff, so the moves drop only exact
+    // zeros and mps is left as it was.
+    MpsState* canonical = NULL;
+    if (mps->center != 0) {
+        canonical = create_mps(mps->num_qubits, mps->max_bond);
+        if (!canonical || !copy_mps(canonical, mps)) {
+            free_mps(canonical);
+            return false;
+        }
+        canonical->cutoff = 0.0;
+        if (!move_center(canonical, 0, 0)) {
+            free_mps(canonical);
+            return false;
+        }
+        mps = canonical;
+    }
+    Complex* vector = malloc((size_t)mps->peak_bond * sizeof(Complex));
+    Complex* branch = malloc((size_t)2 * mps->peak_bond * sizeof(Complex));
+    if (!vector || !branch) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(vector);
+        free(branch);
+        free_mps(canonical);
+        return false;
+    }
+    for (uint64_t shot = 0; shot < num_shots; shot++) {
+        uint8_t* bits = outcomes + shot * (uint64_t)mps->num_qubits;
+        vector[0] = (Complex){1.0, 0.0};
+        for (int q = 0; q < mps->num_qubits; q++) {
+            int left = mps->bond[q], right = mps->bond[q + 1];
+            const Complex* site = mps->sites[q];
+            double probability[2] = {0.0, 0.0};
+            for (int s = 0; s < 2; s++) {
+                Complex* w = branch + (size_t)s * right;
+                for (int r = 0; r < right; r++) w[r] = (Complex){0.0, 0.0};
+                for (int l = 0; l < left; l++) {
+                    for (int r = 0; r < right; r++) {
+                        Complex term = complex_mul(vector[l], site[(size_t)(l * 2 + s) * right + r]);
+                        w[r].real += term.real;
+                        w[r].imag += term.imag;
+                    }
+                }
+                for (int r = 0; r < right; r++) probability[s] += w[r].real * w[r].real + w[r].imag * w[r].imag;
+            }
+            int s = rng_uniform(rng) * (probability[0] + probability[1]) < probability[0] ? 0 : 1;
+            double scale = 1.0 / sqrt(probability[s]);
+            for (int r = 0; r < right; r++) {
+                vector[r] = (Complex){branch[(size_t)s * right + r].real * scale, branch[(size_t)s * right + r].imag * scale};
+            }
+            bits[q] = (uint8_t)s;
+        }
+    }
+    free(vector);
+    free(branch);
+    free_mps(canonical);
+    return true;
+}
+
+bool mps_to_statevector(const MpsState* mps, Statevector* sv) {
+    if (!mps || !sv || sv->num_qubits != mps->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for MPS conversion\n");
+        return false;
+    }
+    // After site q, partial[i * bond[q + 1] + r] holds the contraction of sites 0..q for
+    // the basis state i of the first q + 1 qubits
+    size_t largest = 1;
+    for (int q = 0; q < mps->num_qubits; q++) {
+        size_t entries = ((size_t)1 << (q + 1)) * (size_t)mps->bond[q + 1];
+        if (entries > largest) largest = entries;
+    }
+    Complex* partial = malloc(largest * sizeof(Complex));
+    Complex* next = malloc(largest * sizeof(Complex));
+    if (!partial || !next) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(partial);
+        free(next);
+        return false;
+    }
+    partial[0] = (Complex){1.0, 0.0};
+    for (int q = 0; q < mps->num_qubits; q++) {
+        int left = mps->bond[q], right = mps->bond[q + 1];
+        size_t prefixes = (size_t)1 << q;
+        const Complex* site = mps->sites[q];
+        memset(next, 0, 2 * prefixes * right * sizeof(Complex));
+        for (size_t i = 0; i < prefixes; i++) {
+            for (int s = 0; s < 2; s++) {
+                Complex* out = next + (i | (size_t)s << q) * right;
+                for (int l = 0; l < left; l++) {
+                    Complex x = partial[i * left + l];
+                    for (int r = 0; r < right; r++) {
+                        Complex term = complex_mul(x, site[(size_t)(l * 2 + s) * right + r]);
+                        out[r].real += term.real;
+                        out[r].imag += term.imag;
+                    }
+                }
+            }
+        }
+        Complex* swap = partial;
+        partial = next;
+        next = swap;
+    }
+    for (size_t i = 0; i < sv->dimension; i++) {
+        sv->real[i] = partial[i].real;
+        sv->imag[i] = partial[i].imag;
+    }
+    free(partial);
+    free(next);
+    return true;
+}
@@ -0,0 +1,74 @@
+// mps.h
+#ifndef MPS_H
+#define MPS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "statevector_core.h"
+#include "circuit.h"
+#include "measurement.h"
+
+#define MPS_DEFAULT_MAX_BOND 64
+
+// Singular values below this fraction of the largest one are dropped even under the cap
+#define MPS_DEFAULT_CUTOFF 1e-12
+
+// Matrix product state: site q holds a bond[q] x 2 x bond[q + 1] tensor A_q, and the
+// amplitude of basis state b is A_0[b_0] A_1[b_1] ... A_{n-1}[b_{n-1}], a product of
+// bond-dimension matrices (bond[0] = bond[n] = 1). Memory grows with n * bond^2 instead
+// of 2^n, which suits shallow or nearest-neighbour circuits whose entanglement stays low.
+//
+// The state is kept in mixed canonical form around the site center: the sites left of it
+// are left-orthonormal and those right of it right-orthonormal, so truncating the bond
+// next to the center drops the smallest Schmidt coefficients of the whole state.
+typedef struct {
+    int num_qubits;
+    int max_bond;             // bond dimension cap
+    double cutoff;            // relative singular value cutoff
+    int center;               // orthogonality center
+    int* bond;                // num_qubits + 1 bond dimensions
+    Complex** sites;          // site q, entry (l, s, r) at (l * 2 + s) * bond[q + 1] + r
+    double discarded_weight;  // sum of the squared singular values truncated so far
+    double fidelity;          // product of the weights kept by each truncation, an estimate
+    int peak_bond;            // largest bond dimension reached
+} MpsState;
+
+// |0...0⟩ with bond dimension 1 everywhere. max_bond = 0 selects MPS_DEFAULT_MAX_BOND.
+MpsState* create_mps(int num_qubits, int max_bond);
+void free_mps(MpsState* mps);
+bool initialize_mps(MpsState* mps);
+bool copy_mps(MpsState* dst, const MpsState* src);
+
+// Bytes held by the site tensors
+size_t mps_memory_bytes(const MpsState* mps);
+
+// A 2x2 gate on one site. Leaves the bonds unchanged.
+bool mps_apply_gate(MpsState* mps, const QuantumGate* gate, int qubit);
+
+// A 4x4 gate (row-major) on qubits q and q + 1. Bit 0 of a row or column index belongs to
+// q, bit 1 to q + 1, as in kernel_dense_block(). The two sites are contracted, multiplied
+// and split again with an SVD, keeping at most max_bond singular values.
+bool mps_apply_adjacent(MpsState* mps, const Complex* matrix, int qubit);
+
+// A controlled 2x2 gate on any two qubits. Distant qubits are routed next to each other
+// with SWAP gates and moved back afterwards.
+bool mps_apply_controlled(MpsState* mps, const QuantumGate* gate, int control, int target);
+
+// Applies any circuit op
+bool apply_mps_op(MpsState* mps, const CircuitOp* op, const double* params);
+
+// ⟨b|ψ⟩ for bits[q] = b_q, contracted site by site in O(n bond^2)
+bool mps_amplitude(const MpsState* mps, const uint8_t* bits, Complex* amplitude);
+
+// Draws num_shots samples of all qubits into outcomes, num_qubits bytes per shot. A copy
+// of the state with its center moved to site 0 is made unless it is there already, after
+// which every qubit is drawn from its conditional distribution in O(bond^2), so a shot
+// costs O(n bond^2) and the state is never expanded.
+bool mps_sample(const MpsState* mps, uint64_t num_shots, Rng* rng, uint8_t* outcomes);
+
+// Expands the state into sv, which must have as many qubits. Used to check the MPS against
+// the statevector backends.
+bool mps_to_statevector(const MpsState* mps, Statevector* sv);
+
+#endif // MPS_H
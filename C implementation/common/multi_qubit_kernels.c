@@ -0,0 +1,224 @@
+// multi_qubit_kernels.c
+#include <stdio.h>
+#include "multi_qubit_kernels.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+
+// Same as the pair kernels: no fused multiply-add, so every SIMD level gives the same bits
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Consecutive groups processed together when their amplitudes are contiguous
+#define DENSE_LANES 8
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define QSIM_HAVE_X86_SIMD 1
+#endif
+
+typedef struct {
+    double* real;
+    double* imag;
+    const Complex* matrix;
+    int k;
+    int sorted_qubits[MAX_BLOCK_QUBITS];
+    size_t offsets[1 << MAX_BLOCK_QUBITS];
+    size_t run_length;  // consecutive groups whose base indices are consecutive
+} DenseBlockJob;
+
+// Index of the first amplitude of group g: g with a zero bit inserted at every block qubit
+static inline size_t group_base_index(size_t g, const int* sorted_qubits, int k) {
+    for (int b = 0; b < k; b++) {
+        size_t low = g & (((size_t)1 << sorted_qubits[b]) - 1);
+        g = ((g - low) << 1) | low;
+    }
+    return g;
+}
+
+// Applies the block to DENSE_LANES consecutive groups starting at base. Every loop over
+// lanes has a constant trip count, so the compiler keeps each lane set in one vector
+// register and the matrix-vector product runs on whole registers of the split arrays.
+// k is a literal at every call site, which lets the loops over the block unroll too.
+static inline __attribute__((always_inline)) void dense_block_lanes(const DenseBlockJob* job, size_t base, int k) {
+    int size = 1 << k;
+    double in_re[1 << MAX_BLOCK_QUBITS][DENSE_LANES], in_im[1 << MAX_BLOCK_QUBITS][DENSE_LANES];
+
+    for (int c = 0; c < size; c++) {
+        for (int l = 0; l < DENSE_LANES; l++) {
+            in_re[c][l] = job->real[base + job->offsets[c] + l];
+            in_im[c][l] = job->imag[base + job->offsets[c] + l];
+        }
+    }
+    for (int r = 0; r < size; r++) {
+        const Complex* row = job->matrix + (size_t)r * size;
+        double acc_re[DENSE_LANES] = {0.0}, acc_im[DENSE_LANES] = {0.0};
+        for (int c = 0; c < size; c++) {
+            for (int l = 0; l < DENSE_LANES; l++) {
+                acc_re[l] += row[c].real * in_re[c][l] - row[c].imag * in_im[c][l];
+                acc_im[l] += row[c].real * in_im[c][l] + row[c].imag * in_re[c][l];
+            }
+        }
+        for (int l = 0; l < DENSE_LANES; l++) {
+            job->real[base + job->offsets[r] + l] = acc_re[l];
+            job->imag[base + job->offsets[r] + l] = acc_im[l];
+        }
+    }
+}
+
+// The same product for DENSE_LANES groups whose amplitudes are not contiguous (a block
+// qubit below log2(DENSE_LANES)): the loads gather from each lane's base, but the
+// arithmetic still runs on whole registers
+static inline __attribute__((always_inline)) void dense_block_gathered_lanes(const DenseBlockJob* job,
+                                                                            const size_t* bases, int k) {
+    int size = 1 << k;
+    double in_re[1 << MAX_BLOCK_QUBITS][DENSE_LANES], in_im[1 << MAX_BLOCK_QUBITS][DENSE_LANES];
+
+    for (int c = 0; c < size; c++) {
+        for (int l = 0; l < DENSE_LANES; l++) {
+            in_re[c][l] = job->real[bases[l] + job->offsets[c]];
+            in_im[c][l] = job->imag[bases[l] + job->offsets[c]];
+        }
+    }
+    for (int r = 0; r < size; r++) {
+        const Complex* row = job->matrix + (size_t)r * size;
+        double acc_re[DENSE_LANES] = {0.0}, acc_im[DENSE_LANES] = {0.0};
+        for (int c = 0; c < size; c++) {
+            for (int l = 0; l < DENSE_LANES; l++) {
+                acc_re[l] += row[c].real * in_re[c][l] - row[c].imag * in_im[c][l];
+                acc_im[l] += row[c].real * in_im[c][l] + row[c].imag * in_re[c][l];
+            }
+        }
+        for (int l = 0; l < DENSE_LANES; l++) {
+            job->real[bases[l] + job->offsets[r]] = acc_re[l];
+            job->imag[bases[l] + job->offsets[r]] = acc_im[l];
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void dense_block_single(const DenseBlockJob* job, size_t base) {
+    int size = 1 << job->k;
+    double in_re[1 << MAX_BLOCK_QUBITS], in_im[1 << MAX_BLOCK_QUBITS];
+    for (int c = 0; c < size; c++) {
+        in_re[c] = job->real[base + job->offsets[c]];
+        in_im[c] = job->imag[base + job->offsets[c]];
+    }
+    for (int r = 0; r < size; r++) {
+        const Complex* row = job->matrix + (size_t)r * size;
+        double acc_re = 0.0, acc_im = 0.0;
+        for (int c = 0; c < size; c++) {
+            acc_re += row[c].real * in_re[c] - row[c].imag * in_im[c];
+            acc_im += row[c].real * in_im[c] + row[c].imag * in_re[c];
+        }
+        job->real[base + job->offsets[r]] = acc_re;
+        job->imag[base + job->offsets[r]] = acc_im;
+    }
+}
+
+// One copy of the lane loops per k, so that the block loops unroll for each block size
+#define DENSE_BLOCK_FOR_K(k, call) \
+    switch (k) {                   \
+        case 1: call(1); break;    \
+        case 2: call(2); break;    \
+        case 3: call(3); break;    \
+        case 4: call(4); break;    \
+        default: call(5); break;   \
+    }
+
+static inline __attribute__((always_inline)) void dense_block_gathered(const DenseBlockJob* job, size_t begin,
+                                                                          size_t end) {
+    size_t g = begin;
+    for (; g + DENSE_LANES <= end; g += DENSE_LANES) {
+        size_t bases[DENSE_LANES];
+        for (int l = 0; l < DENSE_LANES; l++) bases[l] = group_base_index(g + l, job->sorted_qubits, job->k);
+#define GATHERED(k) dense_block_gathered_lanes(job, bases, k)
+        DENSE_BLOCK_FOR_K(job->k, GATHERED)
+#undef GATHERED
+    }
+    for (; g < end; g++) {
+        dense_block_single(job, group_base_index(g, job->sorted_qubits, job->k));
+    }
+}
+
+// Chunks and runs are both multiples of DENSE_LANES, so lane sets never straddle a run
+static inline __attribute__((always_inline)) void dense_block_contiguous(const DenseBlockJob* job, size_t begin,
+                                                                            size_t end) {
+    for (size_t g = begin; g < end; g += DENSE_LANES) {
+        size_t base = group_base_index(g, job->sorted_qubits, job->k);
+#define CONTIGUOUS(k) dense_block_lanes(job, base, k)
+        DENSE_BLOCK_FOR_K(job->k, CONTIGUOUS)
+#undef CONTIGUOUS
+    }
+}
+
+// Contiguous and gathered groups get separate tasks, so that each is compiled on its own
+#define DEFINE_DENSE_TASKS(name, body)                                             \
+    static void name(size_t begin, size_t end, int worker, void* context) {        \
+        (void)worker;                                                              \
+        body(context, begin, end);                                                 \
+    }
+
+DEFINE_DENSE_TASKS(dense_contiguous_task, dense_block_contiguous)
+DEFINE_DENSE_TASKS(dense_gathered_task, dense_block_gathered)
+
+// The same loops compiled for wider registers; dispatch follows get_simd_level()
+#ifdef QSIM_HAVE_X86_SIMD
+__attribute__((target("avx2"))) DEFINE_DENSE_TASKS(dense_contiguous_task_avx2, dense_block_contiguous)
+__attribute__((target("avx2"))) DEFINE_DENSE_TASKS(dense_gathered_task_avx2, dense_block_gathered)
+__attribute__((target("avx512f"))) DEFINE_DENSE_TASKS(dense_contiguous_task_avx512, dense_block_contiguous)
+__attribute__((target("avx512f"))) DEFINE_DENSE_TASKS(dense_gathered_task_avx512, dense_block_gathered)
+#endif
+
+static ParallelTask select_dense_task(bool contiguous) {
+#ifdef QSIM_HAVE_X86_SIMD
+    switch (get_simd_level()) {
+        case SIMD_AVX512: return contiguous ? dense_contiguous_task_avx512 : dense_gathered_task_avx512;
+        case SIMD_AVX2:   return contiguous ? dense_contiguous_task_avx2 : dense_gathered_task_avx2;
+        default: break;
+    }
+#endif
+    return contiguous ? dense_contiguous_task : dense_gathered_task;
+}
+
+bool kernel_dense_block(Statevector* sv, const Complex* matrix, const int* qubits, int k) {
+    if (!sv || !matrix || k < 1 || k > MAX_BLOCK_QUBITS || k > sv->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for dense block\n");
+        return false;
+    }
+
+    DenseBlockJob job = {.real = sv->real, .imag = sv->imag, .matrix = matrix, .k = k};
+    for (int b = 0; b < k; b++) {
+        if (qubits[b] < 0 || qubits[b] >= sv->num_qubits) {
+            fprintf(stderr, "Error: Invalid qubit indices\n");
+            return false;
+        }
+        // Insertion sort keeps the sorted copy used for group enumeration
+        int i = b;
+        while (i > 0 && job.sorted_qubits[i - 1] > qubits[b]) {
+            job.sorted_qubits[i] = job.sorted_qubits[i - 1];
+            i--;
+        }
+        if (i > 0 && job.sorted_qubits[i - 1] == qubits[b]) {
+            fprintf(stderr, "Error: Block qubits must be distinct\n");
+            return false;
+        }
+        job.sorted_qubits[i] = qubits[b];
+    }
+    for (int r = 0; r < (1 << k); r++) {
+        job.offsets[r] = 0;
+        for (int b = 0; b < k; b++) {
+            if (r & (1 << b)) job.offsets[r] |= (size_t)1 << qubits[b];
+        }
+    }
+
+    job.run_length = (size_t)1 << job.sorted_qubits[0];
+
+    INSTRUMENT_BEGIN(span);
+    ParallelTask task = select_dense_task(job.run_length >= DENSE_LANES);
+    parallel_for(sv->dimension >> k, task, &job);
+    // A group of 2^k amplitudes counts as 2^(k-1) pairs
+    INSTRUMENT_END(span, "kernel", "dense-block", job.sorted_qubits[0], -1, sv->dimension / 2,
+                   2 * sv->dimension * BYTES_PER_AMPLITUDE);
+    return true;
+}
@@ -0,0 +1,15 @@
+// multi_qubit_kernels.h
+#ifndef MULTI_QUBIT_KERNELS_H
+#define MULTI_QUBIT_KERNELS_H
+
+#include <stdbool.h>
+#include "statevector_core.h"
+
+#define MAX_BLOCK_QUBITS 5
+
+// Applies a dense 2^k x 2^k matrix (row-major) to the qubits qubits[0..k-1]. Bit b of a
+// row or column index corresponds to qubits[b]. Each group of 2^k amplitudes is
+// gathered, multiplied and scattered back in a single pass over the state.
+bool kernel_dense_block(Statevector* sv, const Complex* matrix, const int* qubits, int k);
+
+#endif // MULTI_QUBIT_KERNELS_H
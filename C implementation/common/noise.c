@@ -0,0 +1,461 @@
+// noise.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "noise.h"
+#include "thread_pool.h"
+#include "diagonal_sweep.h"
+
+// Damping without a decision leaves the state unnormalized, its squared norm shrinking by
+// up to 1 - gamma each time. It is rescaled before the bound on it drops below this.
+#define NORM_RESCALE_BOUND 1e-100
+
+// The circuit flattened into ops and the channels after them
+typedef enum {
+    NOISE_OP,
+    NOISE_DEPOLARIZE,
+    NOISE_DAMP
+} NoiseStepKind;
+
+typedef struct {
+    NoiseStepKind kind;
+    int op;              // NOISE_OP: index into circuit->ops
+    int qubit;           // channels
+    double probability;  // channels: p or gamma
+} NoiseStep;
+
+static bool valid_noise_model(const NoiseModel* noise) {
+    double rates[] = {noise->depolarizing, noise->depolarizing_2q, noise->amplitude_damping, noise->readout_error};
+    for (int i = 0; i < 4; i++) {
+        if (!(rates[i] >= 0.0 && rates[i] <= 1.0)) return false;
+    }
+    return true;
+}
+
+static NoiseStep* build_noise_steps(const Circuit* circuit, const NoiseModel* noise, int* num_steps) {
+    NoiseStep* steps = malloc((size_t)(circuit->num_ops > 0 ? circuit->num_ops : 1) * 5 * sizeof(NoiseStep));
+    if (!steps) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    int count = 0;
+    for (int i = 0; i < circuit->num_ops; i++) {
+        const CircuitOp* op = &circuit->ops[i];
+        steps[count++] = (NoiseStep){NOISE_OP, i, op->target, 0.0};
+        int qubits[2] = {op->target, op->control};
+        int num_qubits = op->control == NO_CONTROL ? 1 : 2;
+        double p = num_qubits == 1 ? noise->depolarizing : noise->depolarizing_2q;
+        for (int k = 0; k < num_qubits; k++) {
+            if (p > 0.0) steps[count++] = (NoiseStep){NOISE_DEPOLARIZE, i, qubits[k], p};
+            if (noise->amplitude_damping > 0.0) {
+                steps[count++] = (NoiseStep){NOISE_DAMP, i, qubits[k], noise->amplitude_damping};
+            }
+        }
+    }
+    *num_steps = count;
+    return steps;
+}
+
+// Trajectory states
+
+// Damping without a decay multiplies the |1⟩ amplitudes of its qubit by sqrt(1 - gamma).
+// These factors are kept per qubit and only applied when something that does not commute
+// with them comes along: folded into the next single-qubit gate on the qubit, or applied
+// together in one diagonal sweep before the state is read. The state is left unnormalized
+// until a damping decision needs its norm.
+typedef struct {
+    Statevector* sv;
+    double* pending;    // per qubit, factor of the |1⟩ amplitudes not yet applied
+    double norm_bound;  // lower bound on the squared norm since it was last known
+} TrajectoryState;
+
+static void flush_qubit(TrajectoryState* state, int qubit) {
+    if (state->pending[qubit] == 1.0) return;
+    Complex one = {1.0, 0.0}, factor = {state->pending[qubit], 0.0};
+    kernel_diagonal_pairs(state->sv, one, factor, qubit);
+    state->pending[qubit] = 1.0;
+}
+
+static bool flush_all(TrajectoryState* state) {
+    DiagonalSweep* sweep = create_diagonal_sweep();
+    if (!sweep) return false;
+    for (int q = 0; q < state->sv->num_qubits; q++) {
+        if (state->pending[q] == 1.0) continue;
+        QuantumGate damping = {{{{1.0, 0.0}, {0.0, 0.0}}, {{0.0, 0.0}, {state->pending[q], 0.0}}}};
+        if (!diagonal_sweep_add(sweep, &damping, q, NO_CONTROL)) {
+            // Tables full: apply what is there and start a new sweep
+            kernel_diagonal_sweep(state->sv, sweep, sweep->qubits, 0);
+            free_diagonal_sweep(sweep);
+            sweep = create_diagonal_sweep();
+            if (!sweep || !diagonal_sweep_add(sweep, &damping, q, NO_CONTROL)) {
+                free_diagonal_sweep(sweep);
+                return false;
+            }
+        }
+        state->pending[q] = 1.0;
+    }
+    if (sweep->num_gates > 0) kernel_diagonal_sweep(state->sv, sweep, sweep->qubits, 0);
+    free_diagonal_sweep(sweep);
+    return true;
+}
+
+static void rescale_state(TrajectoryState* state, double squared_norm) {
+    Complex scale = {1.0 / sqrt(squared_norm), 0.0};
+    kernel_diagonal_pairs(state->sv, scale, scale, 0);
+    state->norm_bound = 1.0;
+}
+
+// Squared norm of the whole state and of its part with qubit = 1, summed in blocks of
+// 2^SAMPLE_BLOCK_QUBITS amplitudes so the result does not depend on the thread count
+typedef struct {
+    const Statevector* sv;
+    int qubit;
+    size_t block_size;
+    double* excited;
+    double* total;
+} PopulationJob;
+
+static void population_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const PopulationJob* job = context;
+    size_t bit = (size_t)1 << job->qubit;
+    for (size_t b = begin; b < end; b++) {
+        const double* re = job->sv->real + b * job->block_size;
+        const double* im = job->sv->imag + b * job->block_size;
+        size_t first = b * job->block_size;
+        double excited = 0.0, total = 0.0;
+        for (size_t i = 0; i < job->block_size; i++) {
+            double p = re[i] * re[i] + im[i] * im[i];
+            total += p;
+            if ((first + i) & bit) excited += p;
+        }
+        job->excited[b] = excited;
+        job->total[b] = total;
+    }
+}
+
+static bool qubit_population(const Statevector* sv, int qubit, double* excited, double* total) {
+    size_t block_size = sv->dimension < ((size_t)1 << SAMPLE_BLOCK_QUBITS) ? sv->dimension
+                                                                         : (size_t)1 << SAMPLE_BLOCK_QUBITS;
+    size_t blocks = sv->dimension / block_size;
+    double* sums = malloc(2 * blocks * sizeof(double));
+    if (!sums) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    PopulationJob job = {sv, qubit, block_size, sums, sums + blocks};
+    parallel_for_items(blocks, population_task, &job);
+    *excited = 0.0;
+    *total = 0.0;
+    for (size_t b = 0; b < blocks; b++) {
+        *excited += job.excited[b];
+        *total += job.total[b];
+    }
+    free(sums);
+    return true;
+}
+
+// Applies an op, taking care of the pending damping on its qubits. Diagonal gates and
+// controls commute with it; a single-qubit gate absorbs it into its matrix.
+static bool apply_noisy_op(TrajectoryState* state, const CircuitOp* op, const double* params) {
+    double factor = state->pending[op->target];
+    if (factor == 1.0) return apply_circuit_op(state->sv, op, params);
+    QuantumGate gate = circuit_op_gate(op, params);
+    if (is_diagonal_gate(&gate)) return apply_circuit_op(state->sv, op, params);
+    if (op->control != NO_CONTROL) {
+        flush_qubit(state, op->target);
+        return apply_circuit_op(state->sv, op, params);
+    }
+    QuantumGate damping = {{{{1.0, 0.0}, {0.0, 0.0}}, {{0.0, 0.0}, {factor, 0.0}}}};
+    QuantumGate folded = multiply_gates(gate, damping);
+    kernel_matrix_pairs(state->sv, &folded, op->target);
+    state->pending[op->target] = 1.0;
+    return true;
+}
+
+// A step whose channel drew no error: nothing for a Pauli channel, the no-decay Kraus
+// operator diag(1, sqrt(1 - gamma)) for damping
+static bool apply_quiet_step(TrajectoryState* state, const NoiseStep* step, const Circuit* circuit,
+                             const double* params) {
+    switch (step->kind) {
+        case NOISE_OP:
+            return apply_noisy_op(state, &circuit->ops[step->op], params);
+        case NOISE_DEPOLARIZE:
+            return true;
+        case NOISE_DAMP:
+            state->pending[step->qubit] *= sqrt(1.0 - step->probability);
+            state->norm_bound *= 1.0 - step->probability;
+            if (state->norm_bound < NORM_RESCALE_BOUND) {
+                if (!flush_all(state)) return false;
+                double norm = statevector_norm(state->sv);
+                rescale_state(state, norm * norm);
+            }
+            return true;
+    }
+    return false;
+}
+
+static bool advance_state(TrajectoryState* state, const NoiseStep* steps, int from, int to, const Circuit* circuit,
+                          const double* params) {
+    for (int s = from; s < to; s++) {
+        if (!apply_quiet_step(state, &steps[s], circuit, params)) return false;
+    }
+    return true;
+}
+
+// A channel whose uniform fell below its probability. The same uniform picks the Pauli,
+// or decides against the actual decay probability gamma * P(1).
+static bool apply_event(TrajectoryState* state, const NoiseStep* step, double uniform) {
+    if (step->kind == NOISE_DEPOLARIZE) {
+        double third = step->probability / 3.0;
+        if (uniform < third) {
+            flush_qubit(state, step->qubit);
+            kernel_swap_pairs(state->sv, step->qubit);
+        } else if (uniform < 2.0 * third) {
+            QuantumGate y = get_y_gate();
+            flush_qubit(state, step->qubit);
+            kernel_matrix_pairs(state->sv, &y, step->qubit);
+        } else {
+            Complex minus_one = {-1.0, 0.0};
+            kernel_phase_pairs(state->sv, minus_one, step->qubit);
+        }
+        return true;
+    }
+
+    double excited, total;
+    if (!flush_all(state) || !qubit_population(state->sv, step->qubit, &excited, &total)) return false;
+    double gamma = step->probability;
+    if (uniform * total < gamma * excited) {
+        // Decay, K1 = sqrt(gamma) |0⟩⟨1|, normalized
+        QuantumGate decay = {{{{0.0, 0.0}, {1.0 / sqrt(excited), 0.0}}, {{0.0, 0.0}, {0.0, 0.0}}}};
+        kernel_matrix_pairs(state->sv, &decay, step->qubit);
+    } else {
+        double scale = 1.0 / sqrt(total - gamma * excited);
+        Complex d0 = {scale, 0.0}, d1 = {sqrt(1.0 - gamma) * scale, 0.0};
+        kernel_diagonal_pairs(state->sv, d0, d1, step->qubit);
+    }
+    state->norm_bound = 1.0;
+    return true;
+}
+
+// Draws a uniform for every channel from step from on and returns the first one that
+// falls below its probability, or num_steps
+static int next_event(const NoiseStep* steps, int num_steps, int from, Rng* rng, double* uniform) {
+    for (int s = from; s < num_steps; s++) {
+        if (steps[s].kind == NOISE_OP) continue;
+        *uniform = rng_uniform(rng);
+        if (*uniform < steps[s].probability) return s;
+    }
+    return num_steps;
+}
+
+// Trajectories
+
+typedef struct {
+    uint64_t index;
+    int first_event;
+    double uniform;      // the draw that triggered it
+    Rng rng;             // channel draws, positioned after that one
+    uint64_t shot_seed;  // a separate stream for sampling and readout errors
+} TrajectoryStart;
+
+static int compare_starts(const void* a, const void* b) {
+    const TrajectoryStart* x = a;
+    const TrajectoryStart* y = b;
+    if (x->first_event != y->first_event) return x->first_event < y->first_event ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+typedef struct {
+    TrajectoryState prefix;  // the error-free evolution, position steps in
+    TrajectoryState work;
+    int position;
+    TrajectoryStats stats;
+    bool failed;
+} NoiseWorker;
+
+typedef struct {
+    const Circuit* circuit;
+    const double* params;
+    const NoiseModel* noise;
+    const NoiseStep* steps;
+    int num_steps;
+    uint64_t shots;
+    const TrajectoryStart* starts;  // in order of first event
+    uint64_t* outcomes;             // shots per trajectory, by trajectory index
+    NoiseWorker* workers;
+} TrajectoryJob;
+
+static bool create_trajectory_state(TrajectoryState* state, int num_qubits) {
+    state->sv = create_statevector(num_qubits);
+    state->pending = malloc((size_t)(num_qubits > 0 ? num_qubits : 1) * sizeof(double));
+    if (!state->sv || !state->pending) {
+        if (state->sv) fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    for (int q = 0; q < num_qubits; q++) state->pending[q] = 1.0;
+    state->norm_bound = 1.0;
+    return true;
+}
+
+static void free_trajectory_state(TrajectoryState* state) {
+    free_statevector(state->sv);
+    free(state->pending);
+}
+
+static void copy_trajectory_state(TrajectoryState* dst, const TrajectoryState* src) {
+    copy_statevector(dst->sv, src->sv);
+    memcpy(dst->pending, src->pending, (size_t)src->sv->num_qubits * sizeof(double));
+    dst->norm_bound = src->norm_bound;
+}
+
+static bool prepare_worker(NoiseWorker* worker, int num_qubits) {
+    worker->position = 0;
+    return create_trajectory_state(&worker->prefix, num_qubits) && create_trajectory_state(&worker->work, num_qubits);
+}
+
+// Runs one trajectory from its first event to the end of the circuit
+static bool run_trajectory(const TrajectoryJob* job, NoiseWorker* worker, const TrajectoryStart* start) {
+    TrajectoryState* state = &worker->work;
+    Rng rng = start->rng;
+    double uniform = start->uniform;
+    for (int s = start->first_event; s < job->num_steps;) {
+        if (!apply_event(state, &job->steps[s], uniform)) return false;
+        int next = next_event(job->steps, job->num_steps, s + 1, &rng, &uniform);
+        if (!advance_state(state, job->steps, s + 1, next, job->circuit, job->params)) return false;
+        worker->stats.noise_events++;
+        worker->stats.trajectory_steps += (uint64_t)(next - s);
+        s = next;
+    }
+    return true;
+}
+
+// Samples the final state of a trajectory and flips each measured bit with the readout
+// error rate
+static bool record_shots(const Statevector* sv, const TrajectoryJob* job, const TrajectoryStart* start) {
+    Rng rng;
+    rng_seed(&rng, start->shot_seed);
+    ShotHistogram histogram;
+    if (!sample_shots(sv, job->shots, &rng, &histogram)) return false;
+    uint64_t* outcomes = job->outcomes + start->index * job->shots;
+    double readout = job->noise->readout_error;
+    uint64_t s = 0;
+    for (size_t k = 0; k < histogram.num_outcomes; k++) {
+        for (uint64_t c = 0; c < histogram.counts[k]; c++, s++) {
+            uint64_t outcome = histogram.outcomes[k];
+            if (readout > 0.0) {
+                for (int q = 0; q < sv->num_qubits; q++) {
+                    if (rng_uniform(&rng) < readout) outcome ^= (uint64_t)1 << q;
+                }
+            }
+            outcomes[s] = outcome;
+        }
+    }
+    free_shot_histogram(&histogram);
+    return true;
+}
+
+// Trajectories [begin, end) of the sorted starts on one worker. Their first events only
+// move forward, and so does the worker's prefix state.
+static void trajectory_task(size_t begin, size_t end, int worker_index, void* context) {
+    const TrajectoryJob* job = context;
+    NoiseWorker* worker = &job->workers[worker_index];
+    if (!prepare_worker(worker, job->circuit->num_qubits)) {
+        worker->failed = true;
+        return;
+    }
+    for (size_t t = begin; t < end; t++) {
+        const TrajectoryStart* start = &job->starts[t];
+        if (!advance_state(&worker->prefix, job->steps, worker->position, start->first_event, job->circuit,
+                           job->params)) {
+            worker->failed = true;
+            return;
+        }
+        worker->stats.shared_steps += (uint64_t)(start->first_event - worker->position);
+        worker->position = start->first_event;
+
+        TrajectoryState* final_state = &worker->prefix;
+        if (start->first_event < job->num_steps) {
+            copy_trajectory_state(&worker->work, &worker->prefix);
+            if (!run_trajectory(job, worker, start)) {
+                worker->failed = true;
+                return;
+            }
+            final_state = &worker->work;
+        }
+        if (!flush_all(final_state) || !record_shots(final_state->sv, job, start)) {
+            worker->failed = true;
+            return;
+        }
+    }
+}
+
+bool run_noisy_trajectories(const Circuit* circuit, const double* params, const NoiseModel* noise,
+                            uint64_t num_trajectories, uint64_t shots_per_trajectory, Rng* rng,
+                            ShotHistogram* histogram, TrajectoryStats* stats) {
+    if (!circuit || !noise || !rng || !histogram || num_trajectories == 0 || shots_per_trajectory == 0 ||
+        (circuit->num_params > 0 && !params) || circuit->num_qubits > 62) {
+        fprintf(stderr, "Error: Invalid parameters for noisy simulation\n");
+        return false;
+    }
+    if (!valid_noise_model(noise)) {
+        fprintf(stderr, "Error: Invalid noise model\n");
+        return false;
+    }
+    int num_steps;
+    NoiseStep* steps = build_noise_steps(circuit, noise, &num_steps);
+    TrajectoryStart* starts = malloc(num_trajectories * sizeof(TrajectoryStart));
+    int num_workers = num_trajectories >= (uint64_t)thread_pool_get_num_threads() ? thread_pool_get_num_threads() : 1;
+    NoiseWorker* workers = calloc((size_t)num_workers, sizeof(NoiseWorker));
+    uint64_t num_shots = num_trajectories * shots_per_trajectory;
+    histogram->outcomes = malloc(num_shots * sizeof(uint64_t));
+    histogram->counts = malloc(num_shots * sizeof(uint64_t));
+    if (!steps || !starts || !workers || !histogram->outcomes || !histogram->counts) {
+        if (steps) fprintf(stderr, "Error: Memory allocation failed\n");
+        free(steps);
+        free(starts);
+        free(workers);
+        free_shot_histogram(histogram);
+        return false;
+    }
+
+    // Every trajectory draws up to its first event before any state is touched
+    uint64_t seed = rng_next(rng);
+    for (uint64_t t = 0; t < num_trajectories; t++) {
+        starts[t].index = t;
+        rng_seed(&starts[t].rng, seed + 2 * t);
+        starts[t].shot_seed = seed + 2 * t + 1;
+        starts[t].uniform = 0.0;
+        starts[t].first_event = next_event(steps, num_steps, 0, &starts[t].rng, &starts[t].uniform);
+    }
+    qsort(starts, num_trajectories, sizeof(TrajectoryStart), compare_starts);
+
+    TrajectoryJob job = {circuit, params, noise, steps, num_steps, shots_per_trajectory, starts,
+                         histogram->outcomes, workers};
+    if (num_workers > 1) parallel_for_items(num_trajectories, trajectory_task, &job);
+    else trajectory_task(0, num_trajectories, 0, &job);
+
+    bool ok = true;
+    if (stats) *stats = (TrajectoryStats){(uint64_t)num_steps, 0, 0, 0};
+    for (int w = 0; w < num_workers; w++) {
+        ok = ok && !workers[w].failed;
+        if (stats) {
+            stats->noise_events += workers[w].stats.noise_events;
+            stats->shared_steps += workers[w].stats.shared_steps;
+            stats->trajectory_steps += workers[w].stats.trajectory_steps;
+        }
+        free_trajectory_state(&workers[w].prefix);
+        free_trajectory_state(&workers[w].work);
+    }
+    if (ok) {
+        tally_shot_histogram(histogram, circuit->num_qubits, num_shots);
+    } else {
+        fprintf(stderr, "Error: Noisy trajectory run failed\n");
+        free_shot_histogram(histogram);
+    }
+    free(steps);
+    free(starts);
+    free(workers);
+    return ok;
+}
@@ -0,0 +1,46 @@
+// noise.h
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "circuit.h"
+#include "measurement.h"
+
+// Error rates of a simple device model. Channels act after every op on each qubit it
+// touches, depolarizing first, then amplitude damping.
+typedef struct {
+    double depolarizing;       // single-qubit ops: X, Y or Z with probability p / 3 each
+    double depolarizing_2q;    // two-qubit ops: the same, independently on both qubits
+    double amplitude_damping;  // gamma: |1⟩ decays to |0⟩ with probability gamma
+    double readout_error;      // every measured bit flips with this probability
+} NoiseModel;
+
+// Where the work of run_noisy_trajectories() went, in circuit ops and channels applied
+typedef struct {
+    uint64_t steps_per_trajectory;  // ops and channels of one run through the circuit
+    uint64_t noise_events;          // Pauli errors and damping decisions that needed the state
+    uint64_t shared_steps;          // applied to the error-free prefix states
+    uint64_t trajectory_steps;      // applied to single trajectories after their first event
+} TrajectoryStats;
+
+// Samples the noisy circuit as num_trajectories quantum trajectories, each a pure state on
+// which every channel applies one Kraus operator drawn at random, and measures each
+// trajectory shots_per_trajectory times. The histogram approximates the noisy device's
+// outcome distribution without a 4^n density matrix.
+//
+// Where no error is drawn, a Pauli channel costs nothing and damping only records its fixed
+// no-decay factor, which is folded into the next gate on the qubit; the decay probability,
+// a pass over the state, is only computed when the drawn uniform falls below gamma, and the
+// state stays unnormalized until then. Until its first error a trajectory
+// follows the same evolution as every other, so trajectories are run in order of their
+// first error, continuing from a copy of a shared error-free state that only moves forward.
+// Trajectory t draws from its own generator seeded from rng and t, so the histogram does
+// not depend on the thread count. With at least as many trajectories as threads, each
+// thread runs a contiguous share of them on two private states; otherwise they run one
+// after the other with every kernel split over the threads.
+bool run_noisy_trajectories(const Circuit* circuit, const double* params, const NoiseModel* noise,
+                            uint64_t num_trajectories, uint64_t shots_per_trajectory, Rng* rng,
+                            ShotHistogram* histogram, TrajectoryStats* stats);
+
+#endif // NOISE_H
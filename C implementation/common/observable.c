@@ -0,0 +1,391 @@
+// observable.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "observable.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+
+#define OBSERVABLE_BLOCK ((size_t)1 << OBSERVABLE_BLOCK_QUBITS)
+
+Observable* create_observable(int num_qubits) {
+    if (num_qubits < 1 || num_qubits > MAX_OBSERVABLE_QUBITS) {
+        fprintf(stderr, "Error: Observable qubit count must be between 1 and %d\n", MAX_OBSERVABLE_QUBITS);
+        return NULL;
+    }
+    Observable* observable = calloc(1, sizeof(Observable));
+    if (!observable) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    observable->num_qubits = num_qubits;
+    return observable;
+}
+
+void free_observable(Observable* observable) {
+    if (!observable) return;
+    free(observable->terms);
+    free(observable);
+}
+
+bool observable_add_term(Observable* observable, double coefficient, const char* paulis) {
+    if (!observable || !paulis) {
+        fprintf(stderr, "Error: Invalid parameters for observable term\n");
+        return false;
+    }
+    uint64_t x_mask = 0, z_mask = 0;
+    for (int q = 0; paulis[q]; q++) {
+        if (q >= observable->num_qubits) {
+            fprintf(stderr, "Error: Pauli string longer than %d qubits\n", observable->num_qubits);
+            return false;
+        }
+        uint64_t bit = (uint64_t)1 << q;
+        switch (paulis[q]) {
+            case 'I': break;
+            case 'X': x_mask |= bit; break;
+            case 'Y': x_mask |= bit; z_mask |= bit; break;
+            case 'Z': z_mask |= bit; break;
+            default:
+                fprintf(stderr, "Error: Invalid Pauli '%c'\n", paulis[q]);
+                return false;
+        }
+    }
+
+    for (int t = 0; t < observable->num_terms; t++) {
+        PauliTerm* term = &observable->terms[t];
+        if (term->x_mask == x_mask && term->z_mask == z_mask) {
+            term->coefficient += coefficient;
+            return true;
+        }
+    }
+    if (observable->num_terms == observable->capacity) {
+        int capacity = observable->capacity ? 2 * observable->capacity : 16;
+        PauliTerm* terms = realloc(observable->terms, (size_t)capacity * sizeof(PauliTerm));
+        if (!terms) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            return false;
+        }
+        observable->terms = terms;
+        observable->capacity = capacity;
+    }
+    observable->terms[observable->num_terms++] = (PauliTerm){x_mask, z_mask, coefficient};
+    return true;
+}
+
+// Grouping
+
+typedef struct {
+    uint64_t x_mask;
+    int term;
+} FlipKey;
+
+static int compare_flips(const void* a, const void* b) {
+    const FlipKey* x = a;
+    const FlipKey* y = b;
+    if (x->x_mask != y->x_mask) return x->x_mask < y->x_mask ? -1 : 1;
+    return x->term - y->term;
+}
+
+// Term indices ordered by x_mask, so that each group of equal masks is contiguous
+static int* group_terms(const Observable* observable) {
+    int* order = malloc((size_t)observable->num_terms * sizeof(int) + 1);
+    FlipKey* keys = malloc((size_t)observable->num_terms * sizeof(FlipKey) + 1);
+    if (!order || !keys) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(order);
+        free(keys);
+        return NULL;
+    }
+    for (int t = 0; t < observable->num_terms; t++) keys[t] = (FlipKey){observable->terms[t].x_mask, t};
+    qsort(keys, (size_t)observable->num_terms, sizeof(FlipKey), compare_flips);
+    for (int t = 0; t < observable->num_terms; t++) order[t] = keys[t].term;
+    free(keys);
+    return order;
+}
+
+int observable_num_passes(const Observable* observable) {
+    if (!observable || observable->num_terms == 0) return 0;
+    int* order = group_terms(observable);
+    if (!order) return -1;
+    int passes = 1;
+    for (int t = 1; t < observable->num_terms; t++) {
+        passes += observable->terms[order[t]].x_mask != observable->terms[order[t - 1]].x_mask;
+    }
+    free(order);
+    return passes;
+}
+
+// Evaluation
+
+// For x_mask != 0 each item g is a pair (i, j = i ^ x_mask), where i is g with a zero bit
+// inserted at the highest bit of x_mask. Term t gets 2 s_t(i) w_t(p), p = conj(ψ_j) ψ_i,
+// s_t(i) = (-1)^popcount(i & z_t), and w_t(p) the real part of i^popcount(x & z_t)
+// (p ± conj(p)) / 2: Re p, -Im p, -Re p or Im p. The contribution of j is folded in, so
+// every pair is read once. For x_mask == 0 each item is an amplitude i and term t gets
+// s_t(i) |ψ_i|^2.
+//
+// Since bit `high` of i is zero, s_t(i) = (-1)^popcount(g & z'_t) with z'_t the mask with
+// that bit removed. Over a block of items the sum of s_t times the values is then entry
+// z'_t of the block's Walsh-Hadamard transform, up to the sign the block's own bits give,
+// so a group with many terms transforms each block once and reads one entry per term.
+typedef struct {
+    const double* real;
+    const double* imag;
+    uint64_t x_mask;
+    int high;
+    size_t num_items;
+    size_t slice_items;
+    int group_size;
+    const uint64_t* z_items;  // z'_t of the group's terms
+    const int* phases;        // popcount(x & z_t) mod 4
+    bool transform_re;        // enough terms read the real (even phase) or imaginary parts
+    bool transform_im;        // to make transforming the block worthwhile
+    double* partials;         // slice s, term k of the group at s * group_size + k
+} GroupJob;
+
+// Transforming costs OBSERVABLE_BLOCK_QUBITS passes over a block, a direct sum one per term
+#define TRANSFORM_MIN_TERMS (OBSERVABLE_BLOCK_QUBITS / 2)
+
+// In-place, unnormalized: entry z becomes the sum of (-1)^popcount(b & z) value[b]
+static void walsh_hadamard(double* value, size_t n) {
+    for (size_t half = 1; half < n; half <<= 1) {
+        for (size_t start = 0; start < n; start += 2 * half) {
+            for (size_t b = start; b < start + half; b++) {
+                double u = value[b], v = value[b + half];
+                value[b] = u + v;
+                value[b + half] = u - v;
+            }
+        }
+    }
+}
+
+static void group_slice_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const GroupJob* job = context;
+    double value_re[OBSERVABLE_BLOCK], value_im[OBSERVABLE_BLOCK];
+    uint64_t low_mask = ((uint64_t)1 << job->high) - 1;
+    size_t n = job->num_items < OBSERVABLE_BLOCK ? job->num_items : OBSERVABLE_BLOCK;
+
+    for (size_t s = begin; s < end; s++) {
+        double* sums = job->partials + s * job->group_size;
+        for (int k = 0; k < job->group_size; k++) sums[k] = 0.0;
+        size_t first = s * job->slice_items;
+        size_t last = first + job->slice_items < job->num_items ? first + job->slice_items : job->num_items;
+
+        // Slices are whole blocks, so every block has n items
+        for (size_t start = first; start < last; start += n) {
+            if (job->x_mask == 0) {
+                for (size_t b = 0; b < n; b++) {
+                    size_t i = start + b;
+                    value_re[b] = job->real[i] * job->real[i] + job->imag[i] * job->imag[i];
+                }
+            } else {
+                for (size_t b = 0; b < n; b++) {
+                    uint64_t g = start + b;
+                    uint64_t i = ((g & ~low_mask) << 1) | (g & low_mask);
+                    uint64_t j = i ^ job->x_mask;
+                    value_re[b] = 2.0 * (job->real[j] * job->real[i] + job->imag[j] * job->imag[i]);
+                    value_im[b] = 2.0 * (job->real[j] * job->imag[i] - job->imag[j] * job->real[i]);
+                }
+            }
+            if (job->transform_re) walsh_hadamard(value_re, n);
+            if (job->transform_im) walsh_hadamard(value_im, n);
+
+            for (int k = 0; k < job->group_size; k++) {
+                bool odd = job->phases[k] & 1;
+                const double* value = odd ? value_im : value_re;
+                uint64_t z = job->z_items[k];
+                double sum;
+                if (odd ? job->transform_im : job->transform_re) {
+                    sum = value[z & (n - 1)];
+                    if (__builtin_parityll(start & z)) sum = -sum;
+                } else {
+                    sum = 0.0;
+                    for (size_t b = 0; b < n; b++) {
+                        sum += __builtin_parityll((start + b) & z) ? -value[b] : value[b];
+                    }
+                }
+                // i^phase: Re p for 0, -Im p for 1, -Re p for 2, Im p for 3
+                sums[k] += job->phases[k] == 0 || job->phases[k] == 3 ? sum : -sum;
+            }
+        }
+    }
+}
+
+bool pauli_expectations(const Statevector* sv, const Observable* observable, double* values) {
+    if (!sv || !observable || !values || observable->num_qubits > sv->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for expectation values\n");
+        return false;
+    }
+    if (observable->num_terms == 0) return true;
+    int num_terms = observable->num_terms;
+    int* order = group_terms(observable);
+    double* partials = malloc((size_t)OBSERVABLE_MAX_SLICES * num_terms * sizeof(double));
+    uint64_t* z_items = malloc((size_t)num_terms * sizeof(uint64_t));
+    int* phases = malloc((size_t)num_terms * sizeof(int));
+    if (!order || !partials || !z_items || !phases) {
+        if (order) fprintf(stderr, "Error: Memory allocation failed\n");
+        free(order);
+        free(partials);
+        free(z_items);
+        free(phases);
+        return false;
+    }
+
+    INSTRUMENT_BEGIN(span);
+    int num_passes = 0;
+    for (int first = 0; first < num_terms;) {
+        uint64_t x_mask = observable->terms[order[first]].x_mask;
+        int end = first + 1;
+        while (end < num_terms && observable->terms[order[end]].x_mask == x_mask) end++;
+
+        GroupJob job = {
+            .real = sv->real,
+            .imag = sv->imag,
+            .x_mask = x_mask,
+            .high = x_mask ? 63 - __builtin_clzll(x_mask) : 0,
+            .num_items = x_mask ? sv->dimension / 2 : sv->dimension,
+            .group_size = end - first,
+            .z_items = z_items,
+            .phases = phases,
+            .partials = partials,
+        };
+        int num_even = 0, num_odd = 0;
+        for (int k = 0; k < job.group_size; k++) {
+            const PauliTerm* term = &observable->terms[order[first + k]];
+            uint64_t z = term->z_mask;
+            if (x_mask) {
+                uint64_t low = ((uint64_t)1 << job.high) - 1;
+                z = (z & low) | ((z >> 1) & ~low);
+            }
+            z_items[k] = z;
+            phases[k] = __builtin_popcountll(x_mask & term->z_mask) & 3;
+            if (phases[k] & 1) num_odd++; else num_even++;
+        }
+        job.transform_re = num_even >= TRANSFORM_MIN_TERMS;
+        job.transform_im = num_odd >= TRANSFORM_MIN_TERMS;
+
+        // Slices are whole blocks, and their number depends on the state size only
+        size_t block = job.num_items < OBSERVABLE_BLOCK ? job.num_items : OBSERVABLE_BLOCK;
+        size_t num_blocks = job.num_items / block;
+        size_t num_slices = num_blocks < OBSERVABLE_MAX_SLICES ? num_blocks : OBSERVABLE_MAX_SLICES;
+        job.slice_items = (num_blocks + num_slices - 1) / num_slices * block;
+        num_slices = (job.num_items + job.slice_items - 1) / job.slice_items;
+        parallel_for_items(num_slices, group_slice_task, &job);
+
+        for (int k = 0; k < job.group_size; k++) {
+            double sum = 0.0;
+            for (size_t s = 0; s < num_slices; s++) sum += partials[s * job.group_size + k];
+            values[order[first + k]] = sum;
+        }
+        num_passes++;
+        first = end;
+    }
+    INSTRUMENT_END(span, "kernel", "expectation", -1, -1, (uint64_t)num_passes * sv->dimension / 2,
+                   (uint64_t)num_passes * sv->dimension * BYTES_PER_AMPLITUDE);
+
+    free(order);
+    free(partials);
+    free(z_items);
+    free(phases);
+    return true;
+}
+
+bool expectation_value(const Statevector* sv, const Observable* observable, double* value) {
+    if (!observable || !value) {
+        fprintf(stderr, "Error: Invalid parameters for expectation value\n");
+        return false;
+    }
+    double* values = malloc((size_t)observable->num_terms * sizeof(double) + 1);
+    if (!values) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    bool ok = pauli_expectations(sv, observable, values);
+    if (ok) {
+        double sum = 0.0;
+        for (int t = 0; t < observable->num_terms; t++) sum += observable->terms[t].coefficient * values[t];
+        *value = sum;
+    }
+    free(values);
+    return ok;
+}
+
+// Application
+
+// out_j += f(i) in_i for i = j ^ x_mask, where f(i) sums coefficient * i^popcount(x & z)
+// (-1)^popcount(i & z) over the group's terms
+typedef struct {
+    const double* in_re;
+    const double* in_im;
+    double* out_re;
+    double* out_im;
+    uint64_t x_mask;
+    int group_size;
+    const uint64_t* z_masks;
+    const Complex* weights;  // coefficient * i^popcount(x & z) of each term
+} ApplyJob;
+
+static void apply_group_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const ApplyJob* job = context;
+    for (size_t j = begin; j < end; j++) {
+        size_t i = j ^ job->x_mask;
+        double f_re = 0.0, f_im = 0.0;
+        for (int k = 0; k < job->group_size; k++) {
+            double sign = __builtin_parityll(i & job->z_masks[k]) ? -1.0 : 1.0;
+            f_re += sign * job->weights[k].real;
+            f_im += sign * job->weights[k].imag;
+        }
+        double a = job->in_re[i], b = job->in_im[i];
+        job->out_re[j] += f_re * a - f_im * b;
+        job->out_im[j] += f_re * b + f_im * a;
+    }
+}
+
+bool apply_observable(const Observable* observable, const Statevector* in, Statevector* out) {
+    if (!observable || !in || !out || in == out || in->dimension != out->dimension ||
+        observable->num_qubits > in->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for observable application\n");
+        return false;
+    }
+    memset(out->real, 0, out->dimension * sizeof(double));
+    memset(out->imag, 0, out->dimension * sizeof(double));
+    if (observable->num_terms == 0) return true;
+    int num_terms = observable->num_terms;
+    int* order = group_terms(observable);
+    uint64_t* z_masks = malloc((size_t)num_terms * sizeof(uint64_t));
+    Complex* weights = malloc((size_t)num_terms * sizeof(Complex));
+    if (!order || !z_masks || !weights) {
+        if (order) fprintf(stderr, "Error: Memory allocation failed\n");
+        free(order);
+        free(z_masks);
+        free(weights);
+        return false;
+    }
+
+    for (int first = 0; first < num_terms;) {
+        uint64_t x_mask = observable->terms[order[first]].x_mask;
+        int end = first + 1;
+        while (end < num_terms && observable->terms[order[end]].x_mask == x_mask) end++;
+        for (int k = 0; k < end - first; k++) {
+            const PauliTerm* term = &observable->terms[order[first + k]];
+            double c = term->coefficient;
+            z_masks[k] = term->z_mask;
+            switch (__builtin_popcountll(x_mask & term->z_mask) & 3) {
+                case 0:  weights[k] = (Complex){c, 0.0}; break;
+                case 1:  weights[k] = (Complex){0.0, c}; break;
+                case 2:  weights[k] = (Complex){-c, 0.0}; break;
+                default: weights[k] = (Complex){0.0, -c}; break;
+            }
+        }
+        ApplyJob job = {in->real, in->imag, out->real, out->imag, x_mask, end - first, z_masks, weights};
+        parallel_for(in->dimension, apply_group_task, &job);
+        first = end;
+    }
+
+    free(order);
+    free(z_masks);
+    free(weights);
+    return true;
+}
@@ -0,0 +1,61 @@
+// observable.h
+#ifndef OBSERVABLE_H
+#define OBSERVABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "statevector_core.h"
+
+// Qubits an observable may act on: a Pauli string is stored as two 64-bit masks
+#define MAX_OBSERVABLE_QUBITS 64
+
+// Amplitudes, or amplitude pairs, handled together by one pass: the terms of a group are
+// summed over a block while it is in L1
+#define OBSERVABLE_BLOCK_QUBITS 10
+
+// Partial sums per term are kept for at most this many slices of the state and added in
+// slice order, so results do not depend on the thread count
+#define OBSERVABLE_MAX_SLICES 64
+
+// coefficient * P with P a tensor product of Paulis. Bit q of x_mask is set where P has X
+// or Y on qubit q, bit q of z_mask where it has Z or Y, so P|i⟩ = i^popcount(x_mask &
+// z_mask) (-1)^popcount(i & z_mask) |i ^ x_mask⟩.
+typedef struct {
+    uint64_t x_mask;
+    uint64_t z_mask;
+    double coefficient;
+} PauliTerm;
+
+// A Hermitian observable as a real sum of Pauli strings, e.g. a qubit Hamiltonian
+typedef struct {
+    int num_qubits;
+    int num_terms;
+    int capacity;
+    PauliTerm* terms;
+} Observable;
+
+Observable* create_observable(int num_qubits);  // zero
+void free_observable(Observable* observable);
+
+// Adds coefficient * paulis, where character q of paulis ('I', 'X', 'Y' or 'Z') acts on
+// qubit q and qubits past the end of the string get I. A string already in the observable
+// has its coefficient increased instead.
+bool observable_add_term(Observable* observable, double coefficient, const char* paulis);
+
+// Passes over the state one evaluation makes: terms with the same x_mask, i.e. the same
+// bit flips, share a pass, so all diagonal (I and Z only) terms together cost one
+int observable_num_passes(const Observable* observable);
+
+// ⟨ψ|P|ψ⟩ of every term's Pauli string, without its coefficient, in term order. Read-only:
+// each pass pairs amplitude i with i ^ x_mask in place and needs no copy of the state.
+bool pauli_expectations(const Statevector* sv, const Observable* observable, double* values);
+
+// ⟨ψ|H|ψ⟩ = sum of coefficient * ⟨ψ|P|ψ⟩ over the terms
+bool expectation_value(const Statevector* sv, const Observable* observable, double* value);
+
+// out = H in, for adjoint methods that need H|ψ⟩ as a state. Every group of terms with the
+// same flips is one pass that reads in and adds to out; in and out must be different
+// states of the same size.
+bool apply_observable(const Observable* observable, const Statevector* in, Statevector* out);
+
+#endif // OBSERVABLE_H
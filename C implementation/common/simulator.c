@@ -0,0 +1,222 @@
+// simulator.c
+#include <stdio.h>
+#include <stdlib.h>
+#include "simulator.h"
+#include "stabilizer.h"
+#include "mps.h"
+#include "sparse_statevector.h"
+
+// Whether the circuit's nonzero amplitudes stay few enough for the sparse backend, with
+// room for the statevector's SPARSE_DENSE_DIVISOR when one would fit
+static bool stays_sparse(const Circuit* circuit, const double* params) {
+    if (circuit->num_qubits > SPARSE_MAX_QUBITS) return false;
+    int branching = circuit_branching_ops(circuit, params);
+    if (branching > SPARSE_MAX_BRANCHING_OPS) return false;
+    return circuit->num_qubits >= MPS_MIN_QUBITS ||
+           ((size_t)1 << branching) <= ((size_t)1 << circuit->num_qubits) / SPARSE_DENSE_DIVISOR;
+}
+
+SimulationBackend select_backend(const Circuit* circuit, const double* params) {
+    if (circuit_is_clifford(circuit, params)) return BACKEND_STABILIZER;
+    if (stays_sparse(circuit, params)) return BACKEND_SPARSE;
+    return circuit->num_qubits >= MPS_MIN_QUBITS ? BACKEND_MPS : BACKEND_STATEVECTOR;
+}
+
+const char* simulation_backend_name(SimulationBackend backend) {
+    switch (backend) {
+        case BACKEND_STABILIZER: return "stabilizer";
+        case BACKEND_MPS:        return "mps";
+        case BACKEND_SPARSE:     return "sparse";
+        default:                 return "statevector";
+    }
+}
+
+static bool valid_run(const Circuit* circuit, const double* params, Rng* rng) {
+    if (!circuit || !rng || (circuit->num_params > 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for circuit run\n");
+        return false;
+    }
+    return true;
+}
+
+static StabilizerState* run_stabilizer(const Circuit* circuit, const double* params) {
+    StabilizerState* state = create_stabilizer_state(circuit->num_qubits);
+    for (int i = 0; state && i < circuit->num_ops; i++) {
+        if (!apply_stabilizer_op(state, &circuit->ops[i], params)) {
+            free_stabilizer_state(state);
+            state = NULL;
+        }
+    }
+    return state;
+}
+
+static MpsState* run_mps(const Circuit* circuit, const double* params) {
+    MpsState* mps = create_mps(circuit->num_qubits, 0);
+    for (int i = 0; mps && i < circuit->num_ops; i++) {
+        if (!apply_mps_op(mps, &circuit->ops[i], params)) {
+            free_mps(mps);
+            mps = NULL;
+        }
+    }
+    return mps;
+}
+
+static Statevector* run_statevector(const Circuit* circuit, const double* params) {
+    Statevector* sv = create_statevector(circuit->num_qubits);
+    CircuitPlan plan;
+    if (!sv || !compile_circuit(circuit, 0, &plan)) {
+        free_statevector(sv);
+        return NULL;
+    }
+    bool ok = execute_plan(&plan, sv, params);
+    free_circuit_plan(&plan);
+    if (!ok) {
+        free_statevector(sv);
+        return NULL;
+    }
+    return sv;
+}
+
+bool run_circuit_shot(const Circuit* circuit, const double* params, Rng* rng, uint8_t* outcomes,
+                      SimulationBackend* backend) {
+    if (!valid_run(circuit, params, rng) || !outcomes) return false;
+    SimulationBackend selected = select_backend(circuit, params);
+    if (backend) *backend = selected;
+
+    if (selected == BACKEND_STABILIZER) {
+        StabilizerState* state = run_stabilizer(circuit, params);
+        bool ok = state && stabilizer_measure_all(state, rng, outcomes);
+        free_stabilizer_state(state);
+        return ok;
+    }
+    if (selected == BACKEND_MPS) {
+        MpsState* mps = run_mps(circuit, params);
+        bool ok = mps && mps_sample(mps, 1, rng, outcomes);
+        free_mps(mps);
+        return ok;
+    }
+    if (selected == BACKEND_SPARSE) {
+        HybridState state;
+        uint64_t outcome;
+        bool ok = run_hybrid_circuit(circuit, params, 0, &state);
+        if (ok && state.sparse) ok = sparse_sample(state.sparse, 1, rng, &outcome);
+        else if (ok) ok = measure_all(state.dense, rng, &outcome);
+        for (int q = 0; ok && q < circuit->num_qubits; q++) outcomes[q] = (uint8_t)((outcome >> q) & 1);
+        free_hybrid_state(&state);
+        return ok;
+    }
+    Statevector* sv = run_statevector(circuit, params);
+    uint64_t outcome;
+    bool ok = sv && measure_all(sv, rng, &outcome);
+    for (int q = 0; ok && q < circuit->num_qubits; q++) outcomes[q] = (uint8_t)((outcome >> q) & 1);
+    free_statevector(sv);
+    return ok;
+}
+
+static bool allocate_histogram(ShotHistogram* histogram, uint64_t num_shots) {
+    histogram->outcomes = malloc(num_shots * sizeof(uint64_t));
+    histogram->counts = malloc(num_shots * sizeof(uint64_t));
+    if (!histogram->outcomes || !histogram->counts) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_shot_histogram(histogram);
+        return false;
+    }
+    return true;
+}
+
+// Measures a fresh copy of the tableau once per shot and counts the outcomes
+static bool sample_stabilizer(const StabilizerState* state, uint64_t num_shots, Rng* rng, ShotHistogram* histogram) {
+    StabilizerState* copy = create_stabilizer_state(state->num_qubits);
+    uint8_t* bits = malloc((size_t)state->num_qubits);
+    if (!copy || !bits || !allocate_histogram(histogram, num_shots)) {
+        if (copy && !bits) fprintf(stderr, "Error: Memory allocation failed\n");
+        free_stabilizer_state(copy);
+        free(bits);
+        return false;
+    }
+
+    bool ok = true;
+    for (uint64_t s = 0; ok && s < num_shots; s++) {
+        ok = copy_stabilizer_state(copy, state) && stabilizer_measure_all(copy, rng, bits);
+        uint64_t outcome = 0;
+        for (int q = 0; q < state->num_qubits; q++) outcome |= (uint64_t)bits[q] << q;
+        histogram->outcomes[s] = outcome;
+    }
+    if (ok) tally_shot_histogram(histogram, state->num_qubits, num_shots);
+    else free_shot_histogram(histogram);
+    free_stabilizer_state(copy);
+    free(bits);
+    return ok;
+}
+
+// Draws the shots in batches so the per-qubit outcome bytes stay small
+static bool sample_mps(MpsState* mps, uint64_t num_shots, Rng* rng, ShotHistogram* histogram) {
+    const uint64_t batch = 4096;
+    uint8_t* bits = malloc(batch * (size_t)mps->num_qubits);
+    if (!bits || !allocate_histogram(histogram, num_shots)) {
+        if (!bits) fprintf(stderr, "Error: Memory allocation failed\n");
+        free(bits);
+        return false;
+    }
+
+    bool ok = true;
+    for (uint64_t first = 0; ok && first < num_shots; first += batch) {
+        uint64_t count = num_shots - first < batch ? num_shots - first : batch;
+        ok = mps_sample(mps, count, rng, bits);
+        for (uint64_t s = 0; ok && s < count; s++) {
+            uint64_t outcome = 0;
+            for (int q = 0; q < mps->num_qubits; q++) outcome |= (uint64_t)bits[s * mps->num_qubits + q] << q;
+            histogram->outcomes[first + s] = outcome;
+        }
+    }
+    if (ok) tally_shot_histogram(histogram, mps->num_qubits, num_shots);
+    else free_shot_histogram(histogram);
+    free(bits);
+    return ok;
+}
+
+static bool sample_sparse(const SparseStatevector* state, uint64_t num_shots, Rng* rng, ShotHistogram* histogram) {
+    if (!allocate_histogram(histogram, num_shots)) return false;
+    if (!sparse_sample(state, num_shots, rng, histogram->outcomes)) {
+        free_shot_histogram(histogram);
+        return false;
+    }
+    tally_shot_histogram(histogram, state->num_qubits, num_shots);
+    return true;
+}
+
+bool sample_circuit(const Circuit* circuit, const double* params, uint64_t num_shots, Rng* rng,
+                    ShotHistogram* histogram, SimulationBackend* backend) {
+    if (!valid_run(circuit, params, rng) || !histogram || num_shots == 0) return false;
+    if (circuit->num_qubits > 64) {
+        fprintf(stderr, "Error: Shot histograms hold at most 64 qubits\n");
+        return false;
+    }
+    SimulationBackend selected = select_backend(circuit, params);
+    if (backend) *backend = selected;
+
+    if (selected == BACKEND_STABILIZER) {
+        StabilizerState* state = run_stabilizer(circuit, params);
+        bool ok = state && sample_stabilizer(state, num_shots, rng, histogram);
+        free_stabilizer_state(state);
+        return ok;
+    }
+    if (selected == BACKEND_MPS) {
+        MpsState* mps = run_mps(circuit, params);
+        bool ok = mps && sample_mps(mps, num_shots, rng, histogram);
+        free_mps(mps);
+        return ok;
+    }
+    if (selected == BACKEND_SPARSE) {
+        HybridState state;
+        bool ok = run_hybrid_circuit(circuit, params, 0, &state);
+        if (ok && state.sparse) ok = sample_sparse(state.sparse, num_shots, rng, histogram);
+        else if (ok) ok = sample_shots(state.dense, num_shots, rng, histogram);
+        free_hybrid_state(&state);
+        return ok;
+    }
+    Statevector* sv = run_statevector(circuit, params);
+    bool ok = sv && sample_shots(sv, num_shots, rng, histogram);
+    free_statevector(sv);
+    return ok;
+}
@@ -0,0 +1,46 @@
+// simulator.h
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "circuit.h"
+#include "measurement.h"
+
+// Other circuits on at least this many qubits, whose statevector would take 32 GiB, run on
+// a matrix product state with the default bond cap. The result is then approximate when
+// the circuit entangles more than the cap holds.
+#define MPS_MIN_QUBITS 31
+
+// Circuits with at most this many branching ops (circuit_branching_ops()) hold at most
+// 2^SPARSE_MAX_BRANCHING_OPS nonzero amplitudes and run exactly on the sparse backend
+// when that is also below the density at which run_hybrid_circuit() turns dense
+#define SPARSE_MAX_BRANCHING_OPS 20
+
+// Runs whole circuits from |0...0⟩ on whichever backend suits them: Clifford-only circuits
+// on the stabilizer tableau, whose cost grows with n^2 instead of 2^n, circuits that stay
+// sparse (mostly permutations and phases) on the sparse statevector (sparse_statevector.h),
+// other wide circuits on a matrix product state (mps.h), everything else on a statevector
+typedef enum {
+    BACKEND_STATEVECTOR,
+    BACKEND_STABILIZER,
+    BACKEND_MPS,
+    BACKEND_SPARSE
+} SimulationBackend;
+
+SimulationBackend select_backend(const Circuit* circuit, const double* params);
+const char* simulation_backend_name(SimulationBackend backend);
+
+// Runs the circuit once and measures every qubit: outcomes[q] is the result of qubit q.
+// backend may be NULL; otherwise it receives the backend that ran.
+bool run_circuit_shot(const Circuit* circuit, const double* params, Rng* rng, uint8_t* outcomes,
+                      SimulationBackend* backend);
+
+// num_shots samples of all qubits of a circuit on at most 64 qubits. The circuit runs
+// once; the stabilizer backend then measures a copy of the tableau per shot, the MPS
+// backend samples with mps_sample(), the sparse backend with sparse_sample() and the
+// statevector backend with sample_shots().
+bool sample_circuit(const Circuit* circuit, const double* params, uint64_t num_shots, Rng* rng,
+                    ShotHistogram* histogram, SimulationBackend* backend);
+
+#endif // SIMULATOR_H
@@ -0,0 +1,412 @@
+// sparse_statevector.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sparse_statevector.h"
+#include "diagonal_sweep.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+
+#define SPARSE_MIN_CAPACITY_BITS 4
+
+static Complex complex_mul(Complex a, Complex b) {
+    Complex product = {a.real * b.real - a.imag * b.imag, a.real * b.imag + a.imag * b.real};
+    return product;
+}
+
+// a * x + b * y
+static Complex complex_combine(Complex a, Complex x, Complex b, Complex y) {
+    Complex ax = complex_mul(a, x), by = complex_mul(b, y);
+    Complex sum = {ax.real + by.real, ax.imag + by.imag};
+    return sum;
+}
+
+static bool is_zero_amplitude(Complex a) {
+    return a.real * a.real + a.imag * a.imag <= SPARSE_ZERO_TOLERANCE;
+}
+
+static bool is_anti_diagonal_gate(const QuantumGate* gate) {
+    return gate->elements[0][0].real == 0.0 && gate->elements[0][0].imag == 0.0 &&
+           gate->elements[1][1].real == 0.0 && gate->elements[1][1].imag == 0.0;
+}
+
+// Hash table
+
+// Fibonacci hashing: the top bits of the product spread keys that differ only in their
+// high qubits as well as those that differ in their low ones
+static size_t hash_key(uint64_t key, int bits) {
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+// Empties the table and sizes it for entries keys at a load of at most one half
+static bool reserve_table(SparseTable* table, size_t entries) {
+    int bits = SPARSE_MIN_CAPACITY_BITS;
+    while (((size_t)1 << bits) < 2 * entries) bits++;
+    size_t capacity = (size_t)1 << bits;
+    if (capacity > table->allocated) {
+        uint64_t* keys = malloc(capacity * sizeof(uint64_t));
+        Complex* amplitudes = malloc(capacity * sizeof(Complex));
+        if (!keys || !amplitudes) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            free(keys);
+            free(amplitudes);
+            return false;
+        }
+        free(table->keys);
+        free(table->amplitudes);
+        table->keys = keys;
+        table->amplitudes = amplitudes;
+        table->allocated = capacity;
+        INSTRUMENT_ALLOC(capacity * (sizeof(uint64_t) + sizeof(Complex)));
+    }
+    table->capacity = capacity;
+    table->capacity_bits = bits;
+    memset(table->keys, 0xFF, capacity * sizeof(uint64_t));
+    return true;
+}
+
+static void free_table(SparseTable* table) {
+    free(table->keys);
+    free(table->amplitudes);
+    memset(table, 0, sizeof(SparseTable));
+}
+
+// Slot holding key, or SIZE_MAX
+static size_t find_slot(const SparseTable* table, uint64_t key) {
+    size_t mask = table->capacity - 1;
+    size_t slot = hash_key(key, table->capacity_bits);
+    while (table->keys[slot] != key) {
+        if (table->keys[slot] == SPARSE_EMPTY_KEY) return SIZE_MAX;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// key must not be in the table yet
+static void insert_new(SparseTable* table, uint64_t key, Complex amplitude) {
+    size_t mask = table->capacity - 1;
+    size_t slot = hash_key(key, table->capacity_bits);
+    while (table->keys[slot] != SPARSE_EMPTY_KEY) slot = (slot + 1) & mask;
+    table->keys[slot] = key;
+    table->amplitudes[slot] = amplitude;
+}
+
+static void swap_tables(SparseStatevector* state, size_t count) {
+    SparseTable table = state->table;
+    state->table = state->spare;
+    state->spare = table;
+    state->count = count;
+    if (count > state->peak_count) state->peak_count = count;
+}
+
+// State management
+
+SparseStatevector* create_sparse_statevector(int num_qubits) {
+    if (num_qubits <= 0 || num_qubits > SPARSE_MAX_QUBITS) {
+        fprintf(stderr, "Error: Sparse states hold 1 to %d qubits\n", SPARSE_MAX_QUBITS);
+        return NULL;
+    }
+    SparseStatevector* state = calloc(1, sizeof(SparseStatevector));
+    if (!state) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    state->num_qubits = num_qubits;
+    if (!initialize_sparse_statevector(state)) {
+        free_sparse_statevector(state);
+        return NULL;
+    }
+    return state;
+}
+
+void free_sparse_statevector(SparseStatevector* state) {
+    if (!state) return;
+    free_table(&state->table);
+    free_table(&state->spare);
+    free(state);
+}
+
+bool initialize_sparse_statevector(SparseStatevector* state) {
+    if (!state || !reserve_table(&state->table, 1)) return false;
+    Complex one = {1.0, 0.0};
+    insert_new(&state->table, 0, one);
+    state->flip = 0;
+    state->count = 1;
+    state->peak_count = 1;
+    return true;
+}
+
+Complex sparse_amplitude(const SparseStatevector* state, uint64_t index) {
+    Complex zero = {0.0, 0.0};
+    if (!state || index >> state->num_qubits) return zero;
+    size_t slot = find_slot(&state->table, index ^ state->flip);
+    return slot == SIZE_MAX ? zero : state->table.amplitudes[slot];
+}
+
+// Gates
+
+typedef struct {
+    SparseTable* table;
+    uint64_t flip;
+    uint64_t control_mask;
+    uint64_t target_bit;
+    Complex d0;
+    Complex d1;
+} DiagonalJob;
+
+static void diagonal_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const DiagonalJob* job = context;
+    for (size_t slot = begin; slot < end; slot++) {
+        uint64_t key = job->table->keys[slot];
+        if (key == SPARSE_EMPTY_KEY) continue;
+        uint64_t index = key ^ job->flip;
+        if ((index & job->control_mask) != job->control_mask) continue;
+        Complex* a = &job->table->amplitudes[slot];
+        *a = complex_mul(*a, (index & job->target_bit) ? job->d1 : job->d0);
+    }
+}
+
+static void apply_diagonal(SparseStatevector* state, Complex d0, Complex d1, uint64_t control_mask,
+                           uint64_t target_bit) {
+    DiagonalJob job = {&state->table, state->flip, control_mask, target_bit, d0, d1};
+    parallel_for(state->table.capacity, diagonal_task, &job);
+}
+
+// Moves the entries whose controls are set to the basis state with the target flipped.
+// The amplitude arriving at target 1 is multiplied by elements[1][0], at target 0 by
+// elements[0][1].
+static bool apply_controlled_permutation(SparseStatevector* state, const QuantumGate* gate, uint64_t control_mask,
+                                         uint64_t target_bit) {
+    if (!reserve_table(&state->spare, state->count)) return false;
+    const SparseTable* old = &state->table;
+    for (size_t slot = 0; slot < old->capacity; slot++) {
+        uint64_t key = old->keys[slot];
+        if (key == SPARSE_EMPTY_KEY) continue;
+        uint64_t index = key ^ state->flip;
+        Complex amplitude = old->amplitudes[slot];
+        if ((index & control_mask) == control_mask) {
+            key ^= target_bit;
+            amplitude = complex_mul(amplitude, (index & target_bit) ? gate->elements[0][1] : gate->elements[1][0]);
+        }
+        insert_new(&state->spare, key, amplitude);
+    }
+    swap_tables(state, state->count);
+    return true;
+}
+
+// Combines each pair of basis states that differ only in the target into the two new
+// amplitudes of the pair. A pair is handled from its target-0 entry, or from its target-1
+// entry when that is alone.
+static bool apply_branching(SparseStatevector* state, const QuantumGate* gate, uint64_t control_mask,
+                            uint64_t target_bit) {
+    if (!reserve_table(&state->spare, 2 * state->count)) return false;
+    const SparseTable* old = &state->table;
+    Complex zero = {0.0, 0.0};
+    size_t count = 0;
+    for (size_t slot = 0; slot < old->capacity; slot++) {
+        uint64_t key = old->keys[slot];
+        if (key == SPARSE_EMPTY_KEY) continue;
+        uint64_t index = key ^ state->flip;
+        if ((index & control_mask) != control_mask) {
+            insert_new(&state->spare, key, old->amplitudes[slot]);
+            count++;
+            continue;
+        }
+        size_t partner = find_slot(old, key ^ target_bit);
+        if ((index & target_bit) && partner != SIZE_MAX) continue;
+
+        Complex a0 = (index & target_bit) ? zero : old->amplitudes[slot];
+        Complex a1 = (index & target_bit) ? old->amplitudes[slot] : zero;
+        if (partner != SIZE_MAX) a1 = old->amplitudes[partner];
+        Complex b0 = complex_combine(gate->elements[0][0], a0, gate->elements[0][1], a1);
+        Complex b1 = complex_combine(gate->elements[1][0], a0, gate->elements[1][1], a1);
+        uint64_t key0 = (index & ~target_bit) ^ state->flip;
+        if (!is_zero_amplitude(b0)) {
+            insert_new(&state->spare, key0, b0);
+            count++;
+        }
+        if (!is_zero_amplitude(b1)) {
+            insert_new(&state->spare, key0 ^ target_bit, b1);
+            count++;
+        }
+    }
+    swap_tables(state, count);
+    return true;
+}
+
+bool sparse_apply_gate(SparseStatevector* state, const QuantumGate* gate, const int* controls, int num_controls,
+                       int target) {
+    if (!state || !gate || num_controls < 0 || (num_controls > 0 && !controls) || target < 0 ||
+        target >= state->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for sparse gate\n");
+        return false;
+    }
+    uint64_t target_bit = (uint64_t)1 << target, control_mask = 0;
+    for (int c = 0; c < num_controls; c++) {
+        if (controls[c] < 0 || controls[c] >= state->num_qubits || controls[c] == target) {
+            fprintf(stderr, "Error: Invalid qubit indices\n");
+            return false;
+        }
+        control_mask |= (uint64_t)1 << controls[c];
+    }
+
+    if (is_diagonal_gate(gate)) {
+        apply_diagonal(state, gate->elements[0][0], gate->elements[1][1], control_mask, target_bit);
+        return true;
+    }
+    if (is_anti_diagonal_gate(gate)) {
+        if (control_mask) return apply_controlled_permutation(state, gate, control_mask, target_bit);
+        // Entries keep their slots and only change the basis state they stand for
+        state->flip ^= target_bit;
+        Complex d0 = gate->elements[0][1], d1 = gate->elements[1][0];
+        if (d0.real != 1.0 || d0.imag != 0.0 || d1.real != 1.0 || d1.imag != 0.0) {
+            apply_diagonal(state, d0, d1, 0, target_bit);
+        }
+        return true;
+    }
+    return apply_branching(state, gate, control_mask, target_bit);
+}
+
+bool sparse_apply_toffoli(SparseStatevector* state, int control0, int control1, int target) {
+    QuantumGate x = get_x_gate();
+    int controls[2] = {control0, control1};
+    return sparse_apply_gate(state, &x, controls, 2, target);
+}
+
+bool sparse_apply_op(SparseStatevector* state, const CircuitOp* op, const double* params) {
+    if (!state || !op || (op->param_index >= 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for sparse gate\n");
+        return false;
+    }
+    QuantumGate gate = circuit_op_gate(op, params);
+    return sparse_apply_gate(state, &gate, &op->control, op->control == NO_CONTROL ? 0 : 1, op->target);
+}
+
+// Reading the state
+
+bool sparse_sample(const SparseStatevector* state, uint64_t num_shots, Rng* rng, uint64_t* outcomes) {
+    if (!state || !rng || !outcomes || num_shots == 0) {
+        fprintf(stderr, "Error: Invalid parameters for sampling\n");
+        return false;
+    }
+    uint64_t* indices = malloc(state->count * sizeof(uint64_t));
+    double* prefix = malloc(state->count * sizeof(double));
+    if (!indices || !prefix) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(indices);
+        free(prefix);
+        return false;
+    }
+    size_t count = 0;
+    double total = 0.0;
+    for (size_t slot = 0; slot < state->table.capacity; slot++) {
+        uint64_t key = state->table.keys[slot];
+        if (key == SPARSE_EMPTY_KEY) continue;
+        Complex a = state->table.amplitudes[slot];
+        total += a.real * a.real + a.imag * a.imag;
+        indices[count] = key ^ state->flip;
+        prefix[count++] = total;
+    }
+
+    for (uint64_t s = 0; s < num_shots; s++) {
+        double target = rng_uniform(rng) * total;
+        size_t low = 0, high = count - 1;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (prefix[middle] > target) high = middle;
+            else low = middle + 1;
+        }
+        outcomes[s] = indices[low];
+    }
+    free(indices);
+    free(prefix);
+    return true;
+}
+
+bool sparse_to_statevector(const SparseStatevector* state, Statevector* sv) {
+    if (!state || !sv || sv->num_qubits != state->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for sparse conversion\n");
+        return false;
+    }
+    memset(sv->real, 0, sv->dimension * sizeof(double));
+    memset(sv->imag, 0, sv->dimension * sizeof(double));
+    for (size_t slot = 0; slot < state->table.capacity; slot++) {
+        uint64_t key = state->table.keys[slot];
+        if (key == SPARSE_EMPTY_KEY) continue;
+        size_t index = (size_t)(key ^ state->flip);
+        sv->real[index] = state->table.amplitudes[slot].real;
+        sv->imag[index] = state->table.amplitudes[slot].imag;
+    }
+    return true;
+}
+
+// Circuits
+
+int circuit_branching_ops(const Circuit* circuit, const double* params) {
+    int branching = 0;
+    for (int i = 0; circuit && i < circuit->num_ops; i++) {
+        const CircuitOp* op = &circuit->ops[i];
+        if (op->param_index >= 0 && !params) {
+            if (op->op == OP_RX || op->op == OP_RY) branching++;
+            continue;
+        }
+        QuantumGate gate = circuit_op_gate(op, params);
+        if (!is_diagonal_gate(&gate) && !is_anti_diagonal_gate(&gate)) branching++;
+    }
+    return branching;
+}
+
+// Continues the run on a statevector from op first_op on
+static bool switch_to_dense(const Circuit* circuit, const double* params, int first_op, HybridState* state) {
+    state->dense = create_statevector(circuit->num_qubits);
+    if (!state->dense || !sparse_to_statevector(state->sparse, state->dense)) return false;
+    free_sparse_statevector(state->sparse);
+    state->sparse = NULL;
+    state->switch_op = first_op;
+
+    Circuit rest = *circuit;
+    rest.ops += first_op;
+    rest.num_ops -= first_op;
+    CircuitPlan plan;
+    if (!compile_circuit(&rest, 0, &plan)) return false;
+    bool ok = execute_plan(&plan, state->dense, params);
+    free_circuit_plan(&plan);
+    return ok;
+}
+
+bool run_hybrid_circuit(const Circuit* circuit, const double* params, size_t max_entries, HybridState* state) {
+    if (state) {
+        state->sparse = NULL;
+        state->dense = NULL;
+        state->switch_op = -1;
+    }
+    if (!circuit || !state || (circuit->num_params > 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for circuit run\n");
+        return false;
+    }
+    bool can_switch = circuit->num_qubits <= 62;
+    if (max_entries == 0) {
+        max_entries = can_switch ? ((size_t)1 << circuit->num_qubits) / SPARSE_DENSE_DIVISOR : SIZE_MAX;
+    }
+
+    state->sparse = create_sparse_statevector(circuit->num_qubits);
+    bool ok = state->sparse != NULL;
+    for (int i = 0; ok && i < circuit->num_ops; i++) {
+        if (can_switch && state->sparse->count > max_entries) {
+            ok = switch_to_dense(circuit, params, i, state);
+            break;
+        }
+        ok = sparse_apply_op(state->sparse, &circuit->ops[i], params);
+    }
+    if (!ok) free_hybrid_state(state);
+    return ok;
+}
+
+void free_hybrid_state(HybridState* state) {
+    if (!state) return;
+    free_sparse_statevector(state->sparse);
+    free_statevector(state->dense);
+    state->sparse = NULL;
+    state->dense = NULL;
+}
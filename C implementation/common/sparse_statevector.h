@@ -0,0 +1,95 @@
+// sparse_statevector.h
+#ifndef SPARSE_STATEVECTOR_H
+#define SPARSE_STATEVECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "statevector_core.h"
+#include "circuit.h"
+#include "measurement.h"
+
+// Basis states are 64-bit keys, one of which marks a free slot
+#define SPARSE_MAX_QUBITS 63
+#define SPARSE_EMPTY_KEY UINT64_MAX
+
+// Amplitudes whose squared magnitude falls to this after a gate are dropped, so branches
+// that interfere away leave no entries behind
+#define SPARSE_ZERO_TOLERANCE 1e-30
+
+// run_hybrid_circuit() moves to a statevector once more than 2^n / SPARSE_DENSE_DIVISOR
+// amplitudes are nonzero. A hash table entry costs several times the memory and time of a
+// dense amplitude, so past this density the statevector is the faster of the two.
+#define SPARSE_DENSE_DIVISOR 32
+
+// Open-addressing hash table with linear probing, at most half full
+typedef struct {
+    uint64_t* keys;       // SPARSE_EMPTY_KEY in free slots
+    Complex* amplitudes;
+    size_t capacity;      // slots in use, a power of two
+    size_t allocated;     // slots allocated
+    int capacity_bits;
+} SparseTable;
+
+// Statevector that stores only the nonzero amplitudes, keyed by basis state. Circuits
+// made of permutations (X, CNOT, Toffoli) and phases keep every state at as many entries
+// as it started with however wide it is, and each branching gate (H, RX, RY) at most
+// doubles them, so reversible arithmetic on 40 and more qubits runs in time and memory
+// proportional to the number of nonzero amplitudes instead of 2^n.
+//
+// Gates are applied according to their matrix. Diagonal gates scale the entries in place.
+// Uncontrolled X and Y only toggle a bit of flip: the entry with key k holds basis state
+// k ^ flip, so they cost one pass for Y's phases and nothing for X. Controlled
+// permutations rewrite the keys of the entries whose controls are set, and every other
+// gate combines each pair of entries that differ in the target into up to two new ones;
+// both rebuild the table into spare and swap the two.
+typedef struct {
+    int num_qubits;
+    uint64_t flip;
+    size_t count;       // nonzero amplitudes
+    size_t peak_count;  // most nonzero amplitudes held so far
+    SparseTable table;
+    SparseTable spare;
+} SparseStatevector;
+
+SparseStatevector* create_sparse_statevector(int num_qubits);  // |0...0⟩
+void free_sparse_statevector(SparseStatevector* state);
+bool initialize_sparse_statevector(SparseStatevector* state);
+
+// Amplitude of a basis state, zero when it holds no entry
+Complex sparse_amplitude(const SparseStatevector* state, uint64_t index);
+
+// Applies gate to target when every qubit of controls[0..num_controls) is 1. A Toffoli is
+// the X gate with two controls.
+bool sparse_apply_gate(SparseStatevector* state, const QuantumGate* gate, const int* controls, int num_controls,
+                       int target);
+bool sparse_apply_toffoli(SparseStatevector* state, int control0, int control1, int target);
+bool sparse_apply_op(SparseStatevector* state, const CircuitOp* op, const double* params);
+
+// Draws num_shots basis states from the state's distribution without collapsing it; bit q
+// of outcomes[s] is the result of qubit q in shot s
+bool sparse_sample(const SparseStatevector* state, uint64_t num_shots, Rng* rng, uint64_t* outcomes);
+
+// Scatters the entries into sv, which must have as many qubits
+bool sparse_to_statevector(const SparseStatevector* state, Statevector* sv);
+
+// How many of the ops can at most multiply the number of nonzero amplitudes, by two
+// each: the non-diagonal ops other than X, Y and CNOT. params may be NULL, which counts
+// every parametric RX and RY.
+int circuit_branching_ops(const Circuit* circuit, const double* params);
+
+// A circuit run that starts sparse and continues on a statevector once the sparse state
+// grows past max_entries. Exactly one of sparse and dense is set afterwards.
+typedef struct {
+    SparseStatevector* sparse;
+    Statevector* dense;
+    int switch_op;  // first op applied to the statevector, or -1 if the run stayed sparse
+} HybridState;
+
+// Runs the circuit from |0...0⟩. max_entries = 0 selects 2^n / SPARSE_DENSE_DIVISOR; a
+// circuit on more than 62 qubits, past every statevector, never switches. The ops after
+// the switch are compiled into a plan and executed as on the statevector backend.
+bool run_hybrid_circuit(const Circuit* circuit, const double* params, size_t max_entries, HybridState* state);
+void free_hybrid_state(HybridState* state);
+
+#endif // SPARSE_STATEVECTOR_H
@@ -0,0 +1,472 @@
+// stabilizer.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stabilizer.h"
+#include "observable.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+
+// Rotation angles within this distance of a multiple of π/2 count as Clifford
+#define CLIFFORD_ANGLE_TOLERANCE 1e-12
+
+#define HALF_PI 1.57079632679489661923
+
+static size_t num_rows(const StabilizerState* state) {
+    return 2 * (size_t)state->num_qubits + 1;
+}
+
+static size_t matrix_words(const StabilizerState* state) {
+    return state->row_words * 64 * state->words;
+}
+
+static bool sign(const StabilizerState* state, size_t row) {
+    return (state->r[row / 64] >> (row % 64)) & 1;
+}
+
+static void set_sign(StabilizerState* state, size_t row, bool value) {
+    uint64_t bit = 1ULL << (row % 64);
+    state->r[row / 64] = value ? state->r[row / 64] | bit : state->r[row / 64] & ~bit;
+}
+
+// Layouts
+
+// Transposes a 64x64 bit block in place: bit j of word k trades places with bit k of word j
+static void transpose_block(uint64_t* block) {
+    uint64_t mask = 0x00000000FFFFFFFFULL;
+    for (int j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+        for (int k = 0; k < 64; k = (k + j + 1) & ~j) {
+            uint64_t t = ((block[k] >> j) ^ block[k + j]) & mask;
+            block[k] ^= t << j;
+            block[k + j] ^= t;
+        }
+    }
+}
+
+// in has in_words words per line; out gets the transpose with out_words words per line
+static void transpose_matrix(const uint64_t* in, uint64_t* out, size_t in_words, size_t out_words) {
+    uint64_t block[64];
+    for (size_t bi = 0; bi < out_words; bi++) {
+        for (size_t bj = 0; bj < in_words; bj++) {
+            for (int k = 0; k < 64; k++) block[k] = in[(bi * 64 + k) * in_words + bj];
+            transpose_block(block);
+            for (int k = 0; k < 64; k++) out[(bj * 64 + k) * out_words + bi] = block[k];
+        }
+    }
+}
+
+static void swap_layout(StabilizerState* state) {
+    size_t in_words = state->columns ? state->row_words : state->words;
+    size_t out_words = state->columns ? state->words : state->row_words;
+    uint64_t* transposed = state->spare;
+    transpose_matrix(state->x, transposed, in_words, out_words);
+    state->spare = state->x;
+    state->x = transposed;
+    transposed = state->spare;
+    transpose_matrix(state->z, transposed, in_words, out_words);
+    state->spare = state->z;
+    state->z = transposed;
+    state->columns = !state->columns;
+}
+
+static void use_rows(StabilizerState* state) {
+    if (state->columns) swap_layout(state);
+}
+
+static void use_columns(StabilizerState* state) {
+    if (!state->columns) swap_layout(state);
+}
+
+static uint64_t* row_x(const StabilizerState* state, size_t row) {
+    return state->x + row * state->words;
+}
+
+static uint64_t* row_z(const StabilizerState* state, size_t row) {
+    return state->z + row * state->words;
+}
+
+static uint64_t* column_x(const StabilizerState* state, int qubit) {
+    return state->x + (size_t)qubit * state->row_words;
+}
+
+static uint64_t* column_z(const StabilizerState* state, int qubit) {
+    return state->z + (size_t)qubit * state->row_words;
+}
+
+// State management
+
+StabilizerState* create_stabilizer_state(int num_qubits) {
+    if (num_qubits < 1 || num_qubits > MAX_CIRCUIT_QUBITS) {
+        fprintf(stderr, "Error: Invalid number of qubits\n");
+        return NULL;
+    }
+    StabilizerState* state = malloc(sizeof(StabilizerState));
+    if (!state) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    state->num_qubits = num_qubits;
+    state->words = ((size_t)num_qubits + 63) / 64;
+    state->row_words = (num_rows(state) + 63) / 64;
+    size_t bytes = matrix_words(state) * sizeof(uint64_t);
+    state->x = malloc(bytes);
+    state->z = malloc(bytes);
+    state->spare = malloc(bytes);
+    state->r = malloc(state->row_words * sizeof(uint64_t));
+    if (!state->x || !state->z || !state->spare || !state->r) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_stabilizer_state(state);
+        return NULL;
+    }
+    INSTRUMENT_ALLOC(3 * bytes + state->row_words * sizeof(uint64_t));
+    initialize_stabilizer_state(state);
+    return state;
+}
+
+void free_stabilizer_state(StabilizerState* state) {
+    if (!state) return;
+    free(state->x);
+    free(state->z);
+    free(state->spare);
+    free(state->r);
+    free(state);
+}
+
+// |0...0⟩: destabilizer i is X_i, stabilizer i is Z_i
+bool initialize_stabilizer_state(StabilizerState* state) {
+    if (!state) return false;
+    memset(state->x, 0, matrix_words(state) * sizeof(uint64_t));
+    memset(state->z, 0, matrix_words(state) * sizeof(uint64_t));
+    memset(state->r, 0, state->row_words * sizeof(uint64_t));
+    state->columns = false;
+    for (int q = 0; q < state->num_qubits; q++) {
+        row_x(state, (size_t)q)[q / 64] |= 1ULL << (q % 64);
+        row_z(state, (size_t)state->num_qubits + q)[q / 64] |= 1ULL << (q % 64);
+    }
+    return true;
+}
+
+bool copy_stabilizer_state(StabilizerState* dst, const StabilizerState* src) {
+    if (!dst || !src || dst->num_qubits != src->num_qubits) {
+        fprintf(stderr, "Error: Stabilizer states have different sizes\n");
+        return false;
+    }
+    memcpy(dst->x, src->x, matrix_words(src) * sizeof(uint64_t));
+    memcpy(dst->z, src->z, matrix_words(src) * sizeof(uint64_t));
+    memcpy(dst->r, src->r, src->row_words * sizeof(uint64_t));
+    dst->columns = src->columns;
+    return true;
+}
+
+// Gates
+
+// Conjugation by a gate in the column layout: word w of each column covers rows
+// 64w..64w+63, so every row is updated at once. Padding rows are zero and stay zero.
+
+void stabilizer_h(StabilizerState* state, int qubit) {
+    use_columns(state);
+    uint64_t *x = column_x(state, qubit), *z = column_z(state, qubit);
+    for (size_t w = 0; w < state->row_words; w++) {
+        uint64_t t = x[w];
+        state->r[w] ^= x[w] & z[w];
+        x[w] = z[w];
+        z[w] = t;
+    }
+}
+
+void stabilizer_s(StabilizerState* state, int qubit) {
+    use_columns(state);
+    uint64_t *x = column_x(state, qubit), *z = column_z(state, qubit);
+    for (size_t w = 0; w < state->row_words; w++) {
+        state->r[w] ^= x[w] & z[w];
+        z[w] ^= x[w];
+    }
+}
+
+// Paulis only flip the signs of the rows they anticommute with
+void stabilizer_x(StabilizerState* state, int qubit) {
+    use_columns(state);
+    const uint64_t* z = column_z(state, qubit);
+    for (size_t w = 0; w < state->row_words; w++) state->r[w] ^= z[w];
+}
+
+void stabilizer_y(StabilizerState* state, int qubit) {
+    use_columns(state);
+    const uint64_t *x = column_x(state, qubit), *z = column_z(state, qubit);
+    for (size_t w = 0; w < state->row_words; w++) state->r[w] ^= x[w] ^ z[w];
+}
+
+void stabilizer_z(StabilizerState* state, int qubit) {
+    use_columns(state);
+    const uint64_t* x = column_x(state, qubit);
+    for (size_t w = 0; w < state->row_words; w++) state->r[w] ^= x[w];
+}
+
+void stabilizer_cnot(StabilizerState* state, int control, int target) {
+    use_columns(state);
+    uint64_t *xa = column_x(state, control), *za = column_z(state, control);
+    uint64_t *xb = column_x(state, target), *zb = column_z(state, target);
+    for (size_t w = 0; w < state->row_words; w++) {
+        state->r[w] ^= xa[w] & zb[w] & ~(xb[w] ^ za[w]);
+        xb[w] ^= xa[w];
+        za[w] ^= zb[w];
+    }
+}
+
+void stabilizer_cz(StabilizerState* state, int control, int target) {
+    use_columns(state);
+    uint64_t *xa = column_x(state, control), *za = column_z(state, control);
+    uint64_t *xb = column_x(state, target), *zb = column_z(state, target);
+    for (size_t w = 0; w < state->row_words; w++) {
+        state->r[w] ^= xa[w] & xb[w] & (za[w] ^ zb[w]);
+        za[w] ^= xb[w];
+        zb[w] ^= xa[w];
+    }
+}
+
+// Circuit ops
+
+// Quarter turns k in [0, 4) when angle is a multiple of π/2, -1 otherwise
+static int quarter_turns(double angle) {
+    double turns = round(angle / HALF_PI);
+    if (fabs(angle - turns * HALF_PI) > CLIFFORD_ANGLE_TOLERANCE) return -1;
+    return (int)(((long long)turns % 4 + 4) % 4);
+}
+
+static double op_angle(const CircuitOp* op, const double* params) {
+    return op->param_index >= 0 ? params[op->param_index] : op->angle;
+}
+
+bool is_clifford_op(const CircuitOp* op, const double* params) {
+    switch (op->op) {
+        case OP_T:  return false;
+        case OP_RX:
+        case OP_RY:
+        case OP_RZ: return (op->param_index < 0 || params) && quarter_turns(op_angle(op, params)) >= 0;
+        default:    return op->op >= 0 && op->op < NUM_GATE_OPS;
+    }
+}
+
+bool circuit_is_clifford(const Circuit* circuit, const double* params) {
+    if (!circuit) return false;
+    for (int i = 0; i < circuit->num_ops; i++) {
+        if (!is_clifford_op(&circuit->ops[i], params)) return false;
+    }
+    return true;
+}
+
+static void stabilizer_s_power(StabilizerState* state, int qubit, int power) {
+    for (int k = 0; k < power; k++) stabilizer_s(state, qubit);
+}
+
+bool apply_stabilizer_op(StabilizerState* state, const CircuitOp* op, const double* params) {
+    if (!state || !op || op->target < 0 || op->target >= state->num_qubits ||
+        (op->control != NO_CONTROL && (op->control < 0 || op->control >= state->num_qubits || op->control == op->target))) {
+        fprintf(stderr, "Error: Invalid qubit indices\n");
+        return false;
+    }
+    if (!is_clifford_op(op, params)) {
+        fprintf(stderr, "Error: %s is not a Clifford gate\n", gate_op_name(op->op));
+        return false;
+    }
+    int q = op->target;
+    switch (op->op) {
+        case OP_X:    stabilizer_x(state, q); break;
+        case OP_Y:    stabilizer_y(state, q); break;
+        case OP_Z:    stabilizer_z(state, q); break;
+        case OP_H:    stabilizer_h(state, q); break;
+        case OP_S:    stabilizer_s(state, q); break;
+        case OP_CNOT: stabilizer_cnot(state, op->control, q); break;
+        case OP_CZ:   stabilizer_cz(state, op->control, q); break;
+        // Up to a global phase RZ(kπ/2) = S^k, RX(θ) = H RZ(θ) H and RY(θ) = S RX(θ) S†
+        case OP_RZ:
+            stabilizer_s_power(state, q, quarter_turns(op_angle(op, params)));
+            break;
+        case OP_RX:
+            stabilizer_h(state, q);
+            stabilizer_s_power(state, q, quarter_turns(op_angle(op, params)));
+            stabilizer_h(state, q);
+            break;
+        default:
+            stabilizer_s_power(state, q, 3);
+            stabilizer_h(state, q);
+            stabilizer_s_power(state, q, quarter_turns(op_angle(op, params)));
+            stabilizer_h(state, q);
+            stabilizer_s(state, q);
+            break;
+    }
+    return true;
+}
+
+// Measurement
+
+// Row h becomes row i * row h. The exponent of i the product picks up is counted one word
+// at a time: with row i = (x1, z1) and row h = (x2, z2), a qubit contributes +1 where
+// (P1, P2) is (Y, Z), (X, Y) or (Z, X), and -1 where it is (Y, X), (X, Z) or (Z, Y).
+static void rowsum(StabilizerState* state, size_t h, size_t i) {
+    uint64_t *xh = row_x(state, h), *zh = row_z(state, h);
+    const uint64_t *xi = row_x(state, i), *zi = row_z(state, i);
+    long exponent = 2 * (long)sign(state, h) + 2 * (long)sign(state, i);
+    for (size_t w = 0; w < state->words; w++) {
+        uint64_t x1 = xi[w], z1 = zi[w], x2 = xh[w], z2 = zh[w];
+        uint64_t plus = (x1 & z1 & z2 & ~x2) | (x1 & ~z1 & z2 & x2) | (~x1 & z1 & x2 & ~z2);
+        uint64_t minus = (x1 & z1 & x2 & ~z2) | (x1 & ~z1 & z2 & ~x2) | (~x1 & z1 & x2 & z2);
+        exponent += __builtin_popcountll(plus) - __builtin_popcountll(minus);
+        xh[w] = x2 ^ x1;
+        zh[w] = z2 ^ z1;
+    }
+    // Stabilizer products are Hermitian, so the exponent is 0 or 2 mod 4. Destabilizer
+    // signs are never read.
+    set_sign(state, h, (exponent & 3) == 2);
+}
+
+typedef struct {
+    StabilizerState* state;
+    size_t pivot;
+    size_t word;
+    uint64_t bit;
+} RowsumJob;
+
+// Chunks start at multiples of 64 rows, so no two workers write the same sign word
+static void rowsum_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const RowsumJob* job = context;
+    for (size_t row = begin; row < end; row++) {
+        if (row != job->pivot && (row_x(job->state, row)[job->word] & job->bit)) rowsum(job->state, row, job->pivot);
+    }
+}
+
+bool stabilizer_measure(StabilizerState* state, int qubit, Rng* rng, int* outcome) {
+    if (!state || !rng || !outcome || qubit < 0 || qubit >= state->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for stabilizer measurement\n");
+        return false;
+    }
+    use_rows(state);
+    size_t n = (size_t)state->num_qubits;
+    size_t word = (size_t)qubit / 64;
+    uint64_t bit = 1ULL << (qubit % 64);
+
+    // A stabilizer with X or Y on the qubit anticommutes with Z: the outcome is random
+    size_t pivot = 2 * n;
+    for (size_t row = n; row < 2 * n; row++) {
+        if (row_x(state, row)[word] & bit) {
+            pivot = row;
+            break;
+        }
+    }
+
+    if (pivot < 2 * n) {
+        RowsumJob job = {state, pivot, word, bit};
+        parallel_for(2 * n, rowsum_task, &job);
+        // The old stabilizer becomes the destabilizer of the new one, ±Z on the qubit
+        memcpy(row_x(state, pivot - n), row_x(state, pivot), state->words * sizeof(uint64_t));
+        memcpy(row_z(state, pivot - n), row_z(state, pivot), state->words * sizeof(uint64_t));
+        set_sign(state, pivot - n, sign(state, pivot));
+        memset(row_x(state, pivot), 0, state->words * sizeof(uint64_t));
+        memset(row_z(state, pivot), 0, state->words * sizeof(uint64_t));
+        row_z(state, pivot)[word] = bit;
+        set_sign(state, pivot, rng_next(rng) >> 63);
+        *outcome = sign(state, pivot);
+        return true;
+    }
+
+    // Deterministic: ±Z on the qubit is the product of the stabilizers whose destabilizers
+    // anticommute with it, accumulated in the scratch row
+    size_t scratch = 2 * n;
+    memset(row_x(state, scratch), 0, state->words * sizeof(uint64_t));
+    memset(row_z(state, scratch), 0, state->words * sizeof(uint64_t));
+    set_sign(state, scratch, false);
+    for (size_t row = 0; row < n; row++) {
+        if (row_x(state, row)[word] & bit) rowsum(state, scratch, row + n);
+    }
+    *outcome = sign(state, scratch);
+    return true;
+}
+
+bool stabilizer_measure_all(StabilizerState* state, Rng* rng, uint8_t* outcomes) {
+    if (!state || !outcomes) {
+        fprintf(stderr, "Error: Invalid parameters for stabilizer measurement\n");
+        return false;
+    }
+    for (int q = 0; q < state->num_qubits; q++) {
+        int outcome;
+        if (!stabilizer_measure(state, q, rng, &outcome)) return false;
+        outcomes[q] = (uint8_t)outcome;
+    }
+    return true;
+}
+
+// Conversion
+
+bool stabilizer_to_statevector(const StabilizerState* state, Statevector* sv) {
+    if (!state || !sv || sv->num_qubits != state->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for stabilizer conversion\n");
+        return false;
+    }
+    int n = state->num_qubits;
+    StabilizerState* measured = create_stabilizer_state(n);
+    Statevector* projected = create_statevector(n);
+    Observable* stabilizer = create_observable(n);
+    char* paulis = malloc((size_t)n * ((size_t)n + 1));
+    uint8_t* bits = malloc((size_t)n);
+    if (!paulis || !bits) fprintf(stderr, "Error: Memory allocation failed\n");
+    bool ok = measured && projected && stabilizer && paulis && bits && copy_stabilizer_state(measured, state);
+
+    // The stabilizers, read before the copy is measured
+    bool* negative = NULL;
+    if (ok) {
+        use_rows(measured);
+        negative = malloc((size_t)n * sizeof(bool));
+        ok = negative != NULL;
+    }
+    for (int g = 0; ok && g < n; g++) {
+        const uint64_t* x = row_x(measured, (size_t)(n + g));
+        const uint64_t* z = row_z(measured, (size_t)(n + g));
+        char* string = paulis + (size_t)g * ((size_t)n + 1);
+        for (int q = 0; q < n; q++) {
+            bool xq = (x[q / 64] >> (q % 64)) & 1, zq = (z[q / 64] >> (q % 64)) & 1;
+            string[q] = xq ? (zq ? 'Y' : 'X') : (zq ? 'Z' : 'I');
+        }
+        string[n] = '\0';
+        negative[g] = sign(measured, (size_t)(n + g));
+    }
+
+    // Any basis state the state has weight on survives the projection
+    Rng rng;
+    rng_seed(&rng, 1);
+    ok = ok && stabilizer_measure_all(measured, &rng, bits);
+    if (ok) {
+        memset(sv->real, 0, sv->dimension * sizeof(double));
+        memset(sv->imag, 0, sv->dimension * sizeof(double));
+        size_t index = 0;
+        for (int q = 0; q < n; q++) index |= (size_t)bits[q] << q;
+        sv->real[index] = 1.0;
+    }
+
+    // ψ = (I + g) / 2 ψ for every stabilizer g
+    for (int g = 0; ok && g < n; g++) {
+        stabilizer->num_terms = 0;
+        ok = observable_add_term(stabilizer, negative[g] ? -1.0 : 1.0, paulis + (size_t)g * ((size_t)n + 1)) &&
+             apply_observable(stabilizer, sv, projected);
+        for (size_t i = 0; ok && i < sv->dimension; i++) {
+            sv->real[i] = 0.5 * (sv->real[i] + projected->real[i]);
+            sv->imag[i] = 0.5 * (sv->imag[i] + projected->imag[i]);
+        }
+    }
+    if (ok) {
+        double norm = statevector_norm(sv);
+        for (size_t i = 0; i < sv->dimension; i++) {
+            sv->real[i] /= norm;
+            sv->imag[i] /= norm;
+        }
+    }
+
+    free_stabilizer_state(measured);
+    free_statevector(projected);
+    free_observable(stabilizer);
+    free(paulis);
+    free(bits);
+    free(negative);
+    return ok;
+}
@@ -0,0 +1,67 @@
+// stabilizer.h
+#ifndef STABILIZER_H
+#define STABILIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "statevector_core.h"
+#include "circuit.h"
+#include "measurement.h"
+
+// Stabilizer tableau of an n-qubit state in the CHP layout (Aaronson and Gottesman):
+// rows 0..n-1 are the destabilizers, rows n..2n-1 the stabilizers and row 2n is scratch.
+// Row i is the Pauli string (-1)^r_i prod_q P_q, where bits q of its x and z words give
+// P_q = I, X (x only), Z (z only) or Y (both). The tableau takes O(n^2) bits.
+//
+// x and z are bit matrices kept in one of two layouts. Measurements multiply whole rows,
+// so they want rows bit-packed 64 qubits to a word: a row product is n / 64 word
+// operations. Gates update one qubit in every row, so they want the transpose, one
+// bit-packed column of rows per qubit: a gate is (2n + 1) / 64 word operations. The state
+// switches layout with 64x64 block transposes when the kind of operation changes.
+typedef struct {
+    int num_qubits;
+    size_t words;      // words per row, 64 qubits each
+    size_t row_words;  // words per column, 64 rows each
+    bool columns;      // x and z hold columns: words * 64 of them, row_words words each
+    uint64_t* x;       // rows: row_words * 64 rows of words words each
+    uint64_t* z;
+    uint64_t* r;       // sign of row i in bit i % 64 of word i / 64, in both layouts
+    uint64_t* spare;   // transposition target, swapped with x or z
+} StabilizerState;
+
+StabilizerState* create_stabilizer_state(int num_qubits);  // |0...0⟩, up to MAX_CIRCUIT_QUBITS
+void free_stabilizer_state(StabilizerState* state);
+bool initialize_stabilizer_state(StabilizerState* state);
+bool copy_stabilizer_state(StabilizerState* dst, const StabilizerState* src);
+
+// Clifford gates, O(n / 64) each. Qubits are not checked.
+void stabilizer_h(StabilizerState* state, int qubit);
+void stabilizer_s(StabilizerState* state, int qubit);
+void stabilizer_x(StabilizerState* state, int qubit);
+void stabilizer_y(StabilizerState* state, int qubit);
+void stabilizer_z(StabilizerState* state, int qubit);
+void stabilizer_cnot(StabilizerState* state, int control, int target);
+void stabilizer_cz(StabilizerState* state, int control, int target);
+
+// Whether an op is a Clifford gate: X, Y, Z, H, S, CNOT, CZ, and rotations by a multiple of
+// π/2, which equal a Clifford gate up to a global phase. T is not. params may be NULL when
+// no op is parametric.
+bool is_clifford_op(const CircuitOp* op, const double* params);
+bool circuit_is_clifford(const Circuit* circuit, const double* params);
+
+// Applies a Clifford op; returns false for any other op and leaves the state unchanged
+bool apply_stabilizer_op(StabilizerState* state, const CircuitOp* op, const double* params);
+
+// Measures qubit in the computational basis and collapses the state, O(n^2 / 64)
+bool stabilizer_measure(StabilizerState* state, int qubit, Rng* rng, int* outcome);
+
+// Measures every qubit in turn; outcomes[q] is the result of qubit q
+bool stabilizer_measure_all(StabilizerState* state, Rng* rng, uint8_t* outcomes);
+
+// Writes the state into sv, which must have as many qubits, up to a global phase: a
+// measured basis state in its support is projected with every stabilizer, O(n 2^n). Used
+// to cross-check the tableau against the statevector backends.
+bool stabilizer_to_statevector(const StabilizerState* state, Statevector* sv);
+
+#endif // STABILIZER_H
@@ -0,0 +1,193 @@
+// state_allocator.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "state_allocator.h"
+
+// mbind() without linking libnuma; the values are those of <linux/mempolicy.h>
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+// Nodes a policy mask can name
+#define MAX_NUMA_NODES 1024
+#define NODE_MASK_WORDS (MAX_NUMA_NODES / (8 * sizeof(unsigned long)))
+
+static HugePageMode huge_page_mode = HUGE_PAGES_TRANSPARENT;
+static NumaPolicy numa_policy = NUMA_FIRST_TOUCH;
+static bool settings_initialized = false;
+
+static int num_nodes = 0;
+static unsigned long node_mask[NODE_MASK_WORDS];
+
+// Settings
+
+static void initialize_settings(void) {
+    settings_initialized = true;
+    const char* requested = getenv("QSIM_HUGE_PAGES");
+    if (requested) {
+        if (strcmp(requested, "off") == 0) huge_page_mode = HUGE_PAGES_OFF;
+        else if (strcmp(requested, "transparent") == 0) huge_page_mode = HUGE_PAGES_TRANSPARENT;
+        else if (strcmp(requested, "explicit") == 0) huge_page_mode = HUGE_PAGES_EXPLICIT;
+        else fprintf(stderr, "Error: Unknown QSIM_HUGE_PAGES value '%s'\n", requested);
+    }
+    requested = getenv("QSIM_NUMA");
+    if (requested) {
+        if (strcmp(requested, "first-touch") == 0) numa_policy = NUMA_FIRST_TOUCH;
+        else if (strcmp(requested, "interleave") == 0) numa_policy = NUMA_INTERLEAVE;
+        else fprintf(stderr, "Error: Unknown QSIM_NUMA value '%s'\n", requested);
+    }
+}
+
+HugePageMode get_huge_page_mode(void) {
+    if (!settings_initialized) initialize_settings();
+    return huge_page_mode;
+}
+
+void set_huge_page_mode(HugePageMode mode) {
+    if (!settings_initialized) initialize_settings();
+    huge_page_mode = mode;
+}
+
+const char* huge_page_mode_name(HugePageMode mode) {
+    switch (mode) {
+        case HUGE_PAGES_OFF:         return "off";
+        case HUGE_PAGES_TRANSPARENT: return "transparent";
+        default:                     return "explicit";
+    }
+}
+
+NumaPolicy get_numa_policy(void) {
+    if (!settings_initialized) initialize_settings();
+    return numa_policy;
+}
+
+void set_numa_policy(NumaPolicy policy) {
+    if (!settings_initialized) initialize_settings();
+    numa_policy = policy;
+}
+
+const char* numa_policy_name(NumaPolicy policy) {
+    return policy == NUMA_INTERLEAVE ? "interleave" : "first-touch";
+}
+
+// NUMA nodes
+
+// Reads the online node list, e.g. "0-3" or "0,2-3", into node_mask
+static void initialize_nodes(void) {
+    num_nodes = 1;
+    memset(node_mask, 0, sizeof(node_mask));
+    node_mask[0] = 1;
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (!file) return;
+    char list[256];
+    bool ok = fgets(list, sizeof(list), file) != NULL;
+    fclose(file);
+    if (!ok) return;
+
+    int count = 0;
+    unsigned long mask[NODE_MASK_WORDS] = {0};
+    for (char* range = strtok(list, ",\n"); range; range = strtok(NULL, ",\n")) {
+        int first, last;
+        int fields = sscanf(range, "%d-%d", &first, &last);
+        if (fields < 1) return;
+        if (fields == 1) last = first;
+        if (first < 0 || last < first || last >= MAX_NUMA_NODES) return;
+        for (int node = first; node <= last; node++) {
+            mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+            count++;
+        }
+    }
+    if (count == 0) return;
+    num_nodes = count;
+    memcpy(node_mask, mask, sizeof(node_mask));
+}
+
+int numa_node_count(void) {
+    if (num_nodes == 0) initialize_nodes();
+    return num_nodes;
+}
+
+// Buffers
+
+static size_t mapped_length(size_t bytes) {
+    return (bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+}
+
+// An anonymous mapping of length bytes starting on a huge-page boundary, which transparent
+// huge pages need to cover it completely. The slack around it is unmapped again.
+static void* map_aligned(size_t length) {
+    size_t padded = length + HUGE_PAGE_BYTES;
+    unsigned char* mapping = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) return NULL;
+    uintptr_t start = ((uintptr_t)mapping + HUGE_PAGE_BYTES - 1) & ~(uintptr_t)(HUGE_PAGE_BYTES - 1);
+    size_t head = start - (uintptr_t)mapping;
+    if (head > 0) munmap(mapping, head);
+    if (padded - head > length) munmap((unsigned char*)start + length, padded - head - length);
+    return (void*)start;
+}
+
+void* allocate_state_buffer(size_t bytes) {
+    if (bytes < STATE_MAP_MIN_BYTES) {
+        void* buffer = NULL;
+        return posix_memalign(&buffer, STATEVECTOR_ALIGNMENT, bytes > 0 ? bytes : 1) == 0 ? buffer : NULL;
+    }
+    size_t length = mapped_length(bytes);
+    HugePageMode mode = get_huge_page_mode();
+    void* buffer = NULL;
+
+#ifdef MAP_HUGETLB
+    // Fails at once when the pool cannot reserve the pages; the buffer then falls back to
+    // transparent huge pages below
+    if (mode == HUGE_PAGES_EXPLICIT) {
+        buffer = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (buffer == MAP_FAILED) buffer = NULL;
+    }
+#endif
+    if (!buffer) {
+        buffer = map_aligned(length);
+        if (!buffer) return NULL;
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        // Best effort: with THP disabled the buffer simply keeps 4 KiB pages
+        madvise(buffer, length, mode == HUGE_PAGES_OFF ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+#endif
+    }
+
+#ifdef SYS_mbind
+    // Before the first touch, so every page is placed by the policy. A kernel without NUMA
+    // support rejects the call and the pages are placed by first touch.
+    if (get_numa_policy() == NUMA_INTERLEAVE && numa_node_count() > 1) {
+        syscall(SYS_mbind, buffer, length, MPOL_INTERLEAVE, node_mask, (unsigned long)MAX_NUMA_NODES, 0);
+    }
+#endif
+    return buffer;
+}
+
+void free_state_buffer(void* buffer, size_t bytes) {
+    if (!buffer) return;
+    if (bytes < STATE_MAP_MIN_BYTES) {
+        free(buffer);
+    } else {
+        munmap(buffer, mapped_length(bytes));
+    }
+}
+
+size_t huge_page_bytes_in_use(void) {
+    FILE* file = fopen("/proc/self/smaps_rollup", "r");
+    if (!file) return 0;
+    char line[256];
+    size_t total_kb = 0;
+    while (fgets(line, sizeof(line), file)) {
+        size_t kb;
+        if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1 || sscanf(line, "Private_Hugetlb: %zu kB", &kb) == 1 ||
+            sscanf(line, "Shared_Hugetlb: %zu kB", &kb) == 1) {
+            total_kb += kb;
+        }
+    }
+    fclose(file);
+    return total_kb * 1024;
+}
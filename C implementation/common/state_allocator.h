@@ -0,0 +1,52 @@
+// state_allocator.h
+#ifndef STATE_ALLOCATOR_H
+#define STATE_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "statevector_core.h"
+
+// Buffers of at least this many bytes are mapped directly so they can be backed by huge
+// pages and placed by a NUMA policy; smaller ones come from posix_memalign
+#define STATE_MAP_MIN_BYTES ((size_t)2 << 20)
+
+// Size of the huge pages asked for. Mapped buffers are rounded up to and aligned to it.
+#define HUGE_PAGE_BYTES ((size_t)2 << 20)
+
+typedef enum {
+    HUGE_PAGES_OFF,          // 4 KiB pages only
+    HUGE_PAGES_TRANSPARENT,  // ask the kernel to back the buffer with transparent huge pages
+    HUGE_PAGES_EXPLICIT      // take pages from the hugetlbfs pool, transparent ones if it is short
+} HugePageMode;
+
+typedef enum {
+    NUMA_FIRST_TOUCH,  // a page lives on the node of the thread that first writes it
+    NUMA_INTERLEAVE    // pages are spread round-robin over all online nodes
+} NumaPolicy;
+
+// Both settings apply to buffers allocated afterwards. They default to transparent huge
+// pages and first touch, or to QSIM_HUGE_PAGES (off, transparent or explicit) and
+// QSIM_NUMA (first-touch or interleave) when set.
+HugePageMode get_huge_page_mode(void);
+void set_huge_page_mode(HugePageMode mode);
+const char* huge_page_mode_name(HugePageMode mode);
+NumaPolicy get_numa_policy(void);
+void set_numa_policy(NumaPolicy policy);
+const char* numa_policy_name(NumaPolicy policy);
+
+// Online NUMA nodes, 1 where the system does not report them
+int numa_node_count(void);
+
+// A buffer of at least bytes bytes aligned to STATEVECTOR_ALIGNMENT. Mapped buffers are
+// not touched here, so the first write decides where their pages live: callers zero them
+// with parallel_for, which hands every worker the same range it later processes.
+void* allocate_state_buffer(size_t bytes);
+
+// bytes must be the size the buffer was allocated with
+void free_state_buffer(void* buffer, size_t bytes);
+
+// Bytes of this process backed by huge pages, transparent or explicit, or 0 if the kernel
+// does not report them
+size_t huge_page_bytes_in_use(void);
+
+#endif // STATE_ALLOCATOR_H
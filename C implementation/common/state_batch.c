@@ -0,0 +1,556 @@
+// state_batch.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "state_batch.h"
+#include "thread_pool.h"
+#include "state_allocator.h"
+#include "instrumentation.h"
+
+// Same rounding in every path as in statevector_core.c: no fused multiply-adds
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define QSIM_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Per-lane 2x2 matrices, structure of arrays so that the lanes of a block load together
+enum { M00R, M00I, M01R, M01I, M10R, M10I, M11R, M11I, LANE_MATRIX_ENTRIES };
+
+typedef struct {
+    double* entry[LANE_MATRIX_ENTRIES];  // num_blocks * BATCH_LANES values each, indexed by lane
+} LaneGates;
+
+static bool allocate_lane_gates(LaneGates* gates, const StateBatch* batch) {
+    size_t lanes = (size_t)batch->num_blocks * BATCH_LANES;
+    for (int e = 0; e < LANE_MATRIX_ENTRIES; e++) gates->entry[e] = malloc(lanes * sizeof(double));
+    for (int e = 0; e < LANE_MATRIX_ENTRIES; e++) {
+        if (!gates->entry[e]) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            for (int f = 0; f < LANE_MATRIX_ENTRIES; f++) free(gates->entry[f]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void free_lane_gates(LaneGates* gates) {
+    for (int e = 0; e < LANE_MATRIX_ENTRIES; e++) free(gates->entry[e]);
+}
+
+static void set_lane_gate(LaneGates* gates, int lane, const QuantumGate* gate) {
+    gates->entry[M00R][lane] = gate->elements[0][0].real;
+    gates->entry[M00I][lane] = gate->elements[0][0].imag;
+    gates->entry[M01R][lane] = gate->elements[0][1].real;
+    gates->entry[M01I][lane] = gate->elements[0][1].imag;
+    gates->entry[M10R][lane] = gate->elements[1][0].real;
+    gates->entry[M10I][lane] = gate->elements[1][0].imag;
+    gates->entry[M11R][lane] = gate->elements[1][1].real;
+    gates->entry[M11I][lane] = gate->elements[1][1].imag;
+}
+
+// Padding lanes get the identity
+static void set_padding_gates(LaneGates* gates, const StateBatch* batch) {
+    QuantumGate identity = {{{{1.0, 0.0}, {0.0, 0.0}}, {{0.0, 0.0}, {1.0, 0.0}}}};
+    for (int b = batch->batch_size; b < batch->num_blocks * BATCH_LANES; b++) set_lane_gate(gates, b, &identity);
+}
+
+// State management
+
+static size_t batch_doubles(const StateBatch* batch) {
+    return (size_t)batch->num_blocks * BATCH_LANES * batch->dimension;
+}
+
+static size_t batch_index(const StateBatch* batch, int b, size_t i) {
+    return ((size_t)(b / BATCH_LANES) * batch->dimension + i) * BATCH_LANES + b % BATCH_LANES;
+}
+
+StateBatch* create_state_batch(int num_qubits, int batch_size) {
+    if (num_qubits < 0 || num_qubits > 62 || batch_size < 1) {
+        fprintf(stderr, "Error: Invalid parameters for state batch\n");
+        return NULL;
+    }
+    StateBatch* batch = malloc(sizeof(StateBatch));
+    if (!batch) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    batch->num_qubits = num_qubits;
+    batch->batch_size = batch_size;
+    batch->num_blocks = (batch_size + BATCH_LANES - 1) / BATCH_LANES;
+    batch->dimension = (size_t)1 << num_qubits;
+    size_t bytes = batch_doubles(batch) * sizeof(double);
+    batch->real = allocate_state_buffer(bytes);
+    batch->imag = allocate_state_buffer(bytes);
+    if (!batch->real || !batch->imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_state_batch(batch);
+        return NULL;
+    }
+    INSTRUMENT_ALLOC(2 * bytes);
+    initialize_state_batch(batch);
+    return batch;
+}
+
+void free_state_batch(StateBatch* batch) {
+    if (!batch) return;
+    size_t bytes = batch_doubles(batch) * sizeof(double);
+    free_state_buffer(batch->real, bytes);
+    free_state_buffer(batch->imag, bytes);
+    free(batch);
+}
+
+bool initialize_state_batch(StateBatch* batch) {
+    if (!batch) return false;
+    size_t bytes = batch_doubles(batch) * sizeof(double);
+    memset(batch->real, 0, bytes);
+    memset(batch->imag, 0, bytes);
+    for (int b = 0; b < batch->num_blocks * BATCH_LANES; b++) batch->real[batch_index(batch, b, 0)] = 1.0;
+    return true;
+}
+
+static bool valid_batch_state(const StateBatch* batch, int b, const Statevector* sv) {
+    if (!batch || !sv || b < 0 || b >= batch->batch_size || sv->num_qubits != batch->num_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for batch state copy\n");
+        return false;
+    }
+    return true;
+}
+
+bool load_batch_state(StateBatch* batch, int b, const Statevector* sv) {
+    if (!valid_batch_state(batch, b, sv)) return false;
+    for (size_t i = 0; i < batch->dimension; i++) {
+        batch->real[batch_index(batch, b, i)] = sv->real[i];
+        batch->imag[batch_index(batch, b, i)] = sv->imag[i];
+    }
+    return true;
+}
+
+bool store_batch_state(const StateBatch* batch, int b, Statevector* sv) {
+    if (!valid_batch_state(batch, b, sv)) return false;
+    for (size_t i = 0; i < batch->dimension; i++) {
+        sv->real[i] = batch->real[batch_index(batch, b, i)];
+        sv->imag[i] = batch->imag[batch_index(batch, b, i)];
+    }
+    return true;
+}
+
+// Block kernels. Each walks pairs [pair_begin, pair_end) of the target within one block,
+// skipping those whose control bit is 0, and updates the lanes of both amplitudes of a
+// pair: x' = m00 x + m01 y, y' = m10 x + m11 y, grouped as in matrix_pairs_scalar so every
+// path gives the same bits. The block's matrices stay in registers for the whole walk.
+// Like the single-state kernels there is a variant per gate class: CNOT and X only
+// exchange the amplitudes, diagonal gates scale each by one entry.
+
+typedef enum {
+    LANE_SWAP,      // X and CNOT: the lane matrices are not read
+    LANE_DIAGONAL,  // m00 and m11 only
+    LANE_MATRIX
+} LaneKind;
+
+typedef struct {
+    const StateBatch* batch;
+    const LaneGates* gates;
+    LaneKind kind;
+    int control;
+    int target;
+} BlockJob;
+
+static LaneKind lane_kind(GateOp op) {
+    switch (op) {
+        case OP_X:
+        case OP_CNOT: return LANE_SWAP;
+        case OP_Z:
+        case OP_S:
+        case OP_T:
+        case OP_RZ:
+        case OP_CZ:   return LANE_DIAGONAL;
+        default:      return LANE_MATRIX;
+    }
+}
+
+// Pairs are walked by their lower index i0, which skips the upper half of every run of
+// 2 * 2^target amplitudes. A pair is applied only when its control bit is set.
+static inline size_t pair_index(size_t p, int target) {
+    size_t low = ((size_t)1 << target) - 1;
+    return ((p & ~low) << 1) | (p & low);
+}
+
+static inline size_t next_pair_index(size_t i0, size_t half) {
+    i0++;
+    return (i0 & half) ? i0 + half : i0;
+}
+
+static inline bool pair_selected(const BlockJob* job, size_t i0) {
+    return job->control == NO_CONTROL || ((i0 >> job->control) & 1);
+}
+
+static void swap_block(const BlockJob* job, int block, size_t pair_begin, size_t pair_end) {
+    size_t base = (size_t)block * job->batch->dimension * BATCH_LANES;
+    double* re = job->batch->real + base;
+    double* im = job->batch->imag + base;
+    size_t half = (size_t)1 << job->target;
+    size_t stride = half * BATCH_LANES;
+    double t[BATCH_LANES];
+    for (size_t p = pair_begin, i0 = pair_index(pair_begin, job->target); p < pair_end;
+         p++, i0 = next_pair_index(i0, half)) {
+        if (!pair_selected(job, i0)) continue;
+        size_t x = i0 * BATCH_LANES;
+        memcpy(t, re + x, sizeof(t));
+        memcpy(re + x, re + x + stride, sizeof(t));
+        memcpy(re + x + stride, t, sizeof(t));
+        memcpy(t, im + x, sizeof(t));
+        memcpy(im + x, im + x + stride, sizeof(t));
+        memcpy(im + x + stride, t, sizeof(t));
+    }
+}
+
+static void diagonal_block_scalar(const BlockJob* job, int block, size_t pair_begin, size_t pair_end) {
+    size_t base = (size_t)block * job->batch->dimension * BATCH_LANES;
+    double* re = job->batch->real + base;
+    double* im = job->batch->imag + base;
+    const LaneGates* g = job->gates;
+    const double* d0r = g->entry[M00R] + block * BATCH_LANES;
+    const double* d0i = g->entry[M00I] + block * BATCH_LANES;
+    const double* d1r = g->entry[M11R] + block * BATCH_LANES;
+    const double* d1i = g->entry[M11I] + block * BATCH_LANES;
+    size_t half = (size_t)1 << job->target;
+    for (size_t p = pair_begin, i0 = pair_index(pair_begin, job->target); p < pair_end;
+         p++, i0 = next_pair_index(i0, half)) {
+        if (!pair_selected(job, i0)) continue;
+        size_t x = i0 * BATCH_LANES, y = x + half * BATCH_LANES;
+        for (int b = 0; b < BATCH_LANES; b++) {
+            double ar = re[x + b], ai = im[x + b], br = re[y + b], bi = im[y + b];
+            re[x + b] = d0r[b] * ar - d0i[b] * ai;
+            im[x + b] = d0r[b] * ai + d0i[b] * ar;
+            re[y + b] = d1r[b] * br - d1i[b] * bi;
+            im[y + b] = d1r[b] * bi + d1i[b] * br;
+        }
+    }
+}
+
+static void matrix_block_scalar(const BlockJob* job, int block, size_t pair_begin, size_t pair_end) {
+    size_t base = (size_t)block * job->batch->dimension * BATCH_LANES;
+    double* re = job->batch->real + base;
+    double* im = job->batch->imag + base;
+    const double* m[LANE_MATRIX_ENTRIES];
+    for (int e = 0; e < LANE_MATRIX_ENTRIES; e++) m[e] = job->gates->entry[e] + block * BATCH_LANES;
+    size_t half = (size_t)1 << job->target;
+    for (size_t p = pair_begin, i0 = pair_index(pair_begin, job->target); p < pair_end;
+         p++, i0 = next_pair_index(i0, half)) {
+        if (!pair_selected(job, i0)) continue;
+        size_t x = i0 * BATCH_LANES, y = x + half * BATCH_LANES;
+        for (int b = 0; b < BATCH_LANES; b++) {
+            double ar = re[x + b], ai = im[x + b], br = re[y + b], bi = im[y + b];
+            re[x + b] = (m[M00R][b] * ar - m[M00I][b] * ai) + (m[M01R][b] * br - m[M01I][b] * bi);
+            im[x + b] = (m[M00R][b] * ai + m[M00I][b] * ar) + (m[M01R][b] * bi + m[M01I][b] * br);
+            re[y + b] = (m[M10R][b] * ar - m[M10I][b] * ai) + (m[M11R][b] * br - m[M11I][b] * bi);
+            im[y + b] = (m[M10R][b] * ai + m[M10I][b] * ar) + (m[M11R][b] * bi + m[M11I][b] * br);
+        }
+    }
+}
+
+#ifdef QSIM_HAVE_X86_SIMD
+
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+
+// A block is two AVX2 registers wide
+AVX2 static void diagonal_block_avx2(const BlockJob* job, int block, size_t pair_begin, size_t pair_end) {
+    size_t base = (size_t)block * job->batch->dimension * BATCH_LANES;
+    const LaneGates* g = job->gates;
+    size_t half = (size_t)1 << job->target;
+    for (int offset = 0; offset < BATCH_LANES; offset += 4) {
+        double* re = job->batch->real + base + offset;
+        double* im = job->batch->imag + base + offset;
+        size_t lane = (size_t)block * BATCH_LANES + offset;
+        __m256d d0r = _mm256_loadu_pd(g->entry[M00R] + lane), d0i = _mm256_loadu_pd(g->entry[M00I] + lane);
+        __m256d d1r = _mm256_loadu_pd(g->entry[M11R] + lane), d1i = _mm256_loadu_pd(g->entry[M11I] + lane);
+        for (size_t p = pair_begin, i0 = pair_index(pair_begin, job->target); p < pair_end;
+             p++, i0 = next_pair_index(i0, half)) {
+            if (!pair_selected(job, i0)) continue;
+            size_t x = i0 * BATCH_LANES, y = x + half * BATCH_LANES;
+            __m256d ar = _mm256_load_pd(re + x), ai = _mm256_load_pd(im + x);
+            __m256d br = _mm256_load_pd(re + y), bi = _mm256_load_pd(im + y);
+            _mm256_store_pd(re + x, _mm256_sub_pd(_mm256_mul_pd(d0r, ar), _mm256_mul_pd(d0i, ai)));
+            _mm256_store_pd(im + x, _mm256_add_pd(_mm256_mul_pd(d0r, ai), _mm256_mul_pd(d0i, ar)));
+            _mm256_store_pd(re + y, _mm256_sub_pd(_mm256_mul_pd(d1r, br), _mm256_mul_pd(d1i, bi)));
+            _mm256_store_pd(im + y, _mm256_add_pd(_mm256_mul_pd(d1r, bi), _mm256_mul_pd(d1i, br)));
+        }
+    }
+}
+
+AVX2 static void matrix_block_avx2(const BlockJob* job, int block, size_t pair_begin, size_t pair_end) {
+    size_t base = (size_t)block * job->batch->dimension * BATCH_LANES;
+    const LaneGates* g = job->gates;
+    size_t half = (size_t)1 << job->target;
+    for (int offset = 0; offset < BATCH_LANES; offset += 4) {
+        double* re = job->batch->real + base + offset;
+        double* im = job->batch->imag + base + offset;
+        size_t lane = (size_t)block * BATCH_LANES + offset;
+        __m256d m00r = _mm256_loadu_pd(g->entry[M00R] + lane), m00i = _mm256_loadu_pd(g->entry[M00I] + lane);
+        __m256d m01r = _mm256_loadu_pd(g->entry[M01R] + lane), m01i = _mm256_loadu_pd(g->entry[M01I] + lane);
+        __m256d m10r = _mm256_loadu_pd(g->entry[M10R] + lane), m10i = _mm256_loadu_pd(g->entry[M10I] + lane);
+        __m256d m11r = _mm256_loadu_pd(g->entry[M11R] + lane), m11i = _mm256_loadu_pd(g->entry[M11I] + lane);
+        for (size_t p = pair_begin, i0 = pair_index(pair_begin, job->target); p < pair_end;
+             p++, i0 = next_pair_index(i0, half)) {
+            if (!pair_selected(job, i0)) continue;
+            size_t x = i0 * BATCH_LANES, y = x + half * BATCH_LANES;
+            __m256d ar = _mm256_load_pd(re + x), ai = _mm256_load_pd(im + x);
+            __m256d br = _mm256_load_pd(re + y), bi = _mm256_load_pd(im + y);
+            _mm256_store_pd(re + x, _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(m00r, ar), _mm256_mul_pd(m00i, ai)),
+                                                  _mm256_sub_pd(_mm256_mul_pd(m01r, br), _mm256_mul_pd(m01i, bi))));
+            _mm256_store_pd(im + x, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m00r, ai), _mm256_mul_pd(m00i, ar)),
+                                                  _mm256_add_pd(_mm256_mul_pd(m01r, bi), _mm256_mul_pd(m01i, br))));
+            _mm256_store_pd(re + y, _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(m10r, ar), _mm256_mul_pd(m10i, ai)),
+                                                  _mm256_sub_pd(_mm256_mul_pd(m11r, br), _mm256_mul_pd(m11i, bi))));
+            _mm256_store_pd(im + y, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(m10r, ai), _mm256_mul_pd(m10i, ar)),
+                                                  _mm256_add_pd(_mm256_mul_pd(m11r, bi), _mm256_mul_pd(m11i, br))));
+        }
+    }
+}
+
+AVX512 static void diagonal_block_avx512(const BlockJob* job, int block, size_t pair_begin, size_t pair_end) {
+    size_t base = (size_t)block * job->batch->dimension * BATCH_LANES;
+    double* re = job->batch->real + base;
+    double* im = job->batch->imag + base;
+    const LaneGates* g = job->gates;
+    size_t lane = (size_t)block * BATCH_LANES;
+    __m512d d0r = _mm512_loadu_pd(g->entry[M00R] + lane), d0i = _mm512_loadu_pd(g->entry[M00I] + lane);
+    __m512d d1r = _mm512_loadu_pd(g->entry[M11R] + lane), d1i = _mm512_loadu_pd(g->entry[M11I] + lane);
+    size_t half = (size_t)1 << job->target;
+    for (size_t p = pair_begin, i0 = pair_index(pair_begin, job->target); p < pair_end;
+         p++, i0 = next_pair_index(i0, half)) {
+        if (!pair_selected(job, i0)) continue;
+        size_t x = i0 * BATCH_LANES, y = x + half * BATCH_LANES;
+        __m512d ar = _mm512_load_pd(re + x), ai = _mm512_load_pd(im + x);
+        __m512d br = _mm512_load_pd(re + y), bi = _mm512_load_pd(im + y);
+        _mm512_store_pd(re + x, _mm512_sub_pd(_mm512_mul_pd(d0r, ar), _mm512_mul_pd(d0i, ai)));
+        _mm512_store_pd(im + x, _mm512_add_pd(_mm512_mul_pd(d0r, ai), _mm512_mul_pd(d0i, ar)));
+        _mm512_store_pd(re + y, _mm512_sub_pd(_mm512_mul_pd(d1r, br), _mm512_mul_pd(d1i, bi)));
+        _mm512_store_pd(im + y, _mm512_add_pd(_mm512_mul_pd(d1r, bi), _mm512_mul_pd(d1i, br)));
+    }
+}
+
+AVX512 static void matrix_block_avx512(const BlockJob* job, int block, size_t pair_begin, size_t pair_end) {
+    size_t base = (size_t)block * job->batch->dimension * BATCH_LANES;
+    double* re = job->batch->real + base;
+    double* im = job->batch->imag + base;
+    const LaneGates* g = job->gates;
+    size_t lane = (size_t)block * BATCH_LANES;
+    __m512d m00r = _mm512_loadu_pd(g->entry[M00R] + lane), m00i = _mm512_loadu_pd(g->entry[M00I] + lane);
+    __m512d m01r = _mm512_loadu_pd(g->entry[M01R] + lane), m01i = _mm512_loadu_pd(g->entry[M01I] + lane);
+    __m512d m10r = _mm512_loadu_pd(g->entry[M10R] + lane), m10i = _mm512_loadu_pd(g->entry[M10I] + lane);
+    __m512d m11r = _mm512_loadu_pd(g->entry[M11R] + lane), m11i = _mm512_loadu_pd(g->entry[M11I] + lane);
+    size_t half = (size_t)1 << job->target;
+    for (size_t p = pair_begin, i0 = pair_index(pair_begin, job->target); p < pair_end;
+         p++, i0 = next_pair_index(i0, half)) {
+        if (!pair_selected(job, i0)) continue;
+        size_t x = i0 * BATCH_LANES, y = x + half * BATCH_LANES;
+        __m512d ar = _mm512_load_pd(re + x), ai = _mm512_load_pd(im + x);
+        __m512d br = _mm512_load_pd(re + y), bi = _mm512_load_pd(im + y);
+        _mm512_store_pd(re + x, _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(m00r, ar), _mm512_mul_pd(m00i, ai)),
+                                              _mm512_sub_pd(_mm512_mul_pd(m01r, br), _mm512_mul_pd(m01i, bi))));
+        _mm512_store_pd(im + x, _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(m00r, ai), _mm512_mul_pd(m00i, ar)),
+                                              _mm512_add_pd(_mm512_mul_pd(m01r, bi), _mm512_mul_pd(m01i, br))));
+        _mm512_store_pd(re + y, _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(m10r, ar), _mm512_mul_pd(m10i, ai)),
+                                              _mm512_sub_pd(_mm512_mul_pd(m11r, br), _mm512_mul_pd(m11i, bi))));
+        _mm512_store_pd(im + y, _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(m10r, ai), _mm512_mul_pd(m10i, ar)),
+                                              _mm512_add_pd(_mm512_mul_pd(m11r, bi), _mm512_mul_pd(m11i, br))));
+    }
+}
+
+#endif
+
+static void run_block(const BlockJob* job, int block, size_t pair_begin, size_t pair_end) {
+    if (job->kind == LANE_SWAP) {
+        swap_block(job, block, pair_begin, pair_end);
+        return;
+    }
+    bool diagonal = job->kind == LANE_DIAGONAL;
+    switch (get_simd_level()) {
+#ifdef QSIM_HAVE_X86_SIMD
+        case SIMD_AVX512:
+            if (diagonal) diagonal_block_avx512(job, block, pair_begin, pair_end);
+            else matrix_block_avx512(job, block, pair_begin, pair_end);
+            return;
+        case SIMD_AVX2:
+            if (diagonal) diagonal_block_avx2(job, block, pair_begin, pair_end);
+            else matrix_block_avx2(job, block, pair_begin, pair_end);
+            return;
+#endif
+        default:
+            if (diagonal) diagonal_block_scalar(job, block, pair_begin, pair_end);
+            else matrix_block_scalar(job, block, pair_begin, pair_end);
+            return;
+    }
+}
+
+// Splitting
+
+// With a block per thread or more, threads take whole blocks and share nothing
+static bool split_by_blocks(const StateBatch* batch) {
+    return batch->num_blocks >= thread_pool_get_num_threads();
+}
+
+static void block_split_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const BlockJob* job = context;
+    for (size_t block = begin; block < end; block++) run_block(job, (int)block, 0, job->batch->dimension / 2);
+}
+
+static void pair_split_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const BlockJob* job = context;
+    for (int block = 0; block < job->batch->num_blocks; block++) run_block(job, block, begin, end);
+}
+
+static void run_block_job(const BlockJob* job) {
+    if (split_by_blocks(job->batch)) parallel_for_items((size_t)job->batch->num_blocks, block_split_task, (void*)job);
+    else parallel_for(job->batch->dimension / 2, pair_split_task, (void*)job);
+}
+
+// Gates
+
+static bool valid_qubits(const StateBatch* batch, int control, int target) {
+    if (target < 0 || target >= batch->num_qubits ||
+        (control != NO_CONTROL && (control < 0 || control >= batch->num_qubits || control == target))) {
+        fprintf(stderr, "Error: Invalid qubit index\n");
+        return false;
+    }
+    return true;
+}
+
+bool apply_batch_gates(StateBatch* batch, const QuantumGate* gates, int control, int target) {
+    if (!batch || !gates) {
+        fprintf(stderr, "Error: Invalid parameters for batch gate\n");
+        return false;
+    }
+    if (!valid_qubits(batch, control, target)) return false;
+    LaneGates lane_gates;
+    if (!allocate_lane_gates(&lane_gates, batch)) return false;
+    for (int b = 0; b < batch->batch_size; b++) set_lane_gate(&lane_gates, b, &gates[b]);
+    set_padding_gates(&lane_gates, batch);
+
+    INSTRUMENT_BEGIN(span);
+    BlockJob job = {batch, &lane_gates, LANE_MATRIX, control, target};
+    run_block_job(&job);
+    INSTRUMENT_END(span, "kernel", "batch-gates", target, control, batch->dimension / 2 * batch->batch_size,
+                   2 * batch->dimension * batch->batch_size * BYTES_PER_AMPLITUDE);
+    free_lane_gates(&lane_gates);
+    return true;
+}
+
+// Circuits
+
+typedef struct {
+    const Circuit* circuit;
+    const StateBatch* batch;
+    const double* params;
+    bool failed;
+} CircuitBatchJob;
+
+// Consecutive uncontrolled ops on one target are applied as one per-lane product, the
+// batch counterpart of fusing gates in compile_circuit(). Returns the end of the run
+// starting at first and its kernel.
+static int op_run(const Circuit* circuit, int first, LaneKind* kind) {
+    const CircuitOp* op = &circuit->ops[first];
+    int end = first + 1;
+    *kind = lane_kind(op->op);
+    if (op->control != NO_CONTROL) return end;
+    bool diagonal = *kind == LANE_DIAGONAL;
+    while (end < circuit->num_ops && circuit->ops[end].control == NO_CONTROL &&
+           circuit->ops[end].target == op->target) {
+        diagonal = diagonal && lane_kind(circuit->ops[end].op) == LANE_DIAGONAL;
+        end++;
+    }
+    if (end > first + 1) *kind = diagonal ? LANE_DIAGONAL : LANE_MATRIX;
+    return end;
+}
+
+// Fills the lanes of blocks [first_block, last_block) with the product of ops
+// [first, end), bound to each lane's parameters
+static void bind_lane_gates(const CircuitBatchJob* job, int first, int end, LaneGates* gates, int first_block,
+                            int last_block) {
+    int lane_begin = first_block * BATCH_LANES;
+    int lane_end = last_block * BATCH_LANES < job->batch->batch_size ? last_block * BATCH_LANES : job->batch->batch_size;
+    const CircuitOp* ops = job->circuit->ops;
+    bool fixed = true;
+    for (int i = first; i < end; i++) fixed = fixed && ops[i].param_index < 0;
+    if (fixed) {
+        QuantumGate gate = circuit_op_gate(&ops[first], NULL);
+        for (int i = first + 1; i < end; i++) gate = multiply_gates(circuit_op_gate(&ops[i], NULL), gate);
+        for (int b = lane_begin; b < lane_end; b++) set_lane_gate(gates, b, &gate);
+        return;
+    }
+    for (int b = lane_begin; b < lane_end; b++) {
+        const double* params = job->params + (size_t)b * job->circuit->num_params;
+        QuantumGate gate = circuit_op_gate(&ops[first], params);
+        for (int i = first + 1; i < end; i++) gate = multiply_gates(circuit_op_gate(&ops[i], params), gate);
+        set_lane_gate(gates, b, &gate);
+    }
+}
+
+// The whole circuit on blocks [begin, end), one block at a time so that it stays in cache
+// from one gate to the next
+static void circuit_blocks_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    CircuitBatchJob* job = context;
+    LaneGates gates;
+    if (!allocate_lane_gates(&gates, job->batch)) {
+        job->failed = true;
+        return;
+    }
+    set_padding_gates(&gates, job->batch);
+    for (size_t block = begin; block < end; block++) {
+        for (int i = 0, run_end; i < job->circuit->num_ops; i = run_end) {
+            const CircuitOp* op = &job->circuit->ops[i];
+            BlockJob block_job = {job->batch, &gates, LANE_MATRIX, op->control, op->target};
+            run_end = op_run(job->circuit, i, &block_job.kind);
+            if (block_job.kind != LANE_SWAP) bind_lane_gates(job, i, run_end, &gates, (int)block, (int)block + 1);
+            run_block(&block_job, (int)block, 0, job->batch->dimension / 2);
+        }
+    }
+    free_lane_gates(&gates);
+}
+
+bool run_circuit_batch(const Circuit* circuit, StateBatch* batch, const double* params) {
+    if (!circuit || !batch || (circuit->num_params > 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for batch circuit run\n");
+        return false;
+    }
+    if (circuit->num_qubits > batch->num_qubits) {
+        fprintf(stderr, "Error: State batch is too small for the circuit\n");
+        return false;
+    }
+    CircuitBatchJob job = {circuit, batch, params, false};
+    INSTRUMENT_BEGIN(span);
+    if (split_by_blocks(batch)) {
+        parallel_for_items((size_t)batch->num_blocks, circuit_blocks_task, &job);
+        if (job.failed) fprintf(stderr, "Error: Batch circuit run failed\n");
+    } else {
+        // Fewer blocks than threads: one gate at a time, each split over the amplitude pairs
+        LaneGates gates;
+        job.failed = !allocate_lane_gates(&gates, batch);
+        if (!job.failed) {
+            set_padding_gates(&gates, batch);
+            for (int i = 0, end; i < circuit->num_ops; i = end) {
+                const CircuitOp* op = &circuit->ops[i];
+                BlockJob block_job = {batch, &gates, LANE_MATRIX, op->control, op->target};
+                end = op_run(circuit, i, &block_job.kind);
+                if (block_job.kind != LANE_SWAP) bind_lane_gates(&job, i, end, &gates, 0, batch->num_blocks);
+                parallel_for(batch->dimension / 2, pair_split_task, &block_job);
+            }
+            free_lane_gates(&gates);
+        }
+    }
+    INSTRUMENT_END(span, "kernel", "batch-circuit", NO_CONTROL, NO_CONTROL,
+                   batch->dimension / 2 * batch->batch_size * circuit->num_ops,
+                   2 * batch->dimension * batch->batch_size * BYTES_PER_AMPLITUDE * circuit->num_ops);
+    return !job.failed;
+}
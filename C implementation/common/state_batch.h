@@ -0,0 +1,48 @@
+// state_batch.h
+#ifndef STATE_BATCH_H
+#define STATE_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "statevector_core.h"
+#include "circuit.h"
+
+// States per block: the doubles of one cache line and of one AVX-512 register
+#define BATCH_LANES 8
+
+// batch_size statevectors of the same size, interleaved amplitude by amplitude in blocks
+// of BATCH_LANES states ("lanes"): amplitude i of state b is element
+// ((b / BATCH_LANES) * dimension + i) * BATCH_LANES + b % BATCH_LANES of real and imag.
+// The copies of one amplitude across a block fill a cache line, so a gate updates all the
+// block's states with full-width SIMD operations, each lane with its own 2x2 matrix,
+// whatever the target qubit. One block is contiguous, so it can run a whole circuit while
+// it stays in cache. The last block is padded with states nothing reads back: matrix gates
+// give them the identity, but swaps exchange all BATCH_LANES lanes of a block at once.
+typedef struct {
+    int num_qubits;
+    int batch_size;
+    int num_blocks;
+    size_t dimension;
+    double* real;
+    double* imag;
+} StateBatch;
+
+StateBatch* create_state_batch(int num_qubits, int batch_size);  // every state |0...0⟩
+void free_state_batch(StateBatch* batch);
+bool initialize_state_batch(StateBatch* batch);
+
+// Copies state b in from or out to an ordinary statevector with as many qubits
+bool load_batch_state(StateBatch* batch, int b, const Statevector* sv);
+bool store_batch_state(const StateBatch* batch, int b, Statevector* sv);
+
+// gates[b] acts on state b, on target, controlled by control or NO_CONTROL
+bool apply_batch_gates(StateBatch* batch, const QuantumGate* gates, int control, int target);
+
+// Runs the circuit on every state of the batch, continuing from their current contents.
+// Row b of params (circuit->num_params values) binds the parameters of state b; params may
+// be NULL for a circuit without parametric ops. With at least as many blocks as threads,
+// each thread takes whole blocks through the whole circuit, one block at a time and
+// without synchronizing per gate; otherwise every gate is split over the amplitude pairs.
+bool run_circuit_batch(const Circuit* circuit, StateBatch* batch, const double* params);
+
+#endif // STATE_BATCH_H
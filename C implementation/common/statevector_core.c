@@ -0,0 +1,1067 @@
+// statevector_core.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "statevector_core.h"
+#include "thread_pool.h"
+#include "state_allocator.h"
+#include "instrumentation.h"
+
+// The SIMD kernels must produce the same bits as the scalar loops, so the compiler
+// may not fuse a multiply and an add into an FMA in either path.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define QSIM_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// State management
+
+size_t statevector_bytes(int num_qubits) {
+    return ((size_t)1 << num_qubits) * BYTES_PER_AMPLITUDE;
+}
+
+int max_qubits_for_memory(size_t bytes) {
+    int num_qubits = 0;
+    while (num_qubits < 62 && statevector_bytes(num_qubits + 1) <= bytes) {
+        num_qubits++;
+    }
+    return num_qubits;
+}
+
+Statevector* create_statevector(int num_qubits) {
+    if (num_qubits < 0 || num_qubits > 62) {
+        fprintf(stderr, "Error: Invalid number of qubits\n");
+        return NULL;
+    }
+
+    Statevector* sv = malloc(sizeof(Statevector));
+    if (!sv) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    sv->num_qubits = num_qubits;
+    sv->dimension = (size_t)1 << num_qubits;
+    sv->real = NULL;
+    sv->imag = NULL;
+
+    size_t bytes = sv->dimension * sizeof(double);
+    sv->real = allocate_state_buffer(bytes);
+    sv->imag = allocate_state_buffer(bytes);
+    if (!sv->real || !sv->imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_statevector(sv);
+        return NULL;
+    }
+
+    INSTRUMENT_ALLOC(2 * bytes);
+    // Also the first touch of the pages, from the workers that will process them
+    initialize_statevector(sv);
+    return sv;
+}
+
+void free_statevector(Statevector* sv) {
+    if (!sv) return;
+    free_state_buffer(sv->real, sv->dimension * sizeof(double));
+    free_state_buffer(sv->imag, sv->dimension * sizeof(double));
+    free(sv);
+}
+
+static void zero_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    Statevector* sv = context;
+    memset(sv->real + begin, 0, (end - begin) * sizeof(double));
+    memset(sv->imag + begin, 0, (end - begin) * sizeof(double));
+}
+
+bool initialize_statevector(Statevector* sv) {
+    if (!sv) return false;
+
+    parallel_for(sv->dimension, zero_task, sv);
+    sv->real[0] = 1.0;  // Initialize to |0...0⟩
+    return true;
+}
+
+bool copy_statevector(Statevector* dst, const Statevector* src) {
+    if (!dst || !src || dst->dimension != src->dimension) {
+        fprintf(stderr, "Error: Statevector dimensions do not match\n");
+        return false;
+    }
+    memcpy(dst->real, src->real, src->dimension * sizeof(double));
+    memcpy(dst->imag, src->imag, src->dimension * sizeof(double));
+    return true;
+}
+
+void print_statevector(const Statevector* sv) {
+    if (!sv) return;
+
+    printf("Statevector (%d qubits):\n", sv->num_qubits);
+    for (size_t i = 0; i < sv->dimension; i++) {
+        if (fabs(sv->real[i]) > 1e-10 || fabs(sv->imag[i]) > 1e-10) {  // Only print non-zero amplitudes
+            printf("|%zu⟩: %.6f %+.6fi\n", i, sv->real[i], sv->imag[i]);
+        }
+    }
+    printf("\n");
+}
+
+double statevector_norm(const Statevector* sv) {
+    double sum = 0.0;
+    for (size_t i = 0; i < sv->dimension; i++) {
+        sum += sv->real[i] * sv->real[i] + sv->imag[i] * sv->imag[i];
+    }
+    return sqrt(sum);
+}
+
+// Standard gates
+
+QuantumGate get_x_gate(void) {
+    QuantumGate X = {
+        .elements = {
+            {{0.0, 0.0}, {1.0, 0.0}},
+            {{1.0, 0.0}, {0.0, 0.0}}
+        }
+    };
+    return X;
+}
+
+QuantumGate get_y_gate(void) {
+    QuantumGate Y = {
+        .elements = {
+            {{0.0, 0.0}, {0.0, -1.0}},
+            {{0.0, 1.0}, {0.0,  0.0}}
+        }
+    };
+    return Y;
+}
+
+QuantumGate get_z_gate(void) {
+    QuantumGate Z = {
+        .elements = {
+            {{1.0, 0.0}, { 0.0, 0.0}},
+            {{0.0, 0.0}, {-1.0, 0.0}}
+        }
+    };
+    return Z;
+}
+
+QuantumGate get_hadamard_gate(void) {
+    double inv_sqrt_2 = 1.0 / sqrt(2);
+    QuantumGate H = {
+        .elements = {
+            {{inv_sqrt_2, 0.0}, { inv_sqrt_2, 0.0}},
+            {{inv_sqrt_2, 0.0}, {-inv_sqrt_2, 0.0}}
+        }
+    };
+    return H;
+}
+
+QuantumGate get_s_gate(void) {
+    QuantumGate S = {
+        .elements = {
+            {{1.0, 0.0}, {0.0, 0.0}},
+            {{0.0, 0.0}, {0.0, 1.0}}  // e^{iπ/2}
+        }
+    };
+    return S;
+}
+
+QuantumGate get_t_gate(void) {
+    double inv_sqrt_2 = 1.0 / sqrt(2);
+    QuantumGate T = {
+        .elements = {
+            {{1.0, 0.0}, {0.0, 0.0}},
+            {{0.0, 0.0}, {inv_sqrt_2, inv_sqrt_2}}  // e^{iπ/4}
+        }
+    };
+    return T;
+}
+
+QuantumGate get_rx_gate(double theta) {
+    double c = cos(theta / 2), s = sin(theta / 2);
+    QuantumGate RX = {
+        .elements = {
+            {{c, 0.0}, {0.0, -s}},
+            {{0.0, -s}, {c, 0.0}}
+        }
+    };
+    return RX;
+}
+
+QuantumGate get_ry_gate(double theta) {
+    double c = cos(theta / 2), s = sin(theta / 2);
+    QuantumGate RY = {
+        .elements = {
+            {{c, 0.0}, {-s, 0.0}},
+            {{s, 0.0}, { c, 0.0}}
+        }
+    };
+    return RY;
+}
+
+QuantumGate get_rz_gate(double theta) {
+    double c = cos(theta / 2), s = sin(theta / 2);
+    QuantumGate RZ = {
+        .elements = {
+            {{c, -s}, {0.0, 0.0}},
+            {{0.0, 0.0}, {c, s}}
+        }
+    };
+    return RZ;
+}
+
+QuantumGate multiply_gates(QuantumGate a, QuantumGate b) {
+    QuantumGate product;
+    for (int r = 0; r < 2; r++) {
+        for (int c = 0; c < 2; c++) {
+            Complex x0 = a.elements[r][0], y0 = b.elements[0][c];
+            Complex x1 = a.elements[r][1], y1 = b.elements[1][c];
+            product.elements[r][c].real = (x0.real * y0.real - x0.imag * y0.imag) + (x1.real * y1.real - x1.imag * y1.imag);
+            product.elements[r][c].imag = (x0.real * y0.imag + x0.imag * y0.real) + (x1.real * y1.imag + x1.imag * y1.real);
+        }
+    }
+    return product;
+}
+
+// Pair enumeration. Pair p of a target qubit consists of the amplitude whose index is p
+// with a zero bit inserted at the target position and its partner stride = 2^target
+// above it. Kernels receive a range [begin, end) of pair indices and walk it as runs of
+// consecutive lower indices, so they can be split across threads at any chunk boundary.
+
+static inline size_t pair_lower_index(size_t p, int target) {
+    size_t low = p & (((size_t)1 << target) - 1);
+    return ((p - low) << 1) | low;
+}
+
+static inline size_t pair_run_length(size_t p, size_t end, size_t stride) {
+    size_t run = stride - (p & (stride - 1));
+    return run < end - p ? run : end - p;
+}
+
+// x with a zero bit inserted at each of the ascending positions sorted_bits[0..count)
+static inline size_t insert_zero_bits(size_t x, const int* sorted_bits, int count) {
+    for (int b = 0; b < count; b++) x = pair_lower_index(x, sorted_bits[b]);
+    return x;
+}
+
+// Scalar kernels
+
+static void swap_pairs_scalar(double* re, double* im, size_t begin, size_t end, int target) {
+    size_t stride = (size_t)1 << target;
+    for (size_t p = begin; p < end;) {
+        size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+        for (size_t j = j0; j < j0 + run; j++) {
+            size_t k = j + stride;
+            double t = re[j]; re[j] = re[k]; re[k] = t;
+            t = im[j]; im[j] = im[k]; im[k] = t;
+        }
+        p += run;
+    }
+}
+
+static void hadamard_pairs_scalar(double* re, double* im, size_t begin, size_t end, int target) {
+    size_t stride = (size_t)1 << target;
+    double c = 1.0 / sqrt(2.0);
+    for (size_t p = begin; p < end;) {
+        size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+        for (size_t j = j0; j < j0 + run; j++) {
+            size_t k = j + stride;
+            double a = re[j], b = re[k];
+            re[j] = c * (a + b);
+            re[k] = c * (a - b);
+            a = im[j]; b = im[k];
+            im[j] = c * (a + b);
+            im[k] = c * (a - b);
+        }
+        p += run;
+    }
+}
+
+static void phase_pairs_scalar(double* re, double* im, size_t begin, size_t end, int target, Complex ph) {
+    size_t stride = (size_t)1 << target;
+    for (size_t p = begin; p < end;) {
+        size_t run = pair_run_length(p, end, stride), k0 = pair_lower_index(p, target) + stride;
+        for (size_t k = k0; k < k0 + run; k++) {
+            double br = re[k], bi = im[k];
+            re[k] = ph.real * br - ph.imag * bi;
+            im[k] = ph.real * bi + ph.imag * br;
+        }
+        p += run;
+    }
+}
+
+static void diagonal_pairs_scalar(double* re, double* im, size_t begin, size_t end, int target, const Complex* d) {
+    size_t stride = (size_t)1 << target;
+    Complex d0 = d[0], d1 = d[1];
+    for (size_t p = begin; p < end;) {
+        size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+        for (size_t j = j0; j < j0 + run; j++) {
+            size_t k = j + stride;
+            double ar = re[j], ai = im[j], br = re[k], bi = im[k];
+            re[j] = d0.real * ar - d0.imag * ai;
+            im[j] = d0.real * ai + d0.imag * ar;
+            re[k] = d1.real * br - d1.imag * bi;
+            im[k] = d1.real * bi + d1.imag * br;
+        }
+        p += run;
+    }
+}
+
+static void matrix_pairs_scalar(double* re, double* im, size_t begin, size_t end, int target, const QuantumGate* g) {
+    size_t stride = (size_t)1 << target;
+    Complex m00 = g->elements[0][0], m01 = g->elements[0][1];
+    Complex m10 = g->elements[1][0], m11 = g->elements[1][1];
+    for (size_t p = begin; p < end;) {
+        size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+        for (size_t j = j0; j < j0 + run; j++) {
+            size_t k = j + stride;
+            double ar = re[j], ai = im[j], br = re[k], bi = im[k];
+            re[j] = (m00.real * ar - m00.imag * ai) + (m01.real * br - m01.imag * bi);
+            im[j] = (m00.real * ai + m00.imag * ar) + (m01.real * bi + m01.imag * br);
+            re[k] = (m10.real * ar - m10.imag * ai) + (m11.real * br - m11.imag * bi);
+            im[k] = (m10.real * ai + m10.imag * ar) + (m11.real * bi + m11.imag * br);
+        }
+        p += run;
+    }
+}
+
+#ifdef QSIM_HAVE_X86_SIMD
+
+// AVX2 kernels (4 doubles per register). When stride >= 4 the two halves of a pair
+// live in different registers; for stride 1 and 2 both halves share one register and
+// the partner amplitude is brought in with a permute. In that case the pairs
+// [begin, end) are exactly the amplitudes [2 * begin, 2 * end).
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256d avx2_partner(__m256d v, size_t stride) {
+    return stride == 1 ? _mm256_permute_pd(v, 0x5) : _mm256_permute4x64_pd(v, 0x4E);
+}
+
+AVX2 static inline __m256d avx2_upper_mask(size_t stride) {
+    return stride == 1 ? _mm256_castsi256_pd(_mm256_set_epi64x(-1, 0, -1, 0))
+                       : _mm256_castsi256_pd(_mm256_set_epi64x(-1, -1, 0, 0));
+}
+
+AVX2 static void swap_pairs_avx2(double* re, double* im, size_t begin, size_t end, int target) {
+    size_t stride = (size_t)1 << target;
+    if (stride >= 4) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+            for (size_t j = j0; j < j0 + run; j += 4) {
+                size_t k = j + stride;
+                __m256d ar = _mm256_loadu_pd(re + j), br = _mm256_loadu_pd(re + k);
+                __m256d ai = _mm256_loadu_pd(im + j), bi = _mm256_loadu_pd(im + k);
+                _mm256_storeu_pd(re + j, br); _mm256_storeu_pd(re + k, ar);
+                _mm256_storeu_pd(im + j, bi); _mm256_storeu_pd(im + k, ai);
+            }
+            p += run;
+        }
+        return;
+    }
+    for (size_t i = 2 * begin; i < 2 * end; i += 4) {
+        _mm256_storeu_pd(re + i, avx2_partner(_mm256_loadu_pd(re + i), stride));
+        _mm256_storeu_pd(im + i, avx2_partner(_mm256_loadu_pd(im + i), stride));
+    }
+}
+
+AVX2 static void hadamard_pairs_avx2(double* re, double* im, size_t begin, size_t end, int target) {
+    size_t stride = (size_t)1 << target;
+    __m256d c = _mm256_set1_pd(1.0 / sqrt(2.0));
+    if (stride >= 4) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+            for (size_t j = j0; j < j0 + run; j += 4) {
+                size_t k = j + stride;
+                __m256d a = _mm256_loadu_pd(re + j), b = _mm256_loadu_pd(re + k);
+                _mm256_storeu_pd(re + j, _mm256_mul_pd(c, _mm256_add_pd(a, b)));
+                _mm256_storeu_pd(re + k, _mm256_mul_pd(c, _mm256_sub_pd(a, b)));
+                a = _mm256_loadu_pd(im + j); b = _mm256_loadu_pd(im + k);
+                _mm256_storeu_pd(im + j, _mm256_mul_pd(c, _mm256_add_pd(a, b)));
+                _mm256_storeu_pd(im + k, _mm256_mul_pd(c, _mm256_sub_pd(a, b)));
+            }
+            p += run;
+        }
+        return;
+    }
+    __m256d upper = avx2_upper_mask(stride);
+    for (size_t i = 2 * begin; i < 2 * end; i += 4) {
+        __m256d v = _mm256_loadu_pd(re + i), w = avx2_partner(v, stride);
+        // Lower lanes hold a (a + b), upper lanes hold b (a - b = w - v)
+        __m256d t = _mm256_blendv_pd(_mm256_add_pd(v, w), _mm256_sub_pd(w, v), upper);
+        _mm256_storeu_pd(re + i, _mm256_mul_pd(c, t));
+        v = _mm256_loadu_pd(im + i); w = avx2_partner(v, stride);
+        t = _mm256_blendv_pd(_mm256_add_pd(v, w), _mm256_sub_pd(w, v), upper);
+        _mm256_storeu_pd(im + i, _mm256_mul_pd(c, t));
+    }
+}
+
+AVX2 static void phase_pairs_avx2(double* re, double* im, size_t begin, size_t end, int target, Complex ph) {
+    size_t stride = (size_t)1 << target;
+    __m256d pr = _mm256_set1_pd(ph.real), pi = _mm256_set1_pd(ph.imag);
+    if (stride >= 4) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), k0 = pair_lower_index(p, target) + stride;
+            for (size_t k = k0; k < k0 + run; k += 4) {
+                __m256d br = _mm256_loadu_pd(re + k), bi = _mm256_loadu_pd(im + k);
+                _mm256_storeu_pd(re + k, _mm256_sub_pd(_mm256_mul_pd(pr, br), _mm256_mul_pd(pi, bi)));
+                _mm256_storeu_pd(im + k, _mm256_add_pd(_mm256_mul_pd(pr, bi), _mm256_mul_pd(pi, br)));
+            }
+            p += run;
+        }
+        return;
+    }
+    __m256d upper = avx2_upper_mask(stride);
+    for (size_t i = 2 * begin; i < 2 * end; i += 4) {
+        __m256d vr = _mm256_loadu_pd(re + i), vi = _mm256_loadu_pd(im + i);
+        __m256d nr = _mm256_sub_pd(_mm256_mul_pd(pr, vr), _mm256_mul_pd(pi, vi));
+        __m256d ni = _mm256_add_pd(_mm256_mul_pd(pr, vi), _mm256_mul_pd(pi, vr));
+        _mm256_storeu_pd(re + i, _mm256_blendv_pd(vr, nr, upper));
+        _mm256_storeu_pd(im + i, _mm256_blendv_pd(vi, ni, upper));
+    }
+}
+
+AVX2 static void diagonal_pairs_avx2(double* re, double* im, size_t begin, size_t end, int target, const Complex* d) {
+    size_t stride = (size_t)1 << target;
+    __m256d d0r = _mm256_set1_pd(d[0].real), d0i = _mm256_set1_pd(d[0].imag);
+    __m256d d1r = _mm256_set1_pd(d[1].real), d1i = _mm256_set1_pd(d[1].imag);
+    if (stride >= 4) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+            for (size_t j = j0; j < j0 + run; j += 4) {
+                size_t k = j + stride;
+                __m256d ar = _mm256_loadu_pd(re + j), ai = _mm256_loadu_pd(im + j);
+                __m256d br = _mm256_loadu_pd(re + k), bi = _mm256_loadu_pd(im + k);
+                _mm256_storeu_pd(re + j, _mm256_sub_pd(_mm256_mul_pd(d0r, ar), _mm256_mul_pd(d0i, ai)));
+                _mm256_storeu_pd(im + j, _mm256_add_pd(_mm256_mul_pd(d0r, ai), _mm256_mul_pd(d0i, ar)));
+                _mm256_storeu_pd(re + k, _mm256_sub_pd(_mm256_mul_pd(d1r, br), _mm256_mul_pd(d1i, bi)));
+                _mm256_storeu_pd(im + k, _mm256_add_pd(_mm256_mul_pd(d1r, bi), _mm256_mul_pd(d1i, br)));
+            }
+            p += run;
+        }
+        return;
+    }
+    // Lower lanes are scaled by d0, upper lanes by d1
+    __m256d upper = avx2_upper_mask(stride);
+    __m256d cr = _mm256_blendv_pd(d0r, d1r, upper), ci = _mm256_blendv_pd(d0i, d1i, upper);
+    for (size_t i = 2 * begin; i < 2 * end; i += 4) {
+        __m256d vr = _mm256_loadu_pd(re + i), vi = _mm256_loadu_pd(im + i);
+        _mm256_storeu_pd(re + i, _mm256_sub_pd(_mm256_mul_pd(cr, vr), _mm256_mul_pd(ci, vi)));
+        _mm256_storeu_pd(im + i, _mm256_add_pd(_mm256_mul_pd(cr, vi), _mm256_mul_pd(ci, vr)));
+    }
+}
+
+AVX2 static inline void avx2_cmul_add(__m256d xr, __m256d xi, __m256d yr, __m256d yi,
+                                      __m256d cr, __m256d ci, __m256d dr, __m256d di,
+                                      __m256d* out_r, __m256d* out_i) {
+    // out = (c * x) + (d * y), grouped exactly as in matrix_pairs_scalar
+    *out_r = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(cr, xr), _mm256_mul_pd(ci, xi)),
+                           _mm256_sub_pd(_mm256_mul_pd(dr, yr), _mm256_mul_pd(di, yi)));
+    *out_i = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(cr, xi), _mm256_mul_pd(ci, xr)),
+                           _mm256_add_pd(_mm256_mul_pd(dr, yi), _mm256_mul_pd(di, yr)));
+}
+
+AVX2 static void matrix_pairs_avx2(double* re, double* im, size_t begin, size_t end, int target, const QuantumGate* g) {
+    size_t stride = (size_t)1 << target;
+    __m256d m00r = _mm256_set1_pd(g->elements[0][0].real), m00i = _mm256_set1_pd(g->elements[0][0].imag);
+    __m256d m01r = _mm256_set1_pd(g->elements[0][1].real), m01i = _mm256_set1_pd(g->elements[0][1].imag);
+    __m256d m10r = _mm256_set1_pd(g->elements[1][0].real), m10i = _mm256_set1_pd(g->elements[1][0].imag);
+    __m256d m11r = _mm256_set1_pd(g->elements[1][1].real), m11i = _mm256_set1_pd(g->elements[1][1].imag);
+    __m256d nr, ni;
+    if (stride >= 4) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+            for (size_t j = j0; j < j0 + run; j += 4) {
+                size_t k = j + stride;
+                __m256d ar = _mm256_loadu_pd(re + j), ai = _mm256_loadu_pd(im + j);
+                __m256d br = _mm256_loadu_pd(re + k), bi = _mm256_loadu_pd(im + k);
+                avx2_cmul_add(ar, ai, br, bi, m00r, m00i, m01r, m01i, &nr, &ni);
+                _mm256_storeu_pd(re + j, nr); _mm256_storeu_pd(im + j, ni);
+                avx2_cmul_add(ar, ai, br, bi, m10r, m10i, m11r, m11i, &nr, &ni);
+                _mm256_storeu_pd(re + k, nr); _mm256_storeu_pd(im + k, ni);
+            }
+            p += run;
+        }
+        return;
+    }
+    // Lower lanes: self * m00 + partner * m01, upper lanes: self * m11 + partner * m10
+    __m256d upper = avx2_upper_mask(stride);
+    __m256d sr = _mm256_blendv_pd(m00r, m11r, upper), si = _mm256_blendv_pd(m00i, m11i, upper);
+    __m256d pr = _mm256_blendv_pd(m01r, m10r, upper), pi = _mm256_blendv_pd(m01i, m10i, upper);
+    for (size_t i = 2 * begin; i < 2 * end; i += 4) {
+        __m256d vr = _mm256_loadu_pd(re + i), vi = _mm256_loadu_pd(im + i);
+        __m256d wr = avx2_partner(vr, stride), wi = avx2_partner(vi, stride);
+        avx2_cmul_add(vr, vi, wr, wi, sr, si, pr, pi, &nr, &ni);
+        _mm256_storeu_pd(re + i, nr); _mm256_storeu_pd(im + i, ni);
+    }
+}
+
+// AVX-512 kernels (8 doubles per register), same structure with strides 1, 2 and 4
+// handled in-register through a lane permutation.
+
+#define AVX512 __attribute__((target("avx512f")))
+
+AVX512 static inline __m512i avx512_partner_index(size_t stride) {
+    long long idx[8];
+    for (int lane = 0; lane < 8; lane++) idx[lane] = lane ^ (long long)stride;
+    return _mm512_loadu_si512(idx);
+}
+
+static inline __mmask8 avx512_upper_mask(size_t stride) {
+    __mmask8 mask = 0;
+    for (int lane = 0; lane < 8; lane++) {
+        if (lane & stride) mask |= (__mmask8)(1 << lane);
+    }
+    return mask;
+}
+
+AVX512 static void swap_pairs_avx512(double* re, double* im, size_t begin, size_t end, int target) {
+    size_t stride = (size_t)1 << target;
+    if (stride >= 8) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+            for (size_t j = j0; j < j0 + run; j += 8) {
+                size_t k = j + stride;
+                __m512d ar = _mm512_loadu_pd(re + j), br = _mm512_loadu_pd(re + k);
+                __m512d ai = _mm512_loadu_pd(im + j), bi = _mm512_loadu_pd(im + k);
+                _mm512_storeu_pd(re + j, br); _mm512_storeu_pd(re + k, ar);
+                _mm512_storeu_pd(im + j, bi); _mm512_storeu_pd(im + k, ai);
+            }
+            p += run;
+        }
+        return;
+    }
+    __m512i idx = avx512_partner_index(stride);
+    for (size_t i = 2 * begin; i < 2 * end; i += 8) {
+        _mm512_storeu_pd(re + i, _mm512_permutexvar_pd(idx, _mm512_loadu_pd(re + i)));
+        _mm512_storeu_pd(im + i, _mm512_permutexvar_pd(idx, _mm512_loadu_pd(im + i)));
+    }
+}
+
+AVX512 static void hadamard_pairs_avx512(double* re, double* im, size_t begin, size_t end, int target) {
+    size_t stride = (size_t)1 << target;
+    __m512d c = _mm512_set1_pd(1.0 / sqrt(2.0));
+    if (stride >= 8) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+            for (size_t j = j0; j < j0 + run; j += 8) {
+                size_t k = j + stride;
+                __m512d a = _mm512_loadu_pd(re + j), b = _mm512_loadu_pd(re + k);
+                _mm512_storeu_pd(re + j, _mm512_mul_pd(c, _mm512_add_pd(a, b)));
+                _mm512_storeu_pd(re + k, _mm512_mul_pd(c, _mm512_sub_pd(a, b)));
+                a = _mm512_loadu_pd(im + j); b = _mm512_loadu_pd(im + k);
+                _mm512_storeu_pd(im + j, _mm512_mul_pd(c, _mm512_add_pd(a, b)));
+                _mm512_storeu_pd(im + k, _mm512_mul_pd(c, _mm512_sub_pd(a, b)));
+            }
+            p += run;
+        }
+        return;
+    }
+    __m512i idx = avx512_partner_index(stride);
+    __mmask8 upper = avx512_upper_mask(stride);
+    for (size_t i = 2 * begin; i < 2 * end; i += 8) {
+        __m512d v = _mm512_loadu_pd(re + i), w = _mm512_permutexvar_pd(idx, v);
+        __m512d t = _mm512_mask_blend_pd(upper, _mm512_add_pd(v, w), _mm512_sub_pd(w, v));
+        _mm512_storeu_pd(re + i, _mm512_mul_pd(c, t));
+        v = _mm512_loadu_pd(im + i); w = _mm512_permutexvar_pd(idx, v);
+        t = _mm512_mask_blend_pd(upper, _mm512_add_pd(v, w), _mm512_sub_pd(w, v));
+        _mm512_storeu_pd(im + i, _mm512_mul_pd(c, t));
+    }
+}
+
+AVX512 static void phase_pairs_avx512(double* re, double* im, size_t begin, size_t end, int target, Complex ph) {
+    size_t stride = (size_t)1 << target;
+    __m512d pr = _mm512_set1_pd(ph.real), pi = _mm512_set1_pd(ph.imag);
+    if (stride >= 8) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), k0 = pair_lower_index(p, target) + stride;
+            for (size_t k = k0; k < k0 + run; k += 8) {
+                __m512d br = _mm512_loadu_pd(re + k), bi = _mm512_loadu_pd(im + k);
+                _mm512_storeu_pd(re + k, _mm512_sub_pd(_mm512_mul_pd(pr, br), _mm512_mul_pd(pi, bi)));
+                _mm512_storeu_pd(im + k, _mm512_add_pd(_mm512_mul_pd(pr, bi), _mm512_mul_pd(pi, br)));
+            }
+            p += run;
+        }
+        return;
+    }
+    __mmask8 upper = avx512_upper_mask(stride);
+    for (size_t i = 2 * begin; i < 2 * end; i += 8) {
+        __m512d vr = _mm512_loadu_pd(re + i), vi = _mm512_loadu_pd(im + i);
+        __m512d nr = _mm512_sub_pd(_mm512_mul_pd(pr, vr), _mm512_mul_pd(pi, vi));
+        __m512d ni = _mm512_add_pd(_mm512_mul_pd(pr, vi), _mm512_mul_pd(pi, vr));
+        _mm512_storeu_pd(re + i, _mm512_mask_blend_pd(upper, vr, nr));
+        _mm512_storeu_pd(im + i, _mm512_mask_blend_pd(upper, vi, ni));
+    }
+}
+
+AVX512 static void diagonal_pairs_avx512(double* re, double* im, size_t begin, size_t end, int target, const Complex* d) {
+    size_t stride = (size_t)1 << target;
+    __m512d d0r = _mm512_set1_pd(d[0].real), d0i = _mm512_set1_pd(d[0].imag);
+    __m512d d1r = _mm512_set1_pd(d[1].real), d1i = _mm512_set1_pd(d[1].imag);
+    if (stride >= 8) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+            for (size_t j = j0; j < j0 + run; j += 8) {
+                size_t k = j + stride;
+                __m512d ar = _mm512_loadu_pd(re + j), ai = _mm512_loadu_pd(im + j);
+                __m512d br = _mm512_loadu_pd(re + k), bi = _mm512_loadu_pd(im + k);
+                _mm512_storeu_pd(re + j, _mm512_sub_pd(_mm512_mul_pd(d0r, ar), _mm512_mul_pd(d0i, ai)));
+                _mm512_storeu_pd(im + j, _mm512_add_pd(_mm512_mul_pd(d0r, ai), _mm512_mul_pd(d0i, ar)));
+                _mm512_storeu_pd(re + k, _mm512_sub_pd(_mm512_mul_pd(d1r, br), _mm512_mul_pd(d1i, bi)));
+                _mm512_storeu_pd(im + k, _mm512_add_pd(_mm512_mul_pd(d1r, bi), _mm512_mul_pd(d1i, br)));
+            }
+            p += run;
+        }
+        return;
+    }
+    __mmask8 upper = avx512_upper_mask(stride);
+    __m512d cr = _mm512_mask_blend_pd(upper, d0r, d1r), ci = _mm512_mask_blend_pd(upper, d0i, d1i);
+    for (size_t i = 2 * begin; i < 2 * end; i += 8) {
+        __m512d vr = _mm512_loadu_pd(re + i), vi = _mm512_loadu_pd(im + i);
+        _mm512_storeu_pd(re + i, _mm512_sub_pd(_mm512_mul_pd(cr, vr), _mm512_mul_pd(ci, vi)));
+        _mm512_storeu_pd(im + i, _mm512_add_pd(_mm512_mul_pd(cr, vi), _mm512_mul_pd(ci, vr)));
+    }
+}
+
+AVX512 static inline void avx512_cmul_add(__m512d xr, __m512d xi, __m512d yr, __m512d yi,
+                                          __m512d cr, __m512d ci, __m512d dr, __m512d di,
+                                          __m512d* out_r, __m512d* out_i) {
+    *out_r = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(cr, xr), _mm512_mul_pd(ci, xi)),
+                           _mm512_sub_pd(_mm512_mul_pd(dr, yr), _mm512_mul_pd(di, yi)));
+    *out_i = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(cr, xi), _mm512_mul_pd(ci, xr)),
+                           _mm512_add_pd(_mm512_mul_pd(dr, yi), _mm512_mul_pd(di, yr)));
+}
+
+AVX512 static void matrix_pairs_avx512(double* re, double* im, size_t begin, size_t end, int target, const QuantumGate* g) {
+    size_t stride = (size_t)1 << target;
+    __m512d m00r = _mm512_set1_pd(g->elements[0][0].real), m00i = _mm512_set1_pd(g->elements[0][0].imag);
+    __m512d m01r = _mm512_set1_pd(g->elements[0][1].real), m01i = _mm512_set1_pd(g->elements[0][1].imag);
+    __m512d m10r = _mm512_set1_pd(g->elements[1][0].real), m10i = _mm512_set1_pd(g->elements[1][0].imag);
+    __m512d m11r = _mm512_set1_pd(g->elements[1][1].real), m11i = _mm512_set1_pd(g->elements[1][1].imag);
+    __m512d nr, ni;
+    if (stride >= 8) {
+        for (size_t p = begin; p < end;) {
+            size_t run = pair_run_length(p, end, stride), j0 = pair_lower_index(p, target);
+            for (size_t j = j0; j < j0 + run; j += 8) {
+                size_t k = j + stride;
+                __m512d ar = _mm512_loadu_pd(re + j), ai = _mm512_loadu_pd(im + j);
+                __m512d br = _mm512_loadu_pd(re + k), bi = _mm512_loadu_pd(im + k);
+                avx512_cmul_add(ar, ai, br, bi, m00r, m00i, m01r, m01i, &nr, &ni);
+                _mm512_storeu_pd(re + j, nr); _mm512_storeu_pd(im + j, ni);
+                avx512_cmul_add(ar, ai, br, bi, m10r, m10i, m11r, m11i, &nr, &ni);
+                _mm512_storeu_pd(re + k, nr); _mm512_storeu_pd(im + k, ni);
+            }
+            p += run;
+        }
+        return;
+    }
+    __m512i idx = avx512_partner_index(stride);
+    __mmask8 upper = avx512_upper_mask(stride);
+    __m512d sr = _mm512_mask_blend_pd(upper, m00r, m11r), si = _mm512_mask_blend_pd(upper, m00i, m11i);
+    __m512d pr = _mm512_mask_blend_pd(upper, m01r, m10r), pi = _mm512_mask_blend_pd(upper, m01i, m10i);
+    for (size_t i = 2 * begin; i < 2 * end; i += 8) {
+        __m512d vr = _mm512_loadu_pd(re + i), vi = _mm512_loadu_pd(im + i);
+        __m512d wr = _mm512_permutexvar_pd(idx, vr), wi = _mm512_permutexvar_pd(idx, vi);
+        avx512_cmul_add(vr, vi, wr, wi, sr, si, pr, pi, &nr, &ni);
+        _mm512_storeu_pd(re + i, nr); _mm512_storeu_pd(im + i, ni);
+    }
+}
+
+#endif // QSIM_HAVE_X86_SIMD
+
+// SIMD dispatch
+
+static SimdLevel simd_level;
+static bool simd_level_initialized = false;
+
+bool simd_level_supported(SimdLevel level) {
+#ifdef QSIM_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    switch (level) {
+        case SIMD_SCALAR: return true;
+        case SIMD_AVX2:   return __builtin_cpu_supports("avx2");
+        case SIMD_AVX512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#else
+    return level == SIMD_SCALAR;
+#endif
+}
+
+static void initialize_simd_level(void) {
+    simd_level = SIMD_SCALAR;
+    if (simd_level_supported(SIMD_AVX512)) {
+        simd_level = SIMD_AVX512;
+    } else if (simd_level_supported(SIMD_AVX2)) {
+        simd_level = SIMD_AVX2;
+    }
+
+    const char* requested = getenv("QSIM_SIMD");
+    if (requested) {
+        SimdLevel level = simd_level;
+        if (strcmp(requested, "scalar") == 0) level = SIMD_SCALAR;
+        else if (strcmp(requested, "avx2") == 0) level = SIMD_AVX2;
+        else if (strcmp(requested, "avx512") == 0) level = SIMD_AVX512;
+        else fprintf(stderr, "Error: Unknown QSIM_SIMD value '%s'\n", requested);
+        if (simd_level_supported(level)) {
+            simd_level = level;
+        } else {
+            fprintf(stderr, "Error: %s is not supported on this CPU\n", simd_level_name(level));
+        }
+    }
+    simd_level_initialized = true;
+}
+
+SimdLevel get_simd_level(void) {
+    if (!simd_level_initialized) initialize_simd_level();
+    return simd_level;
+}
+
+bool set_simd_level(SimdLevel level) {
+    if (!simd_level_initialized) initialize_simd_level();
+    if (!simd_level_supported(level)) {
+        fprintf(stderr, "Error: %s is not supported on this CPU\n", simd_level_name(level));
+        return false;
+    }
+    simd_level = level;
+    return true;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SIMD_SCALAR: return "scalar";
+        case SIMD_AVX2:   return "avx2";
+        case SIMD_AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+// A SIMD kernel needs at least one full register of amplitudes
+static SimdLevel kernel_level(size_t dim) {
+    SimdLevel level = get_simd_level();
+    if (level == SIMD_AVX512 && dim < 8) level = SIMD_AVX2;
+    if (level == SIMD_AVX2 && dim < 4) level = SIMD_SCALAR;
+    return level;
+}
+
+// Parallel pair jobs. A job covers runs of run_pairs pairs. Run r occupies the 2 * run_pairs
+// amplitudes starting at r * 2 * run_pairs with a zero bit inserted at every control and the
+// control bits set, which lets controlled gates whose controls all lie above the target
+// reuse the uncontrolled kernels on the sub-arrays where the controls are 1.
+
+typedef enum {
+    PAIR_SWAP,      // permutation
+    PAIR_HADAMARD,
+    PAIR_PHASE,     // diagonal with a 1 on the lower amplitude
+    PAIR_DIAGONAL,
+    PAIR_MATRIX     // dense
+} PairOp;
+
+typedef struct {
+    PairOp op;
+    SimdLevel level;
+    double* real;
+    double* imag;
+    int target;
+    size_t run_pairs;
+    int num_controls;
+    int controls[2];  // ascending
+    size_t control_mask;
+    Complex phase;
+    Complex diagonal[2];
+    const QuantumGate* gate;
+} PairJob;
+
+static void run_pair_kernel(const PairJob* job, double* re, double* im, size_t begin, size_t end) {
+    switch (job->level) {
+#ifdef QSIM_HAVE_X86_SIMD
+        case SIMD_AVX512:
+            switch (job->op) {
+                case PAIR_SWAP:     swap_pairs_avx512(re, im, begin, end, job->target); return;
+                case PAIR_HADAMARD: hadamard_pairs_avx512(re, im, begin, end, job->target); return;
+                case PAIR_PHASE:    phase_pairs_avx512(re, im, begin, end, job->target, job->phase); return;
+                case PAIR_DIAGONAL: diagonal_pairs_avx512(re, im, begin, end, job->target, job->diagonal); return;
+                case PAIR_MATRIX:   matrix_pairs_avx512(re, im, begin, end, job->target, job->gate); return;
+            }
+            return;
+        case SIMD_AVX2:
+            switch (job->op) {
+                case PAIR_SWAP:     swap_pairs_avx2(re, im, begin, end, job->target); return;
+                case PAIR_HADAMARD: hadamard_pairs_avx2(re, im, begin, end, job->target); return;
+                case PAIR_PHASE:    phase_pairs_avx2(re, im, begin, end, job->target, job->phase); return;
+                case PAIR_DIAGONAL: diagonal_pairs_avx2(re, im, begin, end, job->target, job->diagonal); return;
+                case PAIR_MATRIX:   matrix_pairs_avx2(re, im, begin, end, job->target, job->gate); return;
+            }
+            return;
+#endif
+        default:
+            switch (job->op) {
+                case PAIR_SWAP:     swap_pairs_scalar(re, im, begin, end, job->target); return;
+                case PAIR_HADAMARD: hadamard_pairs_scalar(re, im, begin, end, job->target); return;
+                case PAIR_PHASE:    phase_pairs_scalar(re, im, begin, end, job->target, job->phase); return;
+                case PAIR_DIAGONAL: diagonal_pairs_scalar(re, im, begin, end, job->target, job->diagonal); return;
+                case PAIR_MATRIX:   matrix_pairs_scalar(re, im, begin, end, job->target, job->gate); return;
+            }
+            return;
+    }
+}
+
+static void pair_job_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const PairJob* job = context;
+    while (begin < end) {
+        size_t run = begin / job->run_pairs;
+        size_t local_begin = begin - run * job->run_pairs;
+        size_t local_end = job->run_pairs;
+        if (local_end - local_begin > end - begin) local_end = local_begin + (end - begin);
+
+        size_t base = insert_zero_bits(run * 2 * job->run_pairs, job->controls, job->num_controls) | job->control_mask;
+        run_pair_kernel(job, job->real + base, job->imag + base, local_begin, local_end);
+        begin += local_end - local_begin;
+    }
+}
+
+static void run_pair_job(PairJob* job, size_t num_runs) {
+    job->level = kernel_level(2 * job->run_pairs);
+    parallel_for(num_runs * job->run_pairs, pair_job_task, job);
+}
+
+#ifdef QSIM_INSTRUMENT
+// Kernel span names by number of controls and PairOp
+static const char* const pair_op_names[3][5] = {
+    {"swap", "hadamard", "phase", "diagonal", "matrix"},
+    {"c-swap", "c-hadamard", "c-phase", "c-diagonal", "c-matrix"},
+    {"cc-swap", "cc-hadamard", "cc-phase", "cc-diagonal", "cc-matrix"},
+};
+
+// Amplitude bytes read and written for num_pairs pairs; phase kernels only touch the
+// upper amplitude of each pair
+static uint64_t pair_bytes(PairOp op, size_t num_pairs) {
+    return (uint64_t)num_pairs * (op == PAIR_PHASE ? 1 : 2) * 2 * BYTES_PER_AMPLITUDE;
+}
+#endif
+
+static void run_whole_state(Statevector* sv, PairJob* job) {
+    INSTRUMENT_BEGIN(span);
+    job->real = sv->real;
+    job->imag = sv->imag;
+    job->run_pairs = sv->dimension / 2;
+    run_pair_job(job, 1);
+    INSTRUMENT_END(span, "kernel", pair_op_names[0][job->op], job->target, -1, sv->dimension / 2,
+                   pair_bytes(job->op, sv->dimension / 2));
+}
+
+void kernel_swap_pairs(Statevector* sv, int target) {
+    PairJob job = {.op = PAIR_SWAP, .target = target};
+    run_whole_state(sv, &job);
+}
+
+void kernel_hadamard_pairs(Statevector* sv, int target) {
+    PairJob job = {.op = PAIR_HADAMARD, .target = target};
+    run_whole_state(sv, &job);
+}
+
+void kernel_phase_pairs(Statevector* sv, Complex phase, int target) {
+    PairJob job = {.op = PAIR_PHASE, .target = target, .phase = phase};
+    run_whole_state(sv, &job);
+}
+
+void kernel_diagonal_pairs(Statevector* sv, Complex d0, Complex d1, int target) {
+    PairJob job = {.op = PAIR_DIAGONAL, .target = target, .diagonal = {d0, d1}};
+    run_whole_state(sv, &job);
+}
+
+void kernel_matrix_pairs(Statevector* sv, const QuantumGate* gate, int target) {
+    PairJob job = {.op = PAIR_MATRIX, .target = target, .gate = gate};
+    run_whole_state(sv, &job);
+}
+
+// Controlled kernels. Only the pairs whose control bits are all 1 are visited: pair index
+// q gets a zero bit inserted at every control and at the target, and the control bits are
+// then set, so there is no test per amplitude and no iteration is wasted. When every
+// control is above the target and the runs span a register, the selected amplitudes form
+// runs of 2^lowest_control that hold whole target pairs, and the uncontrolled kernels run
+// on each run. Otherwise the lower amplitudes of the selected pairs form runs of
+// 2^lowest_bit with their partners stride above them; runs that fill a register still go
+// through the SIMD kernels, and shorter ones through a scalar loop specialized for each
+// gate class.
+
+typedef struct {
+    PairJob pair;  // op, gate, target and the SIMD level for the runs
+    int num_bits;
+    int sorted_bits[3];    // controls and target, ascending
+    size_t inserted_mask;  // bits of the controls and the target
+    size_t run_length;
+} ControlledJob;
+
+// op is a literal at every call site, so each gate class gets its own loop with the
+// others folded away
+static inline __attribute__((always_inline)) void controlled_pairs(const ControlledJob* job, size_t begin,
+                                                                      size_t end, PairOp op) {
+    size_t stride = (size_t)1 << job->pair.target;
+    double* re = job->pair.real;
+    double* im = job->pair.imag;
+    Complex m00 = {1.0, 0.0}, m01 = {0.0, 0.0}, m10 = {0.0, 0.0}, m11 = job->pair.phase;
+    if (op == PAIR_DIAGONAL) {
+        m00 = job->pair.diagonal[0];
+        m11 = job->pair.diagonal[1];
+    } else if (op == PAIR_MATRIX) {
+        m00 = job->pair.gate->elements[0][0];
+        m01 = job->pair.gate->elements[0][1];
+        m10 = job->pair.gate->elements[1][0];
+        m11 = job->pair.gate->elements[1][1];
+    }
+
+    // z is the current pair index with the zero bits inserted; stepping past the end of a
+    // run carries over the inserted bits, which is cheaper than inserting them again
+    size_t z = insert_zero_bits(begin, job->sorted_bits, job->num_bits);
+    for (size_t q = begin; q < end;) {
+        size_t run = pair_run_length(q, end, job->run_length), j0 = z | job->pair.control_mask;
+        for (size_t j = j0; j < j0 + run; j++) {
+            size_t k = j + stride;
+            if (op == PAIR_SWAP) {
+                double t = re[j]; re[j] = re[k]; re[k] = t;
+                t = im[j]; im[j] = im[k]; im[k] = t;
+            } else if (op == PAIR_PHASE) {
+                double br = re[k], bi = im[k];
+                re[k] = m11.real * br - m11.imag * bi;
+                im[k] = m11.real * bi + m11.imag * br;
+            } else if (op == PAIR_DIAGONAL) {
+                double ar = re[j], ai = im[j], br = re[k], bi = im[k];
+                re[j] = m00.real * ar - m00.imag * ai;
+                im[j] = m00.real * ai + m00.imag * ar;
+                re[k] = m11.real * br - m11.imag * bi;
+                im[k] = m11.real * bi + m11.imag * br;
+            } else {
+                double ar = re[j], ai = im[j], br = re[k], bi = im[k];
+                re[j] = (m00.real * ar - m00.imag * ai) + (m01.real * br - m01.imag * bi);
+                im[j] = (m00.real * ai + m00.imag * ar) + (m01.real * bi + m01.imag * br);
+                re[k] = (m10.real * ar - m10.imag * ai) + (m11.real * br - m11.imag * bi);
+                im[k] = (m10.real * ai + m10.imag * ar) + (m11.real * bi + m11.imag * br);
+            }
+        }
+        q += run;
+        z = (((z + run - 1) | job->inserted_mask) + 1) & ~job->inserted_mask;
+    }
+}
+
+static void controlled_pairs_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const ControlledJob* job = context;
+    if (job->pair.level == SIMD_SCALAR) {
+        switch (job->pair.op) {
+            case PAIR_SWAP:     controlled_pairs(job, begin, end, PAIR_SWAP); return;
+            case PAIR_PHASE:    controlled_pairs(job, begin, end, PAIR_PHASE); return;
+            case PAIR_DIAGONAL: controlled_pairs(job, begin, end, PAIR_DIAGONAL); return;
+            default:            controlled_pairs(job, begin, end, PAIR_MATRIX); return;
+        }
+    }
+
+    // A run is shorter than stride, so its pairs are the first pairs of the sub-array
+    // starting at the run and the pair kernels take their wide-stride path on it
+    size_t z = insert_zero_bits(begin, job->sorted_bits, job->num_bits);
+    for (size_t q = begin; q < end;) {
+        size_t run = pair_run_length(q, end, job->run_length), j0 = z | job->pair.control_mask;
+        run_pair_kernel(&job->pair, job->pair.real + j0, job->pair.imag + j0, 0, run);
+        q += run;
+        z = (((z + run - 1) | job->inserted_mask) + 1) & ~job->inserted_mask;
+    }
+}
+
+// job carries the op, target and gate; the controls must be distinct from each other and
+// from the target
+static void run_controlled(Statevector* sv, PairJob* job, const int* controls, int num_controls) {
+    INSTRUMENT_BEGIN(span);
+    job->real = sv->real;
+    job->imag = sv->imag;
+    job->num_controls = num_controls;
+    job->control_mask = 0;
+    for (int c = 0; c < num_controls; c++) {
+        int i = c;
+        while (i > 0 && job->controls[i - 1] > controls[c]) {
+            job->controls[i] = job->controls[i - 1];
+            i--;
+        }
+        job->controls[i] = controls[c];
+        job->control_mask |= (size_t)1 << controls[c];
+    }
+
+    // Runs shorter than a register cost a kernel call for a few pairs; those are cheaper
+    // through the indexed loop
+    if (job->controls[0] > job->target && job->controls[0] >= 3) {
+        job->run_pairs = ((size_t)1 << job->controls[0]) / 2;
+        run_pair_job(job, sv->dimension >> num_controls >> job->controls[0]);
+        INSTRUMENT_END(span, "kernel", pair_op_names[num_controls][job->op], job->target, controls[0],
+                       sv->dimension >> (num_controls + 1), pair_bytes(job->op, sv->dimension >> (num_controls + 1)));
+        return;
+    }
+
+    ControlledJob controlled = {.pair = *job, .num_bits = num_controls + 1};
+    controlled.inserted_mask = job->control_mask | ((size_t)1 << job->target);
+    int i = num_controls;
+    while (i > 0 && job->controls[i - 1] > job->target) {
+        controlled.sorted_bits[i] = job->controls[i - 1];
+        i--;
+    }
+    controlled.sorted_bits[i] = job->target;
+    while (i > 0) {
+        i--;
+        controlled.sorted_bits[i] = job->controls[i];
+    }
+    controlled.run_length = (size_t)1 << controlled.sorted_bits[0];
+    controlled.pair.level = kernel_level(controlled.run_length);
+    parallel_for(sv->dimension >> (num_controls + 1), controlled_pairs_task, &controlled);
+    INSTRUMENT_END(span, "kernel", pair_op_names[num_controls][job->op], job->target, controls[0],
+                   sv->dimension >> (num_controls + 1), pair_bytes(job->op, sv->dimension >> (num_controls + 1)));
+}
+
+void kernel_controlled_swap_pairs(Statevector* sv, int control, int target) {
+    PairJob job = {.op = PAIR_SWAP, .target = target};
+    run_controlled(sv, &job, &control, 1);
+}
+
+void kernel_controlled_phase_pairs(Statevector* sv, Complex phase, int control, int target) {
+    PairJob job = {.op = PAIR_PHASE, .target = target, .phase = phase};
+    run_controlled(sv, &job, &control, 1);
+}
+
+void kernel_controlled_diagonal_pairs(Statevector* sv, Complex d0, Complex d1, int control, int target) {
+    PairJob job = {.op = PAIR_DIAGONAL, .target = target, .diagonal = {d0, d1}};
+    run_controlled(sv, &job, &control, 1);
+}
+
+void kernel_controlled_matrix_pairs(Statevector* sv, const QuantumGate* gate, int control, int target) {
+    PairJob job = {.op = PAIR_MATRIX, .target = target, .gate = gate};
+    run_controlled(sv, &job, &control, 1);
+}
+
+void kernel_doubly_controlled_swap_pairs(Statevector* sv, int control0, int control1, int target) {
+    PairJob job = {.op = PAIR_SWAP, .target = target};
+    int controls[2] = {control0, control1};
+    run_controlled(sv, &job, controls, 2);
+}
+
+void kernel_doubly_controlled_phase_pairs(Statevector* sv, Complex phase, int control0, int control1, int target) {
+    PairJob job = {.op = PAIR_PHASE, .target = target, .phase = phase};
+    int controls[2] = {control0, control1};
+    run_controlled(sv, &job, controls, 2);
+}
+
+void kernel_doubly_controlled_diagonal_pairs(Statevector* sv, Complex d0, Complex d1, int control0, int control1,
+                                             int target) {
+    PairJob job = {.op = PAIR_DIAGONAL, .target = target, .diagonal = {d0, d1}};
+    int controls[2] = {control0, control1};
+    run_controlled(sv, &job, controls, 2);
+}
+
+void kernel_doubly_controlled_matrix_pairs(Statevector* sv, const QuantumGate* gate, int control0, int control1,
+                                           int target) {
+    PairJob job = {.op = PAIR_MATRIX, .target = target, .gate = gate};
+    int controls[2] = {control0, control1};
+    run_controlled(sv, &job, controls, 2);
+}
@@ -0,0 +1,88 @@
+// statevector_core.h
+#ifndef STATEVECTOR_CORE_H
+#define STATEVECTOR_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Amplitude arrays are aligned to a cache line so that every SIMD load is aligned
+#define STATEVECTOR_ALIGNMENT 64
+
+// Storage cost of one amplitude: one double for the real part, one for the imaginary part.
+// A statevector of n qubits therefore always occupies exactly 2^n * 16 bytes.
+#define BYTES_PER_AMPLITUDE (2 * sizeof(double))
+
+typedef struct {
+    double real;
+    double imag;
+} Complex;
+
+typedef struct {
+    Complex elements[2][2];
+} QuantumGate;
+
+// Structure-of-arrays statevector: amplitude i is (real[i], imag[i])
+typedef struct {
+    double* real;
+    double* imag;
+    int num_qubits;
+    size_t dimension;
+} Statevector;
+
+typedef enum {
+    SIMD_SCALAR,
+    SIMD_AVX2,
+    SIMD_AVX512
+} SimdLevel;
+
+// State management
+Statevector* create_statevector(int num_qubits);
+void free_statevector(Statevector* sv);
+bool initialize_statevector(Statevector* sv);
+bool copy_statevector(Statevector* dst, const Statevector* src);
+void print_statevector(const Statevector* sv);
+double statevector_norm(const Statevector* sv);
+size_t statevector_bytes(int num_qubits);
+int max_qubits_for_memory(size_t bytes);
+
+// Standard gates
+QuantumGate get_x_gate(void);
+QuantumGate get_y_gate(void);
+QuantumGate get_z_gate(void);
+QuantumGate get_hadamard_gate(void);
+QuantumGate get_s_gate(void);
+QuantumGate get_t_gate(void);
+QuantumGate get_rx_gate(double theta);
+QuantumGate get_ry_gate(double theta);
+QuantumGate get_rz_gate(double theta);
+
+// Product a * b, i.e. the gate that applies b first and then a
+QuantumGate multiply_gates(QuantumGate a, QuantumGate b);
+
+// Pairwise kernels. Each one updates the amplitude pairs (i, i | 1 << target) in place.
+void kernel_swap_pairs(Statevector* sv, int target);
+void kernel_hadamard_pairs(Statevector* sv, int target);
+void kernel_phase_pairs(Statevector* sv, Complex phase, int target);
+void kernel_diagonal_pairs(Statevector* sv, Complex d0, Complex d1, int target);
+void kernel_matrix_pairs(Statevector* sv, const QuantumGate* gate, int target);
+
+// Controlled kernels: only the pairs whose control bits are all 1 are visited. There is
+// one variant per gate class: permutation (swap), phase, diagonal and dense matrix.
+void kernel_controlled_swap_pairs(Statevector* sv, int control, int target);
+void kernel_controlled_phase_pairs(Statevector* sv, Complex phase, int control, int target);
+void kernel_controlled_diagonal_pairs(Statevector* sv, Complex d0, Complex d1, int control, int target);
+void kernel_controlled_matrix_pairs(Statevector* sv, const QuantumGate* gate, int control, int target);
+void kernel_doubly_controlled_swap_pairs(Statevector* sv, int control0, int control1, int target);
+void kernel_doubly_controlled_phase_pairs(Statevector* sv, Complex phase, int control0, int control1, int target);
+void kernel_doubly_controlled_diagonal_pairs(Statevector* sv, Complex d0, Complex d1, int control0, int control1,
+                                             int target);
+void kernel_doubly_controlled_matrix_pairs(Statevector* sv, const QuantumGate* gate, int control0, int control1,
+                                           int target);
+
+// SIMD dispatch. The detected level can be overridden with QSIM_SIMD=scalar|avx2|avx512.
+SimdLevel get_simd_level(void);
+bool set_simd_level(SimdLevel level);
+bool simd_level_supported(SimdLevel level);  // by both the CPU and this build
+const char* simd_level_name(SimdLevel level);
+
+#endif // STATEVECTOR_CORE_H
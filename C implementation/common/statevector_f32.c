@@ -0,0 +1,570 @@
+// statevector_f32.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "statevector_f32.h"
+#include "thread_pool.h"
+#include "state_allocator.h"
+
+// Same as the double kernels: no fused multiply-add, so every SIMD level gives the same bits.
+// GCC's default cost model at -O2 only vectorizes loops without a remainder, which the
+// pair runs of unknown length never are.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off", "vect-cost-model=dynamic")
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define QSIM_HAVE_X86_SIMD 1
+#define AVX2 __attribute__((target("avx2")))
+#define AVX512 __attribute__((target("avx512f")))
+#endif
+
+// State management
+
+size_t statevector_f32_bytes(int num_qubits) {
+    return ((size_t)1 << num_qubits) * BYTES_PER_AMPLITUDE_F32;
+}
+
+const char* precision_name(Precision precision) {
+    return precision == PRECISION_MIXED ? "mixed" : "single";
+}
+
+static void zero_task_f32(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    StatevectorF32* sv = context;
+    memset(sv->real + begin, 0, (end - begin) * sizeof(float));
+    memset(sv->imag + begin, 0, (end - begin) * sizeof(float));
+}
+
+StatevectorF32* create_statevector_f32(int num_qubits, Precision precision) {
+    if (num_qubits < 0 || num_qubits > 62) {
+        fprintf(stderr, "Error: Invalid number of qubits\n");
+        return NULL;
+    }
+    StatevectorF32* sv = malloc(sizeof(StatevectorF32));
+    if (!sv) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    sv->num_qubits = num_qubits;
+    sv->dimension = (size_t)1 << num_qubits;
+    sv->precision = precision;
+    sv->real = NULL;
+    sv->imag = NULL;
+
+    size_t bytes = sv->dimension * sizeof(float);
+    sv->real = allocate_state_buffer(bytes);
+    sv->imag = allocate_state_buffer(bytes);
+    if (!sv->real || !sv->imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_statevector_f32(sv);
+        return NULL;
+    }
+    // The first touch of the pages, from the workers that will process them
+    parallel_for(sv->dimension, zero_task_f32, sv);
+    sv->real[0] = 1.0f;
+    return sv;
+}
+
+void free_statevector_f32(StatevectorF32* sv) {
+    if (!sv) return;
+    free_state_buffer(sv->real, sv->dimension * sizeof(float));
+    free_state_buffer(sv->imag, sv->dimension * sizeof(float));
+    free(sv);
+}
+
+typedef struct {
+    Statevector* wide;
+    StatevectorF32* narrow;
+    double* partial;  // one sum per worker, PARTIAL_STRIDE doubles apart
+    double scale;
+} ConvertJob;
+
+// Worker sums sit a cache line apart
+#define PARTIAL_STRIDE 8
+
+static void to_f32_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const ConvertJob* job = context;
+    for (size_t i = begin; i < end; i++) {
+        job->narrow->real[i] = (float)job->wide->real[i];
+        job->narrow->imag[i] = (float)job->wide->imag[i];
+    }
+}
+
+static void from_f32_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const ConvertJob* job = context;
+    for (size_t i = begin; i < end; i++) {
+        job->wide->real[i] = job->narrow->real[i];
+        job->wide->imag[i] = job->narrow->imag[i];
+    }
+}
+
+bool statevector_to_f32(StatevectorF32* dst, const Statevector* src) {
+    if (!dst || !src || dst->num_qubits != src->num_qubits) {
+        fprintf(stderr, "Error: Statevector sizes do not match\n");
+        return false;
+    }
+    ConvertJob job = {.wide = (Statevector*)src, .narrow = dst};
+    parallel_for(src->dimension, to_f32_task, &job);
+    return true;
+}
+
+bool statevector_from_f32(Statevector* dst, const StatevectorF32* src) {
+    if (!dst || !src || dst->num_qubits != src->num_qubits) {
+        fprintf(stderr, "Error: Statevector sizes do not match\n");
+        return false;
+    }
+    ConvertJob job = {.wide = dst, .narrow = (StatevectorF32*)src};
+    parallel_for(src->dimension, from_f32_task, &job);
+    return true;
+}
+
+static void norm_task(size_t begin, size_t end, int worker, void* context) {
+    const ConvertJob* job = context;
+    const float* re = job->narrow->real;
+    const float* im = job->narrow->imag;
+    double sum = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        sum += (double)re[i] * re[i] + (double)im[i] * im[i];
+    }
+    job->partial[worker * PARTIAL_STRIDE] += sum;
+}
+
+// Re and Im of ⟨wide|narrow⟩ go to partial[0] and partial[1] of the worker, the squared
+// norms of wide and narrow to partial[2] and partial[3]
+static void overlap_task(size_t begin, size_t end, int worker, void* context) {
+    const ConvertJob* job = context;
+    double sum_re = 0.0, sum_im = 0.0, wide_norm = 0.0, narrow_norm = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        double ar = job->wide->real[i], ai = job->wide->imag[i];
+        double br = job->narrow->real[i], bi = job->narrow->imag[i];
+        sum_re += ar * br + ai * bi;
+        sum_im += ar * bi - ai * br;
+        wide_norm += ar * ar + ai * ai;
+        narrow_norm += br * br + bi * bi;
+    }
+    double* partial = job->partial + worker * PARTIAL_STRIDE;
+    partial[0] += sum_re;
+    partial[1] += sum_im;
+    partial[2] += wide_norm;
+    partial[3] += narrow_norm;
+}
+
+static void scale_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const ConvertJob* job = context;
+    float scale = (float)job->scale;
+    for (size_t i = begin; i < end; i++) {
+        job->narrow->real[i] *= scale;
+        job->narrow->imag[i] *= scale;
+    }
+}
+
+// Runs a reduction task and sums the per-worker results into sums[0..count)
+static bool reduce(ConvertJob* job, size_t dimension, ParallelTask task, double* sums, int count) {
+    int num_threads = thread_pool_get_num_threads();
+    job->partial = calloc((size_t)num_threads * PARTIAL_STRIDE, sizeof(double));
+    if (!job->partial) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    parallel_for(dimension, task, job);
+    for (int c = 0; c < count; c++) {
+        sums[c] = 0.0;
+        for (int w = 0; w < num_threads; w++) sums[c] += job->partial[w * PARTIAL_STRIDE + c];
+    }
+    free(job->partial);
+    return true;
+}
+
+double statevector_f32_norm(const StatevectorF32* sv) {
+    ConvertJob job = {.narrow = (StatevectorF32*)sv};
+    double norm = 0.0;
+    if (!reduce(&job, sv->dimension, norm_task, &norm, 1)) return -1.0;
+    return norm;
+}
+
+double check_norm_drift(StatevectorF32* sv, double tolerance) {
+    double norm = statevector_f32_norm(sv);
+    double drift = fabs(norm - 1.0);
+    if (drift > tolerance && norm > 0.0) {
+        ConvertJob job = {.narrow = sv, .scale = 1.0 / sqrt(norm)};
+        parallel_for(sv->dimension, scale_task, &job);
+    }
+    return drift;
+}
+
+double fidelity_f32(const Statevector* reference, const StatevectorF32* sv) {
+    if (!reference || !sv || reference->num_qubits != sv->num_qubits) {
+        fprintf(stderr, "Error: Statevector sizes do not match\n");
+        return -1.0;
+    }
+    ConvertJob job = {.wide = (Statevector*)reference, .narrow = (StatevectorF32*)sv};
+    double sums[4];
+    if (!reduce(&job, sv->dimension, overlap_task, sums, 4)) return -1.0;
+    if (sums[2] <= 0.0 || sums[3] <= 0.0) return 0.0;
+    return (sums[0] * sums[0] + sums[1] * sums[1]) / (sums[2] * sums[3]);
+}
+
+// Pair kernels. The selected pairs are enumerated as in the double controlled kernels: pair
+// index q gets a zero bit inserted at the target and at the control, and the control bit
+// is set. The lower amplitudes then come in runs of 2^lowest_bit with their partners
+// stride above them, and the loop over a run is contiguous in both halves, so the
+// compiler vectorizes it for each SIMD level.
+
+// Uncontrolled gates on targets below this take the block path of f32_small_stride
+#define SMALL_STRIDE_QUBITS 4
+
+typedef enum {
+    F32_SWAP,
+    F32_HADAMARD,
+    F32_PHASE,
+    F32_DIAGONAL,
+    F32_MATRIX
+} F32Op;
+
+typedef struct {
+    F32Op op;
+    float* real;
+    float* imag;
+    int target;
+    size_t control_mask;
+    int num_bits;
+    int sorted_bits[2];    // target and control, ascending
+    size_t inserted_mask;  // bits of the target and the control
+    size_t run_length;
+    double m[4][2];  // m00, m01, m10, m11 as (re, im)
+    float mf[4][2];  // the same, rounded for single precision
+} F32Job;
+
+static inline size_t insert_zero_bit(size_t x, int bit) {
+    size_t low = x & (((size_t)1 << bit) - 1);
+    return ((x - low) << 1) | low;
+}
+
+static inline size_t insert_zero_bits(size_t x, const int* sorted_bits, int count) {
+    for (int b = 0; b < count; b++) x = insert_zero_bit(x, sorted_bits[b]);
+    return x;
+}
+
+// Updates pair j of the halves lo and hi in type T from the coefficients m. op is a
+// literal at every use, so each gate class gets its own loop.
+#define PAIR_UPDATE(T, m, op, lo_re, lo_im, hi_re, hi_im, j)                                  \
+    do {                                                                                      \
+        if (op == F32_SWAP) {                                                                 \
+            float t = lo_re[j]; lo_re[j] = hi_re[j]; hi_re[j] = t;                            \
+            t = lo_im[j]; lo_im[j] = hi_im[j]; hi_im[j] = t;                                  \
+            break;                                                                            \
+        }                                                                                     \
+        T ar = lo_re[j], ai = lo_im[j], br = hi_re[j], bi = hi_im[j];                         \
+        if (op == F32_HADAMARD) {                                                             \
+            lo_re[j] = m[0][0] * (ar + br);                                                   \
+            lo_im[j] = m[0][0] * (ai + bi);                                                   \
+            hi_re[j] = m[0][0] * (ar - br);                                                   \
+            hi_im[j] = m[0][0] * (ai - bi);                                                   \
+        } else if (op == F32_PHASE) {                                                         \
+            hi_re[j] = m[3][0] * br - m[3][1] * bi;                                           \
+            hi_im[j] = m[3][0] * bi + m[3][1] * br;                                           \
+        } else if (op == F32_DIAGONAL) {                                                      \
+            lo_re[j] = m[0][0] * ar - m[0][1] * ai;                                           \
+            lo_im[j] = m[0][0] * ai + m[0][1] * ar;                                           \
+            hi_re[j] = m[3][0] * br - m[3][1] * bi;                                           \
+            hi_im[j] = m[3][0] * bi + m[3][1] * br;                                           \
+        } else {                                                                              \
+            lo_re[j] = (m[0][0] * ar - m[0][1] * ai) + (m[1][0] * br - m[1][1] * bi);         \
+            lo_im[j] = (m[0][0] * ai + m[0][1] * ar) + (m[1][0] * bi + m[1][1] * br);         \
+            hi_re[j] = (m[2][0] * ar - m[2][1] * ai) + (m[3][0] * br - m[3][1] * bi);         \
+            hi_im[j] = (m[2][0] * ai + m[2][1] * ar) + (m[3][0] * bi + m[3][1] * br);         \
+        }                                                                                     \
+    } while (0)
+
+// One run of pairs starting at j0, computed in type T
+#define DEFINE_PAIR_RUN(name, T, coeffs)                                                       \
+    static inline __attribute__((always_inline)) void name(const F32Job* job, float* re, float* im, \
+                                                           size_t j0, size_t run, size_t stride,     \
+                                                           F32Op op) {                               \
+        const T(*m)[2] = job->coeffs;                                                                \
+        /* run <= stride, so the lower and upper halves never overlap */                            \
+        float* restrict lo_re = re + j0;                                                             \
+        float* restrict lo_im = im + j0;                                                             \
+        float* restrict hi_re = re + j0 + stride;                                                    \
+        float* restrict hi_im = im + j0 + stride;                                                    \
+        for (size_t j = 0; j < run; j++) PAIR_UPDATE(T, m, op, lo_re, lo_im, hi_re, hi_im, j);      \
+    }
+
+// Uncontrolled pairs [begin, end) for a stride below a register, which is a literal at
+// every call site: the blocks of 2 * stride amplitudes are handled as interleaved groups
+// so that the loop over blocks vectorizes instead of a run of a few pairs
+#define DEFINE_PAIR_BLOCKS(name, T, coeffs)                                                      \
+    static inline __attribute__((always_inline)) void name(const F32Job* job, size_t begin,        \
+                                                           size_t end, size_t stride, F32Op op) {  \
+        const T(*m)[2] = job->coeffs;                                                              \
+        float* restrict re = job->real;                                                            \
+        float* restrict im = job->imag;                                                            \
+        for (size_t b = begin / stride; b < end / stride; b++) {                                   \
+            float* lo_re = re + 2 * stride * b;                                                    \
+            float* lo_im = im + 2 * stride * b;                                                    \
+            for (size_t s = 0; s < stride; s++) {                                                  \
+                PAIR_UPDATE(T, m, op, lo_re, lo_im, (lo_re + stride), (lo_im + stride), s);        \
+            }                                                                                      \
+        }                                                                                          \
+    }
+
+// Pairs per pass of the staged variant
+#define STAGED_PAIRS 64
+
+// Uncontrolled pairs [begin, end) for strides of 2 and 4, whose interleaving the compiler
+// does not vectorize: each pass copies STAGED_PAIRS lower and upper amplitudes into
+// contiguous buffers, updates them there in one vectorized loop and copies them back
+#define DEFINE_PAIR_STAGED(name, T, coeffs)                                                      \
+    static inline __attribute__((always_inline)) void name(const F32Job* job, size_t begin,        \
+                                                           size_t end, size_t stride, F32Op op) {  \
+        const T(*m)[2] = job->coeffs;                                                              \
+        float lo_re[STAGED_PAIRS], lo_im[STAGED_PAIRS], hi_re[STAGED_PAIRS], hi_im[STAGED_PAIRS]; \
+        for (size_t p = begin; p < end; p += STAGED_PAIRS) {                                       \
+            size_t count = end - p < STAGED_PAIRS ? end - p : STAGED_PAIRS;                        \
+            float* re = job->real + 2 * p;                                                         \
+            float* im = job->imag + 2 * p;                                                         \
+            for (size_t b = 0; b < count / stride; b++) {                                         \
+                for (size_t s = 0; s < stride; s++) {                                              \
+                    lo_re[b * stride + s] = re[2 * stride * b + s];                                \
+                    lo_im[b * stride + s] = im[2 * stride * b + s];                                \
+                    hi_re[b * stride + s] = re[2 * stride * b + stride + s];                       \
+                    hi_im[b * stride + s] = im[2 * stride * b + stride + s];                       \
+                }                                                                                  \
+            }                                                                                      \
+            for (size_t j = 0; j < count; j++) PAIR_UPDATE(T, m, op, lo_re, lo_im, hi_re, hi_im, j); \
+            for (size_t b = 0; b < count / stride; b++) {                                         \
+                for (size_t s = 0; s < stride; s++) {                                              \
+                    re[2 * stride * b + s] = lo_re[b * stride + s];                                \
+                    im[2 * stride * b + s] = lo_im[b * stride + s];                                \
+                    re[2 * stride * b + stride + s] = hi_re[b * stride + s];                       \
+                    im[2 * stride * b + stride + s] = hi_im[b * stride + s];                       \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+    }
+
+DEFINE_PAIR_RUN(pair_run_single, float, mf)
+DEFINE_PAIR_RUN(pair_run_mixed, double, m)
+DEFINE_PAIR_BLOCKS(pair_blocks_single, float, mf)
+DEFINE_PAIR_BLOCKS(pair_blocks_mixed, double, m)
+DEFINE_PAIR_STAGED(pair_staged_single, float, mf)
+DEFINE_PAIR_STAGED(pair_staged_mixed, double, m)
+
+// Chunk bounds are multiples of PARALLEL_CHUNK_ALIGN pairs and so of every small stride
+static inline __attribute__((always_inline)) void f32_small_stride(const F32Job* job, size_t begin, size_t end,
+                                                                      size_t stride, F32Op op, bool mixed) {
+    bool staged = stride == 2 || stride == 4;
+    if (mixed) {
+        if (staged) pair_staged_mixed(job, begin, end, stride, op);
+        else pair_blocks_mixed(job, begin, end, stride, op);
+    } else {
+        if (staged) pair_staged_single(job, begin, end, stride, op);
+        else pair_blocks_single(job, begin, end, stride, op);
+    }
+}
+
+static inline __attribute__((always_inline)) void f32_pairs(const F32Job* job, size_t begin, size_t end, F32Op op,
+                                                               bool mixed) {
+    size_t stride = (size_t)1 << job->target;
+    if (job->num_bits == 1 && job->target < SMALL_STRIDE_QUBITS) {
+        switch (job->target) {
+            case 0:  f32_small_stride(job, begin, end, 1, op, mixed); return;
+            case 1:  f32_small_stride(job, begin, end, 2, op, mixed); return;
+            case 2:  f32_small_stride(job, begin, end, 4, op, mixed); return;
+            default: f32_small_stride(job, begin, end, 8, op, mixed); return;
+        }
+    }
+    size_t z = insert_zero_bits(begin, job->sorted_bits, job->num_bits);
+    for (size_t q = begin; q < end;) {
+        size_t run = job->run_length - (q & (job->run_length - 1));
+        if (run > end - q) run = end - q;
+        size_t j0 = z | job->control_mask;
+        if (mixed) {
+            pair_run_mixed(job, job->real, job->imag, j0, run, stride, op);
+        } else {
+            pair_run_single(job, job->real, job->imag, j0, run, stride, op);
+        }
+        q += run;
+        z = (((z + run - 1) | job->inserted_mask) + 1) & ~job->inserted_mask;
+    }
+}
+
+// Swaps do no arithmetic, so they have a single variant
+#define F32_PAIRS_TASK_BODY(job, begin, end, mixed)                                 \
+    switch ((job)->op) {                                                            \
+        case F32_SWAP:     f32_pairs(job, begin, end, F32_SWAP, false); return;     \
+        case F32_HADAMARD: f32_pairs(job, begin, end, F32_HADAMARD, mixed); return; \
+        case F32_PHASE:    f32_pairs(job, begin, end, F32_PHASE, mixed); return;    \
+        case F32_DIAGONAL: f32_pairs(job, begin, end, F32_DIAGONAL, mixed); return; \
+        default:           f32_pairs(job, begin, end, F32_MATRIX, mixed); return;   \
+    }
+
+static void single_pairs_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    F32_PAIRS_TASK_BODY((const F32Job*)context, begin, end, false)
+}
+
+static void mixed_pairs_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    F32_PAIRS_TASK_BODY((const F32Job*)context, begin, end, true)
+}
+
+#ifdef QSIM_HAVE_X86_SIMD
+AVX2 static void single_pairs_task_avx2(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    F32_PAIRS_TASK_BODY((const F32Job*)context, begin, end, false)
+}
+
+AVX2 static void mixed_pairs_task_avx2(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    F32_PAIRS_TASK_BODY((const F32Job*)context, begin, end, true)
+}
+
+AVX512 static void single_pairs_task_avx512(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    F32_PAIRS_TASK_BODY((const F32Job*)context, begin, end, false)
+}
+
+AVX512 static void mixed_pairs_task_avx512(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    F32_PAIRS_TASK_BODY((const F32Job*)context, begin, end, true)
+}
+#endif
+
+static ParallelTask pairs_task(bool mixed) {
+#ifdef QSIM_HAVE_X86_SIMD
+    switch (get_simd_level()) {
+        case SIMD_AVX512: return mixed ? mixed_pairs_task_avx512 : single_pairs_task_avx512;
+        case SIMD_AVX2:   return mixed ? mixed_pairs_task_avx2 : single_pairs_task_avx2;
+        default: break;
+    }
+#endif
+    return mixed ? mixed_pairs_task : single_pairs_task;
+}
+
+static void run_f32_pairs(StatevectorF32* sv, F32Op op, const QuantumGate* gate, int target, int control) {
+    F32Job job = {.op = op, .real = sv->real, .imag = sv->imag, .target = target};
+    for (int e = 0; e < 4; e++) {
+        Complex c = gate->elements[e / 2][e % 2];
+        job.m[e][0] = c.real;
+        job.m[e][1] = c.imag;
+        job.mf[e][0] = (float)c.real;
+        job.mf[e][1] = (float)c.imag;
+    }
+    job.num_bits = 1;
+    job.sorted_bits[0] = target;
+    job.inserted_mask = (size_t)1 << target;
+    if (control != NO_CONTROL) {
+        job.num_bits = 2;
+        job.sorted_bits[0] = control < target ? control : target;
+        job.sorted_bits[1] = control < target ? target : control;
+        job.control_mask = (size_t)1 << control;
+        job.inserted_mask |= job.control_mask;
+    }
+    job.run_length = (size_t)1 << job.sorted_bits[0];
+    parallel_for(sv->dimension >> job.num_bits, pairs_task(sv->precision == PRECISION_MIXED), &job);
+}
+
+// Fused blocks
+
+typedef struct {
+    float* real;
+    float* imag;
+    const Complex* matrix;
+    int k;
+    int sorted_qubits[MAX_BLOCK_QUBITS];
+    size_t offsets[1 << MAX_BLOCK_QUBITS];
+} F32DenseJob;
+
+#define DEFINE_DENSE_TASK(name, T)                                                                   \
+    static void name(size_t begin, size_t end, int worker, void* context) {                          \
+        (void)worker;                                                                                \
+        const F32DenseJob* job = context;                                                            \
+        int size = 1 << job->k;                                                                      \
+        T in_re[1 << MAX_BLOCK_QUBITS], in_im[1 << MAX_BLOCK_QUBITS];                                \
+        for (size_t g = begin; g < end; g++) {                                                       \
+            size_t base = insert_zero_bits(g, job->sorted_qubits, job->k);                           \
+            for (int c = 0; c < size; c++) {                                                         \
+                in_re[c] = job->real[base + job->offsets[c]];                                        \
+                in_im[c] = job->imag[base + job->offsets[c]];                                        \
+            }                                                                                        \
+            for (int r = 0; r < size; r++) {                                                         \
+                const Complex* row = job->matrix + (size_t)r * size;                                 \
+                T acc_re = 0, acc_im = 0;                                                            \
+                for (int c = 0; c < size; c++) {                                                     \
+                    T m_re = (T)row[c].real, m_im = (T)row[c].imag;                                  \
+                    acc_re += m_re * in_re[c] - m_im * in_im[c];                                     \
+                    acc_im += m_re * in_im[c] + m_im * in_re[c];                                     \
+                }                                                                                    \
+                job->real[base + job->offsets[r]] = (float)acc_re;                                   \
+                job->imag[base + job->offsets[r]] = (float)acc_im;                                   \
+            }                                                                                        \
+        }                                                                                            \
+    }
+
+DEFINE_DENSE_TASK(single_dense_task, float)
+DEFINE_DENSE_TASK(mixed_dense_task, double)
+
+static void run_f32_dense(StatevectorF32* sv, const PlanStep* step) {
+    F32DenseJob job = {.real = sv->real, .imag = sv->imag, .matrix = step->matrix, .k = step->num_qubits};
+    for (int b = 0; b < step->num_qubits; b++) {
+        int i = b;
+        while (i > 0 && job.sorted_qubits[i - 1] > step->qubits[b]) {
+            job.sorted_qubits[i] = job.sorted_qubits[i - 1];
+            i--;
+        }
+        job.sorted_qubits[i] = step->qubits[b];
+    }
+    for (int r = 0; r < (1 << job.k); r++) {
+        job.offsets[r] = 0;
+        for (int b = 0; b < job.k; b++) {
+            if (r & (1 << b)) job.offsets[r] |= (size_t)1 << step->qubits[b];
+        }
+    }
+    parallel_for(sv->dimension >> job.k, sv->precision == PRECISION_MIXED ? mixed_dense_task : single_dense_task,
+                 &job);
+}
+
+// Plan execution
+
+static void run_plan_step_f32(StatevectorF32* sv, const PlanStep* step, const double* params) {
+    switch (step->kind) {
+        case STEP_SWAP:                run_f32_pairs(sv, F32_SWAP, &step->gate, step->target, NO_CONTROL); break;
+        case STEP_HADAMARD:            run_f32_pairs(sv, F32_HADAMARD, &step->gate, step->target, NO_CONTROL); break;
+        case STEP_PHASE:               run_f32_pairs(sv, F32_PHASE, &step->gate, step->target, NO_CONTROL); break;
+        case STEP_DIAGONAL:            run_f32_pairs(sv, F32_DIAGONAL, &step->gate, step->target, NO_CONTROL); break;
+        case STEP_MATRIX:              run_f32_pairs(sv, F32_MATRIX, &step->gate, step->target, NO_CONTROL); break;
+        case STEP_CONTROLLED_SWAP:     run_f32_pairs(sv, F32_SWAP, &step->gate, step->target, step->control); break;
+        case STEP_CONTROLLED_PHASE:    run_f32_pairs(sv, F32_PHASE, &step->gate, step->target, step->control); break;
+        case STEP_CONTROLLED_DIAGONAL: run_f32_pairs(sv, F32_DIAGONAL, &step->gate, step->target, step->control); break;
+        case STEP_CONTROLLED_MATRIX:   run_f32_pairs(sv, F32_MATRIX, &step->gate, step->target, step->control); break;
+        case STEP_DENSE:               run_f32_dense(sv, step); break;
+        case STEP_DIAGONAL_SWEEP:
+            kernel_diagonal_sweep_f32(sv->real, sv->imag, sv->dimension, step->sweep, step->qubits,
+                                      sv->precision == PRECISION_MIXED);
+            break;
+        case STEP_PARAMETRIC: {
+            QuantumGate gate = circuit_op_gate(&step->op, params);
+            run_f32_pairs(sv, step->op.op == OP_RZ ? F32_DIAGONAL : F32_MATRIX, &gate, step->target, NO_CONTROL);
+            break;
+        }
+    }
+}
+
+bool execute_plan_f32(const CircuitPlan* plan, StatevectorF32* sv, const double* params) {
+    if (!plan || !sv || sv->num_qubits < plan->num_qubits || (plan->num_params > 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for plan execution\n");
+        return false;
+    }
+    for (int i = 0; i < plan->num_steps; i++) {
+        run_plan_step_f32(sv, &plan->steps[i], params);
+    }
+    return true;
+}
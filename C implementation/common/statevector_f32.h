@@ -0,0 +1,58 @@
+// statevector_f32.h
+#ifndef STATEVECTOR_F32_H
+#define STATEVECTOR_F32_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "statevector_core.h"
+#include "circuit.h"
+
+// One float for the real part, one for the imaginary part: half of BYTES_PER_AMPLITUDE,
+// so the same memory holds one more qubit and every sweep moves half the bytes
+#define BYTES_PER_AMPLITUDE_F32 (2 * sizeof(float))
+
+// |norm^2 - 1| above which check_norm_drift renormalizes. Single-precision rounding adds
+// roughly 1e-7 per gate and amplitude, so this allows thousands of gates.
+#define NORM_DRIFT_TOLERANCE 1e-4
+
+// How the gate arithmetic is done on float storage
+typedef enum {
+    PRECISION_SINGLE,  // float arithmetic throughout
+    PRECISION_MIXED    // amplitudes widened to double for each gate, rounded once on store
+} Precision;
+
+// Structure-of-arrays statevector with float amplitudes, aligned like Statevector
+typedef struct {
+    float* real;
+    float* imag;
+    int num_qubits;
+    size_t dimension;
+    Precision precision;
+} StatevectorF32;
+
+StatevectorF32* create_statevector_f32(int num_qubits, Precision precision);  // |0...0⟩
+void free_statevector_f32(StatevectorF32* sv);
+size_t statevector_f32_bytes(int num_qubits);
+const char* precision_name(Precision precision);
+
+// Conversions between the double and float states; the qubit counts must match
+bool statevector_to_f32(StatevectorF32* dst, const Statevector* src);
+bool statevector_from_f32(Statevector* dst, const StatevectorF32* src);
+
+// Squared norm accumulated in double
+double statevector_f32_norm(const StatevectorF32* sv);
+
+// Returns |norm^2 - 1| and rescales the state to unit norm when it exceeds tolerance
+double check_norm_drift(StatevectorF32* sv, double tolerance);
+
+// |⟨reference|sv⟩|^2 / (⟨reference|reference⟩ ⟨sv|sv⟩), accumulated in double. Dividing by
+// the norms keeps the result in [0, 1] when rounding has moved sv off unit norm.
+double fidelity_f32(const Statevector* reference, const StatevectorF32* sv);
+
+// Runs a plan compiled for the double path on the float state with the same kernel
+// classes (permutation, phase, diagonal, dense, controlled and fused blocks), in
+// sv->precision. The pair kernels are shared between the two precisions and differ only
+// in the type they compute in.
+bool execute_plan_f32(const CircuitPlan* plan, StatevectorF32* sv, const double* params);
+
+#endif // STATEVECTOR_F32_H
@@ -0,0 +1,194 @@
+// thread_pool.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "thread_pool.h"
+
+// Persistent workers. Worker 0 is the thread that calls parallel_for; workers
+// 1..num_threads-1 sleep on work_ready between jobs.
+static struct {
+    pthread_t* threads;
+    int num_threads;
+    bool initialized;
+    bool shutting_down;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    unsigned long generation;
+    unsigned long start_generation;
+    int pending;
+
+    ParallelTask task;
+    void* context;
+    size_t count;
+    size_t chunk_align;
+} pool = {
+    .num_threads = 1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_ready = PTHREAD_COND_INITIALIZER,
+    .work_done = PTHREAD_COND_INITIALIZER,
+};
+
+static __thread bool inside_parallel_region = false;
+
+static void chunk_bounds(size_t count, size_t align, int num_chunks, int chunk, size_t* begin, size_t* end) {
+    size_t aligned_chunks = (count + align - 1) / align;
+    size_t first = aligned_chunks * (size_t)chunk / (size_t)num_chunks;
+    size_t last = aligned_chunks * (size_t)(chunk + 1) / (size_t)num_chunks;
+    *begin = first * align;
+    *end = last * align;
+    if (*begin > count) *begin = count;
+    if (*end > count) *end = count;
+}
+
+static void run_chunk(int worker) {
+    size_t begin, end;
+    chunk_bounds(pool.count, pool.chunk_align, pool.num_threads, worker, &begin, &end);
+    if (begin < end) {
+        inside_parallel_region = true;
+        pool.task(begin, end, worker, pool.context);
+        inside_parallel_region = false;
+    }
+}
+
+static void* worker_main(void* arg) {
+    int worker = (int)(size_t)arg;
+    unsigned long seen_generation = pool.start_generation;
+
+    for (;;) {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.generation == seen_generation && !pool.shutting_down) {
+            pthread_cond_wait(&pool.work_ready, &pool.lock);
+        }
+        if (pool.shutting_down) {
+            pthread_mutex_unlock(&pool.lock);
+            return NULL;
+        }
+        seen_generation = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        run_chunk(worker);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.pending == 0) {
+            pthread_cond_signal(&pool.work_done);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+}
+
+static bool start_workers(int num_threads) {
+    pool.threads = malloc((size_t)num_threads * sizeof(pthread_t));
+    if (!pool.threads) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return false;
+    }
+    pool.num_threads = num_threads;
+    pool.shutting_down = false;
+    pool.start_generation = pool.generation;
+    for (int i = 1; i < num_threads; i++) {
+        if (pthread_create(&pool.threads[i], NULL, worker_main, (void*)(size_t)i) != 0) {
+            fprintf(stderr, "Error: Could not start worker thread\n");
+            pool.num_threads = i;
+            thread_pool_shutdown();
+            return false;
+        }
+    }
+    return true;
+}
+
+static void initialize_pool(void) {
+    pool.initialized = true;
+    const char* requested = getenv("QSIM_NUM_THREADS");
+    if (requested) {
+        int num_threads = atoi(requested);
+        if (num_threads < 1) {
+            fprintf(stderr, "Error: Invalid QSIM_NUM_THREADS value '%s'\n", requested);
+            return;
+        }
+        thread_pool_set_num_threads(num_threads);
+    }
+}
+
+bool thread_pool_set_num_threads(int num_threads) {
+    if (num_threads < 1) {
+        fprintf(stderr, "Error: Thread count must be at least 1\n");
+        return false;
+    }
+    if (inside_parallel_region) {
+        fprintf(stderr, "Error: Cannot resize the thread pool from inside a parallel task\n");
+        return false;
+    }
+    pool.initialized = true;
+    if (num_threads == pool.num_threads) {
+        return true;
+    }
+    thread_pool_shutdown();
+    if (num_threads == 1) {
+        return true;
+    }
+    return start_workers(num_threads);
+}
+
+int thread_pool_get_num_threads(void) {
+    if (!pool.initialized) initialize_pool();
+    return pool.num_threads;
+}
+
+void thread_pool_shutdown(void) {
+    if (pool.threads) {
+        pthread_mutex_lock(&pool.lock);
+        pool.shutting_down = true;
+        pthread_cond_broadcast(&pool.work_ready);
+        pthread_mutex_unlock(&pool.lock);
+        for (int i = 1; i < pool.num_threads; i++) {
+            pthread_join(pool.threads[i], NULL);
+        }
+        free(pool.threads);
+        pool.threads = NULL;
+    }
+    pool.num_threads = 1;
+}
+
+static void run_parallel(size_t count, size_t chunk_align, size_t min_items, ParallelTask task, void* context) {
+    if (count == 0) return;
+    int num_threads = thread_pool_get_num_threads();
+    if (num_threads == 1 || count < min_items || inside_parallel_region) {
+        task(0, count, 0, context);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.task = task;
+    pool.context = context;
+    pool.count = count;
+    pool.chunk_align = chunk_align;
+    pool.pending = num_threads - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.work_ready);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_chunk(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.pending > 0) {
+        pthread_cond_wait(&pool.work_done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void parallel_for(size_t count, ParallelTask task, void* context) {
+    run_parallel(count, PARALLEL_CHUNK_ALIGN, PARALLEL_MIN_ITEMS, task, context);
+}
+
+void parallel_for_items(size_t count, ParallelTask task, void* context) {
+    run_parallel(count, 1, 2, task, context);
+}
+
+double wall_clock_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
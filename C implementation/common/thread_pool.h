@@ -0,0 +1,36 @@
+// thread_pool.h
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Work is split into chunks whose boundaries are multiples of this many items, so that
+// two threads never write to the same cache line of an amplitude array
+#define PARALLEL_CHUNK_ALIGN 64
+
+// Loops with fewer items than this run on the calling thread only
+#define PARALLEL_MIN_ITEMS 4096
+
+// Processes items [begin, end). worker is the index of the chunk in [0, num_threads).
+typedef void (*ParallelTask)(size_t begin, size_t end, int worker, void* context);
+
+// Thread count. 1 (the default unless QSIM_NUM_THREADS is set) runs everything serially.
+bool thread_pool_set_num_threads(int num_threads);
+int thread_pool_get_num_threads(void);
+void thread_pool_shutdown(void);
+
+// Splits [0, count) into one contiguous chunk per thread and runs task on each. The
+// partition only depends on count and the thread count, so results are reproducible.
+// Calls made from inside a task run serially on the calling worker.
+void parallel_for(size_t count, ParallelTask task, void* context);
+
+// Same as parallel_for for a few coarse items (whole statevectors, circuits): chunks are
+// not aligned and even a count of 2 is split across threads.
+void parallel_for_items(size_t count, ParallelTask task, void* context);
+
+// Wall-clock seconds from a monotonic clock. clock() adds up the CPU time of every
+// thread and cannot be used to time parallel code.
+double wall_clock_seconds(void);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,391 @@
+// transport.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "transport.h"
+#include "thread_pool.h"
+
+// Doubles summed per round of allreduce_sum
+#define REDUCE_SLOT_VALUES 64
+
+// How long a rank waits for its peers before checking that they are still running
+#define SHM_POLL_MILLISECONDS 100
+
+// Header of the shared mapping; a mailbox of SHM_MAILBOX_BYTES follows it for every rank.
+// Rank r only writes to mailbox r. posted[r] counts the messages it has put there and
+// taken[r] the ones a peer has copied out, so the mailbox is free when the two are equal;
+// destination[r] is the rank the message waiting in it is for. Once failed is set every
+// operation on every rank returns false instead of waiting for a peer that may be gone.
+typedef struct {
+    pthread_mutex_t lock;  // robust, so a rank that dies holding it does not block the rest
+    pthread_cond_t changed;
+    int started;  // 0 while rank 0 is still forking, 1 once all ranks exist, -1 on failure
+    bool failed;
+    int arrived;          // ranks waiting in the current barrier
+    uint64_t generation;  // barriers completed
+    bool finished[MAX_RANKS];  // set by a rank leaving finish_shm_transport after its barrier
+    uint64_t posted[MAX_RANKS];
+    uint64_t taken[MAX_RANKS];
+    int destination[MAX_RANKS];
+    double reduce[MAX_RANKS][REDUCE_SLOT_VALUES];
+} ShmRegion;
+
+// Private to each rank: only rank 0 fills in children and the exit statuses it collected
+typedef struct {
+    ShmRegion* region;
+    size_t mapped_bytes;
+    pid_t parent;  // rank 0
+    pid_t children[MAX_RANKS];
+    bool reaped[MAX_RANKS];
+    int status[MAX_RANKS];
+} ShmContext;
+
+// The header is padded to a cache line so the mailboxes stay aligned
+static size_t region_header_bytes(void) {
+    return (sizeof(ShmRegion) + 63) & ~(size_t)63;
+}
+
+static unsigned char* mailbox(ShmRegion* region, int rank) {
+    return (unsigned char*)region + region_header_bytes() + (size_t)rank * SHM_MAILBOX_BYTES;
+}
+
+static bool valid_peer(const Transport* transport, int peer) {
+    if (peer < 0 || peer >= transport->num_ranks || peer == transport->rank) {
+        fprintf(stderr, "Error: Invalid peer rank %d\n", peer);
+        return false;
+    }
+    return true;
+}
+
+// Sets failed with the lock held and wakes every waiting rank
+static void mark_failed(ShmRegion* region) {
+    region->failed = true;
+    pthread_cond_broadcast(&region->changed);
+}
+
+// A rank that died holding the lock leaves the shared state half updated
+static void lock_region(ShmRegion* region) {
+    if (pthread_mutex_lock(&region->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&region->lock);
+        mark_failed(region);
+    }
+}
+
+// Rank 0 reaps children that have exited; the others notice rank 0 is gone when they are
+// handed to a new parent. A sibling's death reaches them through failed. A child that left
+// finish_shm_transport has passed the last barrier, so rank 0 may still be waking up from
+// it and must not take the exit for a failure.
+static bool peers_alive(Transport* transport) {
+    ShmContext* context = transport->context;
+    if (transport->rank != 0) {
+        if (getppid() == context->parent) return true;
+        fprintf(stderr, "Error: Rank 0 exited while rank %d was waiting for it\n", transport->rank);
+        return false;
+    }
+    bool alive = true;
+    for (int r = 1; r < transport->num_ranks; r++) {
+        if (context->reaped[r]) continue;
+        if (waitpid(context->children[r], &context->status[r], WNOHANG) > 0) {
+            context->reaped[r] = true;
+            if (context->region->finished[r]) continue;
+            fprintf(stderr, "Error: Rank %d exited while rank 0 was waiting for it\n", r);
+            alive = false;
+        }
+    }
+    return alive;
+}
+
+// Waits for changed with the lock held for at most SHM_POLL_MILLISECONDS
+static int timed_wait(ShmRegion* region) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += SHM_POLL_MILLISECONDS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(&region->changed, &region->lock, &deadline);
+}
+
+// Waits for changed with the lock held, but wakes every SHM_POLL_MILLISECONDS to check on
+// the peers. Returns false once any rank has failed.
+static bool wait_changed(Transport* transport) {
+    ShmRegion* region = ((ShmContext*)transport->context)->region;
+    if (region->failed) return false;
+    int result = timed_wait(region);
+    if (result == EOWNERDEAD) {
+        pthread_mutex_consistent(&region->lock);
+        mark_failed(region);
+    } else if (result == ETIMEDOUT && !peers_alive(transport)) {
+        mark_failed(region);
+    }
+    return !region->failed;
+}
+
+// Copies one piece of at most SHM_MAILBOX_BYTES for peer into this rank's mailbox
+static bool post(Transport* transport, int peer, const unsigned char* data, size_t bytes) {
+    ShmRegion* region = ((ShmContext*)transport->context)->region;
+    int rank = transport->rank;
+    lock_region(region);
+    bool ok = !region->failed;
+    while (ok && region->posted[rank] != region->taken[rank]) ok = wait_changed(transport);
+    pthread_mutex_unlock(&region->lock);
+    if (!ok) return false;
+
+    memcpy(mailbox(region, rank), data, bytes);
+
+    lock_region(region);
+    region->destination[rank] = peer;
+    region->posted[rank]++;
+    pthread_cond_broadcast(&region->changed);
+    pthread_mutex_unlock(&region->lock);
+    return true;
+}
+
+// Copies the next piece peer posted for this rank out of its mailbox. The peer may still
+// have a message for another rank waiting there, left from the previous exchange.
+static bool take(Transport* transport, int peer, unsigned char* data, size_t bytes) {
+    ShmRegion* region = ((ShmContext*)transport->context)->region;
+    int rank = transport->rank;
+    lock_region(region);
+    bool ok = !region->failed;
+    while (ok && (region->posted[peer] == region->taken[peer] || region->destination[peer] != rank)) {
+        ok = wait_changed(transport);
+    }
+    pthread_mutex_unlock(&region->lock);
+    if (!ok) return false;
+
+    memcpy(data, mailbox(region, peer), bytes);
+
+    lock_region(region);
+    region->taken[peer]++;
+    pthread_cond_broadcast(&region->changed);
+    pthread_mutex_unlock(&region->lock);
+    return true;
+}
+
+static bool shm_send(Transport* transport, int peer, const void* data, size_t bytes) {
+    if (!valid_peer(transport, peer)) return false;
+    for (size_t offset = 0; offset < bytes; offset += SHM_MAILBOX_BYTES) {
+        size_t piece = bytes - offset < SHM_MAILBOX_BYTES ? bytes - offset : SHM_MAILBOX_BYTES;
+        if (!post(transport, peer, (const unsigned char*)data + offset, piece)) return false;
+    }
+    return true;
+}
+
+static bool shm_recv(Transport* transport, int peer, void* data, size_t bytes) {
+    if (!valid_peer(transport, peer)) return false;
+    for (size_t offset = 0; offset < bytes; offset += SHM_MAILBOX_BYTES) {
+        size_t piece = bytes - offset < SHM_MAILBOX_BYTES ? bytes - offset : SHM_MAILBOX_BYTES;
+        if (!take(transport, peer, (unsigned char*)data + offset, piece)) return false;
+    }
+    return true;
+}
+
+// Both sides post a piece before taking the other's, so neither waits on a full mailbox
+static bool shm_exchange(Transport* transport, int peer, const void* send, void* recv, size_t bytes) {
+    if (!valid_peer(transport, peer)) return false;
+    for (size_t offset = 0; offset < bytes; offset += SHM_MAILBOX_BYTES) {
+        size_t piece = bytes - offset < SHM_MAILBOX_BYTES ? bytes - offset : SHM_MAILBOX_BYTES;
+        if (!post(transport, peer, (const unsigned char*)send + offset, piece) ||
+            !take(transport, peer, (unsigned char*)recv + offset, piece)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The last rank to arrive starts the next generation, which releases the others
+static bool shm_barrier(Transport* transport) {
+    ShmRegion* region = ((ShmContext*)transport->context)->region;
+    lock_region(region);
+    bool ok = !region->failed;
+    if (ok) {
+        uint64_t generation = region->generation;
+        if (++region->arrived == transport->num_ranks) {
+            region->arrived = 0;
+            region->generation++;
+            pthread_cond_broadcast(&region->changed);
+        }
+        while (ok && region->generation == generation) ok = wait_changed(transport);
+    }
+    pthread_mutex_unlock(&region->lock);
+    return ok;
+}
+
+static void shm_fail(Transport* transport) {
+    ShmRegion* region = ((ShmContext*)transport->context)->region;
+    lock_region(region);
+    mark_failed(region);
+    pthread_mutex_unlock(&region->lock);
+}
+
+static bool shm_allreduce_sum(Transport* transport, double* values, size_t count) {
+    ShmRegion* region = ((ShmContext*)transport->context)->region;
+    for (size_t offset = 0; offset < count; offset += REDUCE_SLOT_VALUES) {
+        size_t piece = count - offset < REDUCE_SLOT_VALUES ? count - offset : REDUCE_SLOT_VALUES;
+        memcpy(region->reduce[transport->rank], values + offset, piece * sizeof(double));
+        if (!shm_barrier(transport)) return false;
+        for (size_t i = 0; i < piece; i++) {
+            double sum = 0.0;
+            for (int r = 0; r < transport->num_ranks; r++) sum += region->reduce[r][i];
+            values[offset + i] = sum;
+        }
+        // Nobody refills its slot until every rank has read all of them
+        if (!shm_barrier(transport)) return false;
+    }
+    return true;
+}
+
+static bool initialize_region(ShmRegion* region) {
+    pthread_mutexattr_t mutex_attr;
+    pthread_condattr_t cond_attr;
+    bool ok = pthread_mutexattr_init(&mutex_attr) == 0 && pthread_condattr_init(&cond_attr) == 0 &&
+              pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED) == 0 &&
+              pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST) == 0 &&
+              pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED) == 0 &&
+              pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC) == 0 &&
+              pthread_mutex_init(&region->lock, &mutex_attr) == 0 &&
+              pthread_cond_init(&region->changed, &cond_attr) == 0;
+    return ok;
+}
+
+// Children wait here until rank 0 has forked all of them, so a failed fork never leaves
+// part of the ranks running the caller's program
+static void set_started(ShmRegion* region, int started) {
+    lock_region(region);
+    region->started = started;
+    pthread_cond_broadcast(&region->changed);
+    pthread_mutex_unlock(&region->lock);
+}
+
+// Polls like wait_changed, so a child gives up if rank 0 dies while forking the others
+static int wait_started(const ShmContext* context) {
+    ShmRegion* region = context->region;
+    lock_region(region);
+    while (region->started == 0) {
+        int result = timed_wait(region);
+        if (result == EOWNERDEAD) pthread_mutex_consistent(&region->lock);
+        if (region->started == 0 && result != 0 && getppid() != context->parent) {
+            fprintf(stderr, "Error: Rank 0 exited while starting the ranks\n");
+            region->started = -1;
+        }
+    }
+    int started = region->started;
+    pthread_mutex_unlock(&region->lock);
+    return started;
+}
+
+Transport* create_shm_transport(int num_ranks) {
+    if (num_ranks < 1 || num_ranks > MAX_RANKS) {
+        fprintf(stderr, "Error: Rank count must be between 1 and %d\n", MAX_RANKS);
+        return NULL;
+    }
+    Transport* transport = malloc(sizeof(Transport));
+    ShmContext* context = malloc(sizeof(ShmContext));
+    if (!transport || !context) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(transport);
+        free(context);
+        return NULL;
+    }
+    context->mapped_bytes = region_header_bytes() + (size_t)num_ranks * SHM_MAILBOX_BYTES;
+    void* mapping = mmap(NULL, context->mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map shared memory: %s\n", strerror(errno));
+        free(transport);
+        free(context);
+        return NULL;
+    }
+    context->region = mapping;  // zero-filled by mmap
+    if (!initialize_region(context->region)) {
+        fprintf(stderr, "Error: Could not set up process-shared synchronization\n");
+        munmap(mapping, context->mapped_bytes);
+        free(transport);
+        free(context);
+        return NULL;
+    }
+    transport->rank = 0;
+    transport->num_ranks = num_ranks;
+    transport->send = shm_send;
+    transport->recv = shm_recv;
+    transport->exchange = shm_exchange;
+    transport->allreduce_sum = shm_allreduce_sum;
+    transport->barrier = shm_barrier;
+    transport->fail = shm_fail;
+    transport->context = context;
+    context->parent = getpid();
+    memset(context->reaped, 0, sizeof(context->reaped));
+
+    // Worker threads do not survive fork, and buffered output would be printed twice
+    int num_threads = thread_pool_get_num_threads();
+    thread_pool_shutdown();
+    fflush(stdout);
+    fflush(stderr);
+
+    for (int r = 1; r < num_ranks; r++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            transport->rank = r;
+            if (wait_started(context) < 0) _exit(1);
+            thread_pool_set_num_threads(num_threads);
+            return transport;
+        }
+        if (pid < 0) {
+            fprintf(stderr, "Error: Could not start rank %d: %s\n", r, strerror(errno));
+            set_started(context->region, -1);
+            for (int c = 1; c < r; c++) waitpid(context->children[c], NULL, 0);
+            munmap(mapping, context->mapped_bytes);
+            free(transport);
+            free(context);
+            thread_pool_set_num_threads(num_threads);
+            return NULL;
+        }
+        context->children[r] = pid;
+    }
+    set_started(context->region, 1);
+    thread_pool_set_num_threads(num_threads);
+    return transport;
+}
+
+bool finish_shm_transport(Transport* transport) {
+    if (!transport) return false;
+    ShmContext* context = transport->context;
+    bool ok = transport->barrier(transport);
+    if (transport->rank != 0) {
+        ShmRegion* region = context->region;
+        lock_region(region);
+        region->finished[transport->rank] = ok;
+        pthread_mutex_unlock(&region->lock);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(ok ? 0 : 1);
+    }
+
+    // After a failure the children leave the barrier at once, so none is left to wait for
+    for (int r = 1; r < transport->num_ranks; r++) {
+        if (!context->reaped[r] && waitpid(context->children[r], &context->status[r], 0) < 0) {
+            fprintf(stderr, "Error: Lost track of rank %d\n", r);
+            ok = false;
+            continue;
+        }
+        int status = context->status[r];
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Error: Rank %d exited abnormally\n", r);
+            ok = false;
+        }
+    }
+    pthread_cond_destroy(&context->region->changed);
+    pthread_mutex_destroy(&context->region->lock);
+    munmap(context->region, context->mapped_bytes);
+    free(context);
+    free(transport);
+    return ok;
+}
@@ -0,0 +1,47 @@
+// transport.h
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Largest number of ranks a transport connects
+#define MAX_RANKS 64
+
+// Bytes moved through a shared-memory mailbox at a time; larger messages go in pieces
+#define SHM_MAILBOX_BYTES (1 << 20)
+
+// Message passing between the ranks of a distributed run, in the style of MPI: every
+// rank runs the same program and calls the same collective operations in the same
+// order. An MPI build fills in the table with MPI_Send, MPI_Recv, MPI_Sendrecv,
+// MPI_Allreduce and MPI_Barrier; create_shm_transport provides a stand-in for one machine.
+// Every operation returns false instead of blocking once a rank has failed, whether it
+// called fail or died, so the ranks can wind down together.
+typedef struct Transport Transport;
+struct Transport {
+    int rank;
+    int num_ranks;
+    bool (*send)(Transport* transport, int peer, const void* data, size_t bytes);
+    bool (*recv)(Transport* transport, int peer, void* data, size_t bytes);
+    // Sends bytes to peer and receives as many bytes from it; peer must make the same call
+    bool (*exchange)(Transport* transport, int peer, const void* send, void* recv, size_t bytes);
+    // Replaces values on every rank with their sum over all ranks, added in rank order
+    bool (*allreduce_sum)(Transport* transport, double* values, size_t count);
+    bool (*barrier)(Transport* transport);
+    // Like MPI_Abort: makes the pending and later operations of every rank fail
+    void (*fail)(Transport* transport);
+    void* context;
+};
+
+// Forks num_ranks - 1 child processes that communicate through anonymous shared memory
+// and returns in every one of them, with transport->rank telling them apart. The thread
+// pool is stopped before the fork and restarted with the same thread count in each rank.
+// Returns NULL (in the calling process only) on failure.
+Transport* create_shm_transport(int num_ranks);
+
+// Collective. The child ranks exit here; rank 0 waits for them, releases the shared
+// memory and returns true if every rank got here without a failure. Only rank 0 writes output at
+// exit, so an instrumented build traces rank 0.
+bool finish_shm_transport(Transport* transport);
+
+#endif // TRANSPORT_H
@@ -6,18 +6,45 @@
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include "../common/statevector_core.h"
+#include "../common/circuit.h"
+#include "../common/benchmark.h"
+
+#define MAX_QUBITS 22
+#define SUITE_JSON_FILE "matrix_mult_bench.json"
+#define SUITE_CSV_FILE "matrix_mult_bench.csv"
+#define RUNTIME_REPORT "matrix_mult_runtime"  // written as matrix_mult_runtime_bench.json and .csv
+
+// States with fewer qubits than this apply gates as dense operators; from here on the
+// sparse operators are faster (see --bench-sparse)
+#define SPARSE_MIN_QUBITS 4
 
 // Data structures
 typedef struct {
-    double* data;
-    int num_qubits;
+    double* real;
+    double* imag;
     int dimension;
-} Statevector;
+} Matrix;
 
+// Compressed sparse rows: the entries of row i are
+// [row_start[i], row_start[i + 1]), in ascending column order
 typedef struct {
-    double* data;
     int dimension;
-} Matrix;
+    size_t num_entries;
+    size_t* row_start;  // dimension + 1 offsets
+    int* column;
+    double* real;
+    double* imag;
+} SparseMatrix;
+
+// Permutation times diagonal: row i holds the single entry (real[i], imag[i]) in column
+// column[i]. X, Z, S, T, RZ, CNOT and CZ all take this form.
+typedef struct {
+    int dimension;
+    int* column;
+    double* real;
+    double* imag;
+} PermDiagMatrix;
 
 // Common quantum gates
 typedef enum {
@@ -27,21 +54,49 @@ typedef enum {
 } GateType;
 
 // Core functions
-Statevector* create_statevector(int num_qubits);
-void free_statevector(Statevector* sv);
 Matrix* create_matrix(int dimension);
 void free_matrix(Matrix* matrix);
 
 // Gate operations
 Matrix* create_single_qubit_gate(GateType gate_type);
-void apply_single_qubit_gate(Statevector* sv, GateType gate_type, int target_qubit);
-void apply_cnot(Statevector* sv, int control_qubit, int target_qubit);
-void apply_matrix_to_statevector(Statevector* sv, Matrix* matrix);
+Matrix* create_matrix_from_gate(QuantumGate gate);
+bool apply_single_qubit_gate(Statevector* sv, GateType gate_type, int target_qubit);
+bool apply_gate_matrix(Statevector* sv, const Matrix* gate, int target_qubit);
+bool apply_controlled_gate_matrix(Statevector* sv, const Matrix* gate, int control_qubit, int target_qubit);
+bool apply_cnot(Statevector* sv, int control_qubit, int target_qubit);
+bool apply_matrix_to_statevector(Statevector* sv, Matrix* matrix);
+
+// Dense operators, used below SPARSE_MIN_QUBITS and kept for validation
+bool apply_gate_matrix_dense(Statevector* sv, const Matrix* gate, int target_qubit);
+bool apply_controlled_gate_matrix_dense(Statevector* sv, const Matrix* gate, int control_qubit, int target_qubit);
+bool apply_cnot_dense(Statevector* sv, int control_qubit, int target_qubit);
+
+// Sparse operators. Every builder is O(2^n) in time and memory.
+SparseMatrix* create_sparse_matrix(int dimension, size_t num_entries);
+void free_sparse_matrix(SparseMatrix* matrix);
+SparseMatrix* sparse_identity(int dimension);
+SparseMatrix* sparse_from_dense(const Matrix* matrix);  // drops zero entries, e.g. of a custom unitary
+SparseMatrix* sparse_kronecker(const SparseMatrix* a, const SparseMatrix* b);
+SparseMatrix* build_sparse_gate(const Matrix* gate, int target_qubit, int num_qubits);
+SparseMatrix* build_sparse_controlled_gate(const Matrix* gate, int control_qubit, int target_qubit, int num_qubits);
+bool apply_sparse_to_statevector(Statevector* sv, const SparseMatrix* matrix);
+
+// Permutation-diagonal operators. The builders return NULL when the 2x2 gate is neither
+// diagonal nor anti-diagonal.
+void free_perm_diag_matrix(PermDiagMatrix* matrix);
+PermDiagMatrix* build_perm_diag_gate(const Matrix* gate, int target_qubit, int num_qubits);
+PermDiagMatrix* build_perm_diag_controlled_gate(const Matrix* gate, int control_qubit, int target_qubit,
+                                                int num_qubits);
+bool apply_perm_diag_to_statevector(Statevector* sv, const PermDiagMatrix* matrix);
+
+// Circuit interpreter: every op becomes a full 2^n x 2^n operator, stored sparse from
+// SPARSE_MIN_QUBITS on
+bool apply_circuit_op_matrix(Statevector* sv, const CircuitOp* op, const double* params);
+bool apply_circuit(Statevector* sv, const Circuit* circuit, const double* params);
 
 // Utility functions
-void print_statevector(const Statevector* sv);
-double measure_runtime(int num_qubits);
-void save_runtime_data(int num_qubits, double time_taken);
+bool measure_runtime(int num_qubits, BenchStats* stats);
 void run_circuit_test(int num_qubits);
+void run_sparse_benchmark(int max_dense_qubits, int max_sparse_qubits);
 
 #endif // QUANTUM_SIMULATOR_H
\ No newline at end of file
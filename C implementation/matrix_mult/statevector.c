@@ -1,189 +1,783 @@
 // quantum_simulator.c
+#include <string.h>
 #include "quantum_simulator.h"
+#include "../common/thread_pool.h"
+#include "../common/benchmark.h"
+#include "../common/instrumentation.h"
+#include "../common/state_allocator.h"
 
 // Implementation of core functions
-Statevector* create_statevector(int num_qubits) {
-    Statevector* sv = malloc(sizeof(Statevector));
-    sv->num_qubits = num_qubits;
-    sv->dimension = 1 << num_qubits;
-    sv->data = calloc(sv->dimension, sizeof(double));
-    sv->data[0] = 1.0;  // Initialize to |0...0⟩
-    return sv;
-}
-
-void free_statevector(Statevector* sv) {
-    free(sv->data);
-    free(sv);
-}
-
 Matrix* create_matrix(int dimension) {
     Matrix* matrix = malloc(sizeof(Matrix));
+    if (!matrix) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
     matrix->dimension = dimension;
-    matrix->data = calloc(dimension * dimension, sizeof(double));
+    matrix->real = calloc((size_t)dimension * dimension, sizeof(double));
+    matrix->imag = calloc((size_t)dimension * dimension, sizeof(double));
+    if (!matrix->real || !matrix->imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_matrix(matrix);
+        return NULL;
+    }
+    INSTRUMENT_ALLOC(2 * (size_t)dimension * dimension * sizeof(double));
     return matrix;
 }
 
 void free_matrix(Matrix* matrix) {
-    free(matrix->data);
+    if (!matrix) return;
+    free(matrix->real);
+    free(matrix->imag);
     free(matrix);
 }
 
 // Gate creation functions
 Matrix* create_single_qubit_gate(GateType gate_type) {
     Matrix* gate = create_matrix(2);
+    if (!gate) return NULL;
     
     switch (gate_type) {
         case GATE_X:
-            gate->data[0] = 0.0; gate->data[1] = 1.0;
-            gate->data[2] = 1.0; gate->data[3] = 0.0;
+            gate->real[0] = 0.0; gate->real[1] = 1.0;
+            gate->real[2] = 1.0; gate->real[3] = 0.0;
             break;
         case GATE_H:
-            gate->data[0] = 1.0/sqrt(2); gate->data[1] = 1.0/sqrt(2);
-            gate->data[2] = 1.0/sqrt(2); gate->data[3] = -1.0/sqrt(2);
+            gate->real[0] = 1.0/sqrt(2); gate->real[1] = 1.0/sqrt(2);
+            gate->real[2] = 1.0/sqrt(2); gate->real[3] = -1.0/sqrt(2);
             break;
         case GATE_T:
-            gate->data[0] = 1.0; gate->data[1] = 0.0;
-            gate->data[2] = 0.0; gate->data[3] = sqrt(2)/2;
+            gate->real[0] = 1.0; gate->real[1] = 0.0;
+            gate->real[2] = 0.0; gate->real[3] = sqrt(2)/2;
+            gate->imag[3] = sqrt(2)/2;  // e^{iπ/4}
             break;
     }
     
     return gate;
 }
 
-void apply_single_qubit_gate(Statevector* sv, GateType gate_type, int target_qubit) {
+Matrix* create_matrix_from_gate(QuantumGate gate) {
+    Matrix* matrix = create_matrix(2);
+    if (!matrix) return NULL;
+    for (int r = 0; r < 2; r++) {
+        for (int c = 0; c < 2; c++) {
+            matrix->real[r * 2 + c] = gate.elements[r][c].real;
+            matrix->imag[r * 2 + c] = gate.elements[r][c].imag;
+        }
+    }
+    return matrix;
+}
+
+bool apply_single_qubit_gate(Statevector* sv, GateType gate_type, int target_qubit) {
     Matrix* single_gate = create_single_qubit_gate(gate_type);
-    Matrix* full_gate = create_matrix(sv->dimension);
+    bool ok = single_gate && apply_gate_matrix(sv, single_gate, target_qubit);
+    free_matrix(single_gate);
+    return ok;
+}
+
+bool apply_gate_matrix(Statevector* sv, const Matrix* gate, int target_qubit) {
+    if (sv->num_qubits < SPARSE_MIN_QUBITS) {
+        return apply_gate_matrix_dense(sv, gate, target_qubit);
+    }
+    PermDiagMatrix* perm_diag = build_perm_diag_gate(gate, target_qubit, sv->num_qubits);
+    if (perm_diag) {
+        bool ok = apply_perm_diag_to_statevector(sv, perm_diag);
+        free_perm_diag_matrix(perm_diag);
+        return ok;
+    }
+    SparseMatrix* sparse = build_sparse_gate(gate, target_qubit, sv->num_qubits);
+    if (!sparse) return false;
+    bool ok = apply_sparse_to_statevector(sv, sparse);
+    free_sparse_matrix(sparse);
+    return ok;
+}
+
+bool apply_controlled_gate_matrix(Statevector* sv, const Matrix* gate, int control_qubit, int target_qubit) {
+    if (sv->num_qubits < SPARSE_MIN_QUBITS) {
+        return apply_controlled_gate_matrix_dense(sv, gate, control_qubit, target_qubit);
+    }
+    PermDiagMatrix* perm_diag = build_perm_diag_controlled_gate(gate, control_qubit, target_qubit, sv->num_qubits);
+    if (perm_diag) {
+        bool ok = apply_perm_diag_to_statevector(sv, perm_diag);
+        free_perm_diag_matrix(perm_diag);
+        return ok;
+    }
+    SparseMatrix* sparse = build_sparse_controlled_gate(gate, control_qubit, target_qubit, sv->num_qubits);
+    if (!sparse) return false;
+    bool ok = apply_sparse_to_statevector(sv, sparse);
+    free_sparse_matrix(sparse);
+    return ok;
+}
+
+bool apply_cnot(Statevector* sv, int control_qubit, int target_qubit) {
+    if (sv->num_qubits < SPARSE_MIN_QUBITS) {
+        return apply_cnot_dense(sv, control_qubit, target_qubit);
+    }
+    Matrix* x_gate = create_single_qubit_gate(GATE_X);
+    bool ok = x_gate && apply_controlled_gate_matrix(sv, x_gate, control_qubit, target_qubit);
+    free_matrix(x_gate);
+    return ok;
+}
+
+bool apply_gate_matrix_dense(Statevector* sv, const Matrix* gate, int target_qubit) {
+    int dim = (int)sv->dimension;
+    Matrix* full_gate = create_matrix(dim);
+    if (!full_gate) return false;
     
     // Create full gate matrix
-    for (int i = 0; i < sv->dimension; i++) {
-        for (int j = 0; j < sv->dimension; j++) {
+    for (int i = 0; i < dim; i++) {
+        for (int j = 0; j < dim; j++) {
             int i_target = (i >> target_qubit) & 1;
             int j_target = (j >> target_qubit) & 1;
             if ((i & ~(1 << target_qubit)) == (j & ~(1 << target_qubit))) {
-                full_gate->data[i * sv->dimension + j] = single_gate->data[i_target * 2 + j_target];
+                full_gate->real[i * dim + j] = gate->real[i_target * 2 + j_target];
+                full_gate->imag[i * dim + j] = gate->imag[i_target * 2 + j_target];
             }
         }
     }
     
-    apply_matrix_to_statevector(sv, full_gate);
+    bool ok = apply_matrix_to_statevector(sv, full_gate);
+    free_matrix(full_gate);
+    return ok;
+}
+
+bool apply_controlled_gate_matrix_dense(Statevector* sv, const Matrix* gate, int control_qubit, int target_qubit) {
+    int dim = (int)sv->dimension;
+    Matrix* full_gate = create_matrix(dim);
+    if (!full_gate) return false;
     
-    free_matrix(single_gate);
+    // Identity where the control bit is 0, the gate on the target qubit where it is 1
+    for (int i = 0; i < dim; i++) {
+        for (int j = 0; j < dim; j++) {
+            if ((i & ~(1 << target_qubit)) != (j & ~(1 << target_qubit))) {
+                continue;
+            }
+            if ((i >> control_qubit) & 1) {
+                int i_target = (i >> target_qubit) & 1;
+                int j_target = (j >> target_qubit) & 1;
+                full_gate->real[i * dim + j] = gate->real[i_target * 2 + j_target];
+                full_gate->imag[i * dim + j] = gate->imag[i_target * 2 + j_target];
+            } else if (i == j) {
+                full_gate->real[i * dim + j] = 1.0;
+            }
+        }
+    }
+    
+    bool ok = apply_matrix_to_statevector(sv, full_gate);
     free_matrix(full_gate);
+    return ok;
 }
 
-void apply_cnot(Statevector* sv, int control_qubit, int target_qubit) {
-    Matrix* cnot = create_matrix(sv->dimension);
+bool apply_cnot_dense(Statevector* sv, int control_qubit, int target_qubit) {
+    int dim = (int)sv->dimension;
+    Matrix* cnot = create_matrix(dim);
+    if (!cnot) return false;
     
     // Initialize as identity matrix
-    for (int i = 0; i < sv->dimension; i++) {
-        cnot->data[i * sv->dimension + i] = 1.0;
+    for (int i = 0; i < dim; i++) {
+        cnot->real[i * dim + i] = 1.0;
     }
     
     // Modify for CNOT operation
-    for (int i = 0; i < sv->dimension; i++) {
+    for (int i = 0; i < dim; i++) {
         int control_bit = (i >> control_qubit) & 1;
         if (control_bit == 1) {
             int j = i ^ (1 << target_qubit);
-            cnot->data[i * sv->dimension + i] = 0.0;
-            cnot->data[i * sv->dimension + j] = 1.0;
+            cnot->real[i * dim + i] = 0.0;
+            cnot->real[i * dim + j] = 1.0;
         }
     }
     
-    apply_matrix_to_statevector(sv, cnot);
+    bool ok = apply_matrix_to_statevector(sv, cnot);
     free_matrix(cnot);
+    return ok;
 }
 
-void apply_matrix_to_statevector(Statevector* sv, Matrix* matrix) {
-    double* result = calloc(sv->dimension, sizeof(double));
+bool apply_matrix_to_statevector(Statevector* sv, Matrix* matrix) {
+    INSTRUMENT_BEGIN(span);
+    int dim = (int)sv->dimension;
+    double* result_real = calloc(dim, sizeof(double));
+    double* result_imag = calloc(dim, sizeof(double));
+    if (!result_real || !result_imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(result_real);
+        free(result_imag);
+        return false;
+    }
+    INSTRUMENT_ALLOC(2 * (size_t)dim * sizeof(double));
     
-    for (int i = 0; i < sv->dimension; i++) {
-        for (int j = 0; j < sv->dimension; j++) {
-            result[i] += matrix->data[i * sv->dimension + j] * sv->data[j];
+    for (int i = 0; i < dim; i++) {
+        for (int j = 0; j < dim; j++) {
+            double m_re = matrix->real[i * dim + j], m_im = matrix->imag[i * dim + j];
+            result_real[i] += m_re * sv->real[j] - m_im * sv->imag[j];
+            result_imag[i] += m_re * sv->imag[j] + m_im * sv->real[j];
         }
     }
     
     // Copy result back to statevector
-    for (int i = 0; i < sv->dimension; i++) {
-        sv->data[i] = result[i];
+    for (int i = 0; i < dim; i++) {
+        sv->real[i] = result_real[i];
+        sv->imag[i] = result_imag[i];
     }
     
-    free(result);
+    free(result_real);
+    free(result_imag);
+    // Every matrix element is read once; the state is read dim times and written once
+    INSTRUMENT_END(span, "operator", "dense", -1, -1, 0,
+                   (uint64_t)dim * dim * 2 * (sizeof(double) + BYTES_PER_AMPLITUDE / 2) + (uint64_t)dim * BYTES_PER_AMPLITUDE);
+    return true;
 }
 
-// Utility functions
-void print_statevector(const Statevector* sv) {
-    printf("Statevector (%d qubits):\n", sv->num_qubits);
-    for (int i = 0; i < sv->dimension; i++) {
-        if (fabs(sv->data[i]) > 1e-10) {  // Only print non-zero amplitudes
-            printf("|%d⟩: %.6f\n", i, sv->data[i]);
+// Sparse operators
+
+SparseMatrix* create_sparse_matrix(int dimension, size_t num_entries) {
+    SparseMatrix* matrix = malloc(sizeof(SparseMatrix));
+    if (!matrix) return NULL;
+    matrix->dimension = dimension;
+    matrix->num_entries = num_entries;
+    matrix->row_start = calloc((size_t)dimension + 1, sizeof(size_t));
+    matrix->column = malloc((num_entries + 1) * sizeof(int));
+    matrix->real = malloc((num_entries + 1) * sizeof(double));
+    matrix->imag = malloc((num_entries + 1) * sizeof(double));
+    if (!matrix->row_start || !matrix->column || !matrix->real || !matrix->imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_sparse_matrix(matrix);
+        return NULL;
+    }
+    INSTRUMENT_ALLOC(((size_t)dimension + 1) * sizeof(size_t) + (num_entries + 1) * (sizeof(int) + 2 * sizeof(double)));
+    return matrix;
+}
+
+void free_sparse_matrix(SparseMatrix* matrix) {
+    if (!matrix) return;
+    free(matrix->row_start);
+    free(matrix->column);
+    free(matrix->real);
+    free(matrix->imag);
+    free(matrix);
+}
+
+SparseMatrix* sparse_identity(int dimension) {
+    SparseMatrix* identity = create_sparse_matrix(dimension, (size_t)dimension);
+    if (!identity) return NULL;
+    for (int i = 0; i < dimension; i++) {
+        identity->row_start[i] = (size_t)i;
+        identity->column[i] = i;
+        identity->real[i] = 1.0;
+        identity->imag[i] = 0.0;
+    }
+    identity->row_start[dimension] = (size_t)dimension;
+    return identity;
+}
+
+SparseMatrix* sparse_from_dense(const Matrix* matrix) {
+    int dim = matrix->dimension;
+    size_t num_entries = 0;
+    for (size_t k = 0; k < (size_t)dim * dim; k++) {
+        if (matrix->real[k] != 0.0 || matrix->imag[k] != 0.0) num_entries++;
+    }
+    SparseMatrix* sparse = create_sparse_matrix(dim, num_entries);
+    if (!sparse) return NULL;
+
+    size_t e = 0;
+    for (int i = 0; i < dim; i++) {
+        sparse->row_start[i] = e;
+        for (int j = 0; j < dim; j++) {
+            size_t k = (size_t)i * dim + j;
+            if (matrix->real[k] == 0.0 && matrix->imag[k] == 0.0) continue;
+            sparse->column[e] = j;
+            sparse->real[e] = matrix->real[k];
+            sparse->imag[e] = matrix->imag[k];
+            e++;
+        }
+    }
+    sparse->row_start[dim] = e;
+    return sparse;
+}
+
+// Row ia * db + ib of a ⊗ b is row ia of a times row ib of b; columns stay ascending
+SparseMatrix* sparse_kronecker(const SparseMatrix* a, const SparseMatrix* b) {
+    int db = b->dimension;
+    SparseMatrix* product = create_sparse_matrix(a->dimension * db, a->num_entries * b->num_entries);
+    if (!product) return NULL;
+
+    size_t e = 0;
+    for (int ia = 0; ia < a->dimension; ia++) {
+        for (int ib = 0; ib < db; ib++) {
+            product->row_start[ia * db + ib] = e;
+            for (size_t ea = a->row_start[ia]; ea < a->row_start[ia + 1]; ea++) {
+                for (size_t eb = b->row_start[ib]; eb < b->row_start[ib + 1]; eb++) {
+                    product->column[e] = a->column[ea] * db + b->column[eb];
+                    product->real[e] = a->real[ea] * b->real[eb] - a->imag[ea] * b->imag[eb];
+                    product->imag[e] = a->real[ea] * b->imag[eb] + a->imag[ea] * b->real[eb];
+                    e++;
+                }
+            }
+        }
+    }
+    product->row_start[product->dimension] = e;
+    return product;
+}
+
+// I(2^(n - target - 1)) ⊗ gate ⊗ I(2^target): qubit k is bit k of the row index
+SparseMatrix* build_sparse_gate(const Matrix* gate, int target_qubit, int num_qubits) {
+    SparseMatrix* single = sparse_from_dense(gate);
+    SparseMatrix* low = sparse_identity(1 << target_qubit);
+    SparseMatrix* high = sparse_identity(1 << (num_qubits - target_qubit - 1));
+    SparseMatrix* lower = single && low ? sparse_kronecker(single, low) : NULL;
+    SparseMatrix* full = lower && high ? sparse_kronecker(high, lower) : NULL;
+    free_sparse_matrix(single);
+    free_sparse_matrix(low);
+    free_sparse_matrix(high);
+    free_sparse_matrix(lower);
+    return full;
+}
+
+// Identity on the rows whose control bit is 0, the gate on the target qubit elsewhere
+SparseMatrix* build_sparse_controlled_gate(const Matrix* gate, int control_qubit, int target_qubit, int num_qubits) {
+    int dim = 1 << num_qubits;
+    SparseMatrix* sparse = create_sparse_matrix(dim, 2 * (size_t)dim);
+    if (!sparse) return NULL;
+
+    size_t e = 0;
+    for (int i = 0; i < dim; i++) {
+        sparse->row_start[i] = e;
+        if (!((i >> control_qubit) & 1)) {
+            sparse->column[e] = i;
+            sparse->real[e] = 1.0;
+            sparse->imag[e] = 0.0;
+            e++;
+            continue;
+        }
+        int i_target = (i >> target_qubit) & 1;
+        for (int j_target = 0; j_target < 2; j_target++) {
+            int k = i_target * 2 + j_target;
+            if (gate->real[k] == 0.0 && gate->imag[k] == 0.0) continue;
+            sparse->column[e] = (i & ~(1 << target_qubit)) | (j_target << target_qubit);
+            sparse->real[e] = gate->real[k];
+            sparse->imag[e] = gate->imag[k];
+            e++;
         }
     }
-    printf("\n");
+    sparse->row_start[dim] = e;
+    sparse->num_entries = e;
+    return sparse;
 }
 
-double measure_runtime(int num_qubits) {
-    clock_t start = clock();
+typedef struct {
+    const double* in_real;
+    const double* in_imag;
+    double* out_real;
+    double* out_imag;
+    const SparseMatrix* sparse;
+    const PermDiagMatrix* perm_diag;
+} OperatorJob;
+
+static void sparse_rows_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const OperatorJob* job = context;
+    const SparseMatrix* m = job->sparse;
+    for (size_t i = begin; i < end; i++) {
+        double re = 0.0, im = 0.0;
+        for (size_t e = m->row_start[i]; e < m->row_start[i + 1]; e++) {
+            double v_re = job->in_real[m->column[e]], v_im = job->in_imag[m->column[e]];
+            re += m->real[e] * v_re - m->imag[e] * v_im;
+            im += m->real[e] * v_im + m->imag[e] * v_re;
+        }
+        job->out_real[i] = re;
+        job->out_imag[i] = im;
+    }
+}
+
+static void perm_diag_rows_task(size_t begin, size_t end, int worker, void* context) {
+    (void)worker;
+    const OperatorJob* job = context;
+    const PermDiagMatrix* m = job->perm_diag;
+    for (size_t i = begin; i < end; i++) {
+        double v_re = job->in_real[m->column[i]], v_im = job->in_imag[m->column[i]];
+        job->out_real[i] = m->real[i] * v_re - m->imag[i] * v_im;
+        job->out_imag[i] = m->real[i] * v_im + m->imag[i] * v_re;
+    }
+}
+
+// Runs task over the rows into scratch buffers and copies the result back, so sv may also
+// be a view of amplitudes it does not own
+static bool apply_operator_rows(Statevector* sv, ParallelTask task, OperatorJob* job) {
+    size_t bytes = sv->dimension * sizeof(double);
+    double* out_real = allocate_state_buffer(bytes);
+    double* out_imag = allocate_state_buffer(bytes);
+    if (!out_real || !out_imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_state_buffer(out_real, bytes);
+        free_state_buffer(out_imag, bytes);
+        return false;
+    }
+    INSTRUMENT_ALLOC(sv->dimension * BYTES_PER_AMPLITUDE);
+    job->in_real = sv->real;
+    job->in_imag = sv->imag;
+    job->out_real = out_real;
+    job->out_imag = out_imag;
+    parallel_for(sv->dimension, task, job);
+
+    memcpy(sv->real, out_real, bytes);
+    memcpy(sv->imag, out_imag, bytes);
+    free_state_buffer(out_real, bytes);
+    free_state_buffer(out_imag, bytes);
+    return true;
+}
+
+bool apply_sparse_to_statevector(Statevector* sv, const SparseMatrix* matrix) {
+    INSTRUMENT_BEGIN(span);
+    OperatorJob job = {.sparse = matrix};
+    if (!apply_operator_rows(sv, sparse_rows_task, &job)) return false;
+    // Entries and row starts, one gathered amplitude per entry, one written per row
+    INSTRUMENT_END(span, "operator", "csr", -1, -1, 0,
+                   matrix->num_entries * (sizeof(int) + 2 * sizeof(double) + BYTES_PER_AMPLITUDE) +
+                       sv->dimension * (sizeof(size_t) + BYTES_PER_AMPLITUDE));
+    return true;
+}
+
+// Permutation-diagonal operators
+
+static PermDiagMatrix* create_perm_diag_matrix(int dimension) {
+    PermDiagMatrix* matrix = malloc(sizeof(PermDiagMatrix));
+    if (!matrix) return NULL;
+    matrix->dimension = dimension;
+    matrix->column = malloc((size_t)dimension * sizeof(int));
+    matrix->real = malloc((size_t)dimension * sizeof(double));
+    matrix->imag = malloc((size_t)dimension * sizeof(double));
+    if (!matrix->column || !matrix->real || !matrix->imag) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free_perm_diag_matrix(matrix);
+        return NULL;
+    }
+    INSTRUMENT_ALLOC((size_t)dimension * (sizeof(int) + 2 * sizeof(double)));
+    return matrix;
+}
+
+void free_perm_diag_matrix(PermDiagMatrix* matrix) {
+    if (!matrix) return;
+    free(matrix->column);
+    free(matrix->real);
+    free(matrix->imag);
+    free(matrix);
+}
+
+// 1 for a diagonal gate, -1 for an anti-diagonal one, 0 otherwise
+static int perm_diag_kind(const Matrix* gate) {
+    bool off_diagonal_zero = gate->real[1] == 0.0 && gate->imag[1] == 0.0 && gate->real[2] == 0.0 &&
+                             gate->imag[2] == 0.0;
+    bool diagonal_zero = gate->real[0] == 0.0 && gate->imag[0] == 0.0 && gate->real[3] == 0.0 &&
+                         gate->imag[3] == 0.0;
+    if (off_diagonal_zero) return 1;
+    if (diagonal_zero) return -1;
+    return 0;
+}
+
+static PermDiagMatrix* build_perm_diag(const Matrix* gate, int control_qubit, int target_qubit, int num_qubits) {
+    int kind = perm_diag_kind(gate);
+    if (kind == 0) return NULL;
+    int dim = 1 << num_qubits;
+    PermDiagMatrix* matrix = create_perm_diag_matrix(dim);
+    if (!matrix) return NULL;
+
+    for (int i = 0; i < dim; i++) {
+        if (control_qubit != NO_CONTROL && !((i >> control_qubit) & 1)) {
+            matrix->column[i] = i;
+            matrix->real[i] = 1.0;
+            matrix->imag[i] = 0.0;
+            continue;
+        }
+        int i_target = (i >> target_qubit) & 1;
+        int j_target = kind == 1 ? i_target : 1 - i_target;
+        matrix->column[i] = (i & ~(1 << target_qubit)) | (j_target << target_qubit);
+        matrix->real[i] = gate->real[i_target * 2 + j_target];
+        matrix->imag[i] = gate->imag[i_target * 2 + j_target];
+    }
+    return matrix;
+}
+
+PermDiagMatrix* build_perm_diag_gate(const Matrix* gate, int target_qubit, int num_qubits) {
+    return build_perm_diag(gate, NO_CONTROL, target_qubit, num_qubits);
+}
+
+PermDiagMatrix* build_perm_diag_controlled_gate(const Matrix* gate, int control_qubit, int target_qubit,
+                                                int num_qubits) {
+    return build_perm_diag(gate, control_qubit, target_qubit, num_qubits);
+}
+
+bool apply_perm_diag_to_statevector(Statevector* sv, const PermDiagMatrix* matrix) {
+    INSTRUMENT_BEGIN(span);
+    OperatorJob job = {.perm_diag = matrix};
+    if (!apply_operator_rows(sv, perm_diag_rows_task, &job)) return false;
+    INSTRUMENT_END(span, "operator", "perm-diag", -1, -1, 0,
+                   sv->dimension * (sizeof(int) + 2 * sizeof(double) + 2 * BYTES_PER_AMPLITUDE));
+    return true;
+}
+
+bool apply_circuit_op_matrix(Statevector* sv, const CircuitOp* op, const double* params) {
+    if (op->target < 0 || op->target >= sv->num_qubits ||
+        (op->control != NO_CONTROL &&
+         (op->control < 0 || op->control >= sv->num_qubits || op->control == op->target))) {
+        fprintf(stderr, "Error: Invalid qubit indices\n");
+        return false;
+    }
     
+    INSTRUMENT_BEGIN(span);
+    bool ok;
+    switch (op->op) {
+        case OP_X:
+            ok = apply_single_qubit_gate(sv, GATE_X, op->target);
+            break;
+        case OP_H:
+            ok = apply_single_qubit_gate(sv, GATE_H, op->target);
+            break;
+        case OP_T:
+            ok = apply_single_qubit_gate(sv, GATE_T, op->target);
+            break;
+        case OP_CNOT:
+            ok = apply_cnot(sv, op->control, op->target);
+            break;
+        default: {
+            Matrix* gate = create_matrix_from_gate(circuit_op_gate(op, params));
+            if (!gate) {
+                ok = false;
+            } else if (op->control == NO_CONTROL) {
+                ok = apply_gate_matrix(sv, gate, op->target);
+            } else {
+                ok = apply_controlled_gate_matrix(sv, gate, op->control, op->target);
+            }
+            free_matrix(gate);
+            break;
+        }
+    }
+    INSTRUMENT_END(span, "gate", gate_op_name(op->op), op->target, op->control, 0, 0);
+    return ok;
+}
+
+bool apply_circuit(Statevector* sv, const Circuit* circuit, const double* params) {
+    if (circuit->num_qubits > sv->num_qubits || (circuit->num_params > 0 && params == NULL)) {
+        fprintf(stderr, "Error: Circuit does not match the statevector\n");
+        return false;
+    }
+    for (int i = 0; i < circuit->num_ops; i++) {
+        if (!apply_circuit_op_matrix(sv, &circuit->ops[i], params)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Utility functions
+
+// Once a run fails the remaining calls do nothing, and the timing is discarded
+typedef struct {
+    const Circuit* circuit;
+    Statevector* sv;
+    bool ok;
+} CircuitRun;
+
+static void circuit_run_body(void* context) {
+    CircuitRun* run = context;
+    run->ok = run->ok && apply_circuit(run->sv, run->circuit, NULL);
+}
+
+// Times the test circuit over repeated trials
+bool measure_runtime(int num_qubits, BenchStats* stats) {
+    // Test circuit: X on qubit 0, H on qubit 1, CNOT from qubit 0 to qubit 1
+    Circuit* circuit = create_circuit(num_qubits);
     Statevector* sv = create_statevector(num_qubits);
-    
-    // Apply test circuit
-    apply_single_qubit_gate(sv, GATE_X, 0);
-    apply_single_qubit_gate(sv, GATE_H, 1);
+    if (!circuit || !sv) {
+        free_circuit(circuit);
+        free_statevector(sv);
+        return false;
+    }
+    circuit_add_gate(circuit, OP_X, 0);
     if (num_qubits > 1) {
-        apply_cnot(sv, 0, 1);
+        circuit_add_gate(circuit, OP_H, 1);
+        circuit_add_controlled(circuit, OP_CNOT, 0, 1);
     }
-    
-    clock_t end = clock();
-    double time_taken = (double)(end - start) / CLOCKS_PER_SEC;
-    
-    free_statevector(sv);
-    return time_taken;
-}
 
-void save_runtime_data(int num_qubits, double time_taken) {
-    FILE* file = fopen("runtime_data.txt", "a");
-    if (file == NULL) {
-        fprintf(stderr, "Error opening runtime_data.txt\n");
-        return;
+    CircuitRun run = {circuit, sv, true};
+    bool ok = bench_measure_run(circuit_run_body, &run, stats);
+    if (ok && !run.ok) {
+        fprintf(stderr, "Error: Test circuit failed on %d qubits\n", num_qubits);
+        ok = false;
     }
-    fprintf(file, "%d %.6f\n", num_qubits, time_taken);
-    fclose(file);
+
+    free_statevector(sv);
+    free_circuit(circuit);
+    return ok;
 }
 
 void run_circuit_test(int num_qubits) {
     Statevector* sv = create_statevector(num_qubits);
     
-    printf("\nRunning %d qubit circuit test:\n", num_qubits);
-    print_statevector(sv);
-    
-    // Apply test circuit
-    apply_single_qubit_gate(sv, GATE_X, num_qubits - 1);
-    printf("After X on qubit %d:\n", num_qubits - 1);
-    print_statevector(sv);
+    // Test circuit: X on the last qubit, H and T on qubit 0, CNOT from qubit 0 to the last qubit
+    Circuit* circuit = create_circuit(num_qubits);
+    circuit_add_gate(circuit, OP_X, num_qubits - 1);
+    circuit_add_gate(circuit, OP_H, 0);
+    circuit_add_gate(circuit, OP_T, 0);
+    circuit_add_controlled(circuit, OP_CNOT, 0, num_qubits - 1);
     
-    apply_single_qubit_gate(sv, GATE_H, 0);
-    printf("After H on qubit 0:\n");
+    printf("\nRunning %d qubit circuit test:\n", num_qubits);
     print_statevector(sv);
     
-    apply_cnot(sv, 0, num_qubits - 1);
-    printf("After CNOT (control: 0, target: %d):\n", num_qubits - 1);
-    print_statevector(sv);
+    for (int i = 0; i < circuit->num_ops; i++) {
+        const CircuitOp* op = &circuit->ops[i];
+        apply_circuit_op_matrix(sv, op, NULL);
+        if (op->control == NO_CONTROL) {
+            printf("After %s on qubit %d:\n", gate_op_name(op->op), op->target);
+        } else {
+            printf("After %s (control: %d, target: %d):\n", gate_op_name(op->op), op->control, op->target);
+        }
+        print_statevector(sv);
+    }
     
+    free_circuit(circuit);
+    free_statevector(sv);
+}
+
+// Sparse benchmark
+
+typedef enum { BENCH_DENSE, BENCH_SPARSE } BenchPath;
+
+// Builds and applies H on the top qubit (a CSR operator) and CNOT from qubit 0 to the top
+// qubit (a permutation-diagonal one), continuing from the current state
+typedef struct {
+    Statevector* sv;
+    const Matrix* h_gate;
+    const Matrix* x_gate;
+    BenchPath path;
+    bool ok;
+} SparseCaseRun;
+
+static void sparse_case_body(void* context) {
+    SparseCaseRun* run = context;
+    Statevector* sv = run->sv;
+    int top = sv->num_qubits - 1;
+    bool ok;
+    if (run->path == BENCH_DENSE) {
+        ok = apply_gate_matrix_dense(sv, run->h_gate, top);
+        if (ok && sv->num_qubits > 1) ok = apply_cnot_dense(sv, 0, top);
+    } else {
+        SparseMatrix* sparse = build_sparse_gate(run->h_gate, top, sv->num_qubits);
+        ok = sparse && apply_sparse_to_statevector(sv, sparse);
+        free_sparse_matrix(sparse);
+        if (ok && sv->num_qubits > 1) {
+            PermDiagMatrix* perm_diag = build_perm_diag_controlled_gate(run->x_gate, 0, top, sv->num_qubits);
+            ok = perm_diag && apply_perm_diag_to_statevector(sv, perm_diag);
+            free_perm_diag_matrix(perm_diag);
+        }
+    }
+    run->ok = run->ok && ok;
+}
+
+static bool time_sparse_case(int num_qubits, BenchPath path, BenchStats* stats) {
+    Statevector* sv = create_statevector(num_qubits);
+    Matrix* h_gate = create_single_qubit_gate(GATE_H);
+    Matrix* x_gate = create_single_qubit_gate(GATE_X);
+    bool ok = sv && h_gate && x_gate;
+    if (ok) {
+        SparseCaseRun run = {sv, h_gate, x_gate, path, true};
+        ok = bench_measure_run(sparse_case_body, &run, stats) && run.ok;
+    }
+    free_matrix(h_gate);
+    free_matrix(x_gate);
     free_statevector(sv);
+    return ok;
+}
+
+// Times the dense Kronecker path up to max_dense_qubits (its 2^n x 2^n matrices cost
+// 16 * 4^n bytes) and the sparse path up to max_sparse_qubits, and reports the first
+// qubit count from which the sparse path is faster
+void run_sparse_benchmark(int max_dense_qubits, int max_sparse_qubits) {
+    if (max_dense_qubits < 1 || max_sparse_qubits < 1 || max_dense_qubits > 14 ||
+        max_sparse_qubits > MAX_QUBITS) {
+        fprintf(stderr, "Error: Invalid parameters for sparse benchmark\n");
+        return;
+    }
+    BenchReport* report = create_bench_report("sparse_operators");
+    if (!report) return;
+    int max_qubits = max_dense_qubits > max_sparse_qubits ? max_dense_qubits : max_sparse_qubits;
+    int crossover = -1;
+    bool ok = true;
+    printf("%-8s %12s %12s\n", "qubits", "dense (s)", "sparse (s)");
+    for (int num_qubits = 1; num_qubits <= max_qubits && ok; num_qubits++) {
+        BenchStats dense, sparse;
+        bool with_dense = num_qubits <= max_dense_qubits, with_sparse = num_qubits <= max_sparse_qubits;
+        ok = (!with_dense || time_sparse_case(num_qubits, BENCH_DENSE, &dense)) &&
+             (!with_sparse || time_sparse_case(num_qubits, BENCH_SPARSE, &sparse));
+        if (!ok) break;
+        if (with_dense && with_sparse) {
+            if (sparse.median < dense.median && crossover < 0) crossover = num_qubits;
+            if (sparse.median >= dense.median) crossover = -1;
+        }
+        printf("%-8d", num_qubits);
+        if (with_dense) printf(" %12.6f", dense.median); else printf(" %12s", "-");
+        if (with_sparse) printf(" %12.6f", sparse.median); else printf(" %12s", "-");
+        printf("\n");
+
+        if (with_dense) {
+            BenchResult* result = bench_report_add(report, "dense", &dense);
+            bench_result_value(result, "num_qubits", num_qubits);
+        }
+        if (with_sparse) {
+            BenchResult* result = bench_report_add(report, "sparse", &sparse);
+            bench_result_value(result, "num_qubits", num_qubits);
+            if (with_dense) bench_result_value(result, "speedup", dense.median / sparse.median);
+        }
+    }
+    if (crossover > 0) {
+        printf("Sparse path is faster from %d qubits (SPARSE_MIN_QUBITS = %d)\n", crossover, SPARSE_MIN_QUBITS);
+    } else {
+        printf("Sparse path did not overtake the dense path up to %d qubits\n", max_dense_qubits);
+    }
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
 }
 
 // main.c
-int main(void) {
+int main(int argc, char** argv) {
+    // Sparse crossover benchmark: ./a.out --bench-sparse [max_dense_qubits] [max_sparse_qubits]
+    if (argc > 1 && strcmp(argv[1], "--bench-sparse") == 0) {
+        int max_dense_qubits = argc > 2 ? atoi(argv[2]) : 12;
+        int max_sparse_qubits = argc > 3 ? atoi(argv[3]) : MAX_QUBITS;
+        run_sparse_benchmark(max_dense_qubits, max_sparse_qubits);
+        return 0;
+    }
+
+    // Benchmark suite: ./a.out --bench-suite [min_qubits] [max_qubits] [trials]
+    if (argc > 1 && strcmp(argv[1], "--bench-suite") == 0) {
+        BenchBackend backend = {"matrix_mult", apply_circuit_op_matrix};
+        BenchOptions options = {
+            .min_qubits = argc > 2 ? atoi(argv[2]) : 2,
+            .max_qubits = argc > 3 ? atoi(argv[3]) : 20,
+            .warmup = BENCH_DEFAULT_WARMUP,
+            .trials = argc > 4 ? atoi(argv[4]) : BENCH_DEFAULT_TRIALS,
+            .json_path = SUITE_JSON_FILE,
+            .csv_path = SUITE_CSV_FILE,
+        };
+        return run_benchmark_suite(&backend, &options) ? 0 : 1;
+    }
+
     // Run circuit tests for 2-4 qubits
     for (int num_qubits = 2; num_qubits <= 4; num_qubits++) {
         run_circuit_test(num_qubits);
     }
     
     // Measure runtime for increasing number of qubits
-    for (int num_qubits = 1; num_qubits <= 14; num_qubits++) {
-        double time_taken = measure_runtime(num_qubits);
-        save_runtime_data(num_qubits, time_taken);
+    BenchReport* report = create_bench_report(RUNTIME_REPORT);
+    if (!report) return 1;
+    for (int num_qubits = 1; num_qubits <= MAX_QUBITS; num_qubits++) {
+        BenchStats stats;
+        if (measure_runtime(num_qubits, &stats)) {
+            char label[BENCH_LABEL_LENGTH];
+            snprintf(label, sizeof(label), "qubits/%d", num_qubits);
+            bench_result_value(bench_report_add(report, label, &stats), "num_qubits", num_qubits);
+        }
     }
-    
-    return 0;
+    bool ok = write_bench_report(report);
+    free_bench_report(report);
+    return ok ? 0 : 1;
 }
\ No newline at end of file
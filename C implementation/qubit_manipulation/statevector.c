@@ -2,157 +2,454 @@
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
+#include <string.h>
+#include "../common/statevector_core.h"
+#include "../common/thread_pool.h"
+#include "../common/circuit.h"
+#include "../common/benchmark.h"
+#include "../common/instrumentation.h"
+#include "../common/observable.h"
 
-void apply_x(double *statevector, int num_qubit, int target);
-void apply_h(double *statevector, int num_qubit, int target);
-void apply_cnot(double *statevector, int num_qubit, int control, int target);
-void print_statevector(double *statevector, int num_qubit);
-void initialize_statevector(double *statevector, int num_qubit);
-void save_runtime_data(int num_qubits, double time_taken);
-double test_runtime(int num_qubit);
+void apply_x(Statevector *statevector, int target);
+void apply_h(Statevector *statevector, int target);
+void apply_t(Statevector *statevector, int target);
+void apply_cnot(Statevector *statevector, int control, int target);
+void apply_gate(Statevector *statevector, QuantumGate gate, int target);
+void apply_controlled(Statevector *statevector, QuantumGate gate, int control, int target);
+bool apply_gate_op(Statevector *statevector, const CircuitOp *op, const double *params);
+bool test_runtime(int num_qubit, int num_threads, BenchStats *stats);
+void run_scaling_benchmark(int num_qubit, int max_threads);
+void run_expectation_benchmark(int num_qubit, int num_terms);
 
-int main(void) {
+int main(int argc, char **argv) {
 
-    int num_qubit = 4;
-    double* statevector = (double*) malloc((1 << num_qubit) * sizeof(double));
+    // Benchmark suite: ./a.out --bench-suite [min_qubits] [max_qubits] [trials]
+    if (argc > 1 && strcmp(argv[1], "--bench-suite") == 0) {
+        BenchBackend backend = {"qubit_manipulation", apply_gate_op};
+        BenchOptions options = {
+            .min_qubits = argc > 2 ? atoi(argv[2]) : 2,
+            .max_qubits = argc > 3 ? atoi(argv[3]) : 26,
+            .warmup = BENCH_DEFAULT_WARMUP,
+            .trials = argc > 4 ? atoi(argv[4]) : BENCH_DEFAULT_TRIALS,
+            .json_path = "qubit_manipulation_bench.json",
+            .csv_path = "qubit_manipulation_bench.csv",
+        };
+        return run_benchmark_suite(&backend, &options) ? 0 : 1;
+    }
 
-    for (int i = 0; i < (1 << num_qubit); i++) {
-        statevector[i] = (i == 0) ? 1.0 : 0.0;
+    // Strong-scaling benchmark: ./a.out --bench-scaling [num_qubit] [max_threads]
+    if (argc > 1 && strcmp(argv[1], "--bench-scaling") == 0) {
+        int bench_qubits = argc > 2 ? atoi(argv[2]) : 28;
+        int max_threads = argc > 3 ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        run_scaling_benchmark(bench_qubits, max_threads);
+        return 0;
     }
 
-    print_statevector(statevector, num_qubit);
+    // Expectation value benchmark: ./a.out --bench-expectation [num_qubit] [num_terms]
+    if (argc > 1 && strcmp(argv[1], "--bench-expectation") == 0) {
+        int bench_qubits = argc > 2 ? atoi(argv[2]) : 20;
+        int num_terms = argc > 3 ? atoi(argv[3]) : 2000;
+        run_expectation_benchmark(bench_qubits, num_terms);
+        return 0;
+    }
 
-    // Apply X gate on qubit 0
-    apply_x(statevector, num_qubit, 2);
-    print_statevector(statevector, num_qubit);
+    int num_qubit = 4;
+    Statevector* statevector = create_statevector(num_qubit);  // Initialized to |0...0⟩
+    if (statevector == NULL) {
+        return 1;
+    }
 
-    // Apply H gate on qubit 1
-    apply_h(statevector, num_qubit, 1);
-    print_statevector(statevector, num_qubit);
+    // Demo circuit: X on qubit 2, H and T on qubit 1, then CNOT (control qubit 1, target qubit 2)
+    Circuit* circuit = create_circuit(num_qubit);
+    if (circuit == NULL) {
+        free_statevector(statevector);
+        return 1;
+    }
+    circuit_add_gate(circuit, OP_X, 2);
+    circuit_add_gate(circuit, OP_H, 1);
+    circuit_add_gate(circuit, OP_T, 1);
+    circuit_add_controlled(circuit, OP_CNOT, 1, 2);
+
+    print_statevector(statevector);
+    for (int i = 0; i < circuit->num_ops; i++) {
+        apply_circuit_op(statevector, &circuit->ops[i], NULL);  // Each op goes to its fastest kernel
+        print_statevector(statevector);
+    }
+    free_circuit(circuit);
 
-    // Apply CNOT gate (control qubit 0, target qubit 1)
-    apply_cnot(statevector, num_qubit, 0, 2);
-    print_statevector(statevector, num_qubit);
-    
 
     // TESTING AREA
 
     int max_qubits = 28;  // Maximum number of qubits to simulate
 
+    // Written as qubit_manipulation_runtime_bench.json and .csv
+    BenchReport *report = create_bench_report("qubit_manipulation_runtime");
+    if (report == NULL) {
+        free_statevector(statevector);
+        return 1;
+    }
     for (int num_qubit = 1; num_qubit <= max_qubits; num_qubit++) {
-        double time_taken = test_runtime(num_qubit);  // Test runtime for current number of qubits
-        save_runtime_data(num_qubit, time_taken);     // Save the result to file
+        BenchStats stats;  // Test runtime for current number of qubits
+        if (test_runtime(num_qubit, thread_pool_get_num_threads(), &stats)) {
+            char label[BENCH_LABEL_LENGTH];
+            snprintf(label, sizeof(label), "qubits/%d", num_qubit);
+            bench_result_value(bench_report_add(report, label, &stats), "num_qubits", num_qubit);
+        }
     }
+    bool ok = write_bench_report(report);  // Save the results with the machine they ran on
+    free_bench_report(report);
 
 
-    free(statevector);
+    free_statevector(statevector);
 
 
-    return 0;
+    return ok ? 0 : 1;
 }
 
 
 // Function to apply the X (Pauli-X) gate on a target qubit
-void apply_x(double *statevector, int num_qubit, int target) {
-    int dim = 1 << num_qubit;  // 2^num_qubit
-    for (int i = 0; i < dim; i++) {
-        // Check if the target qubit is 0, then swap with the state where target is 1
-        if (!(i & (1 << target))) {
-            int swap_index = i | (1 << target);  // Set target qubit to 1
-            double temp = statevector[i];
-            statevector[i] = statevector[swap_index];
-            statevector[swap_index] = temp;
-        }
-    }
+void apply_x(Statevector *statevector, int target) {
+    // Swap every amplitude pair that differs only in the target qubit
+    INSTRUMENT_BEGIN(span);
+    kernel_swap_pairs(statevector, target);
+    INSTRUMENT_END(span, "gate", "X", target, NO_CONTROL, 0, 0);
 }
 
 // Function to apply the H (Hadamard) gate on a target qubit
-void apply_h(double *statevector, int num_qubit, int target) {
-    int dim = 1 << num_qubit;  // 2^num_qubit
-    double sqrt_2_inv = 1.0 / sqrt(2.0);  // Precompute 1/sqrt(2)
-    
-    for (int i = 0; i < dim; i++) {
-        // Check if the target qubit is 0, then combine the states where target is 0 and 1
-        if (!(i & (1 << target))) {
-            int target_1_index = i | (1 << target);  // Set target qubit to 1
-            double a = statevector[i];  // Amplitude where target qubit is 0
-            double b = statevector[target_1_index];  // Amplitude where target qubit is 1
-
-            // Update the amplitudes according to Hadamard transformation
-            statevector[i] = sqrt_2_inv * (a + b);
-            statevector[target_1_index] = sqrt_2_inv * (a - b);
-        }
-    }
+void apply_h(Statevector *statevector, int target) {
+    // Replace each pair (a, b) with ((a + b) / sqrt(2), (a - b) / sqrt(2))
+    INSTRUMENT_BEGIN(span);
+    kernel_hadamard_pairs(statevector, target);
+    INSTRUMENT_END(span, "gate", "H", target, NO_CONTROL, 0, 0);
+}
+
+// Function to apply the T gate on a target qubit
+void apply_t(Statevector *statevector, int target) {
+    // Multiply the amplitudes where the target qubit is 1 by e^{iπ/4}
+    Complex phase = {1.0 / sqrt(2.0), 1.0 / sqrt(2.0)};
+    INSTRUMENT_BEGIN(span);
+    kernel_phase_pairs(statevector, phase, target);
+    INSTRUMENT_END(span, "gate", "T", target, NO_CONTROL, 0, 0);
 }
 
 // Function to apply the CNOT gate (as described earlier)
-void apply_cnot(double *statevector, int num_qubit, int control, int target) {
-    int dim = 1 << num_qubit;  // 2^num_qubit
-    for (int i = 0; i < dim; i++) {
-        // Check if control qubit is 1
-        if (i & (1 << control)) {
-            // Get the indices for the target qubit being 0 or 1
-            int target0 = i & ~(1 << target);  // target = 0
-            int target1 = i | (1 << target);   // target = 1
-            
-            // Swap amplitudes for target qubit being 0 and 1
-            double temp = statevector[target0];
-            statevector[target0] = statevector[target1];
-            statevector[target1] = temp;
-        }
+void apply_cnot(Statevector *statevector, int control, int target) {
+    // Swap the target pairs whose control qubit is 1
+    INSTRUMENT_BEGIN(span);
+    kernel_controlled_swap_pairs(statevector, control, target);
+    INSTRUMENT_END(span, "gate", "CNOT", target, control, 0, 0);
+}
+
+// Function to apply any other single-qubit gate on a target qubit
+void apply_gate(Statevector *statevector, QuantumGate gate, int target) {
+    // Replace each pair (a, b) with the gate's matrix times (a, b)
+    INSTRUMENT_BEGIN(span);
+    kernel_matrix_pairs(statevector, &gate, target);
+    INSTRUMENT_END(span, "gate", "U", target, NO_CONTROL, 0, 0);
+}
+
+// Function to apply any other single-qubit gate on a target qubit, controlled by another
+void apply_controlled(Statevector *statevector, QuantumGate gate, int control, int target) {
+    // The same, on the target pairs whose control qubit is 1
+    INSTRUMENT_BEGIN(span);
+    kernel_controlled_matrix_pairs(statevector, &gate, control, target);
+    INSTRUMENT_END(span, "gate", "CU", target, control, 0, 0);
+}
+
+// Function to apply a circuit op with the gate functions above, which the benchmark suite
+// times for this approach
+bool apply_gate_op(Statevector *statevector, const CircuitOp *op, const double *params) {
+    int num_qubit = statevector->num_qubits;
+    if (op->target < 0 || op->target >= num_qubit ||
+        (op->control != NO_CONTROL && (op->control < 0 || op->control >= num_qubit || op->control == op->target))) {
+        printf("Error: Invalid qubit indices\n");
+        return false;
     }
+    if (op->param_index >= 0 && params == NULL) {
+        printf("Error: Missing circuit parameters\n");
+        return false;
+    }
+    if (op->control != NO_CONTROL) {
+        if (op->op == OP_CNOT) apply_cnot(statevector, op->control, op->target);
+        else apply_controlled(statevector, circuit_op_gate(op, params), op->control, op->target);
+        return true;
+    }
+    switch (op->op) {
+        case OP_X: apply_x(statevector, op->target); break;
+        case OP_H: apply_h(statevector, op->target); break;
+        case OP_T: apply_t(statevector, op->target); break;
+        default:   apply_gate(statevector, circuit_op_gate(op, params), op->target); break;
+    }
+    return true;
 }
 
-// Function to print the current statevector
-void print_statevector(double *statevector, int num_qubit) {
-    int dim = 1 << num_qubit;  // 2^num_qubit
-    for (int i = 0; i < dim; i++) {
-        printf("state[%d] = %f\n", i, statevector[i]);
+// Function to time a circuit with repeated trials, on a state first touched by num_threads
+// workers
+static bool time_circuit(const Circuit *circuit, int num_threads, BenchStats *stats) {
+    if (!thread_pool_set_num_threads(num_threads)) {
+        return false;
+    }
+    Statevector* statevector = create_statevector(circuit->num_qubits);  // initialized to |0...0⟩
+    if (statevector == NULL) {
+        return false;
     }
-        printf("\n");
-}   
+    CircuitPlan plan;  // compiled once before the timed runs
+    if (!compile_circuit(circuit, 0, &plan)) {
+        free_statevector(statevector);
+        return false;
+    }
+
+    // One warmup run, then the median of several trials on the wall clock (clock() adds
+    // up the time of every thread)
+    BenchPlanRun run = {&plan, statevector};
+    bool ok = bench_measure_run(bench_plan_body, &run, stats);
+
+    free_circuit_plan(&plan);
+    free_statevector(statevector);
+    return ok;
+}
 
-void initialize_statevector(double *statevector, int num_qubit) {
-    int dim = 1 << num_qubit;
-    for (int i = 0; i < dim; i++) {
-        statevector[i] = (i == 0) ? 1.0 : 0.0;  // Initialize to |0...0⟩
+// Function to time the test circuit for a given number of qubits and threads
+bool test_runtime(int num_qubit, int num_threads, BenchStats *stats) { 
+    // Gates (X, H, CNOT) on various qubits
+    Circuit* circuit = create_circuit(num_qubit);
+    if (circuit == NULL) {
+        return false;
     }
+    circuit_add_gate(circuit, OP_X, 0);
+    circuit_add_gate(circuit, OP_H, 0);
+    if (num_qubit > 1) {
+        circuit_add_controlled(circuit, OP_CNOT, 0, 1);  // Only if there are at least 2 qubits
+    }
+    bool ok = time_circuit(circuit, num_threads, stats);
+    free_circuit(circuit);
+    return ok;
 }
 
-void save_runtime_data(int num_qubits, double time_taken) {
-    FILE *file = fopen("runtime_data.txt", "a");  // Open the file in append mode
-    if (file == NULL) {
-        printf("Error opening file!\n");
+// Function to report the speedup of the parallel kernels over the serial run (1 thread), on
+// H on every qubit followed by a CNOT ladder: every gate sweeps the whole state, so the
+// sweeps rather than waking the workers make up the time
+void run_scaling_benchmark(int num_qubit, int max_threads) {
+    if (num_qubit < 2 || num_qubit > 30 || max_threads < 1) {
+        printf("Error: Invalid parameters for scaling benchmark\n");
+        return;
+    }
+    Circuit *circuit = create_circuit(num_qubit);
+    if (circuit == NULL) {
         return;
     }
-    fprintf(file, "%d %f\n", num_qubits, time_taken);  // Write num_qubits and time_taken
-    fclose(file);
+    for (int q = 0; q < num_qubit; q++) circuit_add_gate(circuit, OP_H, q);
+    for (int q = 0; q + 1 < num_qubit; q++) circuit_add_controlled(circuit, OP_CNOT, q, q + 1);
+    BenchReport *report = create_bench_report("scaling");
+    if (report == NULL) {
+        free_circuit(circuit);
+        return;
+    }
+
+    printf("%d qubits, %d gates\n", num_qubit, circuit->num_ops);
+    double serial_time = -1.0;
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        BenchStats stats;
+        if (!time_circuit(circuit, num_threads, &stats)) break;
+        double time_taken = stats.median;
+        if (serial_time < 0) serial_time = time_taken;
+        double speedup = serial_time / time_taken;
+        printf("%d threads: %f s, speedup %.2fx, efficiency %.0f%%\n",
+               num_threads, time_taken, speedup, 100.0 * speedup / num_threads);
+
+        char label[BENCH_LABEL_LENGTH];
+        snprintf(label, sizeof(label), "threads/%d", num_threads);
+        BenchResult *result = bench_report_add(report, label, &stats);
+        bench_result_value(result, "num_qubits", num_qubit);
+        bench_result_value(result, "gates", circuit->num_ops);
+        bench_result_value(result, "threads", num_threads);
+        bench_result_value(result, "speedup", speedup);
+        bench_result_value(result, "efficiency", speedup / num_threads);
+    }
+    thread_pool_set_num_threads(1);
+    write_bench_report(report);
+    free_bench_report(report);
+    free_circuit(circuit);
+}
+
+// Function to compute <psi|P|psi> the way it is done without the observable engine: copy
+// the state, apply the Pauli string gate by gate and take the inner product
+static double copy_and_apply_expectation(const Statevector *statevector, const PauliTerm *term) {
+    Statevector *copy = create_statevector(statevector->num_qubits);
+    if (copy == NULL) {
+        return 0.0;
+    }
+    memcpy(copy->real, statevector->real, statevector->dimension * sizeof(double));
+    memcpy(copy->imag, statevector->imag, statevector->dimension * sizeof(double));
+    QuantumGate y = get_y_gate();
+    Complex minus_one = {-1.0, 0.0};
+    for (int q = 0; q < statevector->num_qubits; q++) {
+        int x = (term->x_mask >> q) & 1, z = (term->z_mask >> q) & 1;
+        if (x && z) kernel_matrix_pairs(copy, &y, q);
+        else if (x) apply_x(copy, q);
+        else if (z) kernel_phase_pairs(copy, minus_one, q);
+    }
+    double value = 0.0;
+    for (size_t i = 0; i < statevector->dimension; i++) {
+        value += statevector->real[i] * copy->real[i] + statevector->imag[i] * copy->imag[i];
+    }
+    free_statevector(copy);
+    return value;
 }
 
-// Function to test and return the runtime for a given number of qubits
-double test_runtime(int num_qubit) { 
-    int dim = 1 << num_qubit;  // Dimension of the statevector (2^num_qubit)
-    double* statevector = (double*) malloc(dim * sizeof(double));  // Allocate memory for statevector
+// Function to count the Pauli strings on num_qubit qubits with one to max_weight non-identity
+// factors: sum over w of C(n, w) 3^w
+static long count_pauli_strings(int num_qubit, int max_weight) {
+    long count = 0, choose = 1, power = 1;
+    for (int w = 1; w <= max_weight && w <= num_qubit; w++) {
+        choose = choose * (num_qubit - w + 1) / w;
+        power *= 3;
+        count += choose * power;
+    }
+    return count;
+}
 
-    initialize_statevector(statevector, num_qubit);  // Initialize to |0...0⟩
+// Function to evaluate every term with the observable engine
+typedef struct {
+    const Statevector *statevector;
+    const Observable *observable;
+    double *values;
+    bool ok;
+} EngineRun;
 
-    // Start measuring time
-    clock_t start_time = clock();
+static void engine_run_body(void *context) {
+    EngineRun *run = context;
+    run->ok = pauli_expectations(run->statevector, run->observable, run->values) && run->ok;
+}
 
-    // Apply gates (X, H, CNOT) on various qubits
-    apply_x(statevector, num_qubit, 0);
-    apply_h(statevector, num_qubit, 0);
-    if (num_qubit > 1) {
-        apply_cnot(statevector, num_qubit, 0, 1);  // Only if there are at least 2 qubits
+// Function to evaluate every stride-th term by copy and apply, keeping the largest
+// difference from the engine's values
+typedef struct {
+    const Statevector *statevector;
+    const Observable *observable;
+    const double *values;
+    int stride;
+    double max_error;
+} BaselineRun;
+
+static void baseline_run_body(void *context) {
+    BaselineRun *run = context;
+    for (int t = 0; t < run->observable->num_terms; t += run->stride) {
+        double value = copy_and_apply_expectation(run->statevector, &run->observable->terms[t]);
+        double error = fabs(value - run->values[t]);
+        if (error > run->max_error) run->max_error = error;
     }
+}
 
-    // Stop measuring time
-    clock_t end_time = clock();
-    double time_taken = (double)(end_time - start_time) / CLOCKS_PER_SEC;
+// Function to time a Hamiltonian of num_terms Pauli strings on a layered H-T-CNOT state:
+// ZZ on every qubit pair, X on every qubit, XX and YY on neighbours, then random strings
+// of up to four Paulis. The copy-and-apply baseline runs on a sample of the terms and is
+// scaled up to all of them. Asking for more terms than there are such strings gets all of
+// them, and the terms actually built are reported.
+void run_expectation_benchmark(int num_qubit, int num_terms) {
+    if (num_qubit < 2 || num_qubit > 30 || num_terms < 1) {
+        printf("Error: Invalid parameters for expectation benchmark\n");
+        return;
+    }
+    Statevector *statevector = create_statevector(num_qubit);
+    Observable *observable = create_observable(num_qubit);
+    char *paulis = malloc((size_t)num_qubit + 1);
+    if (statevector == NULL || observable == NULL || paulis == NULL) {
+        free_statevector(statevector);
+        free_observable(observable);
+        free(paulis);
+        return;
+    }
+    for (int layer = 0; layer < 3; layer++) {
+        for (int q = 0; q < num_qubit; q++) {
+            apply_h(statevector, q);
+            if ((q + layer) % 2) apply_t(statevector, q);
+        }
+        for (int q = layer % 2; q + 1 < num_qubit; q += 2) apply_cnot(statevector, q, q + 1);
+    }
 
-    // Free memory
-    free(statevector);
+    long max_terms = count_pauli_strings(num_qubit, 4);
+    if (num_terms > max_terms) {
+        printf("Only %ld strings of up to four Paulis on %d qubits, using all of them\n", max_terms, num_qubit);
+        num_terms = (int)max_terms;
+    }
+    // Random strings repeat ever more often as they run out, so the draws are bounded too
+    long draws_left = 64L * num_terms;
+    unsigned int seed = 7;
+    while (observable->num_terms < num_terms && draws_left-- > 0) {
+        int t = observable->num_terms;
+        memset(paulis, 'I', (size_t)num_qubit);
+        paulis[num_qubit] = '\0';
+        int pairs = num_qubit * (num_qubit - 1) / 2;
+        if (t < pairs) {
+            // Pair t in row-major order of the upper triangle
+            int a = 0, rest = t;
+            while (rest >= num_qubit - 1 - a) rest -= num_qubit - 1 - a++;
+            paulis[a] = paulis[a + 1 + rest] = 'Z';
+        } else if (t < pairs + num_qubit) {
+            paulis[t - pairs] = 'X';
+        } else if (t < pairs + 3 * num_qubit - 2) {
+            int q = (t - pairs - num_qubit) / 2;
+            paulis[q] = paulis[q + 1] = (t - pairs - num_qubit) % 2 ? 'Y' : 'X';
+        } else {
+            for (int k = 0; k < 4; k++) {
+                seed = seed * 1103515245u + 12345u;
+                paulis[(seed >> 8) % (unsigned)num_qubit] = "XYZ"[(seed >> 20) % 3];
+            }
+        }
+        if (!observable_add_term(observable, 1.0 / (1 + t % 7), paulis)) break;
+    }
+
+    if (observable->num_terms < num_terms) {
+        printf("Built %d distinct terms of the %d requested\n", observable->num_terms, num_terms);
+    }
 
-    // Return the time taken
-    return time_taken;
-}
\ No newline at end of file
+    double *values = malloc((size_t)observable->num_terms * sizeof(double));
+    BenchReport *report = values != NULL ? create_bench_report("expectation") : NULL;
+    if (report == NULL) {
+        free(values);
+        free_statevector(statevector);
+        free_observable(observable);
+        free(paulis);
+        return;
+    }
+    EngineRun engine = {statevector, observable, values, true};
+    BenchStats engine_stats;
+    bool ok = bench_measure_run(engine_run_body, &engine, &engine_stats) && engine.ok;
+
+    int stride = observable->num_terms > 50 ? observable->num_terms / 50 : 1;
+    int sampled = (observable->num_terms + stride - 1) / stride;
+    BaselineRun baseline = {statevector, observable, values, stride, 0.0};
+    BenchStats baseline_stats;
+    ok = ok && bench_measure_run(baseline_run_body, &baseline, &baseline_stats);
+
+    if (ok) {
+        double engine_time = engine_stats.median;
+        double baseline_time = baseline_stats.median * observable->num_terms / sampled;
+        int passes = observable_num_passes(observable);
+        printf("%d qubits, %d terms in %d passes\n", num_qubit, observable->num_terms, passes);
+        printf("Observable engine: %f s, copy and apply: %f s (estimated from %d terms), speedup %.1fx\n",
+               engine_time, baseline_time, sampled, baseline_time / engine_time);
+        printf("Max difference: %.3e\n", baseline.max_error);
+
+        BenchResult *result = bench_report_add(report, "engine", &engine_stats);
+        bench_result_value(result, "num_qubits", num_qubit);
+        bench_result_value(result, "terms", observable->num_terms);
+        bench_result_value(result, "passes", passes);
+        // Timed on the sampled terms only; estimated_s scales it up to all of them
+        result = bench_report_add(report, "copy_and_apply", &baseline_stats);
+        bench_result_value(result, "num_qubits", num_qubit);
+        bench_result_value(result, "terms", sampled);
+        bench_result_value(result, "estimated_s", baseline_time);
+        bench_result_value(result, "speedup", baseline_time / engine_time);
+        bench_result_value(result, "max_diff", baseline.max_error);
+        write_bench_report(report);
+    }
+
+    free_bench_report(report);
+    free(values);
+    free_statevector(statevector);
+    free_observable(observable);
+    free(paulis);
+}
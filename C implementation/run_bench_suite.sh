@@ -0,0 +1,13 @@
+#!/bin/sh
+# Builds each approach and runs the shared benchmark suite on it, so that the three reports
+# (<backend>_bench.json and .csv) land side by side in the current directory:
+#   ./run_bench_suite.sh [min_qubits] [max_qubits] [trials]
+# Without arguments every approach uses its own default range. CC picks the compiler.
+set -e
+root=$(cd "$(dirname "$0")" && pwd)
+build=$(mktemp -d)
+trap 'rm -rf "$build"' EXIT
+for backend in tensor_mult qubit_manipulation matrix_mult; do
+    ${CC:-clang} -O2 "$root/$backend"/*.c "$root"/common/*.c -lm -lpthread -o "$build/$backend"
+    "$build/$backend" --bench-suite "$@"
+done
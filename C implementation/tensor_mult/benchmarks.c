@@ -0,0 +1,1365 @@
+// benchmarks.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "quantum_simulator.h"
+#include "../common/circuit.h"
+#include "../common/benchmark.h"
+#include "../common/observable.h"
+#include "../common/gradient.h"
+#include "../common/state_allocator.h"
+#include "../common/thread_pool.h"
+#include "../common/measurement.h"
+#include "../common/stabilizer.h"
+#include "../common/simulator.h"
+#include "../common/mps.h"
+#include "../common/state_batch.h"
+#include "../common/noise.h"
+#include "../common/checkpoint.h"
+#include "../common/mapped_statevector.h"
+#include "../common/sparse_statevector.h"
+
+// Benchmarks of whole circuits and engines, timed with bench_measure_run and written as
+// structured reports (<name>_bench.json and .csv) next to the suite's
+
+// Diagonal sweep benchmark
+
+// QFT-style: every qubit gets an H followed by the phase ladder it controls (CZ, S and T
+// standing in for the controlled rotations), so the diagonal gates of later qubits are
+// hoisted past the H gates into long runs
+static Circuit* build_qft_style_circuit(int num_qubits, int depth) {
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    bool ok = true;
+    for (int layer = 0; layer < depth && ok; layer++) {
+        for (int q = 0; q < num_qubits && ok; q++) {
+            ok = circuit_add_gate(circuit, OP_H, q);
+            for (int k = q + 1; k < num_qubits && ok; k++) {
+                ok = circuit_add_controlled(circuit, OP_CZ, k, q) && circuit_add_gate(circuit, k % 2 ? OP_T : OP_S, k);
+            }
+        }
+    }
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+// QAOA-style: each layer is a cost layer of CZ on a ring and RZ on every qubit, all
+// diagonal, followed by an RX mixer
+static Circuit* build_qaoa_style_circuit(int num_qubits, int depth) {
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    bool ok = true;
+    for (int q = 0; q < num_qubits && ok; q++) ok = circuit_add_gate(circuit, OP_H, q);
+    for (int layer = 0; layer < depth && ok; layer++) {
+        for (int q = 0; q < num_qubits && ok; q++) {
+            ok = circuit_add_controlled(circuit, OP_CZ, q, (q + 1) % num_qubits);
+        }
+        for (int q = 0; q < num_qubits && ok; q++) {
+            ok = circuit_add_rotation(circuit, OP_RZ, q, 0.41 * (layer + 1) + 0.07 * q);
+        }
+        for (int q = 0; q < num_qubits && ok; q++) {
+            ok = circuit_add_rotation(circuit, OP_RX, q, 0.23 * (layer + 1));
+        }
+    }
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+// Runs both circuits gate by gate and as compiled plans, where each run of diagonal gates
+// is one sweep, and reports the passes over the state and the time of each. One run of
+// each from |0...0⟩ is compared before the timed runs continue from the results.
+void run_diagonal_benchmark(int num_qubits, int depth) {
+    if (num_qubits < 2 || num_qubits > MAX_QUBITS || depth < 1) {
+        fprintf(stderr, "Error: Invalid parameters for diagonal benchmark\n");
+        return;
+    }
+    BenchReport* report = create_bench_report("diagonal");
+    if (!report) return;
+    const char* names[2] = {"qft", "qaoa"};
+    printf("%-7s %-7s %7s %7s %7s %12s %12s %9s %10s\n", "circuit", "qubits", "gates", "passes", "sweeps",
+           "gates (s)", "swept (s)", "speedup", "max diff");
+
+    bool ok = true;
+    for (int c = 0; c < 2 && ok; c++) {
+        Circuit* circuit = c == 0 ? build_qft_style_circuit(num_qubits, depth) : build_qaoa_style_circuit(num_qubits, depth);
+        Statevector* gate_sv = create_statevector(num_qubits);
+        Statevector* swept_sv = create_statevector(num_qubits);
+        CircuitPlan plan;
+        if (!circuit || !gate_sv || !swept_sv || !compile_circuit(circuit, 0, &plan)) {
+            fprintf(stderr, "Error: Failed to set up diagonal benchmark\n");
+            free_circuit(circuit);
+            free_statevector(gate_sv);
+            free_statevector(swept_sv);
+            ok = false;
+            break;
+        }
+
+        BenchOpsRun gate_run = {circuit, gate_sv};
+        BenchPlanRun swept_run = {&plan, swept_sv};
+        bench_ops_body(&gate_run);
+        bench_plan_body(&swept_run);
+        int num_sweeps = 0;
+        for (int i = 0; i < plan.num_steps; i++) num_sweeps += plan.steps[i].kind == STEP_DIAGONAL_SWEEP;
+        double max_error = 0.0;
+        for (size_t i = 0; i < gate_sv->dimension; i++) {
+            double err = fabs(swept_sv->real[i] - gate_sv->real[i]) + fabs(swept_sv->imag[i] - gate_sv->imag[i]);
+            if (err > max_error) max_error = err;
+        }
+
+        BenchStats gate_stats, swept_stats;
+        ok = bench_measure_run(bench_ops_body, &gate_run, &gate_stats) &&
+             bench_measure_run(bench_plan_body, &swept_run, &swept_stats);
+        if (ok) {
+            printf("%-7s %-7d %7d %7d %7d %12.6f %12.6f %8.2fx %10.3e\n", names[c], num_qubits, circuit->num_ops,
+                   plan.num_steps, num_sweeps, gate_stats.median, swept_stats.median,
+                   gate_stats.median / swept_stats.median, max_error);
+            char label[BENCH_LABEL_LENGTH];
+            snprintf(label, sizeof(label), "%s/gates", names[c]);
+            BenchResult* result = bench_report_add(report, label, &gate_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "depth", depth);
+            bench_result_value(result, "passes", circuit->num_ops);
+            snprintf(label, sizeof(label), "%s/swept", names[c]);
+            result = bench_report_add(report, label, &swept_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "depth", depth);
+            bench_result_value(result, "passes", plan.num_steps);
+            bench_result_value(result, "sweeps", num_sweeps);
+            bench_result_value(result, "speedup", gate_stats.median / swept_stats.median);
+            bench_result_value(result, "max_diff", max_error);
+        }
+
+        free_circuit_plan(&plan);
+        free_circuit(circuit);
+        free_statevector(gate_sv);
+        free_statevector(swept_sv);
+    }
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+}
+
+// Gradient benchmark
+
+// Parameters of the sampled derivatives timed by the parameter-shift rule, whose cost
+// grows with the parameter count; the full time is extrapolated from them
+#define GRADIENT_SHIFT_SAMPLES 4
+
+// Hardware-efficient ansatz: each layer is a parametric RY and RZ on every qubit followed
+// by a CNOT ladder, so it has 2 * num_qubits * layers parameters
+static Circuit* build_hardware_efficient_ansatz(int num_qubits, int layers) {
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    bool ok = true;
+    int param = 0;
+    for (int layer = 0; layer < layers && ok; layer++) {
+        for (int q = 0; q < num_qubits && ok; q++) {
+            ok = circuit_add_parametric(circuit, OP_RY, q, param++) && circuit_add_parametric(circuit, OP_RZ, q, param++);
+        }
+        for (int q = 0; q + 1 < num_qubits && ok; q++) ok = circuit_add_controlled(circuit, OP_CNOT, q, q + 1);
+    }
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+// Sum of Z_q and Z_q Z_q+1 over the chain, an Ising-type cost function
+static Observable* build_chain_observable(int num_qubits) {
+    Observable* observable = create_observable(num_qubits);
+    char* paulis = malloc((size_t)num_qubits + 1);
+    bool ok = observable && paulis;
+    for (int q = 0; q < num_qubits && ok; q++) {
+        memset(paulis, 'I', (size_t)num_qubits);
+        paulis[num_qubits] = '\0';
+        paulis[q] = 'Z';
+        ok = observable_add_term(observable, 1.0, paulis);
+        if (ok && q + 1 < num_qubits) {
+            paulis[q + 1] = 'Z';
+            ok = observable_add_term(observable, 0.5, paulis);
+        }
+    }
+    free(paulis);
+    if (!ok) {
+        free_observable(observable);
+        return NULL;
+    }
+    return observable;
+}
+
+// Parameter-shift derivatives of the sampled parameters
+typedef struct {
+    const Circuit* circuit;
+    const double* params;
+    const Observable* observable;
+    int samples;
+    double* derivatives;
+    bool ok;
+} ShiftRun;
+
+static void shift_run_body(void* context) {
+    ShiftRun* run = context;
+    for (int s = 0; s < run->samples && run->ok; s++) {
+        int k = (int)((long)s * run->circuit->num_params / run->samples);
+        run->ok = parameter_shift_derivative(run->circuit, run->params, run->observable, k, &run->derivatives[s]);
+    }
+}
+
+typedef struct {
+    const Circuit* circuit;
+    const double* params;
+    const Observable* observable;
+    double* gradient;
+    bool ok;
+} AdjointRun;
+
+static void adjoint_run_body(void* context) {
+    AdjointRun* run = context;
+    double expectation;
+    run->ok = run->ok && adjoint_gradient(run->circuit, run->params, run->observable, &expectation, run->gradient);
+}
+
+// Times the full adjoint gradient against the parameter-shift rule, which is timed on
+// GRADIENT_SHIFT_SAMPLES parameters and scaled to all of them; the sampled derivatives
+// are checked against the adjoint ones
+void run_gradient_benchmark(int min_qubits, int max_qubits, int layers) {
+    if (min_qubits < 2 || max_qubits > MAX_QUBITS || min_qubits > max_qubits || layers < 1) {
+        fprintf(stderr, "Error: Invalid parameters for gradient benchmark\n");
+        return;
+    }
+    BenchReport* report = create_bench_report("gradient");
+    if (!report) return;
+    size_t memory = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE);
+    printf("%-7s %7s %7s %14s %14s %9s %10s\n", "qubits", "params", "gates", "adjoint (s)", "shift est (s)",
+           "speedup", "max diff");
+
+    bool ok = true;
+    for (int num_qubits = min_qubits; num_qubits <= max_qubits && ok; num_qubits++) {
+        // The adjoint method keeps two states; leave a quarter of the memory to everything else
+        if (2 * statevector_bytes(num_qubits) > memory / 4 * 3) {
+            printf("%d qubits: skipped, needs %zu MiB\n", num_qubits, 2 * statevector_bytes(num_qubits) >> 20);
+            continue;
+        }
+        Circuit* circuit = build_hardware_efficient_ansatz(num_qubits, layers);
+        Observable* observable = build_chain_observable(num_qubits);
+        double* params = circuit ? malloc((size_t)circuit->num_params * sizeof(double)) : NULL;
+        double* gradient = circuit ? malloc((size_t)circuit->num_params * sizeof(double)) : NULL;
+        if (!circuit || !observable || !params || !gradient) {
+            fprintf(stderr, "Error: Failed to set up gradient benchmark\n");
+            free_circuit(circuit);
+            free_observable(observable);
+            free(params);
+            free(gradient);
+            ok = false;
+            break;
+        }
+        for (int k = 0; k < circuit->num_params; k++) params[k] = (double)(benchmark_random() % 6283) / 1000.0;
+
+        int samples = circuit->num_params < GRADIENT_SHIFT_SAMPLES ? circuit->num_params : GRADIENT_SHIFT_SAMPLES;
+        double derivatives[GRADIENT_SHIFT_SAMPLES];
+        AdjointRun adjoint = {circuit, params, observable, gradient, true};
+        ShiftRun shift = {circuit, params, observable, samples, derivatives, true};
+        BenchStats adjoint_stats, shift_stats;
+        ok = bench_measure_run(adjoint_run_body, &adjoint, &adjoint_stats) &&
+             bench_measure_run(shift_run_body, &shift, &shift_stats);
+        if (ok && (!adjoint.ok || !shift.ok)) {
+            fprintf(stderr, "Error: Gradient computation failed\n");
+            ok = false;
+        }
+        if (ok) {
+            double max_error = 0.0;
+            for (int s = 0; s < samples; s++) {
+                int k = (int)((long)s * circuit->num_params / samples);
+                if (fabs(derivatives[s] - gradient[k]) > max_error) max_error = fabs(derivatives[s] - gradient[k]);
+            }
+            double shift_estimate = shift_stats.median * circuit->num_params / samples;
+            printf("%-7d %7d %7d %14.6f %14.6f %8.2fx %10.3e\n", num_qubits, circuit->num_params, circuit->num_ops,
+                   adjoint_stats.median, shift_estimate, shift_estimate / adjoint_stats.median, max_error);
+            BenchResult* result = bench_report_add(report, "adjoint", &adjoint_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "layers", layers);
+            bench_result_value(result, "params", circuit->num_params);
+            bench_result_value(result, "gates", circuit->num_ops);
+            // Timed on the sampled parameters only
+            result = bench_report_add(report, "parameter-shift", &shift_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "layers", layers);
+            bench_result_value(result, "params", samples);
+            bench_result_value(result, "full_estimate_s", shift_estimate);
+            bench_result_value(result, "max_diff", max_error);
+        }
+
+        free_circuit(circuit);
+        free_observable(observable);
+        free(params);
+        free(gradient);
+    }
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+}
+
+// Memory placement benchmark
+
+// Allocates, first-touches and releases a state
+typedef struct {
+    int num_qubits;
+    bool ok;
+} AllocationRun;
+
+static void allocation_run_body(void* context) {
+    AllocationRun* run = context;
+    Statevector* sv = create_statevector(run->num_qubits);
+    run->ok = run->ok && sv;
+    free_statevector(sv);
+}
+
+// One gate, applied again on every call
+typedef struct {
+    const CircuitOp* op;
+    Statevector* sv;
+} GateRun;
+
+static void gate_run_body(void* context) {
+    const GateRun* run = context;
+    apply_circuit_op(run->sv, run->op, NULL);
+}
+
+// Times allocating, first-touching and releasing a state, then single gates on the lowest
+// and the three highest qubits, under each page size and NUMA policy, over repeats
+// trials. High-qubit gates pair amplitudes that lie far apart, so with 4 KiB pages nearly
+// every access misses the TLB.
+void run_memory_benchmark(int num_qubits, int repeats) {
+    if (num_qubits < 4 || num_qubits > MAX_QUBITS || repeats < 1) {
+        fprintf(stderr, "Error: Invalid parameters for memory benchmark\n");
+        return;
+    }
+    size_t memory = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE);
+    if (statevector_bytes(num_qubits) > memory / 4 * 3) {
+        printf("%d qubits: skipped, needs %zu MiB\n", num_qubits, statevector_bytes(num_qubits) >> 20);
+        return;
+    }
+    BenchReport* report = create_bench_report("memory");
+    if (!report) return;
+    HugePageMode saved_mode = get_huge_page_mode();
+    NumaPolicy saved_policy = get_numa_policy();
+    struct {
+        HugePageMode mode;
+        NumaPolicy policy;
+    } configs[4] = {
+        {HUGE_PAGES_OFF, NUMA_FIRST_TOUCH},
+        {HUGE_PAGES_TRANSPARENT, NUMA_FIRST_TOUCH},
+        {HUGE_PAGES_EXPLICIT, NUMA_FIRST_TOUCH},
+        {HUGE_PAGES_TRANSPARENT, NUMA_INTERLEAVE},
+    };
+    // Interleaving is the same as first touch on a single node
+    int num_configs = numa_node_count() > 1 ? 4 : 3;
+    printf("%d qubits, %d NUMA node(s), %d thread(s)\n", num_qubits, numa_node_count(), thread_pool_get_num_threads());
+    printf("%-12s %-12s %12s %10s %12s %12s\n", "pages", "numa", "alloc (s)", "huge MiB", "low (s)", "high (s)");
+
+    bool ok = true;
+    for (int c = 0; c < num_configs && ok; c++) {
+        set_huge_page_mode(configs[c].mode);
+        set_numa_policy(configs[c].policy);
+        const char* pages = huge_page_mode_name(configs[c].mode);
+        const char* numa = numa_policy_name(configs[c].policy);
+        char label[BENCH_LABEL_LENGTH];
+
+        AllocationRun allocation = {num_qubits, true};
+        BenchStats alloc_stats;
+        ok = bench_measure(allocation_run_body, &allocation, BENCH_RUN_WARMUP, repeats, &alloc_stats) && allocation.ok;
+        size_t huge_before = huge_page_bytes_in_use();
+        Statevector* sv = ok ? create_statevector(num_qubits) : NULL;
+        if (!sv) {
+            ok = false;
+            break;
+        }
+        size_t huge_bytes = huge_page_bytes_in_use() - huge_before;
+        snprintf(label, sizeof(label), "%s/%s/allocate", pages, numa);
+        BenchResult* result = bench_report_add(report, label, &alloc_stats);
+        bench_result_value(result, "num_qubits", num_qubits);
+        bench_result_value(result, "huge_page_bytes", (double)huge_bytes);
+
+        // The lowest qubit, and the mean over the three highest
+        double low_time = 0.0, high_time = 0.0;
+        for (int t = 0; t < 4 && ok; t++) {
+            int target = t == 0 ? 0 : num_qubits - t;
+            CircuitOp op = {OP_RY, target, NO_CONTROL, -1, 0.3};
+            GateRun gate = {&op, sv};
+            BenchStats stats;
+            ok = bench_measure(gate_run_body, &gate, BENCH_RUN_WARMUP, repeats, &stats);
+            if (!ok) break;
+            if (t == 0) low_time = stats.median;
+            else high_time += stats.median / 3.0;
+            snprintf(label, sizeof(label), "%s/%s/ry", pages, numa);
+            result = bench_report_add(report, label, &stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "target", target);
+        }
+        if (ok) {
+            printf("%-12s %-12s %12.6f %10zu %12.6f %12.6f\n", pages, numa, alloc_stats.median, huge_bytes >> 20,
+                   low_time, high_time);
+        }
+        free_statevector(sv);
+    }
+
+    set_huge_page_mode(saved_mode);
+    set_numa_policy(saved_policy);
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+}
+
+// Clifford benchmark
+
+// Circuits up to this many qubits are also run on a statevector and compared
+#define CLIFFORD_CHECK_QUBITS 20
+
+// Brickwork of random Clifford gates: each layer is one of H, S, X, Y, Z on every qubit,
+// then CNOT or CZ on neighbouring pairs, offset by one qubit on odd layers
+static Circuit* build_clifford_circuit(int num_qubits, int depth) {
+    static const GateOp single[5] = {OP_H, OP_S, OP_X, OP_Y, OP_Z};
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    bool ok = true;
+    for (int layer = 0; layer < depth && ok; layer++) {
+        for (int q = 0; q < num_qubits && ok; q++) ok = circuit_add_gate(circuit, single[benchmark_random() % 5], q);
+        for (int q = layer % 2; q + 1 < num_qubits && ok; q += 2) {
+            ok = circuit_add_controlled(circuit, benchmark_random() % 2 ? OP_CNOT : OP_CZ, q, q + 1);
+        }
+    }
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+// Circuit ops on the tableau, continuing from the current state
+typedef struct {
+    const Circuit* circuit;
+    StabilizerState* state;
+} TableauRun;
+
+static void tableau_run_body(void* context) {
+    const TableauRun* run = context;
+    for (int i = 0; i < run->circuit->num_ops; i++) apply_stabilizer_op(run->state, &run->circuit->ops[i], NULL);
+}
+
+// Measures every qubit of a fresh copy of state, since measuring collapses it
+typedef struct {
+    const StabilizerState* state;
+    StabilizerState* scratch;
+    Rng* rng;
+    uint8_t* outcomes;
+} TableauMeasureRun;
+
+static void tableau_measure_body(void* context) {
+    const TableauMeasureRun* run = context;
+    copy_stabilizer_state(run->scratch, run->state);
+    stabilizer_measure_all(run->scratch, run->rng, run->outcomes);
+}
+
+// Runs random Clifford circuits through the tableau, which the simulator routes them to,
+// from 16 qubits up to max_qubits, and measures every qubit. Small circuits are also run
+// on a statevector, and the two states are compared after one run from |0...0⟩.
+void run_clifford_benchmark(int max_qubits, int depth) {
+    if (max_qubits < 2 || max_qubits > MAX_CIRCUIT_QUBITS || depth < 1) {
+        fprintf(stderr, "Error: Invalid parameters for Clifford benchmark\n");
+        return;
+    }
+    BenchReport* report = create_bench_report("clifford");
+    if (!report) return;
+    Rng rng;
+    rng_seed(&rng, MEASUREMENT_SEED);
+    printf("%-7s %8s %-12s %12s %12s %14s %10s\n", "qubits", "gates", "backend", "gates (s)", "measure (s)",
+           "statevector (s)", "fidelity");
+
+    bool ok = true;
+    for (int num_qubits = max_qubits < 16 ? max_qubits : 16; num_qubits <= max_qubits && ok;
+         num_qubits = num_qubits < max_qubits && 2 * num_qubits > max_qubits ? max_qubits : 2 * num_qubits) {
+        Circuit* circuit = build_clifford_circuit(num_qubits, depth);
+        StabilizerState* state = circuit ? create_stabilizer_state(num_qubits) : NULL;
+        StabilizerState* scratch = circuit ? create_stabilizer_state(num_qubits) : NULL;
+        uint8_t* outcomes = malloc((size_t)num_qubits);
+        if (!circuit || !state || !scratch || !outcomes) {
+            fprintf(stderr, "Error: Failed to set up Clifford benchmark\n");
+            free_circuit(circuit);
+            free_stabilizer_state(state);
+            free_stabilizer_state(scratch);
+            free(outcomes);
+            ok = false;
+            break;
+        }
+        SimulationBackend backend = select_backend(circuit, NULL);
+        TableauRun gates = {circuit, state};
+        tableau_run_body(&gates);
+
+        BenchStats sv_stats;
+        double fidelity = -1.0;
+        bool compared = false;
+        if (num_qubits <= CLIFFORD_CHECK_QUBITS) {
+            Statevector* sv = create_statevector(num_qubits);
+            Statevector* converted = create_statevector(num_qubits);
+            CircuitPlan plan;
+            if (sv && converted && compile_circuit(circuit, 0, &plan)) {
+                BenchPlanRun sv_run = {&plan, sv};
+                bench_plan_body(&sv_run);
+                if (stabilizer_to_statevector(state, converted)) {
+                    double re = 0.0, im = 0.0;
+                    for (size_t i = 0; i < sv->dimension; i++) {
+                        re += sv->real[i] * converted->real[i] + sv->imag[i] * converted->imag[i];
+                        im += sv->real[i] * converted->imag[i] - sv->imag[i] * converted->real[i];
+                    }
+                    fidelity = re * re + im * im;
+                }
+                compared = bench_measure_run(bench_plan_body, &sv_run, &sv_stats);
+                free_circuit_plan(&plan);
+            }
+            free_statevector(sv);
+            free_statevector(converted);
+        }
+
+        TableauMeasureRun measure = {state, scratch, &rng, outcomes};
+        BenchStats gate_stats, measure_stats;
+        ok = bench_measure_run(tableau_run_body, &gates, &gate_stats) &&
+             bench_measure_run(tableau_measure_body, &measure, &measure_stats);
+        if (ok) {
+            printf("%-7d %8d %-12s %12.3e %12.3e", num_qubits, circuit->num_ops, simulation_backend_name(backend),
+                   gate_stats.median, measure_stats.median);
+            if (compared) printf(" %14.3e %10.6f\n", sv_stats.median, fidelity);
+            else printf(" %14s %10s\n", "-", "-");
+            BenchResult* result = bench_report_add(report, "tableau/gates", &gate_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "depth", depth);
+            bench_result_value(result, "gates", circuit->num_ops);
+            result = bench_report_add(report, "tableau/measure", &measure_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            if (compared) {
+                result = bench_report_add(report, "statevector/gates", &sv_stats);
+                bench_result_value(result, "num_qubits", num_qubits);
+                bench_result_value(result, "depth", depth);
+                bench_result_value(result, "gates", circuit->num_ops);
+                bench_result_value(result, "fidelity", fidelity);
+            }
+        }
+
+        free_circuit(circuit);
+        free_stabilizer_state(state);
+        free_stabilizer_state(scratch);
+        free(outcomes);
+        if (num_qubits == max_qubits) break;
+    }
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+}
+
+// MPS benchmark
+
+// Circuits up to this many qubits are also run on a statevector and compared
+#define MPS_CHECK_QUBITS 20
+#define MPS_BENCHMARK_SHOTS 1000
+
+// Shallow circuit of random RZ-RY-RZ rotations on every qubit and a brickwork of CNOTs on
+// neighbouring pairs, plus one CNOT across four qubits per layer to exercise the routing
+static Circuit* build_shallow_circuit(int num_qubits, int depth) {
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    bool ok = true;
+    for (int layer = 0; layer < depth && ok; layer++) {
+        for (int q = 0; q < num_qubits && ok; q++) {
+            ok = circuit_add_rotation(circuit, OP_RZ, q, 0.001 * (benchmark_random() % 6283)) &&
+                 circuit_add_rotation(circuit, OP_RY, q, 0.001 * (benchmark_random() % 6283)) &&
+                 circuit_add_rotation(circuit, OP_RZ, q, 0.001 * (benchmark_random() % 6283));
+        }
+        for (int q = layer % 2; q + 1 < num_qubits && ok; q += 2) ok = circuit_add_controlled(circuit, OP_CNOT, q, q + 1);
+        if (num_qubits > 4 && ok) {
+            int control = (int)(benchmark_random() % (uint64_t)(num_qubits - 4));
+            ok = circuit_add_controlled(circuit, OP_CNOT, control, control + 4);
+        }
+    }
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+// The circuit from |0...0⟩, so every run reaches the same bonds
+typedef struct {
+    const Circuit* circuit;
+    MpsState* mps;
+    bool ok;
+} MpsRun;
+
+static void mps_run_body(void* context) {
+    MpsRun* run = context;
+    run->ok = run->ok && initialize_mps(run->mps);
+    for (int i = 0; i < run->circuit->num_ops && run->ok; i++) {
+        run->ok = apply_mps_op(run->mps, &run->circuit->ops[i], NULL);
+    }
+}
+
+typedef struct {
+    const MpsState* mps;
+    Rng* rng;
+    uint8_t* outcomes;
+    bool ok;
+} MpsSampleRun;
+
+static void mps_sample_body(void* context) {
+    MpsSampleRun* run = context;
+    run->ok = run->ok && mps_sample(run->mps, MPS_BENCHMARK_SHOTS, run->rng, run->outcomes);
+}
+
+// Runs shallow circuits on a matrix product state with bond dimension at most max_bond,
+// from 20 qubits up to max_qubits, and samples every qubit. The memory held by the site
+// tensors is set against the 2^n * 16 bytes a statevector would need; circuits small
+// enough are also run on a statevector and compared.
+void run_mps_benchmark(int max_qubits, int depth, int max_bond) {
+    if (max_qubits < 2 || max_qubits > MAX_CIRCUIT_QUBITS || depth < 1 || max_bond < 1) {
+        fprintf(stderr, "Error: Invalid parameters for MPS benchmark\n");
+        return;
+    }
+    BenchReport* report = create_bench_report("mps");
+    if (!report) return;
+    Rng rng;
+    rng_seed(&rng, MEASUREMENT_SEED);
+    printf("%-7s %6s %6s %12s %12s %12s %12s %14s %10s\n", "qubits", "bond", "peak", "gates (s)", "discarded",
+           "MPS (MiB)", "shots (s)", "statevector", "fidelity");
+
+    bool ok = true;
+    for (int num_qubits = max_qubits < MPS_CHECK_QUBITS ? max_qubits : MPS_CHECK_QUBITS; num_qubits <= max_qubits && ok;
+         num_qubits = num_qubits < max_qubits && 2 * num_qubits > max_qubits ? max_qubits : 2 * num_qubits) {
+        Circuit* circuit = build_shallow_circuit(num_qubits, depth);
+        MpsState* mps = circuit ? create_mps(num_qubits, max_bond) : NULL;
+        uint8_t* outcomes = malloc((size_t)MPS_BENCHMARK_SHOTS * num_qubits);
+        if (!circuit || !mps || !outcomes) {
+            fprintf(stderr, "Error: Failed to set up MPS benchmark\n");
+            free_circuit(circuit);
+            free_mps(mps);
+            free(outcomes);
+            ok = false;
+            break;
+        }
+
+        MpsRun gates = {circuit, mps, true};
+        BenchStats gate_stats, shot_stats;
+        ok = bench_measure_run(mps_run_body, &gates, &gate_stats) && gates.ok;
+
+        double fidelity = -1.0;
+        if (ok && num_qubits <= MPS_CHECK_QUBITS) {
+            Statevector* sv = create_statevector(num_qubits);
+            Statevector* converted = create_statevector(num_qubits);
+            CircuitPlan plan;
+            if (sv && converted && compile_circuit(circuit, 0, &plan)) {
+                execute_plan(&plan, sv, NULL);
+                if (mps_to_statevector(mps, converted)) {
+                    double re = 0.0, im = 0.0;
+                    for (size_t i = 0; i < sv->dimension; i++) {
+                        re += sv->real[i] * converted->real[i] + sv->imag[i] * converted->imag[i];
+                        im += sv->real[i] * converted->imag[i] - sv->imag[i] * converted->real[i];
+                    }
+                    fidelity = re * re + im * im;
+                }
+                free_circuit_plan(&plan);
+            }
+            free_statevector(sv);
+            free_statevector(converted);
+        }
+        int peak_bond = mps->peak_bond;
+        double discarded = mps->discarded_weight;
+        size_t mps_bytes = mps_memory_bytes(mps);
+
+        MpsSampleRun shots = {mps, &rng, outcomes, true};
+        ok = ok && bench_measure_run(mps_sample_body, &shots, &shot_stats) && shots.ok;
+        if (!ok) {
+            fprintf(stderr, "Error: MPS benchmark run failed\n");
+        } else {
+            char statevector_size[32];
+            snprintf(statevector_size, sizeof(statevector_size), "2^%d MiB", num_qubits - 16);
+            printf("%-7d %6d %6d %12.6f %12.3e %12.3f %12.6f %14s", num_qubits, max_bond, peak_bond, gate_stats.median,
+                   discarded, mps_bytes / (1024.0 * 1024.0), shot_stats.median, statevector_size);
+            if (fidelity >= 0) printf(" %10.6f\n", fidelity);
+            else printf(" %10s\n", "-");
+            BenchResult* result = bench_report_add(report, "gates", &gate_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "depth", depth);
+            bench_result_value(result, "max_bond", max_bond);
+            bench_result_value(result, "peak_bond", peak_bond);
+            bench_result_value(result, "discarded_weight", discarded);
+            bench_result_value(result, "mps_bytes", (double)mps_bytes);
+            if (fidelity >= 0) bench_result_value(result, "fidelity", fidelity);
+            result = bench_report_add(report, "shots", &shot_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "shots", MPS_BENCHMARK_SHOTS);
+        }
+
+        free_circuit(circuit);
+        free_mps(mps);
+        free(outcomes);
+        if (num_qubits == max_qubits) break;
+    }
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+}
+
+// Batch benchmark
+
+typedef enum {
+    BATCH_ONE_AT_A_TIME,
+    BATCH_OVER_THREADS,
+    BATCH_INTERLEAVED
+} BatchMode;
+
+// Every state from |0...0⟩ through the ansatz with its own parameters, one of three ways
+typedef struct {
+    BatchMode mode;
+    const Circuit* circuit;
+    const CircuitPlan* plan;
+    Statevector** states;
+    StateBatch* batch;
+    int batch_size;
+    const double* params;
+    bool ok;
+} BatchRun;
+
+static void batch_run_body(void* context) {
+    BatchRun* run = context;
+    switch (run->mode) {
+        case BATCH_ONE_AT_A_TIME:
+            for (int b = 0; b < run->batch_size && run->ok; b++) {
+                run->ok = initialize_statevector(run->states[b]) &&
+                          execute_plan(run->plan, run->states[b], run->params + (size_t)b * run->circuit->num_params);
+            }
+            break;
+        case BATCH_OVER_THREADS:
+            for (int b = 0; b < run->batch_size && run->ok; b++) run->ok = initialize_statevector(run->states[b]);
+            run->ok = run->ok && execute_plan_batch(run->plan, run->states, run->batch_size, run->params);
+            break;
+        case BATCH_INTERLEAVED:
+            run->ok = run->ok && initialize_state_batch(run->batch) &&
+                      run_circuit_batch(run->circuit, run->batch, run->params);
+            break;
+    }
+}
+
+// Runs the hardware-efficient ansatz with different parameters on batch_size states three
+// ways: one state at a time through a compiled plan, the separate states spread over the
+// thread pool with execute_plan_batch(), and all of them interleaved in one StateBatch.
+// Throughput is given in states x gates per second; the interleaved results are checked
+// against the single-state ones.
+void run_batch_benchmark(int num_qubits, int batch_size, int layers) {
+    Circuit* circuit = build_hardware_efficient_ansatz(num_qubits, layers);
+    double* params = circuit ? malloc((size_t)batch_size * circuit->num_params * sizeof(double)) : NULL;
+    Statevector** states = calloc((size_t)(batch_size > 0 ? batch_size : 1), sizeof(Statevector*));
+    StateBatch* batch = batch_size > 0 ? create_state_batch(num_qubits, batch_size) : NULL;
+    Statevector* check = create_statevector(num_qubits);
+    BenchReport* report = create_bench_report("batch");
+    CircuitPlan plan;
+    bool ok = circuit && params && states && batch && check && report && compile_circuit(circuit, 0, &plan);
+    for (int b = 0; ok && b < batch_size; b++) ok = (states[b] = create_statevector(num_qubits)) != NULL;
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to set up batch benchmark\n");
+        if (states) {
+            for (int b = 0; b < batch_size; b++) free_statevector(states[b]);
+        }
+        free(states);
+        free(params);
+        free_circuit(circuit);
+        free_state_batch(batch);
+        free_statevector(check);
+        free_bench_report(report);
+        return;
+    }
+    for (size_t i = 0; i < (size_t)batch_size * circuit->num_params; i++) {
+        params[i] = 0.001 * (benchmark_random() % 6283);
+    }
+    double work = (double)batch_size * circuit->num_ops;
+
+    // The separate states end up holding the results of the threaded run; each call
+    // starts from |0...0⟩, so they are those of every other mode too
+    static const char* const mode_names[3] = {"one state at a time", "states over threads", "interleaved batch"};
+    static const char* const mode_labels[3] = {"one-at-a-time", "over-threads", "interleaved"};
+    BenchStats stats[3];
+    for (int m = 0; m < 3 && ok; m++) {
+        BatchRun run = {(BatchMode)m, circuit, &plan, states, batch, batch_size, params, true};
+        ok = bench_measure_run(batch_run_body, &run, &stats[m]) && run.ok;
+    }
+    if (!ok) fprintf(stderr, "Error: Batch benchmark run failed\n");
+
+    double max_error = 0.0;
+    for (int b = 0; b < batch_size && ok; b++) {
+        store_batch_state(batch, b, check);
+        for (size_t i = 0; i < check->dimension; i++) {
+            double error = fabs(check->real[i] - states[b]->real[i]) + fabs(check->imag[i] - states[b]->imag[i]);
+            if (error > max_error) max_error = error;
+        }
+    }
+
+    if (ok) {
+        printf("%d qubits, %d states, %d gates, %d threads, %s\n", num_qubits, batch_size, circuit->num_ops,
+               thread_pool_get_num_threads(), simd_level_name(get_simd_level()));
+        printf("%-22s %12s %16s\n", "mode", "time (s)", "state-gates/s");
+        for (int m = 0; m < 3; m++) {
+            printf("%-22s %12.6f %16.3e\n", mode_names[m], stats[m].median, work / stats[m].median);
+            BenchResult* result = bench_report_add(report, mode_labels[m], &stats[m]);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "batch_size", batch_size);
+            bench_result_value(result, "gates", circuit->num_ops);
+            bench_result_value(result, "state_gates_per_s", work / stats[m].median);
+            if (m == BATCH_INTERLEAVED) bench_result_value(result, "max_diff", max_error);
+        }
+        printf("Speedup over one state at a time: %.2fx, max difference %.3e\n",
+               stats[BATCH_ONE_AT_A_TIME].median / stats[BATCH_INTERLEAVED].median, max_error);
+        write_bench_report(report);
+    }
+
+    for (int b = 0; b < batch_size; b++) free_statevector(states[b]);
+    free(states);
+    free(params);
+    free_circuit_plan(&plan);
+    free_circuit(circuit);
+    free_state_batch(batch);
+    free_statevector(check);
+    free_bench_report(report);
+}
+
+// Noise benchmark
+
+// Error rates of a typical superconducting device
+static const NoiseModel BENCHMARK_NOISE = {
+    .depolarizing = 1e-3,
+    .depolarizing_2q = 1e-2,
+    .amplitude_damping = 1e-3,
+    .readout_error = 2e-2,
+};
+
+// The same trajectories on every call: the generator is reseeded each time
+typedef struct {
+    const Circuit* circuit;
+    uint64_t num_trajectories;
+    ShotHistogram histogram;
+    TrajectoryStats stats;
+    bool ok;
+} NoisyRun;
+
+static void noisy_run_body(void* context) {
+    NoisyRun* run = context;
+    Rng rng;
+    rng_seed(&rng, MEASUREMENT_SEED);
+    free_shot_histogram(&run->histogram);
+    run->ok = run->ok && run_noisy_trajectories(run->circuit, NULL, &BENCHMARK_NOISE, run->num_trajectories, 1, &rng,
+                                                &run->histogram, &run->stats);
+}
+
+// Runs num_trajectories noisy trajectories of a shallow circuit, one shot each, and sets
+// the time against num_trajectories noiseless runs of the same ops, along with the ops and
+// channels the shared error-free prefix saved.
+void run_noise_benchmark(int num_qubits, int num_trajectories, int depth) {
+    if (num_qubits < 1 || num_qubits > 30 || num_trajectories < 1 || depth < 1) {
+        fprintf(stderr, "Error: Invalid parameters for noise benchmark\n");
+        return;
+    }
+    Circuit* circuit = build_shallow_circuit(num_qubits, depth);
+    Statevector* sv = create_statevector(num_qubits);
+    BenchReport* report = create_bench_report("noise");
+    if (!circuit || !sv || !report) {
+        fprintf(stderr, "Error: Failed to set up noise benchmark\n");
+        free_circuit(circuit);
+        free_statevector(sv);
+        free_bench_report(report);
+        return;
+    }
+
+    BenchOpsRun ideal = {circuit, sv};
+    NoisyRun noisy = {circuit, (uint64_t)num_trajectories, {0}, {0}, true};
+    BenchStats ideal_stats, noisy_stats;
+    bool ok = bench_measure_run(bench_ops_body, &ideal, &ideal_stats) &&
+              bench_measure_run(noisy_run_body, &noisy, &noisy_stats) && noisy.ok;
+    if (!ok) {
+        fprintf(stderr, "Error: Noise benchmark failed\n");
+    } else {
+        const TrajectoryStats* stats = &noisy.stats;
+        uint64_t steps = stats->shared_steps + stats->trajectory_steps;
+        uint64_t unshared = stats->steps_per_trajectory * (uint64_t)num_trajectories;
+        double repeated = ideal_stats.median * num_trajectories;
+        double events = (double)stats->noise_events / num_trajectories;
+        printf("%d qubits, %d gates, %d trajectories, %d threads\n", num_qubits, circuit->num_ops, num_trajectories,
+               thread_pool_get_num_threads());
+        printf("Noise events per trajectory: %.2f\n", events);
+        printf("Ops and channels applied: %llu of %llu without a shared prefix (%.1f%% saved)\n",
+               (unsigned long long)steps, (unsigned long long)unshared,
+               unshared > 0 ? 100.0 * (1.0 - (double)steps / unshared) : 0.0);
+        printf("Noiseless run: %.6f s, %d of them: %.6f s\n", ideal_stats.median, num_trajectories, repeated);
+        printf("Noisy trajectories: %.6f s (%.2fx the noiseless runs), %zu distinct outcomes\n", noisy_stats.median,
+               noisy_stats.median / repeated, noisy.histogram.num_outcomes);
+
+        BenchResult* result = bench_report_add(report, "noiseless", &ideal_stats);
+        bench_result_value(result, "num_qubits", num_qubits);
+        bench_result_value(result, "gates", circuit->num_ops);
+        result = bench_report_add(report, "trajectories", &noisy_stats);
+        bench_result_value(result, "num_qubits", num_qubits);
+        bench_result_value(result, "gates", circuit->num_ops);
+        bench_result_value(result, "trajectories", num_trajectories);
+        bench_result_value(result, "noise_events_per_trajectory", events);
+        bench_result_value(result, "shared_steps", (double)stats->shared_steps);
+        bench_result_value(result, "trajectory_steps", (double)stats->trajectory_steps);
+        bench_result_value(result, "unshared_steps", (double)unshared);
+        bench_result_value(result, "vs_noiseless_runs", noisy_stats.median / repeated);
+        write_bench_report(report);
+    }
+    free_shot_histogram(&noisy.histogram);
+    free_circuit(circuit);
+    free_statevector(sv);
+    free_bench_report(report);
+}
+
+// Checkpoint benchmark
+
+// A state with 2^(n/2) nonzero amplitudes: Hadamards on the low half, each copied to the
+// high half with a CNOT
+static Circuit* build_sparse_circuit(int num_qubits) {
+    Circuit* circuit = create_circuit(num_qubits);
+    bool ok = circuit != NULL;
+    for (int q = 0; q < num_qubits / 2 && ok; q++) {
+        ok = circuit_add_gate(circuit, OP_H, q) && circuit_add_controlled(circuit, OP_CNOT, q, q + num_qubits / 2);
+    }
+    ok = ok && circuit_add_rotation(circuit, OP_RY, num_qubits - 1, 0.3);
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+static double max_state_difference(const Statevector* a, const Statevector* b) {
+    double max_error = 0.0;
+    for (size_t i = 0; i < a->dimension; i++) {
+        double error = fabs(a->real[i] - b->real[i]) + fabs(a->imag[i] - b->imag[i]);
+        if (error > max_error) max_error = error;
+    }
+    return max_error;
+}
+
+typedef struct {
+    const Statevector* sv;
+    uint64_t position;
+    const CheckpointOptions* options;
+    const char* path;
+    bool ok;
+} SaveRun;
+
+static void save_run_body(void* context) {
+    SaveRun* run = context;
+    run->ok = run->ok && save_checkpoint(run->sv, run->position, run->options, run->path);
+}
+
+typedef struct {
+    const char* path;
+    bool ok;
+} LoadRun;
+
+static void load_run_body(void* context) {
+    LoadRun* run = context;
+    CheckpointHeader header;
+    Statevector* loaded = run->ok ? load_checkpoint(run->path, &header) : NULL;
+    run->ok = loaded != NULL;
+    free_statevector(loaded);
+}
+
+// Maps the raw checkpoint and finishes the circuit on it. The mapping is copy-on-write, so
+// the file is the same for every call. With expected set, also records how far the result
+// is from it.
+typedef struct {
+    const char* path;
+    const Circuit* circuit;
+    const Statevector* expected;
+    double difference;
+    bool ok;
+} ResumeRun;
+
+static void resume_run_body(void* context) {
+    ResumeRun* run = context;
+    CheckpointHeader header = {0};
+    MappedStatevector* ms = run->ok ? map_checkpoint(run->path, &header) : NULL;
+    run->ok = ms != NULL;
+    for (int i = (int)header.circuit_position; i < run->circuit->num_ops && run->ok; i++) {
+        run->ok = apply_circuit_op(&ms->sv, &run->circuit->ops[i], NULL);
+    }
+    if (run->ok && run->expected) run->difference = max_state_difference(run->expected, &ms->sv);
+    free_mapped_statevector(ms);
+}
+
+// Stops a sparse and a dense circuit halfway, saves the state raw and with zero runs,
+// loads both back and also maps the raw file, finishes the circuit on the mapped copy and
+// compares it with the uninterrupted run
+void run_checkpoint_benchmark(int num_qubits, const char* path) {
+    if (num_qubits < 2 || num_qubits > 34 || !path) {
+        fprintf(stderr, "Error: Invalid parameters for checkpoint benchmark\n");
+        return;
+    }
+    BenchReport* report = create_bench_report("checkpoint");
+    if (!report) return;
+    printf("%d qubits, %zu MiB, %d threads, %s\n", num_qubits, statevector_bytes(num_qubits) >> 20,
+           thread_pool_get_num_threads(), path);
+    printf("%-7s %-10s %10s %10s %10s %12s %12s\n", "state", "format", "MiB", "save (s)", "load (s)", "map+run (s)",
+           "difference");
+
+    const char* names[] = {"sparse", "dense"};
+    bool ok = true;
+    for (int kind = 0; kind < 2 && ok; kind++) {
+        Circuit* circuit = kind == 0 ? build_sparse_circuit(num_qubits) : build_shallow_circuit(num_qubits, 2);
+        Statevector* sv = create_statevector(num_qubits);
+        if (!circuit || !sv) {
+            fprintf(stderr, "Error: Failed to set up checkpoint benchmark\n");
+            free_circuit(circuit);
+            free_statevector(sv);
+            ok = false;
+            break;
+        }
+        int half = circuit->num_ops / 2;
+        for (int i = 0; i < half && ok; i++) ok = apply_circuit_op(sv, &circuit->ops[i], NULL);
+
+        // Raw last: it finishes sv for the comparison with the mapped run
+        CheckpointCompression formats[] = {CHECKPOINT_ZERO_RUNS, CHECKPOINT_RAW};
+        for (int f = 0; f < 2 && ok; f++) {
+            CheckpointOptions options = {formats[f], 0.0, 0};
+            SaveRun save = {sv, (uint64_t)half, &options, path, true};
+            LoadRun load = {path, true};
+            BenchStats save_stats, load_stats, resume_stats;
+            ok = bench_measure_run(save_run_body, &save, &save_stats) && save.ok &&
+                 bench_measure_run(load_run_body, &load, &load_stats) && load.ok;
+            CheckpointHeader header;
+            Statevector* loaded = ok ? load_checkpoint(path, &header) : NULL;
+            ok = loaded != NULL;
+            double difference = ok ? max_state_difference(sv, loaded) : 0.0;
+            free_statevector(loaded);
+
+            // Resume from the mapped raw file and finish the circuit
+            bool resumed = ok && formats[f] == CHECKPOINT_RAW;
+            if (resumed) {
+                for (int i = half; i < circuit->num_ops && ok; i++) ok = apply_circuit_op(sv, &circuit->ops[i], NULL);
+                ResumeRun resume = {path, circuit, sv, 0.0, ok};
+                resume_run_body(&resume);
+                if (resume.difference > difference) difference = resume.difference;
+                resume.expected = NULL;
+                ok = resume.ok && bench_measure_run(resume_run_body, &resume, &resume_stats) && resume.ok;
+            }
+            if (!ok) break;
+
+            const char* format = formats[f] == CHECKPOINT_RAW ? "raw" : "zero-runs";
+            double mib = (double)header.data_bytes / (1 << 20);
+            printf("%-7s %-10s %10.3f %10.4f %10.4f %12.4f %12.3e\n", names[kind], format, mib, save_stats.median,
+                   load_stats.median, resumed ? resume_stats.median : 0.0, difference);
+            char label[BENCH_LABEL_LENGTH];
+            snprintf(label, sizeof(label), "%s/%s/save", names[kind], format);
+            BenchResult* result = bench_report_add(report, label, &save_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "file_bytes", (double)header.data_bytes);
+            snprintf(label, sizeof(label), "%s/%s/load", names[kind], format);
+            result = bench_report_add(report, label, &load_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "max_diff", difference);
+            if (resumed) {
+                snprintf(label, sizeof(label), "%s/%s/map-and-finish", names[kind], format);
+                result = bench_report_add(report, label, &resume_stats);
+                bench_result_value(result, "num_qubits", num_qubits);
+                bench_result_value(result, "ops", circuit->num_ops - half);
+            }
+        }
+        if (!ok) fprintf(stderr, "Error: Checkpoint benchmark failed\n");
+        free_circuit(circuit);
+        free_statevector(sv);
+    }
+    remove(path);
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+}
+
+// Sparse benchmark
+
+// Adders up to this many qubits are also run on a statevector and compared
+#define SPARSE_CHECK_QUBITS 24
+
+// Low bits of the first addend put in superposition, 2^SPARSE_BENCHMARK_BRANCHES sums
+#define SPARSE_BENCHMARK_BRANCHES 10
+
+#define SPARSE_BENCHMARK_SHOTS 10000
+
+// Hybrid runs of the checkpoint benchmark's sparse circuit and a shallow circuit
+#define SPARSE_HYBRID_QUBITS 22
+
+// X with up to two controls, or H. The circuit ops have no Toffoli, so the adder is kept
+// as its own gate list.
+typedef struct {
+    bool hadamard;
+    int num_controls;
+    int controls[2];
+    int target;
+} ReversibleGate;
+
+typedef struct {
+    ReversibleGate* gates;
+    int num_gates;
+} ReversibleCircuit;
+
+static void add_reversible(ReversibleCircuit* circuit, int num_controls, int control0, int control1, int target) {
+    circuit->gates[circuit->num_gates++] = (ReversibleGate){false, num_controls, {control0, control1}, target};
+}
+
+// Cuccaro ripple-carry adder on k-bit registers: qubit 0 is the incoming carry, a_i and
+// b_i sit at 2i + 1 and 2i + 2 and the carry out at 2k + 1, for n = 2k + 2 qubits. It
+// leaves a + b in b and the carry. The inputs are set with X gates, the lowest
+// SPARSE_BENCHMARK_BRANCHES bits of a with H.
+static ReversibleCircuit build_adder(int num_qubits, uint64_t a, uint64_t b) {
+    int k = (num_qubits - 2) / 2;
+    ReversibleCircuit circuit = {malloc((size_t)(8 * k + 4) * sizeof(ReversibleGate)), 0};
+    if (!circuit.gates) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return circuit;
+    }
+    for (int i = 0; i < k; i++) {
+        if (i < SPARSE_BENCHMARK_BRANCHES) circuit.gates[circuit.num_gates++] = (ReversibleGate){true, 0, {0, 0}, 2 * i + 1};
+        else if ((a >> i) & 1) add_reversible(&circuit, 0, 0, 0, 2 * i + 1);
+        if ((b >> i) & 1) add_reversible(&circuit, 0, 0, 0, 2 * i + 2);
+    }
+    // MAJ(c, b_i, a_i) on each bit, the carry out, then UMA(c, b_i, a_i) back down
+    for (int i = 0; i < k; i++) {
+        int c = i == 0 ? 0 : 2 * i - 1, bi = 2 * i + 2, ai = 2 * i + 1;
+        add_reversible(&circuit, 1, ai, 0, bi);
+        add_reversible(&circuit, 1, ai, 0, c);
+        add_reversible(&circuit, 2, c, bi, ai);
+    }
+    add_reversible(&circuit, 1, 2 * k - 1, 0, 2 * k + 1);
+    for (int i = k - 1; i >= 0; i--) {
+        int c = i == 0 ? 0 : 2 * i - 1, bi = 2 * i + 2, ai = 2 * i + 1;
+        add_reversible(&circuit, 2, c, bi, ai);
+        add_reversible(&circuit, 1, ai, 0, c);
+        add_reversible(&circuit, 1, c, 0, bi);
+    }
+    return circuit;
+}
+
+static bool run_reversible_sparse(const ReversibleCircuit* circuit, SparseStatevector* state) {
+    QuantumGate h = get_hadamard_gate(), x = get_x_gate();
+    bool ok = true;
+    for (int g = 0; g < circuit->num_gates && ok; g++) {
+        const ReversibleGate* gate = &circuit->gates[g];
+        ok = sparse_apply_gate(state, gate->hadamard ? &h : &x, gate->controls, gate->num_controls, gate->target);
+    }
+    return ok;
+}
+
+static void run_reversible_dense(const ReversibleCircuit* circuit, Statevector* sv) {
+    for (int g = 0; g < circuit->num_gates; g++) {
+        const ReversibleGate* gate = &circuit->gates[g];
+        if (gate->hadamard) kernel_hadamard_pairs(sv, gate->target);
+        else if (gate->num_controls == 0) kernel_swap_pairs(sv, gate->target);
+        else if (gate->num_controls == 1) kernel_controlled_swap_pairs(sv, gate->controls[0], gate->target);
+        else kernel_doubly_controlled_swap_pairs(sv, gate->controls[0], gate->controls[1], gate->target);
+    }
+}
+
+static double max_sparse_difference(const SparseStatevector* state, const Statevector* sv) {
+    double max_error = 0.0;
+    for (size_t i = 0; i < sv->dimension; i++) {
+        Complex a = sparse_amplitude(state, i);
+        double error = fabs(a.real - sv->real[i]) + fabs(a.imag - sv->imag[i]);
+        if (error > max_error) max_error = error;
+    }
+    return max_error;
+}
+
+// Shots that do not hold a + b in b and the carry out, or leave the incoming carry set
+static uint64_t wrong_sums(const uint64_t* outcomes, uint64_t num_shots, int num_qubits, uint64_t b) {
+    int k = (num_qubits - 2) / 2;
+    uint64_t wrong = 0;
+    for (uint64_t s = 0; s < num_shots; s++) {
+        uint64_t a = 0, sum = ((outcomes[s] >> (2 * k + 1)) & 1) << k;
+        for (int i = 0; i < k; i++) {
+            a |= ((outcomes[s] >> (2 * i + 1)) & 1) << i;
+            sum |= ((outcomes[s] >> (2 * i + 2)) & 1) << i;
+        }
+        if ((outcomes[s] & 1) || sum != a + b) wrong++;
+    }
+    return wrong;
+}
+
+// The adder on the sparse backend, from |0...0⟩ each call
+typedef struct {
+    const ReversibleCircuit* circuit;
+    SparseStatevector* state;
+    bool ok;
+} SparseAdderRun;
+
+static void sparse_adder_run_body(void* context) {
+    SparseAdderRun* run = context;
+    run->ok = run->ok && initialize_sparse_statevector(run->state) && run_reversible_sparse(run->circuit, run->state);
+}
+
+// The adder on a statevector, from |0...0⟩ each call. The reset is one more pass over the
+// state, as cheap as any one of the gates.
+typedef struct {
+    const ReversibleCircuit* circuit;
+    Statevector* sv;
+    bool ok;
+} DenseAdderRun;
+
+static void dense_adder_run_body(void* context) {
+    DenseAdderRun* run = context;
+    run->ok = run->ok && initialize_statevector(run->sv);
+    if (run->ok) run_reversible_dense(run->circuit, run->sv);
+}
+
+// run_hybrid_circuit() keeps the state it returns until the next call
+typedef struct {
+    const Circuit* circuit;
+    HybridState hybrid;
+    bool ok;
+} HybridRun;
+
+static void hybrid_run_body(void* context) {
+    HybridRun* run = context;
+    free_hybrid_state(&run->hybrid);
+    run->ok = run->ok && run_hybrid_circuit(run->circuit, NULL, 0, &run->hybrid);
+}
+
+// Compiling a plan and executing it from |0...0⟩, as run_hybrid_circuit() does with the
+// ops after its switch
+typedef struct {
+    const Circuit* circuit;
+    Statevector* sv;
+    bool ok;
+} CompiledRun;
+
+static void compiled_run_body(void* context) {
+    CompiledRun* run = context;
+    CircuitPlan plan;
+    bool planned = run->ok && initialize_statevector(run->sv) && compile_circuit(run->circuit, 0, &plan);
+    run->ok = planned && execute_plan(&plan, run->sv, NULL);
+    if (planned) free_circuit_plan(&plan);
+}
+
+// Runs a ripple-carry adder over 2^SPARSE_BENCHMARK_BRANCHES first addends on the sparse
+// backend, from 16 qubits up to max_qubits, samples it and checks every sampled sum. Adders
+// small enough are also run on a statevector and compared. Then a circuit that stays
+// sparse and one that does not run through run_hybrid_circuit() against a compiled plan.
+void run_sparse_benchmark(int max_qubits) {
+    if (max_qubits < 16 || max_qubits > SPARSE_MAX_QUBITS - 1) {
+        fprintf(stderr, "Error: Invalid parameters for sparse benchmark\n");
+        return;
+    }
+    BenchReport* report = create_bench_report("sparse");
+    uint64_t* outcomes = malloc(SPARSE_BENCHMARK_SHOTS * sizeof(uint64_t));
+    if (!report || !outcomes) {
+        fprintf(stderr, "Error: Could not set up sparse benchmark\n");
+        free_bench_report(report);
+        free(outcomes);
+        return;
+    }
+    printf("%d threads\n", thread_pool_get_num_threads());
+    printf("%-7s %8s %10s %12s %12s %12s %10s\n", "qubits", "gates", "entries", "sparse (s)", "dense (s)",
+           "difference", "bad shots");
+
+    Rng rng;
+    rng_seed(&rng, MEASUREMENT_SEED);
+    bool ok = true;
+    for (int num_qubits = 16; num_qubits <= max_qubits && ok; num_qubits += 8) {
+        int k = (num_qubits - 2) / 2;
+        uint64_t mask = ((uint64_t)1 << k) - 1;
+        uint64_t a = benchmark_random() & mask & ~(((uint64_t)1 << SPARSE_BENCHMARK_BRANCHES) - 1);
+        uint64_t b = benchmark_random() & mask;
+        ReversibleCircuit circuit = build_adder(num_qubits, a, b);
+        SparseStatevector* state = create_sparse_statevector(num_qubits);
+        ok = circuit.gates && state;
+
+        SparseAdderRun sparse_run = {&circuit, state, ok};
+        BenchStats sparse_stats, dense_stats;
+        ok = ok && bench_measure_run(sparse_adder_run_body, &sparse_run, &sparse_stats) && sparse_run.ok;
+        ok = ok && sparse_sample(state, SPARSE_BENCHMARK_SHOTS, &rng, outcomes);
+        uint64_t wrong = ok ? wrong_sums(outcomes, SPARSE_BENCHMARK_SHOTS, num_qubits, b) : 0;
+
+        bool checked = ok && num_qubits <= SPARSE_CHECK_QUBITS;
+        double difference = 0.0;
+        if (checked) {
+            Statevector* sv = create_statevector(num_qubits);
+            DenseAdderRun dense_run = {&circuit, sv, sv != NULL};
+            ok = bench_measure_run(dense_adder_run_body, &dense_run, &dense_stats) && dense_run.ok;
+            if (ok) difference = max_sparse_difference(state, sv);
+            free_statevector(sv);
+        }
+        if (ok) {
+            printf("%-7d %8d %10zu %12.6f ", num_qubits, circuit.num_gates, state->count, sparse_stats.median);
+            if (checked) printf("%12.6f %12.3e", dense_stats.median, difference);
+            else printf("%12s %12s", "-", "-");
+            printf(" %10llu\n", (unsigned long long)wrong);
+            char label[BENCH_LABEL_LENGTH];
+            snprintf(label, sizeof(label), "adder/%d/sparse", num_qubits);
+            BenchResult* result = bench_report_add(report, label, &sparse_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "gates", circuit.num_gates);
+            bench_result_value(result, "entries", (double)state->count);
+            bench_result_value(result, "wrong_shots", (double)wrong);
+            if (checked) {
+                snprintf(label, sizeof(label), "adder/%d/dense", num_qubits);
+                result = bench_report_add(report, label, &dense_stats);
+                bench_result_value(result, "num_qubits", num_qubits);
+                bench_result_value(result, "gates", circuit.num_gates);
+                bench_result_value(result, "max_diff", difference);
+            }
+        }
+        free(circuit.gates);
+        free_sparse_statevector(state);
+    }
+
+    printf("\n%d qubits, switching at %zu entries\n", SPARSE_HYBRID_QUBITS,
+           ((size_t)1 << SPARSE_HYBRID_QUBITS) / SPARSE_DENSE_DIVISOR);
+    printf("%-8s %8s %10s %12s %12s %12s\n", "circuit", "ops", "switch op", "hybrid (s)", "dense (s)", "difference");
+    const char* names[] = {"sparse", "shallow"};
+    for (int kind = 0; kind < 2 && ok; kind++) {
+        Circuit* circuit = kind == 0 ? build_sparse_circuit(SPARSE_HYBRID_QUBITS)
+                                     : build_shallow_circuit(SPARSE_HYBRID_QUBITS, 2);
+        Statevector* sv = create_statevector(SPARSE_HYBRID_QUBITS);
+        ok = circuit && sv;
+
+        HybridRun hybrid_run = {circuit, {NULL, NULL, -1}, ok};
+        CompiledRun compiled_run = {circuit, sv, ok};
+        BenchStats hybrid_stats, dense_stats;
+        ok = ok && bench_measure_run(hybrid_run_body, &hybrid_run, &hybrid_stats) && hybrid_run.ok &&
+             bench_measure_run(compiled_run_body, &compiled_run, &dense_stats) && compiled_run.ok;
+
+        if (ok) {
+            const HybridState* hybrid = &hybrid_run.hybrid;
+            double difference = hybrid->dense ? max_state_difference(sv, hybrid->dense)
+                                              : max_sparse_difference(hybrid->sparse, sv);
+            printf("%-8s %8d %10d %12.6f %12.6f %12.3e\n", names[kind], circuit->num_ops, hybrid->switch_op,
+                   hybrid_stats.median, dense_stats.median, difference);
+            char label[BENCH_LABEL_LENGTH];
+            snprintf(label, sizeof(label), "hybrid/%s", names[kind]);
+            BenchResult* result = bench_report_add(report, label, &hybrid_stats);
+            bench_result_value(result, "num_qubits", SPARSE_HYBRID_QUBITS);
+            bench_result_value(result, "ops", circuit->num_ops);
+            bench_result_value(result, "switch_op", hybrid->switch_op);
+            bench_result_value(result, "max_diff", difference);
+            snprintf(label, sizeof(label), "hybrid/%s/compiled", names[kind]);
+            result = bench_report_add(report, label, &dense_stats);
+            bench_result_value(result, "num_qubits", SPARSE_HYBRID_QUBITS);
+            bench_result_value(result, "ops", circuit->num_ops);
+        }
+        free_hybrid_state(&hybrid_run.hybrid);
+        free_circuit(circuit);
+        free_statevector(sv);
+    }
+    if (!ok) fprintf(stderr, "Error: Sparse benchmark failed\n");
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+    free(outcomes);
+}
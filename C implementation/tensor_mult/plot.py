@@ -1,14 +1,14 @@
+import csv
 import matplotlib.pyplot as plt
 
-# Read the data from the file
+# Read the median runtimes from the report of the default run
 qubits = []
 runtimes = []
 
-with open('runtime_data.txt', 'r') as f:
-    for line in f:
-        data = line.split()
-        qubits.append(int(data[0]))
-        runtimes.append(float(data[1]))
+with open('tensor_mult_runtime_bench.csv', 'r') as f:
+    for row in csv.DictReader(f):
+        qubits.append(int(float(row['num_qubits'])))
+        runtimes.append(float(row['median_s']))
 
 # Plotting the data
 plt.plot(qubits, runtimes, marker='o')
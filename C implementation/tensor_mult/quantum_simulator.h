@@ -3,27 +3,58 @@
 #define QUANTUM_SIMULATOR_H
 
 #include <stdbool.h>
-
-#define MAX_QUBITS 29
-#define RUNTIME_DATA_FILE "runtime_data.txt"
-
-typedef struct {
-    double elements[2][2];
-} QuantumGate;
+#include <stdint.h>
+#include "../common/statevector_core.h"
+#include "../common/benchmark.h"
+
+#define MAX_QUBITS 29  // 8 GiB of complex amplitudes (BYTES_PER_AMPLITUDE each)
+#define MAPPED_STATE_FILE "statevector.bin"
+#define SAMPLE_HISTOGRAM_FILE "shots.qshg"
+#define TEST_SHOTS 1000
+#define MEASUREMENT_SEED 2024
+#define CHECKPOINT_FILE "checkpoint.qsck"
+#define SUITE_JSON_FILE "tensor_mult_bench.json"
+#define SUITE_CSV_FILE "tensor_mult_bench.csv"
+#define RUNTIME_REPORT "tensor_mult_runtime"  // written as tensor_mult_runtime_bench.json and .csv
 
 // Gate operations
-bool apply_single_qubit_gate(double* state_vector, QuantumGate gate, int num_qubits, int target_qubit);
-bool apply_cnot_gate(double* state_vector, int num_qubits, int control_qubit, int target_qubit);
-bool tensor_contract(double* state_vector, QuantumGate gate, int target_qubit, int num_qubits);
-
-// State management
-bool initialize_state_vector(double* state_vector, int num_qubits);
-void print_state_vector(const double* state_vector, int num_qubits);
+bool apply_single_qubit_gate(Statevector* sv, QuantumGate gate, int target_qubit);
+bool apply_cnot_gate(Statevector* sv, int control_qubit, int target_qubit);
+bool apply_controlled_gate(Statevector* sv, QuantumGate gate, int control_qubit, int target_qubit);
+bool tensor_contract(Statevector* sv, QuantumGate gate, int target_qubit);
+// Dense 2^k x 2^k unitary (row-major, bit b of a row or column index is qubits[b]) on k
+// distinct qubits, 1 <= k <= MAX_BLOCK_QUBITS, in one pass over the state
+bool apply_k_qubit_gate(Statevector* sv, const Complex* matrix, const int* qubits, int k);
+// A circuit op through tensor_contract or the controlled gates above, the path the
+// benchmark suite times for this approach
+bool apply_tensor_op(Statevector* sv, const CircuitOp* op, const double* params);
 
 // Testing and benchmarking
 void run_quantum_circuit_test(int num_qubits);
-double measure_circuit_runtime(int num_qubits);
-void save_runtime_data(int num_qubits, double time_taken);
+bool measure_circuit_runtime(int num_qubits, int num_threads, BenchStats* stats);
+void run_inplace_benchmark(int min_qubits, int max_qubits);
+void run_scaling_benchmark(int num_qubits, int max_threads);
+void run_fusion_benchmark(int num_qubits, int depth, int max_block_qubits);
+void run_blocking_benchmark(int min_qubits, int max_qubits, int depth);
+bool run_simd_check(int num_qubits);
+void run_mapped_benchmark(int num_qubits, const char* path);
+void run_kernel_benchmark(int num_qubits, int repeats);
+void run_sampling_benchmark(int num_qubits, uint64_t num_shots);
+void run_precision_benchmark(int min_qubits, int max_qubits, int depth);
+void run_distributed_benchmark(int local_qubits, int max_ranks, int depth);
+void run_diagonal_benchmark(int num_qubits, int depth);
+void run_kqubit_benchmark(int num_qubits, int repeats);
+void run_gradient_benchmark(int min_qubits, int max_qubits, int layers);
+void run_memory_benchmark(int num_qubits, int repeats);
+void run_clifford_benchmark(int max_qubits, int depth);
+void run_mps_benchmark(int max_qubits, int depth, int max_bond);
+void run_batch_benchmark(int num_qubits, int batch_size, int layers);
+void run_noise_benchmark(int num_qubits, int num_trajectories, int depth);
+void run_checkpoint_benchmark(int num_qubits, const char* path);
+void run_sparse_benchmark(int max_qubits);
+
+// Shared by the benchmarks in statevector.c and benchmarks.c
+uint64_t benchmark_random(void);  // xorshift from a fixed seed, so runs are repeatable
 
 // Validation
 bool validate_qubit_indices(int num_qubits, int qubit1, int qubit2);
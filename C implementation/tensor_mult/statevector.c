@@ -2,31 +2,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include "quantum_simulator.h"
-
-// Standard gates
-QuantumGate get_hadamard_gate(void) {
-    double inv_sqrt_2 = 1.0 / sqrt(2);
-    QuantumGate H = {
-        .elements = {
-            {inv_sqrt_2,  inv_sqrt_2},
-            {inv_sqrt_2, -inv_sqrt_2}
-        }
-    };
-    return H;
-}
-
-QuantumGate get_x_gate(void) {
-    QuantumGate X = {
-        .elements = {
-            {0.0, 1.0},
-            {1.0, 0.0}
-        }
-    };
-    return X;
-}
+#include "../common/thread_pool.h"
+#include "../common/circuit.h"
+#include "../common/cache_blocking.h"
+#include "../common/mapped_statevector.h"
+#include "../common/measurement.h"
+#include "../common/benchmark.h"
+#include "../common/instrumentation.h"
+#include "../common/statevector_f32.h"
+#include "../common/distributed_statevector.h"
+#include "../common/gradient.h"
+#include "../common/state_allocator.h"
+#include "../common/stabilizer.h"
+#include "../common/simulator.h"
+#include "../common/mps.h"
+#include "../common/state_batch.h"
+#include "../common/noise.h"
 
 bool validate_single_qubit(int num_qubits, int qubit) {
     return qubit >= 0 && qubit < num_qubits;
@@ -45,169 +43,1595 @@ bool validate_qubit_indices(int num_qubits, int qubit1, int qubit2) {
     return true;
 }
 
-bool initialize_state_vector(double* state_vector, int num_qubits) {
-    if (!state_vector) return false;
-    
-    int dim = 1 << num_qubits;
-    memset(state_vector, 0, dim * sizeof(double));
-    state_vector[0] = 1.0;  // Initialize to |0⟩⊗n state
+bool tensor_contract(Statevector* sv, QuantumGate gate, int target_qubit) {
+    // Contract the gate with each amplitude pair (i, i | 1 << target) in place
+    // A diagonal gate only scales amplitudes, so it skips the pair mixing
+    INSTRUMENT_BEGIN(span);
+    if (!is_diagonal_gate(&gate)) {
+        kernel_matrix_pairs(sv, &gate, target_qubit);
+    } else if (gate.elements[0][0].real == 1.0 && gate.elements[0][0].imag == 0.0) {
+        kernel_phase_pairs(sv, gate.elements[1][1], target_qubit);
+    } else {
+        kernel_diagonal_pairs(sv, gate.elements[0][0], gate.elements[1][1], target_qubit);
+    }
+    INSTRUMENT_END(span, "gate", "tensor_contract", target_qubit, NO_CONTROL, 0, 0);
     return true;
 }
 
-void print_state_vector(const double* state_vector, int num_qubits) {
-    if (!state_vector) return;
-    
-    int dim = 1 << num_qubits;
-    for (int i = 0; i < dim; i++) {
-        printf("|%d⟩: %.6f\n", i, state_vector[i]);
+bool apply_single_qubit_gate(Statevector* sv, QuantumGate gate, int target_qubit) {
+    if (!sv || !validate_single_qubit(sv->num_qubits, target_qubit)) {
+        fprintf(stderr, "Error: Invalid parameters for single qubit gate\n");
+        return false;
     }
-    printf("\n");
+    return tensor_contract(sv, gate, target_qubit);
 }
 
-bool tensor_contract(double* state_vector, QuantumGate gate, int target_qubit, int num_qubits) {
-    int dim = 1 << num_qubits;
-    double* new_state = calloc(dim, sizeof(double));
-    if (!new_state) {
-        fprintf(stderr, "Error: Memory allocation failed\n");
+bool apply_controlled_gate(Statevector* sv, QuantumGate gate, int control_qubit, int target_qubit) {
+    if (!sv || !validate_qubit_indices(sv->num_qubits, control_qubit, target_qubit)) {
+        return false;
+    }
+    INSTRUMENT_BEGIN(span);
+    if (!is_diagonal_gate(&gate)) {
+        kernel_controlled_matrix_pairs(sv, &gate, control_qubit, target_qubit);
+    } else if (gate.elements[0][0].real == 1.0 && gate.elements[0][0].imag == 0.0) {
+        kernel_controlled_phase_pairs(sv, gate.elements[1][1], control_qubit, target_qubit);
+    } else {
+        kernel_controlled_diagonal_pairs(sv, gate.elements[0][0], gate.elements[1][1], control_qubit, target_qubit);
+    }
+    INSTRUMENT_END(span, "gate", "controlled", target_qubit, control_qubit, 0, 0);
+    return true;
+}
+
+bool apply_cnot_gate(Statevector* sv, int control_qubit, int target_qubit) {
+    if (!sv || !validate_qubit_indices(sv->num_qubits, control_qubit, target_qubit)) {
+        return false;
+    }
+    INSTRUMENT_BEGIN(span);
+    kernel_controlled_swap_pairs(sv, control_qubit, target_qubit);
+    INSTRUMENT_END(span, "gate", "CNOT", target_qubit, control_qubit, 0, 0);
+    return true;
+}
+
+bool apply_k_qubit_gate(Statevector* sv, const Complex* matrix, const int* qubits, int k) {
+    if (!sv || !matrix || !qubits || k < 1 || k > MAX_BLOCK_QUBITS) {
+        fprintf(stderr, "Error: Invalid parameters for k-qubit gate\n");
         return false;
     }
+    INSTRUMENT_BEGIN(span);
+    bool ok = kernel_dense_block(sv, matrix, qubits, k);
+    INSTRUMENT_END(span, "gate", "k-qubit", qubits[0], NO_CONTROL, 0, 0);
+    return ok;
+}
+
+bool apply_tensor_op(Statevector* sv, const CircuitOp* op, const double* params) {
+    if (!sv || !op || (op->param_index >= 0 && !params)) {
+        fprintf(stderr, "Error: Invalid parameters for circuit op\n");
+        return false;
+    }
+    QuantumGate gate = circuit_op_gate(op, params);
+    if (op->control == NO_CONTROL) return apply_single_qubit_gate(sv, gate, op->target);
+    if (op->op == OP_CNOT) return apply_cnot_gate(sv, op->control, op->target);
+    return apply_controlled_gate(sv, gate, op->control, op->target);
+}
+
+// X on the last qubit, H and T on qubit 0, then CNOT from qubit 0 to the last qubit
+static Circuit* build_test_circuit(int num_qubits) {
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    if (!circuit_add_gate(circuit, OP_X, num_qubits - 1) ||
+        !circuit_add_gate(circuit, OP_H, 0) ||
+        !circuit_add_gate(circuit, OP_T, 0) ||
+        !circuit_add_controlled(circuit, OP_CNOT, 0, num_qubits - 1)) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+// Standard timing circuit: H on qubit 0, X on qubit 1, CNOT from qubit 0 to qubit 1
+static Circuit* build_runtime_circuit(int num_qubits) {
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    if (!circuit_add_gate(circuit, OP_H, 0) ||
+        !circuit_add_gate(circuit, OP_X, 1) ||
+        !circuit_add_controlled(circuit, OP_CNOT, 0, 1)) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+void run_quantum_circuit_test(int num_qubits) {
+    Statevector* sv = create_statevector(num_qubits);
+    Circuit* circuit = build_test_circuit(num_qubits);
+    if (!sv || !circuit) {
+        fprintf(stderr, "Error: Failed to initialize quantum state\n");
+        free_statevector(sv);
+        free_circuit(circuit);
+        return;
+    }
+
+    printf("Testing %d qubit circuit:\n", num_qubits);
+    printf("Initial state:\n");
+    print_statevector(sv);
 
-    for (int i = 0; i < dim; i++) {
-        int bit_mask = 1 << target_qubit;
-        int basis_0 = i & ~bit_mask;
-        int basis_1 = i | bit_mask;
-        
-        if ((i & bit_mask) == 0) {
-            new_state[basis_0] += gate.elements[0][0] * state_vector[i];
-            new_state[basis_1] += gate.elements[1][0] * state_vector[i];
+    for (int i = 0; i < circuit->num_ops; i++) {
+        const CircuitOp* op = &circuit->ops[i];
+        if (!apply_circuit_op(sv, op, NULL)) {
+            fprintf(stderr, "Error applying %s gate\n", gate_op_name(op->op));
+            break;
+        }
+        if (op->control == NO_CONTROL) {
+            printf("After %s on qubit %d:\n", gate_op_name(op->op), op->target);
         } else {
-            new_state[basis_0] += gate.elements[0][1] * state_vector[i];
-            new_state[basis_1] += gate.elements[1][1] * state_vector[i];
+            printf("After %s (control: %d, target: %d):\n", gate_op_name(op->op), op->control, op->target);
         }
+        print_statevector(sv);
     }
 
-    memcpy(state_vector, new_state, dim * sizeof(double));
-    free(new_state);
-    return true;
+    Rng rng;
+    ShotHistogram histogram;
+    rng_seed(&rng, MEASUREMENT_SEED);
+    if (sample_shots(sv, TEST_SHOTS, &rng, &histogram)) {
+        printf("Measurement counts (%d shots):\n", TEST_SHOTS);
+        for (size_t i = 0; i < histogram.num_outcomes; i++) {
+            printf("|%llu⟩: %llu\n", (unsigned long long)histogram.outcomes[i],
+                   (unsigned long long)histogram.counts[i]);
+        }
+        printf("\n");
+        free_shot_histogram(&histogram);
+    }
+
+    free_circuit(circuit);
+    free_statevector(sv);
 }
 
-bool apply_single_qubit_gate(double* state_vector, QuantumGate gate, int num_qubits, int target_qubit) {
-    if (!state_vector || !validate_single_qubit(num_qubits, target_qubit)) {
-        fprintf(stderr, "Error: Invalid parameters for single qubit gate\n");
+// Times the compiled circuit with bench_measure_run on a state first touched by
+// num_threads workers
+static bool measure_circuit(const Circuit* circuit, int num_threads, BenchStats* stats) {
+    if (!thread_pool_set_num_threads(num_threads)) {
         return false;
     }
-    return tensor_contract(state_vector, gate, target_qubit, num_qubits);
+    Statevector* sv = create_statevector(circuit->num_qubits);
+    CircuitPlan plan;
+    if (!sv || !compile_circuit(circuit, 0, &plan)) {
+        fprintf(stderr, "Error: Failed to initialize quantum state\n");
+        free_statevector(sv);
+        return false;
+    }
+    BenchPlanRun run = {&plan, sv};
+    bool ok = bench_measure_run(bench_plan_body, &run, stats);
+    free_circuit_plan(&plan);
+    free_statevector(sv);
+    return ok;
 }
 
-bool apply_cnot_gate(double* state_vector, int num_qubits, int control_qubit, int target_qubit) {
-    if (!state_vector || !validate_qubit_indices(num_qubits, control_qubit, target_qubit)) {
+// Times the standard timing circuit
+bool measure_circuit_runtime(int num_qubits, int num_threads, BenchStats* stats) {
+    Circuit* circuit = build_runtime_circuit(num_qubits);
+    bool ok = circuit && measure_circuit(circuit, num_threads, stats);
+    free_circuit(circuit);
+    return ok;
+}
+
+// In-place regression benchmark
+
+// The allocate-and-copy kernels that tensor_contract and apply_cnot_gate used to be,
+// kept as the baseline for run_inplace_benchmark
+static bool tensor_contract_out_of_place(Statevector* sv, QuantumGate gate, int target_qubit) {
+    Statevector* new_state = create_statevector(sv->num_qubits);
+    if (!new_state) {
         return false;
     }
+    new_state->real[0] = 0.0;
+
+    size_t bit_mask = (size_t)1 << target_qubit;
+    for (size_t i = 0; i < sv->dimension; i++) {
+        size_t basis_0 = i & ~bit_mask;
+        size_t basis_1 = i | bit_mask;
+        int column = (i & bit_mask) ? 1 : 0;
+        Complex g0 = gate.elements[0][column];
+        Complex g1 = gate.elements[1][column];
+        double re = sv->real[i], im = sv->imag[i];
+
+        new_state->real[basis_0] += g0.real * re - g0.imag * im;
+        new_state->imag[basis_0] += g0.real * im + g0.imag * re;
+        new_state->real[basis_1] += g1.real * re - g1.imag * im;
+        new_state->imag[basis_1] += g1.real * im + g1.imag * re;
+    }
 
-    int dim = 1 << num_qubits;
-    double* new_state = calloc(dim, sizeof(double));
+    copy_statevector(sv, new_state);
+    free_statevector(new_state);
+    return true;
+}
+
+static bool apply_cnot_gate_out_of_place(Statevector* sv, int control_qubit, int target_qubit) {
+    Statevector* new_state = create_statevector(sv->num_qubits);
     if (!new_state) {
-        fprintf(stderr, "Error: Memory allocation failed\n");
         return false;
     }
 
-    for (int i = 0; i < dim; i++) {
-        int control_bit = (i >> control_qubit) & 1;
-        if (control_bit == 1) {
-            int new_state_idx = i ^ (1 << target_qubit);
-            new_state[i] = state_vector[new_state_idx];
-        } else {
-            new_state[i] = state_vector[i];
+    for (size_t i = 0; i < sv->dimension; i++) {
+        size_t control_bit = (i >> control_qubit) & 1;
+        size_t source_idx = control_bit ? i ^ ((size_t)1 << target_qubit) : i;
+        new_state->real[i] = sv->real[source_idx];
+        new_state->imag[i] = sv->imag[source_idx];
+    }
+
+    copy_statevector(sv, new_state);
+    free_statevector(new_state);
+    return true;
+}
+
+// H on the lowest, middle and highest qubit, or a CNOT spanning the register, with the
+// in-place kernels or the allocate-and-copy ones
+typedef struct {
+    Statevector* sv;
+    bool in_place;
+    bool ok;
+} SequenceRun;
+
+static void hadamard_sequence_body(void* context) {
+    SequenceRun* run = context;
+    QuantumGate H = get_hadamard_gate();
+    int targets[3] = {0, run->sv->num_qubits / 2, run->sv->num_qubits - 1};
+    for (int i = 0; i < 3; i++) {
+        bool ok = run->in_place ? tensor_contract(run->sv, H, targets[i])
+                                : tensor_contract_out_of_place(run->sv, H, targets[i]);
+        run->ok = run->ok && ok;
+    }
+}
+
+static void cnot_sequence_body(void* context) {
+    SequenceRun* run = context;
+    int top = run->sv->num_qubits - 1;
+    bool ok = run->in_place ? apply_cnot_gate(run->sv, 0, top) : apply_cnot_gate_out_of_place(run->sv, 0, top);
+    run->ok = run->ok && ok;
+}
+
+// Times the three H gates and the CNOT
+static bool time_gate_sequence(int num_qubits, bool in_place, BenchStats stats[2]) {
+    Statevector* sv = create_statevector(num_qubits);
+    if (!sv) {
+        return false;
+    }
+    SequenceRun run = {sv, in_place, true};
+    bool ok = bench_measure_run(hadamard_sequence_body, &run, &stats[0]) &&
+              bench_measure_run(cnot_sequence_body, &run, &stats[1]) && run.ok;
+    free_statevector(sv);
+    return ok;
+}
+
+// Runs time_gate_sequence in a child process so that each measurement gets its own
+// peak resident set size
+static bool measure_gate_sequence(int num_qubits, bool in_place, BenchStats stats[2], double* peak_rss_mib) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        fprintf(stderr, "Error: Could not create pipe\n");
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Error: Could not fork benchmark process\n");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        BenchStats child_stats[2];
+        bool ok = time_gate_sequence(num_qubits, in_place, child_stats);
+        if (ok && write(fds[1], child_stats, sizeof(child_stats)) != (ssize_t)sizeof(child_stats)) {
+            ok = false;
         }
+        close(fds[1]);
+        _exit(ok ? 0 : 1);
     }
 
-    memcpy(state_vector, new_state, dim * sizeof(double));
-    free(new_state);
+    close(fds[1]);
+    ssize_t received = read(fds[0], stats, 2 * sizeof(BenchStats));
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+        received != (ssize_t)(2 * sizeof(BenchStats))) {
+        fprintf(stderr, "Error: Benchmark process for %d qubits failed\n", num_qubits);
+        return false;
+    }
+#ifdef __APPLE__
+    *peak_rss_mib = usage.ru_maxrss / (1024.0 * 1024.0);  // bytes
+#else
+    *peak_rss_mib = usage.ru_maxrss / 1024.0;             // kilobytes
+#endif
     return true;
 }
 
-void run_quantum_circuit_test(int num_qubits) {
-    int dim = 1 << num_qubits;
-    double* state_vector = calloc(dim, sizeof(double));
-    if (!state_vector || !initialize_state_vector(state_vector, num_qubits)) {
-        fprintf(stderr, "Error: Failed to initialize quantum state\n");
-        free(state_vector);
+// Per-gate times are the median of the three H gates divided by three, and of the CNOT
+void run_inplace_benchmark(int min_qubits, int max_qubits) {
+    if (min_qubits < 2 || max_qubits > MAX_QUBITS || min_qubits > max_qubits) {
+        fprintf(stderr, "Error: Invalid parameters for in-place benchmark\n");
         return;
     }
+    BenchReport* report = create_bench_report("inplace");
+    if (!report) return;
 
-    QuantumGate H = get_hadamard_gate();
-    QuantumGate X = get_x_gate();
+    printf("%6s %10s | %12s %10s %10s | %12s %10s %10s\n", "qubits", "state MiB",
+           "in-place 1q", "cnot", "peak MiB", "copying 1q", "cnot", "peak MiB");
+    for (int num_qubits = min_qubits; num_qubits <= max_qubits; num_qubits++) {
+        double state_mib = statevector_bytes(num_qubits) / (1024.0 * 1024.0);
+        BenchStats in_place[2], copying[2];
+        double in_place_rss, copying_rss;
+        if (!measure_gate_sequence(num_qubits, true, in_place, &in_place_rss) ||
+            !measure_gate_sequence(num_qubits, false, copying, &copying_rss)) {
+            break;
+        }
+        printf("%6d %10.1f | %11.6fs %9.6fs %10.1f | %11.6fs %9.6fs %10.1f\n", num_qubits, state_mib,
+               in_place[0].median / 3.0, in_place[1].median, in_place_rss, copying[0].median / 3.0,
+               copying[1].median, copying_rss);
 
-    printf("Testing %d qubit circuit:\n", num_qubits);
-    printf("Initial state:\n");
-    print_state_vector(state_vector, num_qubits);
+        const char* labels[4] = {"in-place/h", "in-place/cnot", "copying/h", "copying/cnot"};
+        const BenchStats* stats[4] = {&in_place[0], &in_place[1], &copying[0], &copying[1]};
+        for (int i = 0; i < 4; i++) {
+            BenchResult* result = bench_report_add(report, labels[i], stats[i]);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "gates", i % 2 ? 1 : 3);
+            bench_result_value(result, "state_mib", state_mib);
+            bench_result_value(result, "peak_rss_mib", i < 2 ? in_place_rss : copying_rss);
+        }
+    }
+    write_bench_report(report);
+    free_bench_report(report);
+}
+
+// Strong-scaling benchmark
+
+// H on every qubit followed by a CNOT ladder: 2n - 1 gates that each sweep the whole state,
+// so the sweeps rather than waking the worker pool make up the time
+static Circuit* build_scaling_circuit(int num_qubits) {
+    Circuit* circuit = create_circuit(num_qubits);
+    if (!circuit) return NULL;
+    bool ok = true;
+    for (int q = 0; q < num_qubits && ok; q++) ok = circuit_add_gate(circuit, OP_H, q);
+    for (int q = 0; q + 1 < num_qubits && ok; q++) ok = circuit_add_controlled(circuit, OP_CNOT, q, q + 1);
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
 
-    // Apply test circuit
-    if (!apply_single_qubit_gate(state_vector, X, num_qubits, num_qubits - 1)) {
-        fprintf(stderr, "Error applying X gate\n");
-        free(state_vector);
+// The scaling circuit at a fixed size for 1, 2, 4, ... threads, with the speedup measured
+// against the serial (1 thread) run
+void run_scaling_benchmark(int num_qubits, int max_threads) {
+    if (num_qubits < 2 || num_qubits > MAX_QUBITS || max_threads < 1) {
+        fprintf(stderr, "Error: Invalid parameters for scaling benchmark\n");
         return;
     }
-    printf("After X on qubit %d:\n", num_qubits - 1);
-    print_state_vector(state_vector, num_qubits);
+    Circuit* circuit = build_scaling_circuit(num_qubits);
+    BenchReport* report = circuit ? create_bench_report("scaling") : NULL;
+    if (!report) {
+        free_circuit(circuit);
+        return;
+    }
+    printf("%d qubits, %d gates\n", num_qubits, circuit->num_ops);
+    printf("%-8s %12s %9s %11s\n", "threads", "time (s)", "speedup", "efficiency");
+
+    double serial_time = -1.0;
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        BenchStats stats;
+        if (!measure_circuit(circuit, num_threads, &stats)) break;
+        if (serial_time < 0) serial_time = stats.median;
+        double speedup = serial_time / stats.median;
+        printf("%-8d %12.6f %8.2fx %10.0f%%\n", num_threads, stats.median, speedup, 100.0 * speedup / num_threads);
+
+        char label[BENCH_LABEL_LENGTH];
+        snprintf(label, sizeof(label), "threads/%d", num_threads);
+        BenchResult* result = bench_report_add(report, label, &stats);
+        bench_result_value(result, "num_qubits", num_qubits);
+        bench_result_value(result, "gates", circuit->num_ops);
+        bench_result_value(result, "threads", num_threads);
+        bench_result_value(result, "speedup", speedup);
+        bench_result_value(result, "efficiency", speedup / num_threads);
+    }
+    thread_pool_set_num_threads(1);
+    write_bench_report(report);
+    free_bench_report(report);
+    free_circuit(circuit);
+}
+
+// Gate fusion benchmark
+
+// The standard timing circuit followed by depth layers of RZ-RY-RZ rotations on every
+// qubit, with a CNOT ladder between consecutive layers
+static Circuit* build_rotation_circuit(int num_qubits, int depth) {
+    Circuit* circuit = build_runtime_circuit(num_qubits);
+    if (!circuit) return NULL;
+    bool ok = true;
+    for (int layer = 0; layer < depth && ok; layer++) {
+        for (int q = 0; q < num_qubits && ok; q++) {
+            double angle = 0.37 * (layer + 1) + 0.11 * q;
+            ok = circuit_add_rotation(circuit, OP_RZ, q, angle) &&
+                 circuit_add_rotation(circuit, OP_RY, q, 2.0 * angle) &&
+                 circuit_add_rotation(circuit, OP_RZ, q, -angle);
+        }
+        if (layer + 1 < depth) {
+            for (int q = 0; q + 1 < num_qubits && ok; q++) {
+                ok = circuit_add_controlled(circuit, OP_CNOT, q, q + 1);
+            }
+        }
+    }
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+// Compiling the fused plan, one timed call
+typedef struct {
+    const Circuit* circuit;
+    int max_block_qubits;
+    bool ok;
+} FusionRun;
+
+static void fusion_run_body(void* context) {
+    FusionRun* run = context;
+    CircuitPlan plan;
+    bool ok = compile_circuit(run->circuit, run->max_block_qubits, &plan);
+    if (ok) free_circuit_plan(&plan);
+    run->ok = run->ok && ok;
+}
 
-    if (!apply_single_qubit_gate(state_vector, H, num_qubits, 0)) {
-        fprintf(stderr, "Error applying H gate\n");
-        free(state_vector);
+// The rotation circuit run gate by gate and fused, and the time fusing it takes. One run
+// of each from |0...0⟩ is compared before the timed runs continue from the results.
+void run_fusion_benchmark(int num_qubits, int depth, int max_block_qubits) {
+    if (num_qubits < 2 || num_qubits > MAX_QUBITS || depth < 1) {
+        fprintf(stderr, "Error: Invalid parameters for fusion benchmark\n");
         return;
     }
-    printf("After H on qubit 0:\n");
-    print_state_vector(state_vector, num_qubits);
+    Circuit* circuit = build_rotation_circuit(num_qubits, depth);
+    Statevector* unfused_sv = create_statevector(num_qubits);
+    Statevector* fused_sv = create_statevector(num_qubits);
+    BenchReport* report = create_bench_report("fusion");
+    CircuitPlan unfused, fused;
+    if (!circuit || !unfused_sv || !fused_sv || !report || !compile_circuit(circuit, 0, &unfused)) {
+        fprintf(stderr, "Error: Failed to set up fusion benchmark\n");
+        free_circuit(circuit);
+        free_statevector(unfused_sv);
+        free_statevector(fused_sv);
+        free_bench_report(report);
+        return;
+    }
+    if (!compile_circuit(circuit, max_block_qubits, &fused)) {
+        free_circuit_plan(&unfused);
+        free_circuit(circuit);
+        free_statevector(unfused_sv);
+        free_statevector(fused_sv);
+        free_bench_report(report);
+        return;
+    }
+
+    BenchPlanRun unfused_run = {&unfused, unfused_sv};
+    BenchPlanRun fused_run = {&fused, fused_sv};
+    FusionRun fusion_run = {circuit, max_block_qubits, true};
+    bench_plan_body(&unfused_run);
+    bench_plan_body(&fused_run);
+    double max_error = 0.0;
+    for (size_t i = 0; i < fused_sv->dimension; i++) {
+        double err = fabs(fused_sv->real[i] - unfused_sv->real[i]) + fabs(fused_sv->imag[i] - unfused_sv->imag[i]);
+        if (err > max_error) max_error = err;
+    }
+
+    BenchStats unfused_stats, fused_stats, fusion_stats;
+    bool ok = bench_measure_run(bench_plan_body, &unfused_run, &unfused_stats) &&
+              bench_measure_run(bench_plan_body, &fused_run, &fused_stats) &&
+              bench_measure_run(fusion_run_body, &fusion_run, &fusion_stats) && fusion_run.ok;
+    if (ok) {
+        int num_gates = circuit->num_ops;
+        int passes_saved = num_gates - fused.num_steps;
+        double unfused_time = unfused_stats.median, fused_time = fused_stats.median;
+        double fusion_time = fusion_stats.median;
+        printf("%d qubits, %d gates, blocks of up to %d qubits\n", num_qubits, num_gates, max_block_qubits);
+        printf("Passes: %d unfused, %d fused (%d saved)\n", num_gates, fused.num_steps, passes_saved);
+        printf("Unfused: %.6f s, fused: %.6f s + %.6f s fusion, delta %+.6f s (%.2fx)\n",
+               unfused_time, fused_time, fusion_time, (fused_time + fusion_time) - unfused_time,
+               unfused_time / (fused_time + fusion_time));
+        printf("Max amplitude difference: %.3e\n", max_error);
 
-    if (!apply_cnot_gate(state_vector, num_qubits, 0, num_qubits - 1)) {
-        fprintf(stderr, "Error applying CNOT gate\n");
-        free(state_vector);
+        BenchResult* result = bench_report_add(report, "unfused", &unfused_stats);
+        bench_result_value(result, "num_qubits", num_qubits);
+        bench_result_value(result, "depth", depth);
+        bench_result_value(result, "passes", num_gates);
+        result = bench_report_add(report, "fused", &fused_stats);
+        bench_result_value(result, "num_qubits", num_qubits);
+        bench_result_value(result, "depth", depth);
+        bench_result_value(result, "max_block_qubits", max_block_qubits);
+        bench_result_value(result, "passes", fused.num_steps);
+        bench_result_value(result, "speedup", unfused_time / (fused_time + fusion_time));
+        bench_result_value(result, "max_diff", max_error);
+        result = bench_report_add(report, "fusion", &fusion_stats);
+        bench_result_value(result, "num_qubits", num_qubits);
+        bench_result_value(result, "max_block_qubits", max_block_qubits);
+        bench_result_value(result, "passes_saved", passes_saved);
+        write_bench_report(report);
+    }
+
+    free_circuit_plan(&fused);
+    free_circuit_plan(&unfused);
+    free_circuit(circuit);
+    free_statevector(unfused_sv);
+    free_statevector(fused_sv);
+    free_bench_report(report);
+}
+
+// Cache blocking benchmark
+
+static uint64_t benchmark_rng_state = 0x9e3779b97f4a7c15ULL;
+
+uint64_t benchmark_random(void) {
+    benchmark_rng_state ^= benchmark_rng_state << 13;
+    benchmark_rng_state ^= benchmark_rng_state >> 7;
+    benchmark_rng_state ^= benchmark_rng_state << 17;
+    return benchmark_rng_state;
+}
+
+// depth layers of a random gate (H, T, RX or RY) on every qubit followed by CNOTs
+// between randomly paired qubits
+static Circuit* build_random_circuit(int num_qubits, int depth) {
+    Circuit* circuit = create_circuit(num_qubits);
+    int* order = malloc((size_t)num_qubits * sizeof(int));
+    if (!circuit || !order) {
+        free_circuit(circuit);
+        free(order);
+        return NULL;
+    }
+    bool ok = true;
+    for (int layer = 0; layer < depth && ok; layer++) {
+        for (int q = 0; q < num_qubits && ok; q++) {
+            double angle = (double)(benchmark_random() % 1000) * 0.00628;
+            switch (benchmark_random() % 4) {
+                case 0:  ok = circuit_add_gate(circuit, OP_H, q); break;
+                case 1:  ok = circuit_add_gate(circuit, OP_T, q); break;
+                case 2:  ok = circuit_add_rotation(circuit, OP_RX, q, angle); break;
+                default: ok = circuit_add_rotation(circuit, OP_RY, q, angle); break;
+            }
+        }
+        for (int q = 0; q < num_qubits; q++) order[q] = q;
+        for (int q = num_qubits - 1; q > 0; q--) {
+            int r = (int)(benchmark_random() % (uint64_t)(q + 1));
+            int tmp = order[q];
+            order[q] = order[r];
+            order[r] = tmp;
+        }
+        for (int q = 0; q + 1 < num_qubits && ok; q += 2) {
+            ok = circuit_add_controlled(circuit, OP_CNOT, order[q], order[q + 1]);
+        }
+    }
+    free(order);
+    if (!ok) {
+        free_circuit(circuit);
+        return NULL;
+    }
+    return circuit;
+}
+
+// Index-weighted sum of the amplitudes; equal states give equal checksums
+static double state_checksum(const Statevector* sv) {
+    double sum = 0.0;
+    for (size_t i = 0; i < sv->dimension; i++) {
+        sum += sv->real[i] * (double)(i % 5 + 1) + sv->imag[i] * (double)(i % 3 + 1);
+    }
+    return sum;
+}
+
+// A plan run cache blocked, continuing from the current state
+typedef struct {
+    const CircuitPlan* plan;
+    Statevector* sv;
+    BlockingStats stats;
+    bool ok;
+} BlockedRun;
+
+static void blocked_run_body(void* context) {
+    BlockedRun* run = context;
+    run->ok = execute_plan_blocked(run->plan, run->sv, NULL, &run->stats) && run->ok;
+}
+
+// One run of each from |0...0⟩ is checked against the other before the timed runs, which
+// continue from the result on the same state
+void run_blocking_benchmark(int min_qubits, int max_qubits, int depth) {
+    if (min_qubits < 2 || min_qubits > max_qubits || depth < 1) {
+        fprintf(stderr, "Error: Invalid parameters for blocking benchmark\n");
         return;
     }
-    printf("After CNOT (control: 0, target: %d):\n", num_qubits - 1);
-    print_state_vector(state_vector, num_qubits);
+    BenchReport* report = create_bench_report("blocking");
+    if (!report) return;
+    size_t memory = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE);
+    int local = get_local_qubits();
+    printf("Local qubits: %d (%zu KiB chunks)\n", local, statevector_bytes(local) / 1024);
 
-    free(state_vector);
+    bool ok = true;
+    for (int num_qubits = min_qubits; num_qubits <= max_qubits && ok; num_qubits++) {
+        // A single state is live at a time; leave a quarter of the memory to everything else
+        if (statevector_bytes(num_qubits) > memory / 4 * 3) {
+            printf("%d qubits: skipped, needs %zu MiB\n", num_qubits, statevector_bytes(num_qubits) >> 20);
+            continue;
+        }
+        Circuit* circuit = build_random_circuit(num_qubits, depth);
+        CircuitPlan plan;
+        Statevector* sv = create_statevector(num_qubits);
+        if (!circuit || !sv || !compile_circuit(circuit, 0, &plan)) {
+            fprintf(stderr, "Error: Failed to set up blocking benchmark\n");
+            free_circuit(circuit);
+            free_statevector(sv);
+            ok = false;
+            break;
+        }
+
+        BenchPlanRun sweep_run = {&plan, sv};
+        BlockedRun blocked_run = {&plan, sv, {0}, true};
+        bench_plan_body(&sweep_run);
+        double sweep_checksum = state_checksum(sv);
+        initialize_statevector(sv);
+        blocked_run_body(&blocked_run);
+        double blocked_checksum = state_checksum(sv);
+
+        BenchStats sweep_stats, blocked_stats;
+        ok = bench_measure_run(bench_plan_body, &sweep_run, &sweep_stats) &&
+             bench_measure_run(blocked_run_body, &blocked_run, &blocked_stats) && blocked_run.ok;
+        if (ok) {
+            const BlockingStats* stats = &blocked_run.stats;
+            int blocked_passes = stats->num_windows + stats->num_swap_passes;
+            printf("%d qubits, %d gates: one sweep per gate %.6f s, blocked %.6f s (%d windows + %d swap passes), "
+                   "speedup %.2fx, checksum difference %.3e\n",
+                   num_qubits, plan.num_steps, sweep_stats.median, blocked_stats.median, stats->num_windows,
+                   stats->num_swap_passes, sweep_stats.median / blocked_stats.median,
+                   fabs(sweep_checksum - blocked_checksum));
+            BenchResult* result = bench_report_add(report, "sweep", &sweep_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "depth", depth);
+            bench_result_value(result, "passes", plan.num_steps);
+            result = bench_report_add(report, "blocked", &blocked_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "depth", depth);
+            bench_result_value(result, "local_qubits", local);
+            bench_result_value(result, "passes", blocked_passes);
+            bench_result_value(result, "swap_passes", stats->num_swap_passes);
+            bench_result_value(result, "speedup", sweep_stats.median / blocked_stats.median);
+            bench_result_value(result, "checksum_diff", fabs(sweep_checksum - blocked_checksum));
+        }
+
+        free_circuit_plan(&plan);
+        free_circuit(circuit);
+        free_statevector(sv);
+    }
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
 }
 
-double measure_circuit_runtime(int num_qubits) {
-    int dim = 1 << num_qubits;
-    double* state_vector = calloc(dim, sizeof(double));
-    if (!state_vector || !initialize_state_vector(state_vector, num_qubits)) {
-        fprintf(stderr, "Error: Failed to initialize quantum state\n");
-        free(state_vector);
-        return -1.0;
+// SIMD check
+
+// Uniform in [-1, 1)
+static double benchmark_uniform(void) {
+    return (double)(benchmark_random() >> 11) / (double)(1ULL << 52) - 1.0;
+}
+
+// Applies the same random k-qubit block, for k = 1..MAX_BLOCK_QUBITS, to the same random
+// state under every SIMD level the CPU supports and compares each result bit for bit with
+// the scalar one. Each block runs on qubits 3 and up, where the groups of a lane set are
+// contiguous, and spread over the state from qubit 0, where the lanes are gathered.
+// Returns false if any level differs.
+bool run_simd_check(int num_qubits) {
+    if (num_qubits < MAX_BLOCK_QUBITS + 3 || num_qubits > MAX_QUBITS) {
+        fprintf(stderr, "Error: Invalid parameters for SIMD check\n");
+        return false;
+    }
+    Statevector* initial = create_statevector(num_qubits);
+    Statevector* reference = create_statevector(num_qubits);
+    Statevector* sv = create_statevector(num_qubits);
+    if (!initial || !reference || !sv) {
+        fprintf(stderr, "Error: Failed to set up SIMD check\n");
+        free_statevector(initial);
+        free_statevector(reference);
+        free_statevector(sv);
+        return false;
+    }
+    for (size_t i = 0; i < initial->dimension; i++) {
+        initial->real[i] = benchmark_uniform();
+        initial->imag[i] = benchmark_uniform();
     }
 
-    QuantumGate H = get_hadamard_gate();
-    QuantumGate X = get_x_gate();
+    SimdLevel detected = get_simd_level();
+    SimdLevel levels[] = {SIMD_AVX2, SIMD_AVX512};
+    Complex matrix[1 << (2 * MAX_BLOCK_QUBITS)];
+    bool identical = true;
+    printf("%d qubits, compared with scalar\n", num_qubits);
+    printf("%-3s %-8s %-8s %12s\n", "k", "qubits", "level", "differences");
+    for (int k = 1; k <= MAX_BLOCK_QUBITS; k++) {
+        for (int e = 0; e < (1 << (2 * k)); e++) matrix[e] = (Complex){benchmark_uniform(), benchmark_uniform()};
+        for (int placement = 0; placement < 2; placement++) {
+            int qubits[MAX_BLOCK_QUBITS];
+            for (int b = 0; b < k; b++) qubits[b] = placement == 0 ? b + 3 : b * (num_qubits - 1) / k;
+
+            set_simd_level(SIMD_SCALAR);
+            copy_statevector(reference, initial);
+            kernel_dense_block(reference, matrix, qubits, k);
+            for (int l = 0; l < 2; l++) {
+                if (!simd_level_supported(levels[l])) continue;
+                set_simd_level(levels[l]);
+                copy_statevector(sv, initial);
+                kernel_dense_block(sv, matrix, qubits, k);
+                size_t differences = 0;
+                for (size_t i = 0; i < sv->dimension; i++) {
+                    if (memcmp(&sv->real[i], &reference->real[i], sizeof(double)) != 0 ||
+                        memcmp(&sv->imag[i], &reference->imag[i], sizeof(double)) != 0) {
+                        differences++;
+                    }
+                }
+                if (differences > 0) identical = false;
+                const char* where = placement == 0 ? "low" : "spread";
+                printf("%-3d %-8s %-8s %12zu\n", k, where, simd_level_name(levels[l]), differences);
+            }
+        }
+    }
+    set_simd_level(detected);
+    printf("%s\n", identical ? "All SIMD levels are bit-identical" : "Error: SIMD levels differ");
+    free_statevector(initial);
+    free_statevector(reference);
+    free_statevector(sv);
+    return identical;
+}
 
-    clock_t start_time = clock();
-    
-    // Standard test circuit
-    apply_single_qubit_gate(state_vector, H, num_qubits, 0);
-    apply_single_qubit_gate(state_vector, X, num_qubits, 1);
-    apply_cnot_gate(state_vector, num_qubits, 0, 1);
-    
-    clock_t end_time = clock();
-    double time_taken = (double)(end_time - start_time) / CLOCKS_PER_SEC;
+// Out-of-core benchmark
 
-    free(state_vector);
-    return time_taken;
+// A plan streamed over a file-backed state, including the write-back of every dirty page
+typedef struct {
+    const CircuitPlan* plan;
+    MappedStatevector* ms;
+    MappedStats stats;
+    bool ok;
+} MappedRun;
+
+static void mapped_run_body(void* context) {
+    MappedRun* run = context;
+    run->ok = execute_plan_mapped(run->plan, run->ms, NULL, &run->stats) && sync_mapped_statevector(run->ms) &&
+              run->ok;
 }
 
-void save_runtime_data(int num_qubits, double time_taken) {
-    FILE *file = fopen(RUNTIME_DATA_FILE, "a");
-    if (!file) {
-        fprintf(stderr, "Error: Could not open runtime data file\n");
+// Times single gates on a file-backed state and reports the rate at which the state
+// streams through (bytes read + written)
+void run_mapped_benchmark(int num_qubits, const char* path) {
+    MappedStatevector* ms = create_mapped_statevector(num_qubits, path);
+    if (!ms) return;
+    BenchReport* report = create_bench_report("mapped");
+    if (!report) {
+        free_mapped_statevector(ms);
+        remove(path);
         return;
     }
-    fprintf(file, "%d %.6f\n", num_qubits, time_taken);
-    fclose(file);
+    int chunk = get_chunk_qubits() < num_qubits ? get_chunk_qubits() : num_qubits;
+    printf("%d qubits in %s (%zu MiB), chunks of %d qubits\n", num_qubits, path,
+           statevector_bytes(num_qubits) >> 20, chunk);
+
+    // Low, chunk-local and high targets, and CNOTs that reach across chunks
+    struct {
+        GateOp op;
+        int control;
+        int target;
+    } gates[] = {
+        {OP_H, NO_CONTROL, 0},
+        {OP_H, NO_CONTROL, chunk - 1},
+        {OP_H, NO_CONTROL, num_qubits - 1},
+        {OP_CNOT, 0, num_qubits - 1},
+        {OP_CNOT, num_qubits - 1, num_qubits - 2},
+    };
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(gates) / sizeof(gates[0]) && ok; i++) {
+        Circuit* circuit = create_circuit(num_qubits);
+        CircuitPlan plan;
+        ok = circuit && (gates[i].control == NO_CONTROL
+                             ? circuit_add_gate(circuit, gates[i].op, gates[i].target)
+                             : circuit_add_controlled(circuit, gates[i].op, gates[i].control, gates[i].target));
+        if (!ok || !compile_circuit(circuit, 0, &plan)) {
+            free_circuit(circuit);
+            ok = false;
+            break;
+        }
+
+        MappedRun run = {&plan, ms, {0}, true};
+        BenchStats stats;
+        ok = bench_measure_run(mapped_run_body, &run, &stats) && run.ok;
+        free_circuit_plan(&plan);
+        free_circuit(circuit);
+        if (!ok) break;
+
+        double gb_per_second = (double)run.stats.bytes_moved / stats.median / 1e9;
+        if (gates[i].control == NO_CONTROL) {
+            printf("%s on qubit %d: %.6f s, %.2f GB/s\n", gate_op_name(gates[i].op), gates[i].target,
+                   stats.median, gb_per_second);
+        } else {
+            printf("%s (control: %d, target: %d): %.6f s, %.2f GB/s\n", gate_op_name(gates[i].op),
+                   gates[i].control, gates[i].target, stats.median, gb_per_second);
+        }
+        BenchResult* result = bench_report_add(report, gate_op_name(gates[i].op), &stats);
+        bench_result_value(result, "num_qubits", num_qubits);
+        bench_result_value(result, "chunk_qubits", chunk);
+        bench_result_value(result, "target", gates[i].target);
+        bench_result_value(result, "control", gates[i].control);
+        bench_result_value(result, "bytes", (double)run.stats.bytes_moved);
+        bench_result_value(result, "gbs", gb_per_second);
+    }
+
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+    free_mapped_statevector(ms);
+    remove(path);
+}
+
+// Kernel microbenchmark
+
+// Gate classes timed by run_kernel_benchmark, for 0, 1 and 2 controls
+static const char* const kernel_class_names[] = {
+    "swap", "hadamard", "phase", "diagonal", "matrix",
+    "c-swap", "c-phase", "c-diagonal", "c-matrix",
+    "cc-swap", "cc-phase", "cc-diagonal", "cc-matrix",
+};
+#define NUM_KERNEL_CLASSES (int)(sizeof(kernel_class_names) / sizeof(kernel_class_names[0]))
+
+// Controlled classes are timed with their controls in two placements
+#define FIRST_CONTROLLED_CLASS 5
+enum { CONTROLS_LOW, CONTROLS_HIGH };
+static const char* const control_placement_names[] = {"low", "high"};
+
+// Controls sit on the lowest or on the highest qubits other than the target. The lowest
+// control of a gate must be above the target and at qubit 3 or higher for the run-based
+// SIMD path, so high controls take it on every target below them and low controls never do;
+// those gates go through the direct-indexed path.
+static void apply_kernel_class(Statevector* sv, int kernel_class, int placement, int target) {
+    int top = sv->num_qubits - 1;
+    int c0, c1;
+    if (placement == CONTROLS_HIGH) {
+        c0 = target == top ? top - 1 : top;
+        c1 = target >= top - 1 ? top - 2 : top - 1;
+    } else {
+        c0 = target == 0 ? 1 : 0;
+        c1 = target <= 1 ? 2 : 1;
+    }
+    QuantumGate t_gate = get_t_gate(), rz = get_rz_gate(0.3), ry = get_ry_gate(0.3);
+    Complex phase = t_gate.elements[1][1], d0 = rz.elements[0][0], d1 = rz.elements[1][1];
+    switch (kernel_class) {
+        case 0:  kernel_swap_pairs(sv, target); break;
+        case 1:  kernel_hadamard_pairs(sv, target); break;
+        case 2:  kernel_phase_pairs(sv, phase, target); break;
+        case 3:  kernel_diagonal_pairs(sv, d0, d1, target); break;
+        case 4:  kernel_matrix_pairs(sv, &ry, target); break;
+        case 5:  kernel_controlled_swap_pairs(sv, c0, target); break;
+        case 6:  kernel_controlled_phase_pairs(sv, phase, c0, target); break;
+        case 7:  kernel_controlled_diagonal_pairs(sv, d0, d1, c0, target); break;
+        case 8:  kernel_controlled_matrix_pairs(sv, &ry, c0, target); break;
+        case 9:  kernel_doubly_controlled_swap_pairs(sv, c0, c1, target); break;
+        case 10: kernel_doubly_controlled_phase_pairs(sv, phase, c0, c1, target); break;
+        case 11: kernel_doubly_controlled_diagonal_pairs(sv, d0, d1, c0, c1, target); break;
+        default: kernel_doubly_controlled_matrix_pairs(sv, &ry, c0, c1, target); break;
+    }
+}
+
+typedef struct {
+    Statevector* sv;
+    int kernel_class;
+    int placement;
+    int target;
+} KernelRun;
+
+static void kernel_run_body(void* context) {
+    const KernelRun* run = context;
+    apply_kernel_class(run->sv, run->kernel_class, run->placement, run->target);
+}
+
+// Times every gate class on every target qubit, the controlled ones with low and with high
+// controls, over repeats trials and reports the median in nanoseconds per amplitude of the
+// state
+void run_kernel_benchmark(int num_qubits, int repeats) {
+    if (num_qubits < 3 || num_qubits > MAX_QUBITS || repeats < 1) {
+        fprintf(stderr, "Error: Invalid parameters for kernel benchmark\n");
+        return;
+    }
+    Statevector* sv = create_statevector(num_qubits);
+    if (!sv) return;
+    BenchReport* report = create_bench_report("kernels");
+    if (!report) {
+        free_statevector(sv);
+        return;
+    }
+    printf("%d qubits, %s kernels, median of %d (ns per amplitude)\n", num_qubits,
+           simd_level_name(get_simd_level()), repeats);
+
+    printf("%-17s", "target");
+    for (int target = 0; target < num_qubits; target++) printf("%7d", target);
+    printf("\n");
+    bool ok = true;
+    for (int kernel_class = 0; kernel_class < NUM_KERNEL_CLASSES && ok; kernel_class++) {
+        int placements = kernel_class < FIRST_CONTROLLED_CLASS ? 1 : 2;
+        for (int placement = CONTROLS_LOW; placement < placements && ok; placement++) {
+            char name[24];  // leaves room in the label for the target
+            snprintf(name, sizeof(name), "%s%s%s", kernel_class_names[kernel_class], placements == 1 ? "" : "/",
+                     placements == 1 ? "" : control_placement_names[placement]);
+            printf("%-17s", name);
+            for (int target = 0; target < num_qubits && ok; target++) {
+                KernelRun run = {sv, kernel_class, placement, target};
+                BenchStats stats;
+                ok = bench_measure(kernel_run_body, &run, BENCH_RUN_WARMUP, repeats, &stats);
+                if (!ok) break;
+                double ns_per_amplitude = stats.median * 1e9 / (double)sv->dimension;
+                printf("%7.3f", ns_per_amplitude);
+
+                char label[BENCH_LABEL_LENGTH];
+                snprintf(label, sizeof(label), "%s/%d", name, target);
+                BenchResult* result = bench_report_add(report, label, &stats);
+                bench_result_value(result, "num_qubits", num_qubits);
+                bench_result_value(result, "target", target);
+                bench_result_value(result, "ns_per_amplitude", ns_per_amplitude);
+            }
+            printf("\n");
+        }
+    }
+
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+    free_statevector(sv);
+}
+
+// Precision benchmark
+
+// A plan on a float state, continuing from the current state
+typedef struct {
+    const CircuitPlan* plan;
+    StatevectorF32* sv;
+    bool ok;
+} PlanF32Run;
+
+static void plan_f32_run_body(void* context) {
+    PlanF32Run* run = context;
+    run->ok = execute_plan_f32(run->plan, run->sv, NULL) && run->ok;
+}
+
+// Runs the rotation circuit in double, single and mixed precision and reports the time of
+// each with the fidelity of the float results against the double one and their norm
+// drift, both taken after one run from |0...0⟩ before the timed runs. Sizes where the
+// double state no longer fits run in float only.
+void run_precision_benchmark(int min_qubits, int max_qubits, int depth) {
+    if (min_qubits < 2 || max_qubits < min_qubits || depth < 1) {
+        fprintf(stderr, "Error: Invalid parameters for precision benchmark\n");
+        return;
+    }
+    BenchReport* report = create_bench_report("precision");
+    if (!report) return;
+    size_t memory = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE);
+    printf("%-8s %-8s %12s %12s %12s\n", "qubits", "mode", "time (s)", "1 - fidelity", "norm drift");
+
+    bool ok = true;
+    for (int num_qubits = min_qubits; num_qubits <= max_qubits && ok; num_qubits++) {
+        // Leave a quarter of the memory to everything else, as the blocking benchmark does
+        size_t f32_bytes = statevector_f32_bytes(num_qubits);
+        bool with_double = statevector_bytes(num_qubits) + f32_bytes <= memory / 4 * 3;
+        if (f32_bytes > memory / 4 * 3) {
+            printf("%-8d skipped, needs %zu MiB\n", num_qubits, f32_bytes >> 20);
+            continue;
+        }
+        Circuit* circuit = build_rotation_circuit(num_qubits, depth);
+        CircuitPlan plan;
+        if (!circuit || !compile_circuit(circuit, 0, &plan)) {
+            fprintf(stderr, "Error: Failed to set up precision benchmark\n");
+            free_circuit(circuit);
+            ok = false;
+            break;
+        }
+
+        Statevector* reference = NULL;
+        double double_time = -1.0;
+        if (with_double && (reference = create_statevector(num_qubits))) {
+            BenchPlanRun run = {&plan, reference};
+            BenchStats stats;
+            ok = bench_measure_run(bench_plan_body, &run, &stats);
+            // The timed runs continued from |0...0⟩; the reference is the result of one run
+            initialize_statevector(reference);
+            execute_plan(&plan, reference, NULL);
+            double norm = statevector_norm(reference);
+            double drift = fabs(norm * norm - 1.0);
+            if (ok) {
+                double_time = stats.median;
+                printf("%-8d %-8s %12.6f %12s %12.3e\n", num_qubits, "double", double_time, "-", drift);
+                BenchResult* result = bench_report_add(report, "double", &stats);
+                bench_result_value(result, "num_qubits", num_qubits);
+                bench_result_value(result, "gates", plan.num_steps);
+                bench_result_value(result, "norm_drift", drift);
+            }
+        }
+
+        for (int p = PRECISION_SINGLE; p <= PRECISION_MIXED && ok; p++) {
+            StatevectorF32* sv = create_statevector_f32(num_qubits, (Precision)p);
+            if (!sv) break;
+            PlanF32Run run = {&plan, sv, true};
+            plan_f32_run_body(&run);
+            double infidelity = reference ? 1.0 - fidelity_f32(reference, sv) : -1.0;
+            double drift = check_norm_drift(sv, NORM_DRIFT_TOLERANCE);
+            BenchStats stats;
+            ok = bench_measure_run(plan_f32_run_body, &run, &stats) && run.ok;
+            free_statevector_f32(sv);
+            if (!ok) break;
+
+            printf("%-8d %-8s %12.6f ", num_qubits, precision_name((Precision)p), stats.median);
+            if (reference) printf("%12.3e", infidelity); else printf("%12s", "-");
+            printf(" %12.3e", drift);
+            if (double_time > 0) printf("  (%.2fx)", double_time / stats.median);
+            printf("\n");
+            BenchResult* result = bench_report_add(report, precision_name((Precision)p), &stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "gates", plan.num_steps);
+            bench_result_value(result, "norm_drift", drift);
+            if (reference) bench_result_value(result, "infidelity", infidelity);
+            if (double_time > 0) bench_result_value(result, "speedup", double_time / stats.median);
+        }
+
+        free_statevector(reference);
+        free_circuit_plan(&plan);
+        free_circuit(circuit);
+    }
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+}
+
+// Distributed benchmark
+
+// The plan between two barriers, so that rank 0 times the slowest rank
+typedef struct {
+    const CircuitPlan* plan;
+    DistributedStatevector* ds;
+    bool ok;
+} DistributedRun;
+
+static void distributed_run_body(void* context) {
+    DistributedRun* run = context;
+    Transport* transport = run->ds->transport;
+    bool ok = transport->barrier(transport);
+    ok = ok && execute_plan_distributed(run->plan, run->ds, NULL);
+    ok = transport->barrier(transport) && ok;
+    run->ok = ok && run->ok;
+}
+
+// Weak scaling: every rank keeps 2^local_qubits amplitudes, so each doubling of the rank
+// count adds one global qubit. With more ranks than cores the ranks share the cores and
+// the efficiency shows the communication and the oversubscription together. The
+// exchanges, data sent and norm drift are those of one run from |0...0⟩ before the timed
+// runs. Each trial is a single run: bench_measure would calibrate the calls per trial on
+// every rank separately, and ranks that disagreed would wait at different barriers.
+void run_distributed_benchmark(int local_qubits, int max_ranks, int depth) {
+    if (local_qubits < MIN_DISTRIBUTED_LOCAL_QUBITS || max_ranks < 1 || max_ranks > MAX_RANKS || depth < 1) {
+        fprintf(stderr, "Error: Invalid parameters for distributed benchmark\n");
+        return;
+    }
+    // Created before the ranks fork, which only rank 0 adds to
+    BenchReport* report = create_bench_report("distributed");
+    if (!report) return;
+    size_t memory = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE);
+    printf("%-6s %-7s %12s %10s %14s %11s\n", "ranks", "qubits", "time (s)", "exchanges", "MiB per rank", "efficiency");
+
+    bool ok = true;
+    double base_time = -1.0;
+    for (int num_ranks = 1, global_qubits = 0; num_ranks <= max_ranks && ok; num_ranks *= 2, global_qubits++) {
+        int num_qubits = local_qubits + global_qubits;
+        if (statevector_bytes(local_qubits) * (size_t)num_ranks > memory / 4 * 3) {
+            printf("%-6d skipped, needs %zu MiB\n", num_ranks, (statevector_bytes(local_qubits) * num_ranks) >> 20);
+            break;
+        }
+        Circuit* circuit = build_rotation_circuit(num_qubits, depth);
+        CircuitPlan plan;
+        if (!circuit || !compile_circuit(circuit, 0, &plan)) {
+            fprintf(stderr, "Error: Failed to set up distributed benchmark\n");
+            free_circuit(circuit);
+            ok = false;
+            break;
+        }
+
+        Transport* transport = create_shm_transport(num_ranks);
+        if (!transport) {
+            free_circuit_plan(&plan);
+            free_circuit(circuit);
+            ok = false;
+            break;
+        }
+        DistributedStatevector* ds = create_distributed_statevector(num_qubits, transport);
+        if (ds) {
+            DistributedRun run = {&plan, ds, true};
+            distributed_run_body(&run);
+            DistributedStats sent = ds->stats;
+            double norm = distributed_norm(ds);
+            BenchStats stats;
+            bool timed = bench_measure_calls(distributed_run_body, &run, BENCH_RUN_WARMUP, BENCH_RUN_TRIALS, 1,
+                                             &stats) && run.ok;
+
+            if (transport->rank == 0 && timed) {
+                if (base_time < 0) base_time = stats.median;
+                double mib_sent = sent.bytes_sent / (1024.0 * 1024.0);
+                printf("%-6d %-7d %12.6f %10d %14.1f %10.1f%%\n", num_ranks, num_qubits, stats.median,
+                       sent.num_exchanges, mib_sent, 100.0 * base_time / stats.median);
+
+                char label[BENCH_LABEL_LENGTH];
+                snprintf(label, sizeof(label), "ranks/%d", num_ranks);
+                BenchResult* result = bench_report_add(report, label, &stats);
+                bench_result_value(result, "ranks", num_ranks);
+                bench_result_value(result, "num_qubits", num_qubits);
+                bench_result_value(result, "gates", plan.num_steps);
+                bench_result_value(result, "exchanges", sent.num_exchanges);
+                bench_result_value(result, "mib_sent", mib_sent);
+                bench_result_value(result, "efficiency", base_time / stats.median);
+                bench_result_value(result, "norm_drift", fabs(norm * norm - 1.0));
+            }
+            free_distributed_statevector(ds);
+        }
+        // The other ranks exit here
+        bool finished = finish_shm_transport(transport);
+        free_circuit_plan(&plan);
+        free_circuit(circuit);
+        if (!finished) {
+            fprintf(stderr, "Error: Distributed run on %d ranks failed\n", num_ranks);
+            ok = false;
+        }
+    }
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+}
+
+// k-qubit gate benchmark
+
+// One gate of a decomposed k-qubit unitary: a single-qubit gate, or a CNOT if control is set
+typedef struct {
+    QuantumGate gate;
+    int control;
+    int target;
+} DecomposedGate;
+
+// k + 1 layers of random RY-RZ rotations on every qubit with CNOT ladders between them,
+// on qubits 0..k-1. Returns the number of gates written to sequence.
+static int build_decomposed_unitary(int k, DecomposedGate* sequence) {
+    int count = 0;
+    for (int layer = 0; layer <= k; layer++) {
+        for (int q = 0; q < k; q++) {
+            double a = (double)(benchmark_random() % 6283) / 1000.0;
+            double b = (double)(benchmark_random() % 6283) / 1000.0;
+            QuantumGate ry = get_ry_gate(a), rz = get_rz_gate(b);
+            QuantumGate gate;
+            for (int r = 0; r < 2; r++) {
+                for (int c = 0; c < 2; c++) {
+                    Complex z = rz.elements[r][r], y = ry.elements[r][c];
+                    gate.elements[r][c] = (Complex){z.real * y.real - z.imag * y.imag, z.real * y.imag + z.imag * y.real};
+                }
+            }
+            sequence[count++] = (DecomposedGate){gate, NO_CONTROL, q};
+        }
+        if (layer < k) {
+            for (int q = 0; q + 1 < k; q++) sequence[count++] = (DecomposedGate){{{{{0}}}}, q, q + 1};
+        }
+    }
+    return count;
+}
+
+static bool apply_decomposed(Statevector* sv, const DecomposedGate* sequence, int count, const int* qubits) {
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        const DecomposedGate* g = &sequence[i];
+        ok = g->control == NO_CONTROL ? apply_single_qubit_gate(sv, g->gate, qubits[g->target])
+                                      : apply_cnot_gate(sv, qubits[g->control], qubits[g->target]);
+    }
+    return ok;
+}
+
+// Column c of the unitary is the sequence applied to |c⟩ of a k-qubit state
+static bool decomposed_matrix(int k, const DecomposedGate* sequence, int count, Complex* matrix) {
+    int size = 1 << k;
+    int qubits[MAX_BLOCK_QUBITS];
+    for (int q = 0; q < k; q++) qubits[q] = q;
+    Statevector* basis = create_statevector(k);
+    if (!basis) return false;
+    for (int c = 0; c < size; c++) {
+        for (int r = 0; r < size; r++) {
+            basis->real[r] = r == c ? 1.0 : 0.0;
+            basis->imag[r] = 0.0;
+        }
+        if (!apply_decomposed(basis, sequence, count, qubits)) {
+            free_statevector(basis);
+            return false;
+        }
+        for (int r = 0; r < size; r++) matrix[(size_t)r * size + c] = (Complex){basis->real[r], basis->imag[r]};
+    }
+    free_statevector(basis);
+    return true;
+}
+
+// The uniform superposition every k-qubit comparison starts from
+static void set_uniform_state(Statevector* sv) {
+    double amplitude = 1.0 / sqrt((double)sv->dimension);
+    for (size_t i = 0; i < sv->dimension; i++) {
+        sv->real[i] = amplitude;
+        sv->imag[i] = 0.0;
+    }
+}
+
+typedef struct {
+    Statevector* sv;
+    const DecomposedGate* sequence;
+    int count;
+    const int* qubits;
+    bool ok;
+} DecomposedRun;
+
+static void decomposed_run_body(void* context) {
+    DecomposedRun* run = context;
+    run->ok = apply_decomposed(run->sv, run->sequence, run->count, run->qubits) && run->ok;
+}
+
+typedef struct {
+    Statevector* sv;
+    const Complex* matrix;
+    const int* qubits;
+    int k;
+    bool ok;
+} DenseRun;
+
+static void dense_run_body(void* context) {
+    DenseRun* run = context;
+    run->ok = apply_k_qubit_gate(run->sv, run->matrix, run->qubits, run->k) && run->ok;
+}
+
+// For k = 1..MAX_BLOCK_QUBITS, a random k-qubit unitary applied as its decomposed sequence
+// of single-qubit gates and CNOTs and as one apply_k_qubit_gate call, on the lowest qubits
+// and on qubits spread over the state. Times are the median of repeats trials; the
+// difference is taken after one application of each to the uniform superposition.
+void run_kqubit_benchmark(int num_qubits, int repeats) {
+    if (num_qubits < 2 * MAX_BLOCK_QUBITS || num_qubits > MAX_QUBITS || repeats < 1) {
+        fprintf(stderr, "Error: Invalid parameters for k-qubit benchmark\n");
+        return;
+    }
+    Statevector* decomposed_sv = create_statevector(num_qubits);
+    Statevector* dense_sv = create_statevector(num_qubits);
+    BenchReport* report = decomposed_sv && dense_sv ? create_bench_report("kqubit") : NULL;
+    if (!report) {
+        fprintf(stderr, "Error: Failed to set up k-qubit benchmark\n");
+        free_statevector(decomposed_sv);
+        free_statevector(dense_sv);
+        return;
+    }
+    printf("%d qubits, %s kernels, median of %d\n", num_qubits, simd_level_name(get_simd_level()), repeats);
+    printf("%-3s %-8s %6s %14s %14s %9s %10s\n", "k", "qubits", "gates", "decomposed (s)", "k-qubit (s)",
+           "speedup", "max diff");
+
+    bool ok = true;
+    DecomposedGate sequence[(MAX_BLOCK_QUBITS + 1) * (2 * MAX_BLOCK_QUBITS - 1)];
+    Complex matrix[1 << (2 * MAX_BLOCK_QUBITS)];
+    for (int k = 1; k <= MAX_BLOCK_QUBITS && ok; k++) {
+        int count = build_decomposed_unitary(k, sequence);
+        if (!decomposed_matrix(k, sequence, count, matrix)) {
+            ok = false;
+            break;
+        }
+        for (int placement = 0; placement < 2 && ok; placement++) {
+            int qubits[MAX_BLOCK_QUBITS];
+            for (int b = 0; b < k; b++) qubits[b] = placement == 0 ? b : b * (num_qubits - 1) / k + 1;
+
+            DecomposedRun decomposed = {decomposed_sv, sequence, count, qubits, true};
+            DenseRun dense = {dense_sv, matrix, qubits, k, true};
+            set_uniform_state(decomposed_sv);
+            set_uniform_state(dense_sv);
+            decomposed_run_body(&decomposed);
+            dense_run_body(&dense);
+            double max_error = 0.0;
+            for (size_t i = 0; i < dense_sv->dimension; i++) {
+                double err = fabs(dense_sv->real[i] - decomposed_sv->real[i]) +
+                             fabs(dense_sv->imag[i] - decomposed_sv->imag[i]);
+                if (err > max_error) max_error = err;
+            }
+
+            BenchStats decomposed_stats, dense_stats;
+            ok = bench_measure(decomposed_run_body, &decomposed, BENCH_RUN_WARMUP, repeats, &decomposed_stats) &&
+                 bench_measure(dense_run_body, &dense, BENCH_RUN_WARMUP, repeats, &dense_stats) &&
+                 decomposed.ok && dense.ok;
+            if (!ok) break;
+
+            const char* where = placement == 0 ? "low" : "spread";
+            double speedup = decomposed_stats.median / dense_stats.median;
+            printf("%-3d %-8s %6d %14.6f %14.6f %8.2fx %10.3e\n", k, where, count, decomposed_stats.median,
+                   dense_stats.median, speedup, max_error);
+
+            char label[BENCH_LABEL_LENGTH];
+            snprintf(label, sizeof(label), "decomposed/%d/%s", k, where);
+            BenchResult* result = bench_report_add(report, label, &decomposed_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "k", k);
+            bench_result_value(result, "gates", count);
+            snprintf(label, sizeof(label), "kqubit/%d/%s", k, where);
+            result = bench_report_add(report, label, &dense_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "k", k);
+            bench_result_value(result, "gates", 1);
+            bench_result_value(result, "speedup", speedup);
+            bench_result_value(result, "max_diff", max_error);
+        }
+    }
+
+    if (ok) write_bench_report(report);
+    free_bench_report(report);
+    free_statevector(decomposed_sv);
+    free_statevector(dense_sv);
+}
+
+// Sampling benchmark
+
+typedef struct {
+    const Statevector* sv;
+    double norm;
+} NormRun;
+
+static void norm_run_body(void* context) {
+    NormRun* run = context;
+    run->norm = statevector_norm(run->sv);
+}
+
+// Draws the shots from the same seed on every call
+typedef struct {
+    const Statevector* sv;
+    uint64_t num_shots;
+    bool ok;
+} SampleRun;
+
+static void sample_run_body(void* context) {
+    SampleRun* run = context;
+    Rng rng;
+    ShotHistogram histogram;
+    rng_seed(&rng, MEASUREMENT_SEED);
+    bool ok = sample_shots(run->sv, run->num_shots, &rng, &histogram);
+    if (ok) free_shot_histogram(&histogram);
+    run->ok = run->ok && ok;
+}
+
+// Compares drawing num_shots samples against one plain pass over the state, which is
+// what every shot would cost if each were drawn with its own cumulative scan
+void run_sampling_benchmark(int num_qubits, uint64_t num_shots) {
+    Circuit* circuit = build_rotation_circuit(num_qubits, 1);
+    Statevector* sv = create_statevector(num_qubits);
+    BenchReport* report = create_bench_report("sampling");
+    CircuitPlan plan;
+    if (!circuit || !sv || !report || num_shots == 0 || !compile_circuit(circuit, 0, &plan)) {
+        fprintf(stderr, "Error: Failed to set up sampling benchmark\n");
+        free_circuit(circuit);
+        free_statevector(sv);
+        free_bench_report(report);
+        return;
+    }
+    execute_plan(&plan, sv, NULL);
+
+    Rng rng;
+    ShotHistogram histogram;
+    rng_seed(&rng, MEASUREMENT_SEED);
+    NormRun norm_run = {sv, 0.0};
+    SampleRun sample_run = {sv, num_shots, true};
+    BenchStats sweep_stats, sample_stats;
+    bool ok = sample_shots(sv, num_shots, &rng, &histogram);
+    if (ok) {
+        ok = bench_measure_run(norm_run_body, &norm_run, &sweep_stats) &&
+             bench_measure_run(sample_run_body, &sample_run, &sample_stats) && sample_run.ok;
+        if (ok) {
+            double sweep_time = sweep_stats.median, sample_time = sample_stats.median;
+            printf("%d qubits (norm %.12f), %llu shots, %zu distinct outcomes\n", num_qubits, norm_run.norm,
+                   (unsigned long long)num_shots, histogram.num_outcomes);
+            printf("One state sweep: %.6f s, sampling: %.6f s (%.2f sweeps, %.1f ns per shot)\n", sweep_time,
+                   sample_time, sample_time / sweep_time, sample_time * 1e9 / (double)num_shots);
+            printf("One scan per shot would take about %.1f s\n", sweep_time * (double)num_shots);
+
+            BenchResult* result = bench_report_add(report, "sweep", &sweep_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            result = bench_report_add(report, "sample", &sample_stats);
+            bench_result_value(result, "num_qubits", num_qubits);
+            bench_result_value(result, "shots", (double)num_shots);
+            bench_result_value(result, "outcomes", (double)histogram.num_outcomes);
+            bench_result_value(result, "sweeps", sample_time / sweep_time);
+            bench_result_value(result, "ns_per_shot", sample_time * 1e9 / (double)num_shots);
+            write_bench_report(report);
+        }
+        if (write_shot_histogram(&histogram, SAMPLE_HISTOGRAM_FILE)) {
+            printf("Histogram written to %s\n", SAMPLE_HISTOGRAM_FILE);
+        }
+        free_shot_histogram(&histogram);
+    }
+
+    free_circuit_plan(&plan);
+    free_circuit(circuit);
+    free_statevector(sv);
+    free_bench_report(report);
 }
 
 // main.c
-int main(void) {
+int main(int argc, char** argv) {
+    // In-place regression benchmark: ./a.out --bench-inplace [min_qubits] [max_qubits]
+    if (argc > 1 && strcmp(argv[1], "--bench-inplace") == 0) {
+        int min_qubits = argc > 2 ? atoi(argv[2]) : 20;
+        int max_qubits = argc > 3 ? atoi(argv[3]) : MAX_QUBITS;
+        run_inplace_benchmark(min_qubits, max_qubits);
+        return 0;
+    }
+
+    // SIMD check: ./a.out --check-simd [num_qubits]
+    if (argc > 1 && strcmp(argv[1], "--check-simd") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 12;
+        return run_simd_check(num_qubits) ? 0 : 1;
+    }
+
+    // Gate fusion benchmark: ./a.out --bench-fusion [num_qubits] [depth] [max_block_qubits]
+    if (argc > 1 && strcmp(argv[1], "--bench-fusion") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 24;
+        int depth = argc > 3 ? atoi(argv[3]) : 10;
+        int max_block_qubits = argc > 4 ? atoi(argv[4]) : 3;
+        run_fusion_benchmark(num_qubits, depth, max_block_qubits);
+        return 0;
+    }
+
+    // Cache blocking benchmark: ./a.out --bench-blocking [min_qubits] [max_qubits] [depth]
+    if (argc > 1 && strcmp(argv[1], "--bench-blocking") == 0) {
+        int min_qubits = argc > 2 ? atoi(argv[2]) : 24;
+        int max_qubits = argc > 3 ? atoi(argv[3]) : 30;
+        int depth = argc > 4 ? atoi(argv[4]) : 10;
+        run_blocking_benchmark(min_qubits, max_qubits, depth);
+        return 0;
+    }
+
+    // Out-of-core benchmark: ./a.out --bench-mapped [num_qubits] [path]
+    if (argc > 1 && strcmp(argv[1], "--bench-mapped") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 32;
+        const char* path = argc > 3 ? argv[3] : MAPPED_STATE_FILE;
+        run_mapped_benchmark(num_qubits, path);
+        return 0;
+    }
+
+    // Kernel microbenchmark: ./a.out --bench-kernels [num_qubits] [repeats]
+    if (argc > 1 && strcmp(argv[1], "--bench-kernels") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 24;
+        int repeats = argc > 3 ? atoi(argv[3]) : 5;
+        run_kernel_benchmark(num_qubits, repeats);
+        return 0;
+    }
+
+    // Sampling benchmark: ./a.out --bench-sampling [num_qubits] [num_shots]
+    if (argc > 1 && strcmp(argv[1], "--bench-sampling") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 28;
+        uint64_t num_shots = argc > 3 ? strtoull(argv[3], NULL, 10) : 1000000;
+        run_sampling_benchmark(num_qubits, num_shots);
+        return 0;
+    }
+
+    // Precision benchmark: ./a.out --bench-precision [min_qubits] [max_qubits] [depth]
+    if (argc > 1 && strcmp(argv[1], "--bench-precision") == 0) {
+        int min_qubits = argc > 2 ? atoi(argv[2]) : 20;
+        int max_qubits = argc > 3 ? atoi(argv[3]) : 30;
+        int depth = argc > 4 ? atoi(argv[4]) : 4;
+        run_precision_benchmark(min_qubits, max_qubits, depth);
+        return 0;
+    }
+
+    // Distributed weak-scaling benchmark: ./a.out --bench-distributed [local_qubits] [max_ranks] [depth]
+    if (argc > 1 && strcmp(argv[1], "--bench-distributed") == 0) {
+        int local_qubits = argc > 2 ? atoi(argv[2]) : 22;
+        int max_ranks = argc > 3 ? atoi(argv[3]) : 8;
+        int depth = argc > 4 ? atoi(argv[4]) : 2;
+        run_distributed_benchmark(local_qubits, max_ranks, depth);
+        return 0;
+    }
+
+    // Diagonal sweep benchmark: ./a.out --bench-diagonal [num_qubits] [depth]
+    if (argc > 1 && strcmp(argv[1], "--bench-diagonal") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 22;
+        int depth = argc > 3 ? atoi(argv[3]) : 2;
+        run_diagonal_benchmark(num_qubits, depth);
+        return 0;
+    }
+
+    // k-qubit gate benchmark: ./a.out --bench-kqubit [num_qubits] [repeats]
+    if (argc > 1 && strcmp(argv[1], "--bench-kqubit") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 24;
+        int repeats = argc > 3 ? atoi(argv[3]) : 5;
+        run_kqubit_benchmark(num_qubits, repeats);
+        return 0;
+    }
+
+    // Gradient benchmark: ./a.out --bench-gradient [min_qubits] [max_qubits] [layers]
+    if (argc > 1 && strcmp(argv[1], "--bench-gradient") == 0) {
+        int min_qubits = argc > 2 ? atoi(argv[2]) : 20;
+        int max_qubits = argc > 3 ? atoi(argv[3]) : 26;
+        int layers = argc > 4 ? atoi(argv[4]) : 2;
+        run_gradient_benchmark(min_qubits, max_qubits, layers);
+        return 0;
+    }
+
+    // Memory placement benchmark: ./a.out --bench-memory [num_qubits] [repeats]
+    if (argc > 1 && strcmp(argv[1], "--bench-memory") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 28;
+        int repeats = argc > 3 ? atoi(argv[3]) : 5;
+        run_memory_benchmark(num_qubits, repeats);
+        return 0;
+    }
+
+    // Clifford benchmark: ./a.out --bench-clifford [max_qubits] [depth]
+    if (argc > 1 && strcmp(argv[1], "--bench-clifford") == 0) {
+        int max_qubits = argc > 2 ? atoi(argv[2]) : 4096;
+        int depth = argc > 3 ? atoi(argv[3]) : 10;
+        run_clifford_benchmark(max_qubits, depth);
+        return 0;
+    }
+
+    // MPS benchmark: ./a.out --bench-mps [max_qubits] [depth] [max_bond]
+    if (argc > 1 && strcmp(argv[1], "--bench-mps") == 0) {
+        int max_qubits = argc > 2 ? atoi(argv[2]) : 100;
+        int depth = argc > 3 ? atoi(argv[3]) : 4;
+        int max_bond = argc > 4 ? atoi(argv[4]) : MPS_DEFAULT_MAX_BOND;
+        run_mps_benchmark(max_qubits, depth, max_bond);
+        return 0;
+    }
+
+    // Batch benchmark: ./a.out --bench-batch [num_qubits] [batch_size] [layers]
+    if (argc > 1 && strcmp(argv[1], "--bench-batch") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 12;
+        int batch_size = argc > 3 ? atoi(argv[3]) : 256;
+        int layers = argc > 4 ? atoi(argv[4]) : 4;
+        run_batch_benchmark(num_qubits, batch_size, layers);
+        return 0;
+    }
+
+    // Noise benchmark: ./a.out --bench-noise [num_qubits] [trajectories] [depth]
+    if (argc > 1 && strcmp(argv[1], "--bench-noise") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 20;
+        int num_trajectories = argc > 3 ? atoi(argv[3]) : 100;
+        int depth = argc > 4 ? atoi(argv[4]) : 4;
+        run_noise_benchmark(num_qubits, num_trajectories, depth);
+        return 0;
+    }
+
+    // Checkpoint benchmark: ./a.out --bench-checkpoint [num_qubits] [path]
+    if (argc > 1 && strcmp(argv[1], "--bench-checkpoint") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 24;
+        const char* path = argc > 3 ? argv[3] : CHECKPOINT_FILE;
+        run_checkpoint_benchmark(num_qubits, path);
+        return 0;
+    }
+
+    // Sparse benchmark: ./a.out --bench-sparse [max_qubits]
+    if (argc > 1 && strcmp(argv[1], "--bench-sparse") == 0) {
+        int max_qubits = argc > 2 ? atoi(argv[2]) : 48;
+        run_sparse_benchmark(max_qubits);
+        return 0;
+    }
+
+    // Benchmark suite: ./a.out --bench-suite [min_qubits] [max_qubits] [trials]
+    if (argc > 1 && strcmp(argv[1], "--bench-suite") == 0) {
+        BenchBackend backend = {"tensor_mult", apply_tensor_op};
+        BenchOptions options = {
+            .min_qubits = argc > 2 ? atoi(argv[2]) : 2,
+            .max_qubits = argc > 3 ? atoi(argv[3]) : 26,
+            .warmup = BENCH_DEFAULT_WARMUP,
+            .trials = argc > 4 ? atoi(argv[4]) : BENCH_DEFAULT_TRIALS,
+            .json_path = SUITE_JSON_FILE,
+            .csv_path = SUITE_CSV_FILE,
+        };
+        return run_benchmark_suite(&backend, &options) ? 0 : 1;
+    }
+
+    // Strong-scaling benchmark: ./a.out --bench-scaling [num_qubits] [max_threads]
+    if (argc > 1 && strcmp(argv[1], "--bench-scaling") == 0) {
+        int num_qubits = argc > 2 ? atoi(argv[2]) : 28;
+        int max_threads = argc > 3 ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        run_scaling_benchmark(num_qubits, max_threads);
+        return 0;
+    }
+
     // Run standard tests for small number of qubits
     for (int num_qubits = 2; num_qubits <= 4; num_qubits++) {
         run_quantum_circuit_test(num_qubits);
@@ -215,13 +1639,18 @@ int main(void) {
 
     // Run performance tests
     printf("\nRunning performance tests...\n");
+    BenchReport* report = create_bench_report(RUNTIME_REPORT);
+    if (!report) return 1;
     for (int num_qubits = 2; num_qubits <= MAX_QUBITS; num_qubits++) {
-        double runtime = measure_circuit_runtime(num_qubits);
-        if (runtime >= 0) {
-            save_runtime_data(num_qubits, runtime);
-            printf("Completed test for %d qubits: %.6f seconds\n", num_qubits, runtime);
+        BenchStats stats;
+        if (measure_circuit_runtime(num_qubits, thread_pool_get_num_threads(), &stats)) {
+            printf("Completed test for %d qubits: %.6f seconds\n", num_qubits, stats.median);
+            char label[BENCH_LABEL_LENGTH];
+            snprintf(label, sizeof(label), "qubits/%d", num_qubits);
+            bench_result_value(bench_report_add(report, label, &stats), "num_qubits", num_qubits);
         }
     }
-
-    return 0;
+    bool ok = write_bench_report(report);
+    free_bench_report(report);
+    return ok ? 0 : 1;
 }
\ No newline at end of file